@@ -0,0 +1,151 @@
+/*
+ * adapter.h - NIC advanced properties ([adapter])
+ */
+
+#ifndef ADAPTER_H
+#define ADAPTER_H
+
+#include "utils.h"
+#include "registry.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define ADAPTER_MAX_PROPERTIES  32
+#define ADAPTER_KEYWORD_LEN     64
+#define ADAPTER_VALUE_LEN       64
+
+/* Network adapter device class; one driver key (0000, 0001, ...) per adapter */
+#define ADAPTER_CLASS_KEY \
+    L"SYSTEM\\CurrentControlSet\\Control\\Class\\{4d36e972-e325-11ce-bfc1-08002be10318}"
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/* One advanced property, by its registry keyword (e.g. *JumboPacket) */
+typedef struct {
+    wchar_t keyword[ADAPTER_KEYWORD_LEN];
+    wchar_t value[ADAPTER_VALUE_LEN];
+} AdapterProperty;
+
+typedef struct {
+    AdapterProperty items[ADAPTER_MAX_PROPERTIES];
+    int count;
+} AdapterPropertyList;
+
+typedef struct {
+    wchar_t keyword[ADAPTER_KEYWORD_LEN];
+    wchar_t value[ADAPTER_VALUE_LEN];       /* Value to write */
+    wchar_t previous[ADAPTER_VALUE_LEN];    /* Value it replaces */
+    int had_previous;                       /* 0: deleted again on restore */
+} AdapterChange;
+
+/*
+ * Property writes planned for one adapter; `written` is set once they are
+ * in the registry and cleared once they are restored
+ */
+typedef struct {
+    wchar_t key[MAX_PATH_LEN];              /* Driver key of the adapter */
+    wchar_t interface_name[MAX_IFACE_LEN];  /* Restarted to reload them */
+    AdapterChange items[ADAPTER_MAX_PROPERTIES];
+    int count;
+    int written;
+} AdapterPlan;
+
+/* ============================================================================
+ * PROPERTY LIST
+ * ============================================================================ */
+
+/*
+ * Set a property by keyword, or by one of the short names (rss_queues,
+ * interrupt_moderation, jumbo_packet, receive_buffers, ...); a later value
+ * for the same keyword replaces the earlier one
+ * Returns 0 on success, -1 if the list is full or a field is too long
+ */
+int adapter_property_set(AdapterPropertyList *list, const wchar_t *key, const wchar_t *value);
+
+/* ============================================================================
+ * REGISTRY ACCESS
+ * ============================================================================ */
+
+/*
+ * Find the driver key of the adapter whose NetCfgInstanceId is `guid`
+ * Returns 0 on success, 1 if no adapter matches, -1 on error
+ */
+int adapter_find_key(const RegistryBackend *reg, const wchar_t *guid,
+                     wchar_t *key, size_t size);
+
+/*
+ * Check a value against the driver's Ndi\Params description of `keyword`
+ * (enum entries, or min/max for numbers)
+ * Returns 0 if accepted, 1 if the driver has no such property, -1 if the
+ * value is not one the driver takes
+ */
+int adapter_check_value(const RegistryBackend *reg, const wchar_t *key,
+                        const wchar_t *keyword, const wchar_t *value);
+
+/*
+ * Check every desired property and keep in `plan` those that differ from
+ * the registry. All problems are reported before returning.
+ * Returns the number of changes, or -1 if any property is rejected
+ */
+int adapter_plan(const RegistryBackend *reg, const wchar_t *key,
+                 const AdapterPropertyList *desired, AdapterPlan *plan);
+
+/*
+ * Write the planned values; a failed write puts back those already written
+ * Returns 0 on success, -1 on failure
+ */
+int adapter_write(const RegistryBackend *reg, AdapterPlan *plan);
+
+/*
+ * Put back the values replaced by adapter_write, if any
+ * Returns 0 on success, -1 if a value could not be restored
+ */
+int adapter_restore(const RegistryBackend *reg, AdapterPlan *plan);
+
+/* ============================================================================
+ * APPLY AND ROLLBACK
+ * ============================================================================ */
+
+/*
+ * Plan, report and write `desired` for the adapter `guid`, then restart the
+ * configured interface (recorded in `plan`) once so the driver picks up every value together
+ * Returns 0 on success (or nothing to do), -1 on failure
+ */
+int adapter_sync(const RegistryBackend *reg, const wchar_t *guid,
+                 const AdapterPropertyList *desired, AdapterPlan *plan);
+
+/*
+ * Restore the values in `plan` and restart the interface they belong to
+ * once more
+ */
+void adapter_undo(const RegistryBackend *reg, AdapterPlan *plan);
+
+/*
+ * Apply [adapter] to the configured interface (system registry)
+ * Returns 0 on success (or nothing to do), -1 on failure
+ */
+int adapter_apply(void);
+
+/*
+ * adapter_apply for the adapter `guid` through `reg`; adapter_rollback
+ * restores through the same backend
+ * Returns 0 on success (or nothing to do), -1 on failure
+ */
+int adapter_apply_to(const RegistryBackend *reg, const wchar_t *guid);
+
+/*
+ * Undo the last adapter_apply, if it wrote anything
+ */
+void adapter_rollback(void);
+
+/*
+ * Drop what the last adapter_apply wrote from the rollback state, so a
+ * later rollback leaves it in place
+ */
+void adapter_forget(void);
+
+#endif /* ADAPTER_H */
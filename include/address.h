@@ -0,0 +1,118 @@
+/*
+ * address.h - IP address parsing and bulk unicast address management
+ */
+
+#ifndef ADDRESS_H
+#define ADDRESS_H
+
+#include "utils.h"
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+/* ============================================================================
+ * ADDRESS TYPES
+ * ============================================================================ */
+
+typedef struct {
+    int family;             /* AF_INET or AF_INET6 */
+    BYTE bytes[16];         /* Network byte order, 4 bytes used for IPv4 */
+    int prefix;             /* Prefix length, -1 if not specified */
+} IpAddr;
+
+typedef struct {
+    IpAddr *items;
+    int count;
+    int capacity;
+    int invalid;            /* Entries that could not be added, see validate_config */
+} IpAddrList;
+
+/* ============================================================================
+ * PARSING AND FORMATTING
+ * ============================================================================ */
+
+/*
+ * Parse "address" or "address/prefix" (IPv4 or IPv6)
+ * Returns 0 on success, -1 on failure
+ */
+int address_parse(const wchar_t *text, IpAddr *out);
+
+/*
+ * Format an address, appending "/prefix" when one is set
+ */
+void address_format(const IpAddr *addr, wchar_t *buffer, size_t size);
+
+/*
+ * Convert an IPv4 or IPv6 socket address (prefix is set to -1)
+ * Returns 0 on success, -1 for other families
+ */
+int address_from_sockaddr(const SOCKADDR *sa, IpAddr *out);
+
+/*
+ * Check whether `addr` lies inside `network`/prefix (no prefix = host)
+ * Returns 1 if it does, 0 otherwise
+ */
+int address_in_prefix(const IpAddr *addr, const IpAddr *network);
+
+/*
+ * Order addresses by family, then bytes (prefix is ignored)
+ * Returns <0, 0 or >0 like memcmp
+ */
+int address_compare(const IpAddr *a, const IpAddr *b);
+
+/*
+ * Convert a dotted IPv4 netmask to a prefix length
+ * Returns prefix length, or -1 if the mask is invalid or not contiguous
+ */
+int address_mask_to_prefix(const wchar_t *mask);
+
+/* ============================================================================
+ * ADDRESS LISTS
+ * ============================================================================ */
+
+/*
+ * Append an address to a list (grows as needed)
+ * Returns 0 on success, -1 on allocation failure
+ */
+int address_list_add(IpAddrList *list, const IpAddr *addr);
+
+/*
+ * Release list storage
+ */
+void address_list_free(IpAddrList *list);
+
+/*
+ * Load addresses from a file, one per line (';' and '#' start comments)
+ * Entries that do not parse or whose family differs from `family` are
+ * skipped and counted in list->invalid
+ * Returns number of addresses loaded, or -1 if the file cannot be read
+ */
+int address_list_load_file(IpAddrList *list, const wchar_t *filepath, int family);
+
+/*
+ * Compute the changes needed to turn `current` into `desired`
+ * Both lists are sorted in place. An address whose prefix differs is
+ * reported in both to_remove and to_add.
+ * Returns 0 on success, -1 on allocation failure
+ */
+int address_diff(IpAddrList *desired, IpAddrList *current,
+                 IpAddrList *to_add, IpAddrList *to_remove);
+
+/* ============================================================================
+ * UNICAST TABLE SYNCHRONIZATION
+ * ============================================================================ */
+
+/*
+ * Read manually configured unicast addresses of the interface
+ * Returns 0 on success, -1 on failure
+ */
+int address_get_manual(int family, IpAddrList *out);
+
+/*
+ * Bring the interface's manual addresses in line with `desired`
+ * Missing entries are added and extra entries removed in one pass
+ * through the IP Helper API (no netsh spawns).
+ * Returns 0 on success, -1 on failure
+ */
+int address_sync(int family, const IpAddrList *desired);
+
+#endif /* ADDRESS_H */
@@ -0,0 +1,87 @@
+/*
+ * batch.h - Batch mode: JSON Lines jobs from stdin, one result line each
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include "utils.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define BATCH_LINE_SIZE         4096
+#define BATCH_RESULT_SIZE       (BATCH_LINE_SIZE + 8192)
+#define BATCH_ID_LEN            128     /* Raw JSON token */
+#define BATCH_FIELD_LEN         64
+#define BATCH_MAX_INTERFACES    64
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+typedef enum {
+    BATCH_OP_APPLY,         /* Configure a provider's DNS + DoH */
+    BATCH_OP_STATUS         /* Report the encryption status */
+} BatchOp;
+
+/*
+ * One line of input, e.g.
+ *   {"id": 7, "op": "apply", "interface": "Ethernet", "provider": "cloudflare"}
+ */
+typedef struct {
+    char id[BATCH_ID_LEN];              /* Echoed as given; empty if absent */
+    BatchOp op;
+    wchar_t interface_name[MAX_IFACE_LEN];
+    wchar_t provider[BATCH_FIELD_LEN];
+    int dns_only;                       /* -1 = as configured */
+} BatchJob;
+
+/*
+ * Interface aliases, enumerated once for the whole batch to reject jobs
+ * for unknown interfaces; a job that runs still reads its own interface
+ */
+typedef struct {
+    wchar_t names[BATCH_MAX_INTERFACES][MAX_IFACE_LEN];
+    int count;
+} AdapterSnapshot;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Parse one job line; unknown keys are ignored
+ * Returns 0 on success, -1 with a message in `error`
+ */
+int batch_parse_job(const char *line, BatchJob *job, char *error, size_t error_size);
+
+/*
+ * Enumerate the interface aliases of the system
+ * Returns 0 on success, -1 on failure
+ */
+int batch_snapshot_adapters(AdapterSnapshot *snapshot);
+
+/*
+ * Run one job against the current config and write its result line
+ * (with newline) to `out`
+ * Returns 0 if the job succeeded, 1 if it failed
+ */
+int batch_run_job(const BatchJob *job, const AdapterSnapshot *snapshot, char *out, size_t size);
+
+/*
+ * Run every job read from `in`, streaming result lines to `out`; blank
+ * lines are skipped, and a malformed line fails only its own job
+ * Returns the number of failed jobs
+ */
+int batch_run_stream(FILE *in, FILE *out, const AdapterSnapshot *snapshot);
+
+/*
+ * Run batch mode on stdin/stdout; progress output goes to stderr
+ * Returns 0 if every job succeeded, 1 otherwise
+ */
+int batch_run(void);
+
+#endif /* BATCH_H */
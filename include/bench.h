@@ -0,0 +1,84 @@
+/*
+ * bench.h - Resolver benchmark (dns-bench mode)
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "utils.h"
+#include "probe.h"
+#include "histogram.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define BENCH_DEFAULT_CONCURRENCY   4
+#define BENCH_DEFAULT_DURATION_MS   10000
+#define BENCH_DEFAULT_TIMEOUT_MS    2000
+#define BENCH_DEFAULT_UNCACHED      50
+#define BENCH_MAX_CONCURRENCY       64
+#define BENCH_URL_LEN               256
+
+/* ============================================================================
+ * BENCHMARK TYPES
+ * ============================================================================ */
+
+typedef enum {
+    BENCH_UDP,
+    BENCH_DOH
+} BenchTransport;
+
+typedef struct {
+    BenchTransport transport;
+    wchar_t server[MAX_ADDR_LEN];       /* Server address (label for DoH) */
+    unsigned short port;                /* UDP only, 0 means DNS_PORT */
+    wchar_t url[BENCH_URL_LEN];         /* DoH only: template URL */
+} BenchTarget;
+
+typedef struct {
+    int concurrency;                    /* Parallel workers, each with one query in flight */
+    int duration_ms;
+    int timeout_ms;                     /* Per query */
+    int uncached_percent;               /* Share of random, never-cached names */
+    char names[PROBE_MAX_NAMES][PROBE_NAME_LEN];
+    int name_count;
+} BenchOptions;
+
+typedef struct {
+    Histogram latency;                  /* Microseconds, every answered query */
+    ULONGLONG sent;
+    ULONGLONG answered;
+    ULONGLONG timeouts;
+    ULONGLONG errors;                   /* Send failures, HTTP errors, bad answers */
+    ULONGLONG server_failures;          /* Answered with SERVFAIL or REFUSED */
+    double elapsed_ms;
+} BenchResult;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Fill in default concurrency, duration, timeout and query names
+ */
+void bench_options_init(BenchOptions *opts);
+
+/*
+ * Run `opts->concurrency` workers against one target for the duration
+ * Returns 0 on success, -1 if the benchmark could not be started
+ */
+int bench_measure(const BenchTarget *target, const BenchOptions *opts, BenchResult *result);
+
+/*
+ * Print throughput, error rates and the latency distribution
+ */
+void bench_print_result(const BenchTarget *target, const BenchResult *result);
+
+/*
+ * Run dns-bench mode against the servers configured on the interface
+ * Returns 0 on success, 1 on failure
+ */
+int bench_run(void);
+
+#endif /* BENCH_H */
@@ -6,11 +6,45 @@
 #define CONFIG_H
 
 #include "utils.h"
+#include "address.h"
+#include "route.h"
+#include "nrpt.h"
+#include "probe.h"
+#include "watch.h"
+#include "profile.h"
+#include "serve.h"
+#include "export.h"
+#include "history.h"
+#include "retry.h"
+#include "ready.h"
+#include "warmup.h"
+#include "health.h"
+#include "metrics.h"
+#include "tcp.h"
+#include "adapter.h"
+#include "dnscache.h"
+#include "fastpath.h"
+#include "prefix.h"
+#include "mtu.h"
+#include "suffix.h"
+
+#define MAX_PROVIDERS       16
+#define MAX_PROVIDER_NAME   64
 
 /* ============================================================================
  * CONFIGURATION STRUCTURE
  * ============================================================================ */
 
+/* Extra DNS provider from a [provider.NAME] section */
+typedef struct {
+    wchar_t name[MAX_PROVIDER_NAME];
+    wchar_t ipv4_primary[MAX_ADDR_LEN];
+    wchar_t ipv4_secondary[MAX_ADDR_LEN];
+    wchar_t ipv6_primary[MAX_ADDR_LEN];
+    wchar_t ipv6_secondary[MAX_ADDR_LEN];
+    wchar_t doh_template[256];
+} ProviderConfig;
+
 typedef struct {
     /* Interface */
     wchar_t interface_name[MAX_IFACE_LEN];
@@ -19,11 +53,17 @@ typedef struct {
     wchar_t ipv4_address[MAX_ADDR_LEN];
     wchar_t ipv4_mask[MAX_ADDR_LEN];
     wchar_t ipv4_gateway[MAX_ADDR_LEN];
+    IpAddrList ipv4_addresses;      /* Secondary addresses ([ipv4.addresses]) */
 
     /* IPv6 */
     wchar_t ipv6_address[MAX_ADDR_LEN];
     wchar_t ipv6_prefix[16];
     wchar_t ipv6_gateway[MAX_ADDR_LEN];
+    IpAddrList ipv6_addresses;      /* Secondary addresses ([ipv6.addresses]) */
+
+    /* Static routes ([routes]) */
+    RouteList routes;
+    int routes_prune;
 
     /* DNS servers */
     wchar_t dns_ipv4_primary[MAX_ADDR_LEN];
@@ -31,11 +71,88 @@ typedef struct {
     wchar_t dns_ipv6_primary[MAX_ADDR_LEN];
     wchar_t dns_ipv6_secondary[MAX_ADDR_LEN];
 
+    /* DNS suffix search list ([dns] suffixes) */
+    SuffixList dns_suffixes;
+    int has_suffixes;
+
+    /* LLMNR, NetBIOS and mDNS fallbacks turned off ([dns] fast_path) */
+    FastPathScope fast_path;
+
+    /* Per-namespace DNS policy ([nrpt]) */
+    NrptRuleList nrpt_rules;
+
     /* DoH settings */
     wchar_t doh_template[256];
     int doh_autoupgrade;
     int doh_fallback;
 
+    /* Candidate providers and probe settings for auto mode */
+    ProviderConfig providers[MAX_PROVIDERS];
+    int provider_count;
+    ProbeOptions probe;
+
+    /* Provider enforced by watch mode (--provider or [watch]) */
+    wchar_t provider_name[MAX_PROVIDER_NAME];
+    WatchOptions watch;
+
+    /* Fallback provider and thresholds for health mode ([health]) */
+    wchar_t health_fallback[MAX_PROVIDER_NAME];
+    HealthOptions health;
+
+    /* Site profiles ([profile.NAME]); profile_name forces one (--profile) */
+    Profile profiles[MAX_PROFILES];
+    int profile_count;
+    wchar_t profile_name[PROFILE_NAME_LEN];
+
+    /* Status output and the local status server ([serve]) */
+    int status_json;                /* --json */
+    int status_server;              /* --server: ask a running serve instance */
+    int suffix_cost;                /* --suffix-cost: time each search suffix */
+    wchar_t serve_pipe[SERVE_PIPE_NAME_LEN];
+    int serve_interval;             /* Seconds between refreshes */
+
+    /* Status exporter ([export]) */
+    wchar_t export_file[MAX_PATH_LEN];
+    ExportFormat export_format;
+    int export_interval;            /* Seconds between rewrites, 0 = once */
+
+    /* Status history ring ([history]) */
+    wchar_t history_file[MAX_PATH_LEN];
+    int history_capacity;           /* Records in a new ring file */
+
+    /* Global TCP settings applied with the provider ([tcp], --tcp-KEY) */
+    TcpSettings tcp;
+
+    /* Advanced properties of the interface's NIC ([adapter]) */
+    AdapterPropertyList adapter;
+
+    /* DNS Client cache limits ([resolver_cache]) */
+    DnsCacheSettings resolver_cache;
+
+    /* IPv6 address selection table ([prefix_policy]) */
+    PrefixPreference prefix_preference;
+    PrefixPolicyTable prefix_policies;      /* policy lines, for custom */
+
+    /* Retry policies per netsh step ([retry.address], [retry.dns], [retry.doh], [retry.tcp]) */
+    RetryPolicy retry[RETRY_STEP_COUNT];
+
+    /* Gateway measurement and metric ranks for metrics mode ([metrics]) */
+    MetricsOptions metrics;
+
+    /* Path MTU search for mtu mode ([mtu]) */
+    MtuOptions mtu;
+
+    /* dns-bench options (0 = default) */
+    int bench_concurrency;
+    int bench_duration;             /* Seconds per server */
+
+    /* Wait for the static addresses after applying them (--wait-ready) */
+    int wait_ready;
+    int ready_timeout;              /* Seconds */
+
+    /* Names resolved after applying a provider ([warmup]) */
+    WarmupOptions warmup;
+
     /* Flags */
     int dns_only;
     int has_ipv4;
@@ -57,6 +174,19 @@ typedef enum {
     MODE_CLOUDFLARE,
     MODE_GOOGLE,
     MODE_CUSTOM,
+    MODE_AUTO,
+    MODE_BENCH,
+    MODE_WATCH,
+    MODE_HEALTH,
+    MODE_METRICS,
+    MODE_METRICS_RESTORE,
+    MODE_MTU,
+    MODE_PREFIX_PROBE,
+    MODE_PROFILE,
+    MODE_SERVE,
+    MODE_EXPORT,
+    MODE_HISTORY,
+    MODE_BATCH,
     MODE_STATUS
 } RunMode;
 
@@ -31,10 +31,33 @@ extern const DnsProvider DNS_GOOGLE;
  * PROVIDER FUNCTIONS
  * ============================================================================ */
 
+/*
+ * Look up a provider by name: cloudflare, google, custom (the [dns] and
+ * [doh] sections) or a [provider.NAME] section, case-insensitive
+ * Returns 0 on success, -1 if there is no such provider
+ */
+int dns_find_provider(const wchar_t *name, DnsProvider *out);
+
+/*
+ * Apply the configuration with `provider`: free-address discovery and
+ * pre-flight validation, then every apply step in order, rolled back as
+ * a whole on failure, then --wait-ready and the cache warm-up.
+ * `keep_in_place` leaves DNS servers and DoH templates alone where they
+ * already match, instead of setting them again
+ * Returns 0 on success, non-zero on failure
+ */
+int dns_apply(const DnsProvider *provider, int keep_in_place);
+
 /*
  * Run DNS configuration for the given provider
  * Returns 0 on success, non-zero on failure
  */
 int dns_run_provider(const DnsProvider *provider);
 
+/*
+ * Probe the built-in and configured providers and run the fastest one
+ * Returns 0 on success, non-zero on failure
+ */
+int dns_run_auto(void);
+
 #endif /* DNS_H */
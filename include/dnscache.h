@@ -0,0 +1,109 @@
+/*
+ * dnscache.h - DNS Client resolver cache tuning ([resolver_cache])
+ */
+
+#ifndef DNSCACHE_H
+#define DNSCACHE_H
+
+#include "utils.h"
+#include "registry.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+/* Read by the DNS Client service when it starts */
+#define DNSCACHE_REGISTRY_KEY L"SYSTEM\\CurrentControlSet\\Services\\Dnscache\\Parameters"
+
+typedef enum {
+    DNSCACHE_MAX_TTL,           /* Cap on the TTL of a cached answer */
+    DNSCACHE_MAX_NEGATIVE_TTL,  /* Cap on a cached "no such name", 0 = never cached */
+    DNSCACHE_TABLE_SIZE,        /* Hash table buckets */
+    DNSCACHE_BUCKET_SIZE,       /* Entries per bucket */
+    DNSCACHE_SETTING_COUNT
+} DnsCacheSettingId;
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/*
+ * One DWORD per setting; `set` is 0 for a value that is not configured
+ * (desired) or absent from the registry, so the service default (current)
+ */
+typedef struct {
+    DWORD values[DNSCACHE_SETTING_COUNT];
+    int set[DNSCACHE_SETTING_COUNT];
+} DnsCacheSettings;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Set one value by its [resolver_cache] key (max_ttl, max_negative_ttl,
+ * table_size, bucket_size)
+ * Returns 0 on success, -1 on an unknown key or a value out of range
+ */
+int dnscache_set(DnsCacheSettings *settings, const wchar_t *key, const wchar_t *value);
+
+/*
+ * Check whether any value is set
+ */
+int dnscache_any(const DnsCacheSettings *settings);
+
+/*
+ * Display label, registry value name and service default of a setting
+ */
+const wchar_t *dnscache_label(DnsCacheSettingId id);
+const wchar_t *dnscache_value_name(DnsCacheSettingId id);
+DWORD dnscache_default(DnsCacheSettingId id);
+
+/*
+ * Read the values present under DNSCACHE_REGISTRY_KEY
+ * Returns 0 on success, -1 on error
+ */
+int dnscache_read(const RegistryBackend *reg, DnsCacheSettings *out);
+
+/*
+ * Keep in `changes` the desired values that differ from `current`; an
+ * absent value differs from any configured one
+ * Returns the number of differences
+ */
+int dnscache_diff(const DnsCacheSettings *desired, const DnsCacheSettings *current,
+                  DnsCacheSettings *changes);
+
+/*
+ * Write every set value of `changes`; on failure the values already
+ * written are put back to `previous`
+ * Returns 0 on success, -1 on failure
+ */
+int dnscache_write(const RegistryBackend *reg, const DnsCacheSettings *changes,
+                   const DnsCacheSettings *previous);
+
+/*
+ * Put back, for every set value of `changes`, the value in `previous`,
+ * deleting the ones that were absent
+ * Returns 0 on success, -1 if any write failed
+ */
+int dnscache_restore(const RegistryBackend *reg, const DnsCacheSettings *changes,
+                     const DnsCacheSettings *previous);
+
+/*
+ * Apply the differences between [resolver_cache] and the registry,
+ * recording the values they replace for dnscache_rollback
+ * Returns 0 on success (or nothing to do), -1 on failure
+ */
+int dnscache_apply(void);
+
+/*
+ * Put back the values replaced by the last dnscache_apply, if any
+ */
+void dnscache_rollback(void);
+
+/*
+ * Keep the resolver cache values written by the last dnscache_apply
+ */
+void dnscache_forget(void);
+
+#endif /* DNSCACHE_H */
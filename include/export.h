@@ -0,0 +1,53 @@
+/*
+ * export.h - Status exporter (export mode) for monitoring agents
+ */
+
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include "utils.h"
+#include "status.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define EXPORT_DEFAULT_INTERVAL_S   60
+
+typedef enum {
+    EXPORT_PROMETHEUS,      /* node_exporter textfile collector */
+    EXPORT_JSON
+} ExportFormat;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Parse "prometheus" or "json"
+ * Returns 0 on success, -1 for an unknown format
+ */
+int export_parse_format(const wchar_t *text, ExportFormat *format);
+
+/*
+ * Format a report in the given format
+ * Returns the length written, or -1 if the buffer is too small
+ */
+int export_format(const StatusReport *report, ExportFormat format, char *buffer, size_t size);
+
+/*
+ * Replace a file atomically: write "<path>.tmp", then rename it over path.
+ * Readers see either the old or the new content, never a partial file.
+ * Returns 0 on success, -1 on failure
+ */
+int export_write_file(const wchar_t *path, const char *data, size_t len);
+
+/*
+ * Run export mode: write the status of the interface to the export file,
+ * again on every network change and interval, until Ctrl+C (interval 0
+ * writes once)
+ * Returns 0 on success, 1 on failure
+ */
+int export_run(void);
+
+#endif /* EXPORT_H */
@@ -0,0 +1,133 @@
+/*
+ * fastpath.h - Resolver fast path: LLMNR, NetBIOS and mDNS fallbacks ([dns] fast_path)
+ */
+
+#ifndef FASTPATH_H
+#define FASTPATH_H
+
+#include "utils.h"
+#include "registry.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+/* EnableMulticast = 0 turns LLMNR off (machine-wide policy) */
+#define FASTPATH_LLMNR_KEY  L"SOFTWARE\\Policies\\Microsoft\\Windows NT\\DNSClient"
+/* EnableMDNS = 0 turns mDNS off (machine-wide) */
+#define FASTPATH_MDNS_KEY   L"SYSTEM\\CurrentControlSet\\Services\\Dnscache\\Parameters"
+/* Tcpip_{GUID}\NetbiosOptions: 0 = from DHCP, 1 = on, 2 = off (per interface) */
+#define FASTPATH_NETBT_KEY  L"SYSTEM\\CurrentControlSet\\Services\\NetBT\\Parameters\\Interfaces"
+
+typedef enum {
+    FASTPATH_OFF,           /* Fallbacks left alone (default) */
+    FASTPATH_INTERFACE,     /* NetBIOS off on the interface only */
+    FASTPATH_GLOBAL         /* NetBIOS off on every interface */
+} FastPathScope;
+
+typedef enum {
+    FALLBACK_LLMNR,
+    FALLBACK_NETBIOS,
+    FALLBACK_MDNS,
+    FALLBACK_COUNT
+} FallbackId;
+
+typedef enum {
+    FALLBACK_ENABLED,
+    FALLBACK_DISABLED,
+    FALLBACK_FROM_DHCP      /* NetBIOS: the DHCP server decides */
+} FallbackState;
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+typedef struct {
+    wchar_t key[MAX_PATH_LEN];
+    wchar_t name[32];
+    DWORD value;            /* Value to write */
+    DWORD previous;         /* Value it replaces */
+    int had_previous;       /* 0: deleted again on restore */
+} FastPathChange;
+
+/*
+ * Writes planned for one run; `written` is set once they are in the
+ * registry and cleared once they are restored. Global scope plans one
+ * NetBIOS write per interface, so the list grows as needed.
+ */
+typedef struct {
+    FastPathChange *items;
+    int count;
+    int capacity;
+    int written;
+} FastPathPlan;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Parse a fast_path value: no, interface or global
+ * Returns 0 on success, -1 on an unknown value
+ */
+int fastpath_scope_parse(const wchar_t *text, FastPathScope *scope);
+
+/*
+ * Name of a fallback, and text of its state, as status prints them
+ */
+const wchar_t *fastpath_label(FallbackId id);
+const wchar_t *fastpath_state_text(FallbackState state);
+
+/*
+ * Read the state of each fallback; NetBIOS is read for the interface
+ * `guid` ("{...}")
+ * Returns 0 on success, -1 on error
+ */
+int fastpath_read_state(const RegistryBackend *reg, const wchar_t *guid,
+                        FallbackState states[FALLBACK_COUNT]);
+
+/*
+ * Plan the writes that turn the fallbacks off for `scope`: LLMNR and mDNS
+ * always (they have no per-interface switch), NetBIOS on `guid` or on every
+ * interface. Values already off are left out. `plan` starts empty; release
+ * it with fastpath_plan_free.
+ * Returns the number of planned writes, or -1 on error
+ */
+int fastpath_plan(const RegistryBackend *reg, FastPathScope scope, const wchar_t *guid,
+                  FastPathPlan *plan);
+
+/*
+ * Release plan storage
+ */
+void fastpath_plan_free(FastPathPlan *plan);
+
+/*
+ * Write the plan; on failure the values already written are put back
+ * Returns 0 on success, -1 on failure
+ */
+int fastpath_write(const RegistryBackend *reg, FastPathPlan *plan);
+
+/*
+ * Put back the values the plan replaced, if it was written
+ * Returns 0 on success, -1 if any write failed
+ */
+int fastpath_restore(const RegistryBackend *reg, FastPathPlan *plan);
+
+/*
+ * Turn the fallbacks off as [dns] fast_path asks, recording the values
+ * they replace for fastpath_rollback
+ * Returns 0 on success (or not configured), -1 on failure
+ */
+int fastpath_apply(void);
+
+/*
+ * Put back the values replaced by the last fastpath_apply, if any
+ */
+void fastpath_rollback(void);
+
+/*
+ * Drop the plan of the last fastpath_apply; its writes stay in place
+ */
+void fastpath_forget(void);
+
+#endif /* FASTPATH_H */
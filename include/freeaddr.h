@@ -0,0 +1,88 @@
+/*
+ * freeaddr.h - Free address discovery for --ipv4/--ipv6 auto:RANGE
+ */
+
+#ifndef FREEADDR_H
+#define FREEADDR_H
+
+#include "utils.h"
+#include "address.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define FREEADDR_PREFIX         L"auto:"
+#define FREEADDR_MAX_CANDIDATES 4096    /* A /20, or a /116 for IPv6 */
+#define FREEADDR_BATCH          256     /* Candidates probed at once */
+#define FREEADDR_WAIT_MS        250     /* Time given to ARP/ND replies */
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/* Inclusive range of one family; `first` and `last` share the prefix */
+typedef struct {
+    IpAddr first;
+    IpAddr last;
+} FreeAddrRange;
+
+/*
+ * Asks all candidates for their owner at once and reports which answered.
+ * The system backend sends one datagram to each, so the stack resolves
+ * them over ARP or ND in parallel, waits, then reads the neighbor table;
+ * tests plug in a simulated table.
+ * Returns 0 on success (in_use[i] set for every candidate), -1 on error
+ */
+typedef struct {
+    void *ctx;
+    int (*probe)(void *ctx, const IpAddr *candidates, int count, int wait_ms, int *in_use);
+} FreeAddrBackend;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Check whether a configured address asks for discovery ("auto:...")
+ */
+int freeaddr_is_auto(const wchar_t *text);
+
+/*
+ * Parse the RANGE of "auto:RANGE": "FIRST-LAST" or "NETWORK/PREFIX".
+ * A network leaves out its network and broadcast addresses (IPv4) or its
+ * subnet-router anycast address (IPv6).
+ * Returns 0 on success, -1 if invalid, of another family, or larger than
+ * FREEADDR_MAX_CANDIDATES
+ */
+int freeaddr_parse_range(const wchar_t *text, int family, FreeAddrRange *out);
+
+/*
+ * List the addresses of a range in order, leaving out those in `exclude`
+ * Returns the number of candidates
+ */
+int freeaddr_candidates(const FreeAddrRange *range, const IpAddr *exclude, int exclude_count,
+                        IpAddr *out, int max);
+
+/*
+ * Pick the first free candidate: one of `current` (addresses the interface
+ * already holds) if any is a candidate, otherwise the first one nobody
+ * answers for, probing FREEADDR_BATCH at a time
+ * Returns 0 if found, 1 if every candidate is taken, -1 on error
+ */
+int freeaddr_find(const FreeAddrBackend *backend, const IpAddr *candidates, int count,
+                  const IpAddr *current, int current_count, int wait_ms, IpAddr *out);
+
+/*
+ * Initialize a backend that probes through the interface's neighbor table
+ */
+void freeaddr_backend_system(FreeAddrBackend *backend);
+
+/*
+ * Replace an "auto:RANGE" IPv4 or IPv6 address in g_config with the
+ * address found free; other addresses are left alone
+ * Returns 0 on success, -1 on failure (reported)
+ */
+int freeaddr_resolve(void);
+
+#endif /* FREEADDR_H */
@@ -0,0 +1,146 @@
+/*
+ * health.h - Resolver health probing with automatic provider failover
+ */
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include "utils.h"
+#include "probe.h"
+#include "dns.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define HEALTH_DEFAULT_INTERVAL_MS      10000
+#define HEALTH_DEFAULT_TIMEOUT_MS       1000
+#define HEALTH_DEFAULT_WINDOW           6
+#define HEALTH_DEFAULT_MAX_LATENCY_MS   200
+#define HEALTH_DEFAULT_MAX_LOSS_PCT     20
+#define HEALTH_DEFAULT_FAIL_AFTER       3
+#define HEALTH_DEFAULT_RECOVER_AFTER    12
+#define HEALTH_MAX_WINDOW               64
+
+/* Failing back needs the primary this far inside the thresholds */
+#define HEALTH_RECOVER_PCT              80
+
+#define HEALTH_PRIMARY                  0
+#define HEALTH_FALLBACK                 1
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+typedef struct {
+    int interval_ms;        /* Time between probes */
+    int timeout_ms;         /* Wait for each answer */
+    int window;             /* Samples in the rolling window */
+    int max_latency_ms;     /* Median latency above this is a breach */
+    int max_loss_pct;       /* Unanswered share above this is a breach */
+    int fail_after;         /* Breached evaluations in a row before failover */
+    int recover_after;      /* Healthy evaluations in a row before failback */
+} HealthOptions;
+
+typedef struct {
+    int ok;
+    double ms;
+} HealthSample;
+
+typedef struct {
+    int samples;
+    int loss_pct;
+    double median_ms;       /* Over answered samples */
+} HealthSummary;
+
+typedef enum {
+    HEALTH_UNKNOWN,         /* Window less than half full */
+    HEALTH_GOOD,
+    HEALTH_DEGRADED
+} HealthVerdict;
+
+typedef enum {
+    HEALTH_STAY,
+    HEALTH_FAILOVER,
+    HEALTH_FAILBACK
+} HealthAction;
+
+typedef struct {
+    DnsProvider provider;
+    ProbeTarget target;     /* The provider's first configured server */
+    HealthSample window[HEALTH_MAX_WINDOW];
+    int count;
+    int next;
+} HealthUpstream;
+
+typedef struct {
+    HealthUpstream upstreams[2];    /* HEALTH_PRIMARY, HEALTH_FALLBACK */
+    int active;
+    int bad_streak;
+    int good_streak;
+    int switches;
+} HealthMonitor;
+
+/*
+ * Applies `provider` when the monitor switches
+ * Returns 0 on success; on failure the monitor calls it again with the
+ * active provider, to undo the rollback, and stays where it was
+ */
+typedef int (*HealthSwitch)(void *ctx, const DnsProvider *provider);
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Fill in default interval, thresholds and streak lengths
+ */
+void health_options_init(HealthOptions *opts);
+
+/*
+ * Start monitoring with `primary` active
+ * Returns 0 on success, -1 if a provider has no server to probe
+ */
+int health_monitor_init(HealthMonitor *mon, const DnsProvider *primary,
+                        const DnsProvider *fallback);
+
+/*
+ * Add a probe result to an upstream's rolling window
+ */
+void health_record(HealthUpstream *up, const HealthOptions *opts, int ok, double ms);
+
+/*
+ * Summarize an upstream's window
+ */
+void health_summarize(const HealthUpstream *up, HealthSummary *out);
+
+/*
+ * Judge a summary against the thresholds, scaled by `pct` percent
+ * (100 to detect a breach, HEALTH_RECOVER_PCT to confirm recovery)
+ */
+HealthVerdict health_judge(const HealthSummary *summary, const HealthOptions *opts, int pct);
+
+/*
+ * Update the streaks from the current windows and decide whether to
+ * switch. Failover waits for `fail_after` breaches in a row and a
+ * fallback that is not degraded itself; failback waits for
+ * `recover_after` clean evaluations of the primary.
+ */
+HealthAction health_evaluate(HealthMonitor *mon, const HealthOptions *opts);
+
+/*
+ * Probe both upstreams every `interval_ms` until `stop` is set, calling
+ * `on_switch` for each failover and failback
+ * Returns 0 when stopped, -1 if probing could not be set up
+ */
+int health_loop(HealthMonitor *mon, const HealthOptions *opts, const ProbeOptions *probe,
+                HANDLE stop, HealthSwitch on_switch, void *ctx);
+
+/*
+ * Run health mode: watch `primary`, which should already be applied, and
+ * fail over to `fallback` through the normal apply path until Ctrl+C
+ * Returns 0 on a clean stop, 1 on failure
+ */
+int health_run(const DnsProvider *primary, const DnsProvider *fallback);
+
+#endif /* HEALTH_H */
@@ -0,0 +1,65 @@
+/*
+ * histogram.h - Log-linear latency histogram (HDR-style)
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "utils.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+/*
+ * Values below HIST_LINEAR are counted exactly; above that every power of
+ * two is split into HIST_SUB_BUCKETS equal buckets (about 3% precision).
+ */
+#define HIST_LINEAR         64
+#define HIST_SUB_BUCKETS    32
+#define HIST_BUCKETS        (HIST_LINEAR + 58 * HIST_SUB_BUCKETS)
+
+/* ============================================================================
+ * HISTOGRAM TYPE
+ * ============================================================================ */
+
+typedef struct {
+    ULONGLONG counts[HIST_BUCKETS];
+    ULONGLONG total;
+    ULONGLONG min;
+    ULONGLONG max;
+    double sum;
+} Histogram;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+void histogram_init(Histogram *hist);
+
+/*
+ * Record one value (any unit; the benchmark uses microseconds)
+ */
+void histogram_record(Histogram *hist, ULONGLONG value);
+
+/*
+ * Add all counts of `src` to `dst`
+ */
+void histogram_merge(Histogram *dst, const Histogram *src);
+
+/*
+ * Value at the given percentile (0-100), reported as the highest value
+ * equivalent to its bucket and never above the recorded maximum
+ * Returns 0 for an empty histogram
+ */
+ULONGLONG histogram_percentile(const Histogram *hist, double percentile);
+
+double histogram_mean(const Histogram *hist);
+
+/*
+ * Print a percentile distribution; values are divided by `scale` and
+ * shown with `unit` (e.g. 1000.0 and L"ms" for microsecond samples)
+ */
+void histogram_print(const Histogram *hist, double scale, const wchar_t *unit);
+
+#endif /* HISTOGRAM_H */
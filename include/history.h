@@ -0,0 +1,153 @@
+/*
+ * history.h - Status history ring in a memory-mapped file
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "utils.h"
+#include "status.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define HISTORY_MAGIC               0x48464953  /* "SIFH" */
+#define HISTORY_VERSION             1
+#define HISTORY_DEFAULT_CAPACITY    4096        /* 256 KB of records */
+#define HISTORY_MAX_CAPACITY        1048576
+#define HISTORY_IFACE_LEN           24          /* UTF-8 bytes, truncated */
+#define HISTORY_SERVER_SLOTS        (STATUS_MAX_SERVERS * 2)
+
+/* Per-server flags (HistoryRecord.server_flags) */
+#define HISTORY_SERVER_TEMPLATE     0x01
+#define HISTORY_SERVER_AUTOUPGRADE  0x02
+#define HISTORY_SERVER_FALLBACK     0x04
+#define HISTORY_SERVER_ENCRYPTED    0x08
+
+/* Interface flags (HistoryRecord.flags) */
+#define HISTORY_FULLY_ENCRYPTED     0x01
+#define HISTORY_ANY_FALLBACK        0x02
+#define HISTORY_ANY_UNENCRYPTED     0x04
+
+/* Change bitmap against the previous record of the same interface */
+#define HISTORY_CHANGE_SERVERS      0x00000001  /* Server addresses differ */
+#define HISTORY_CHANGE_ENCRYPTED    0x00000002
+#define HISTORY_CHANGE_FALLBACK     0x00000004
+#define HISTORY_CHANGE_UNENCRYPTED  0x00000008
+#define HISTORY_CHANGE_SLOT(i)      (0x00000100u << (i))  /* Flags of server slot i */
+#define HISTORY_CHANGE_FIRST        0x80000000u /* No earlier record in the ring */
+
+/* ============================================================================
+ * FILE LAYOUT
+ * ============================================================================ */
+
+/*
+ * The file is a header followed by `capacity` records. Writers claim a
+ * slot by incrementing `next` and publish the record by writing its
+ * sequence number last, so several processes can append at once and a
+ * reader skips slots that are empty or half written.
+ */
+typedef struct {
+    DWORD magic;
+    DWORD version;
+    DWORD record_size;
+    DWORD capacity;
+    volatile LONGLONG next;             /* Sequence number of the next record */
+    BYTE reserved[40];
+} HistoryHeader;
+
+typedef struct {
+    ULONGLONG sequence;                 /* 1-based; 0 = empty slot */
+    ULONGLONG timestamp;                /* FILETIME of the snapshot */
+    char interface_name[HISTORY_IFACE_LEN];
+    DWORD servers_hash;                 /* FNV-1a of the server addresses */
+    DWORD changes;                      /* HISTORY_CHANGE_* */
+    BYTE ipv4_count;
+    BYTE ipv6_count;
+    BYTE flags;                         /* HISTORY_FULLY_ENCRYPTED, ... */
+    BYTE reserved[5];
+    BYTE server_flags[HISTORY_SERVER_SLOTS];    /* IPv4 slots, then IPv6 */
+} HistoryRecord;
+
+/*
+ * An attached ring; header and records point into the mapped view, or
+ * into any buffer in tests
+ */
+typedef struct {
+    HistoryHeader *header;
+    HistoryRecord *records;
+    HANDLE file;
+    HANDLE mapping;
+} HistoryRing;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Bytes needed for a ring of `capacity` records
+ */
+size_t history_file_size(DWORD capacity);
+
+/*
+ * Attach to a ring in memory: an all-zero block is initialized with
+ * `capacity`, an existing ring keeps its own capacity
+ * Returns 0 on success, -1 if the block holds something else or is too small
+ */
+int history_attach(HistoryRing *ring, void *base, size_t size, DWORD capacity);
+
+/*
+ * Open and map a ring file; a missing file is created only with `create`
+ * Returns 0 on success, -1 on failure (GetLastError() tells a missing file)
+ */
+int history_open(HistoryRing *ring, const wchar_t *path, DWORD capacity, int create);
+
+/*
+ * Unmap and close a ring opened with history_open
+ */
+void history_close(HistoryRing *ring);
+
+/*
+ * Build the record for a report; `prev` is the previous record of the
+ * same interface, or NULL
+ */
+void history_make_record(const StatusReport *report, const HistoryRecord *prev,
+                         HistoryRecord *record);
+
+/*
+ * Append a report to the ring
+ * Returns 0 on success
+ */
+int history_append(HistoryRing *ring, const StatusReport *report);
+
+/*
+ * Number of records the ring currently holds
+ */
+DWORD history_count(const HistoryRing *ring);
+
+/*
+ * The i-th held record, oldest first
+ * Returns NULL for an empty or half-written slot
+ */
+const HistoryRecord *history_get(const HistoryRing *ring, DWORD index);
+
+/*
+ * One line describing a record: time, interface, state and changes
+ */
+void history_format_record(const HistoryRecord *record, wchar_t *buffer, size_t size);
+
+/*
+ * Append a report to the [history] file, if one is configured. The file
+ * stays mapped for the life of the process, so repeated samples from
+ * serve or export only cost the copy.
+ */
+void history_record(const StatusReport *report);
+
+/*
+ * Run history mode: print the transitions recorded in the history file
+ * Returns 0 on success, 1 on failure
+ */
+int history_run(void);
+
+#endif /* HISTORY_H */
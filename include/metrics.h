@@ -0,0 +1,152 @@
+/*
+ * metrics.h - Interface metric tuning from measured gateway latency
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "utils.h"
+#include "address.h"
+#include "probe.h"
+#include "registry.h"
+#include <iphlpapi.h>
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define METRICS_MAX_LINKS           16
+#define METRICS_DEFAULT_PINGS       5
+#define METRICS_DEFAULT_TIMEOUT_MS  1000
+#define METRICS_MAX_PINGS           50
+#define METRICS_DEFAULT_BASE        10      /* Metric of the fastest link */
+#define METRICS_DEFAULT_STEP        10      /* Added per rank */
+
+/* IPv4 and IPv6, in that order */
+#define METRICS_FAMILIES            2
+
+/* Metrics from before the first run, one subkey per interface alias */
+#define METRICS_STATE_KEY           L"SOFTWARE\\static-ip-fix\\Metrics"
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+typedef struct {
+    int automatic;          /* Windows derives the metric from link speed */
+    ULONG metric;
+} MetricSetting;
+
+typedef struct {
+    wchar_t name[MAX_IFACE_LEN];
+    NET_LUID luid;
+    IpAddr gateway;                             /* IPv4 default gateway */
+    ProbeStats rtt;                             /* Echo round trips to the gateway */
+    ULONG metric;                               /* Assigned metric */
+    int has_family[METRICS_FAMILIES];           /* Set while applying */
+    MetricSetting previous[METRICS_FAMILIES];   /* Recorded for rollback */
+} MetricLink;
+
+typedef struct {
+    int pings;              /* Echo requests per gateway */
+    int timeout_ms;         /* Wait per echo */
+    int base;
+    int step;
+} MetricsOptions;
+
+/*
+ * Measures links and reads or writes their metrics. The system backend
+ * uses ICMP echo and the IP Helper interface table; tests plug in a
+ * simulated adapter and latency model.
+ * ping is called from one thread per link; it returns 0 with the round
+ * trip in `rtt_ms`, or -1 if the echo got no answer.
+ * get returns -1 if the family is not enabled on the link.
+ */
+typedef struct {
+    void *ctx;
+    int (*ping)(void *ctx, const MetricLink *link, int timeout_ms, double *rtt_ms);
+    int (*get)(void *ctx, const MetricLink *link, int family, MetricSetting *out);
+    int (*set)(void *ctx, const MetricLink *link, int family, const MetricSetting *setting);
+} MetricsBackend;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Fill in default pings, timeout, base and step
+ */
+void metrics_options_init(MetricsOptions *opts);
+
+/*
+ * Initialize the system backend
+ */
+void metrics_backend_system(MetricsBackend *backend);
+
+/*
+ * Collect the listed adapters that have an IPv4 default gateway
+ * Returns the number of links, -1 on failure
+ */
+int metrics_list_links(MetricLink *links, int max);
+
+/*
+ * Ping every link's gateway `opts->pings` times, all links at once,
+ * and fill in their `rtt`
+ * Returns 0 on success, -1 if the measurement could not be started
+ */
+int metrics_measure(const MetricsBackend *backend, MetricLink *links, int count,
+                    const MetricsOptions *opts);
+
+/*
+ * Rank the links by median round trip (links that lost more than half their
+ * echoes last) and assign base, base + step, ... in that order
+ * `order` receives the link indexes from fastest to slowest
+ */
+void metrics_assign(MetricLink *links, int count, const MetricsOptions *opts, int *order);
+
+/*
+ * Record each link's current metrics and set the assigned ones on every
+ * enabled family. If a write fails, the recorded metrics are restored.
+ * Returns 0 on success, -1 on failure
+ */
+int metrics_apply(const MetricsBackend *backend, MetricLink *links, int count);
+
+/*
+ * Restore the metrics recorded by metrics_apply
+ * Returns the number of settings that could not be restored
+ */
+int metrics_restore(const MetricsBackend *backend, const MetricLink *links, int count);
+
+/*
+ * Save the metrics recorded by metrics_apply under METRICS_STATE_KEY.
+ * Values saved by an earlier run are kept, so the state stays the one
+ * from before the first run.
+ * Returns 0 on success, -1 if a write failed
+ */
+int metrics_save_state(const RegistryBackend *reg, const MetricLink *links, int count);
+
+/*
+ * Load the saved metrics: `name`, `has_family` and `previous` of each link
+ * Returns the number of links, -1 on failure
+ */
+int metrics_load_state(const RegistryBackend *reg, MetricLink *links, int max);
+
+/*
+ * Forget the saved metrics of one link
+ * Returns 0 on success, -1 on failure
+ */
+int metrics_clear_state(const RegistryBackend *reg, const MetricLink *link);
+
+/*
+ * Run metrics mode: measure all links and prefer the fastest
+ * Returns 0 on success, 1 on failure
+ */
+int metrics_run(void);
+
+/*
+ * Run metrics-restore mode: put back the saved metrics of every link
+ * Returns 0 on success, 1 if a link could not be restored
+ */
+int metrics_restore_run(void);
+
+#endif /* METRICS_H */
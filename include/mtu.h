@@ -0,0 +1,114 @@
+/*
+ * mtu.h - Path MTU probing and interface MTU ([mtu])
+ */
+
+#ifndef MTU_H
+#define MTU_H
+
+#include "utils.h"
+#include "address.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define MTU_MIN_IPV4            576     /* Every IPv4 host must accept this */
+#define MTU_MIN_IPV6            1280    /* IPv6 links cannot go lower */
+#define MTU_MAX                 9000
+#define MTU_DEFAULT_MAX         1500
+#define MTU_DEFAULT_TIMEOUT_MS  1000
+#define MTU_DEFAULT_ATTEMPTS    2
+#define MTU_MAX_ATTEMPTS        5
+#define MTU_ECHO_OVERHEAD       28      /* IPv4 + ICMP echo headers */
+#define MTU_MAX_TARGETS         8
+#define MTU_TARGETS_LEN         256
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+typedef struct {
+    int min;                            /* Known to fit; the search floor */
+    int max;                            /* Largest MTU tried */
+    int timeout_ms;                     /* Wait per probe */
+    int attempts;                       /* Probes per size before it counts as lost */
+    wchar_t targets[MTU_TARGETS_LEN];   /* "gateway", "dns" or IPv4 addresses */
+} MtuOptions;
+
+/* Result of one probe */
+typedef enum {
+    MTU_PROBE_FITS,         /* Echo answered */
+    MTU_PROBE_TOO_BIG,      /* Fragmentation needed, locally or on the path */
+    MTU_PROBE_LOST          /* No answer */
+} MtuProbeResult;
+
+/*
+ * Sends one echo with Don't Fragment set, `size` bytes long at the IP
+ * layer. The system backend uses ICMP echo; tests plug in a simulated
+ * path with a configurable MTU.
+ */
+typedef struct {
+    void *ctx;
+    MtuProbeResult (*probe)(void *ctx, const IpAddr *target, int size, int timeout_ms);
+} MtuBackend;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Fill in default bounds, timeout, attempts and targets ("gateway, dns")
+ */
+void mtu_options_init(MtuOptions *opts);
+
+/*
+ * Initialize the system backend
+ */
+void mtu_backend_system(MtuBackend *backend);
+
+/*
+ * Resolve a target list: "gateway" is `gateway` (skipped if NULL), "dns"
+ * is each of `dns`, anything else must be an IPv4 address. Duplicates
+ * are dropped.
+ * Returns the number of targets, or -1 on an invalid entry
+ */
+int mtu_resolve_targets(const wchar_t *spec, const IpAddr *gateway,
+                        const IpAddr *dns, int dns_count, IpAddr *out, int max);
+
+/*
+ * Binary search the largest packet that reaches `target` unfragmented,
+ * between opts->min and opts->max. A size lost on every attempt counts
+ * as too big, as black-holed packets do. `probes` receives the number
+ * of probes sent.
+ * Returns the path MTU, or -1 if the target does not answer at opts->min
+ */
+int mtu_probe_path(const MtuBackend *backend, const IpAddr *target,
+                   const MtuOptions *opts, int *probes);
+
+/*
+ * Probe every target and report each result
+ * Returns the smallest path MTU, or -1 if no target answered
+ */
+int mtu_discover(const MtuBackend *backend, const IpAddr *targets, int count,
+                 const MtuOptions *opts);
+
+/*
+ * Read the effective MTU of the configured interface for a family
+ * Returns 0 on success, -1 on failure
+ */
+int mtu_read(int family, ULONG *mtu);
+
+/*
+ * Set the MTU of the configured interface through netsh: IPv4, and IPv6
+ * where it is enabled and `mtu` is at least 1280
+ * Returns 0 on success, -1 on failure
+ */
+int mtu_set(int mtu);
+
+/*
+ * MTU mode: probe the targets and set the interface MTU to the result
+ * Returns process exit code
+ */
+int mtu_run(void);
+
+#endif /* MTU_H */
@@ -7,6 +7,7 @@
 
 #include "utils.h"
 #include "config.h"
+#include <iphlpapi.h>
 
 /* ============================================================================
  * DNS SERVER CONSTANTS
@@ -33,11 +34,35 @@ extern const wchar_t *ALL_DNS_SERVERS[];
  * INTERFACE FUNCTIONS
  * ============================================================================ */
 
+/*
+ * Read the adapter table (GetAdaptersAddresses, AF_UNSPEC) with `flags`
+ * Returns the list to release with free(), or NULL on failure
+ */
+IP_ADAPTER_ADDRESSES *network_get_adapters(ULONG flags);
+
+/*
+ * Check whether an adapter is one the tool lists: up, and neither
+ * loopback nor a tunnel
+ */
+int network_adapter_listed(const IP_ADAPTER_ADDRESSES *adapter);
+
 /*
  * List available network interfaces
  */
 void network_list_interfaces(void);
 
+/*
+ * Resolve the configured interface name to its LUID
+ * Returns 0 on success, -1 on failure
+ */
+int network_get_luid(NET_LUID *luid);
+
+/*
+ * Get the adapter GUID ("{...}") of the configured interface
+ * Returns 0 on success, -1 if the interface is not found
+ */
+int network_get_guid(wchar_t *guid, size_t size);
+
 /* ============================================================================
  * ROLLBACK
  * ============================================================================ */
@@ -47,6 +72,12 @@ void network_list_interfaces(void);
  */
 void network_rollback(void);
 
+/*
+ * Keep everything applied so far: the next network_rollback only undoes
+ * module changes made after this call
+ */
+void network_rollback_forget(void);
+
 /* ============================================================================
  * STATIC IP CONFIGURATION
  * ============================================================================ */
@@ -63,10 +94,30 @@ int network_apply_static_ipv4(void);
  */
 int network_apply_static_ipv6(void);
 
+/*
+ * Synchronize secondary addresses from [ipv4.addresses]/[ipv6.addresses]
+ * with the interface's unicast table (primary address is always kept)
+ * Returns 0 on success, -1 on failure
+ */
+int network_apply_secondary_addresses(void);
+
+/*
+ * Synchronize static routes from [routes] with the forwarding table
+ * Returns 0 on success, -1 on failure
+ */
+int network_apply_routes(void);
+
 /* ============================================================================
  * DNS CONFIGURATION
  * ============================================================================ */
 
+/*
+ * Read the DNS servers of the interface in resolver order (IP Helper API,
+ * no netsh spawn)
+ * Returns 0 on success, -1 on failure
+ */
+int network_get_dns_servers(int family, IpAddrList *out);
+
 /*
  * Configure IPv4 DNS servers
  * Returns 0 on success, -1 on failure
@@ -83,6 +134,13 @@ int network_apply_dns_ipv6(const wchar_t *dns1, const wchar_t *dns2);
  * DNS-OVER-HTTPS CONFIGURATION
  * ============================================================================ */
 
+/*
+ * Re-register the DoH template for one server unless it is already in
+ * place with autoupgrade=yes and udpfallback=no
+ * Returns 0 if unchanged, 1 if re-registered, -1 on failure
+ */
+int network_ensure_doh(const wchar_t *server, const wchar_t *doh_template);
+
 /*
  * Configure DoH for all specified DNS servers
  * Returns 0 on success, -1 on failure
@@ -91,4 +149,15 @@ int network_apply_doh(const wchar_t *dns_ipv4_1, const wchar_t *dns_ipv4_2,
                       const wchar_t *dns_ipv6_1, const wchar_t *dns_ipv6_2,
                       const wchar_t *doh_template);
 
+/* ============================================================================
+ * NAME RESOLUTION POLICY
+ * ============================================================================ */
+
+/*
+ * Synchronize [nrpt] rules with the local NRPT store and register DoH
+ * templates for the servers of DoH rules
+ * Returns 0 on success, -1 on failure
+ */
+int network_apply_nrpt(void);
+
 #endif /* NETWORK_H */
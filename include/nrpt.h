@@ -0,0 +1,94 @@
+/*
+ * nrpt.h - Name Resolution Policy Table (per-namespace DNS) rules
+ */
+
+#ifndef NRPT_H
+#define NRPT_H
+
+#include "utils.h"
+#include "registry.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define NRPT_NAMESPACE_LEN  256
+#define NRPT_SERVERS_LEN    512
+#define NRPT_TEMPLATE_LEN   256
+
+/* Local (non-GPO) NRPT store read by the DNS Client service */
+#define NRPT_REGISTRY_KEY \
+    L"SYSTEM\\CurrentControlSet\\Services\\Dnscache\\Parameters\\DnsPolicyConfig"
+
+/* Rules written by this tool carry this key prefix; others are never touched */
+#define NRPT_RULE_PREFIX    L"StaticIpFix-"
+
+/* ============================================================================
+ * RULE TYPES
+ * ============================================================================ */
+
+typedef struct {
+    wchar_t name_space[NRPT_NAMESPACE_LEN];     /* e.g. ".corp.example.com" */
+    wchar_t servers[NRPT_SERVERS_LEN];          /* ';'-separated server list */
+    wchar_t doh_template[NRPT_TEMPLATE_LEN];    /* Empty for plain DNS */
+} NrptRule;
+
+typedef struct {
+    NrptRule *items;
+    int count;
+    int capacity;
+} NrptRuleList;
+
+typedef struct {
+    int added;
+    int updated;
+    int removed;
+    int unchanged;
+    int failed;
+} NrptSyncResult;
+
+/* ============================================================================
+ * PARSING
+ * ============================================================================ */
+
+/*
+ * Build a rule from "namespace" and "server[, server...] [doh=TEMPLATE]"
+ * Returns 0 on success, -1 on failure
+ */
+int nrpt_parse_rule(const wchar_t *name_space, const wchar_t *value, NrptRule *out);
+
+int nrpt_list_add(NrptRuleList *list, const NrptRule *rule);
+void nrpt_list_free(NrptRuleList *list);
+
+/*
+ * Load "namespace = servers [doh=TEMPLATE]" lines from a file
+ * Returns number of rules loaded, or -1 if the file cannot be read
+ */
+int nrpt_list_load_file(NrptRuleList *list, const wchar_t *filepath);
+
+/*
+ * Find a rule by namespace (case-insensitive) in a list sorted by
+ * nrpt_sync/nrpt_read_rules
+ * Returns pointer to the rule or NULL
+ */
+const NrptRule *nrpt_find(const NrptRuleList *list, const wchar_t *name_space);
+
+/* ============================================================================
+ * STORE ACCESS
+ * ============================================================================ */
+
+/*
+ * Read the rules this tool manages, sorted by namespace
+ * Returns 0 on success, -1 on failure
+ */
+int nrpt_read_rules(const RegistryBackend *reg, NrptRuleList *out);
+
+/*
+ * Make the managed rules in the store match `desired` (sorted in place)
+ * Only new or changed rules are written; managed rules that are no
+ * longer desired are deleted.
+ * Returns 0 on success, -1 if any write failed
+ */
+int nrpt_sync(const RegistryBackend *reg, NrptRuleList *desired, NrptSyncResult *result);
+
+#endif /* NRPT_H */
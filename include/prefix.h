@@ -0,0 +1,195 @@
+/*
+ * prefix.h - IPv6 prefix policies for address selection ([prefix_policy])
+ */
+
+#ifndef PREFIX_H
+#define PREFIX_H
+
+#include "utils.h"
+#include "address.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define PREFIX_POLICY_MAX       32
+#define PREFIX_MAX_SERVERS      8
+
+/* IPv6 counts as slower once its median connect time is this much higher */
+#define PREFIX_V6_SLOWER_MS     50.0
+
+typedef enum {
+    PREFIX_NONE,            /* Not configured: the table is left alone */
+    PREFIX_PREFER_V6,       /* The Windows default table */
+    PREFIX_PREFER_V4,       /* Default table with IPv4-mapped above ::/0 */
+    PREFIX_CUSTOM           /* The [prefix_policy] policy lines */
+} PrefixPreference;
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/* One row of "netsh interface ipv6 show prefixpolicies" */
+typedef struct {
+    wchar_t text[MAX_ADDR_LEN];     /* Prefix as written, used in commands */
+    IpAddr prefix;                  /* Parsed, used to compare */
+    int precedence;
+    int label;
+} PrefixPolicy;
+
+typedef struct {
+    PrefixPolicy items[PREFIX_POLICY_MAX];
+    int count;
+} PrefixPolicyTable;
+
+typedef enum {
+    PREFIX_OP_DELETE,
+    PREFIX_OP_SET,
+    PREFIX_OP_ADD
+} PrefixOpKind;
+
+typedef struct {
+    PrefixOpKind kind;
+    PrefixPolicy policy;
+} PrefixOp;
+
+/* Deletes first, so a changed table never holds two rows for a prefix */
+typedef struct {
+    PrefixOp items[2 * PREFIX_POLICY_MAX];
+    int count;
+} PrefixPlan;
+
+/*
+ * Connect latency per address family: every attempt is one TCP connect
+ * to port 53 of a DNS server
+ */
+typedef struct {
+    int attempts;
+    int connected;
+    double median_ms;
+} FamilyLatency;
+
+/*
+ * Times one TCP connect. The system backend uses a non-blocking socket;
+ * tests plug in simulated servers.
+ * Returns the connect time in milliseconds, or -1 if it failed or timed out
+ */
+typedef struct {
+    void *ctx;
+    double (*connect)(void *ctx, const IpAddr *server, int timeout_ms);
+} PrefixProbeBackend;
+
+/* ============================================================================
+ * TABLE
+ * ============================================================================ */
+
+/*
+ * Parse a preference: prefer_v4, prefer_v6 or custom
+ * Returns 0 on success, -1 on an unknown value
+ */
+int prefix_preference_parse(const wchar_t *text, PrefixPreference *out);
+
+/*
+ * Name of a preference, as [prefix_policy] spells it
+ */
+const wchar_t *prefix_preference_name(PrefixPreference preference);
+
+/*
+ * Fill `table` with the preset for prefer_v4 or prefer_v6
+ */
+void prefix_policy_preset(PrefixPreference preference, PrefixPolicyTable *table);
+
+/*
+ * Add a "PREFIX PRECEDENCE LABEL" policy line; a later line for the same
+ * prefix replaces the earlier one
+ * Returns 0 on success, -1 if the line is invalid or the table is full
+ */
+int prefix_policy_add(PrefixPolicyTable *table, const wchar_t *line);
+
+/*
+ * Read the rows of "netsh interface ipv6 show prefixpolicies" output
+ */
+void prefix_policy_parse_netsh(const char *output, PrefixPolicyTable *out);
+
+/*
+ * Tell which preset a table matches; anything else is PREFIX_CUSTOM
+ */
+PrefixPreference prefix_policy_classify(const PrefixPolicyTable *table);
+
+/*
+ * Plan the commands that turn `current` into `desired`
+ * Returns the number of operations
+ */
+int prefix_policy_diff(const PrefixPolicyTable *desired, const PrefixPolicyTable *current,
+                       PrefixPlan *plan);
+
+/*
+ * Build the netsh arguments of one operation
+ * Returns 0 on success, -1 if the command does not fit
+ */
+int prefix_policy_command(const PrefixOp *op, wchar_t *args, size_t size);
+
+/* ============================================================================
+ * APPLY AND ROLLBACK
+ * ============================================================================ */
+
+/*
+ * Read the active table (runs netsh)
+ * Returns 0 on success, -1 on failure
+ */
+int prefix_policy_read(PrefixPolicyTable *out);
+
+/*
+ * Build the table [prefix_policy] asks for
+ * Returns 0 on success, -1 if it is custom and has no policy lines
+ */
+int prefix_policy_desired(PrefixPolicyTable *out);
+
+/*
+ * Apply the differences between [prefix_policy] and the active table,
+ * recording the table they replace for prefix_policy_rollback
+ * Returns 0 on success (or not configured), -1 on failure
+ */
+int prefix_policy_apply(void);
+
+/*
+ * Put back the table replaced by the last prefix_policy_apply, if any
+ */
+void prefix_policy_rollback(void);
+
+/*
+ * Keep the policy table set by the last prefix_policy_apply
+ */
+void prefix_policy_forget(void);
+
+/* ============================================================================
+ * PROBE
+ * ============================================================================ */
+
+/*
+ * Initialize a backend that connects with real sockets
+ */
+void prefix_probe_backend_system(PrefixProbeBackend *backend);
+
+/*
+ * Connect `attempts` times to each server; the median covers the
+ * connects that succeeded
+ */
+void prefix_measure(const PrefixProbeBackend *backend, const IpAddr *servers, int count,
+                    int attempts, int timeout_ms, FamilyLatency *out);
+
+/*
+ * Recommend a preference: prefer_v4 when IPv6 loses more connects than
+ * IPv4, or is PREFIX_V6_SLOWER_MS slower; prefer_v6 otherwise
+ * Returns 0 on success, -1 if there is nothing to compare
+ */
+int prefix_recommend(const FamilyLatency *v4, const FamilyLatency *v6, PrefixPreference *out);
+
+/*
+ * Run prefix-probe mode: measure both families against the interface's
+ * DNS servers and print a recommendation
+ * Returns 0 on success, 1 if nothing could be measured
+ */
+int prefix_probe_run(void);
+
+#endif /* PREFIX_H */
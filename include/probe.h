@@ -0,0 +1,89 @@
+/*
+ * probe.h - Resolver latency probing over plain UDP DNS
+ */
+
+#ifndef PROBE_H
+#define PROBE_H
+
+#include "utils.h"
+#include "address.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define PROBE_DEFAULT_COUNT         5
+#define PROBE_DEFAULT_TIMEOUT_MS    1000
+#define PROBE_MAX_COUNT             100
+#define PROBE_MAX_NAMES             8
+#define PROBE_NAME_LEN              256
+#define PROBE_MAX_TARGETS           32
+
+#define DNS_PORT                    53
+
+/* ============================================================================
+ * PROBE TYPES
+ * ============================================================================ */
+
+typedef struct {
+    const wchar_t *server;      /* IPv4 or IPv6 literal */
+    unsigned short port;        /* 0 means DNS_PORT */
+} ProbeTarget;
+
+typedef struct {
+    int count;                                  /* Queries sent to each target */
+    int timeout_ms;                             /* Wait per round */
+    char names[PROBE_MAX_NAMES][PROBE_NAME_LEN];/* Query names, used in turn */
+    int name_count;
+} ProbeOptions;
+
+typedef struct {
+    int sent;
+    int answered;
+    double median_ms;
+    double p95_ms;
+} ProbeStats;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Fill in the default probe count, timeout and query name
+ */
+void probe_options_init(ProbeOptions *opts);
+
+/*
+ * Encode a recursive A query for `name` with the given transaction ID
+ * Returns the query length, or -1 if the name is invalid or does not fit
+ */
+int probe_build_query(const char *name, unsigned short id, unsigned char *buf, size_t size);
+
+/*
+ * Compute median and p95 (nearest rank) of `n` samples; sorts in place
+ */
+void probe_compute_stats(double *samples, int n, ProbeStats *out);
+
+/*
+ * Open a non-blocking UDP socket connected to the target
+ * Returns the socket, or INVALID_SOCKET on failure
+ */
+SOCKET probe_open_socket(const ProbeTarget *target);
+
+/*
+ * Probe all targets concurrently: each round sends one query to every
+ * target at once and waits up to timeout_ms for the answers.
+ * Unanswered queries count as sent but not answered.
+ * Returns 0 on success, -1 if sockets cannot be set up
+ */
+int probe_run(const ProbeTarget *targets, int count, const ProbeOptions *opts,
+              ProbeStats *stats);
+
+/*
+ * Pick the target with the lowest median (then p95) among those that
+ * answered at least half of their queries
+ * Returns the index, or -1 if no target qualifies
+ */
+int probe_pick_best(const ProbeStats *stats, int count);
+
+#endif /* PROBE_H */
@@ -6,6 +6,29 @@
 #define PROCESS_H
 
 #include "utils.h"
+#include "retry.h"
+
+/* ============================================================================
+ * COMMAND EXECUTOR
+ * ============================================================================ */
+
+/*
+ * Runs the netsh command lines built by the run_netsh* helpers and waits
+ * between retries. The system executor starts processes and sleeps; tests
+ * install a fake that records the commands and returns canned output.
+ */
+typedef struct {
+    void *ctx;
+    int (*run)(void *ctx, wchar_t *cmdline, int silent);
+    int (*capture)(void *ctx, wchar_t *cmdline, char *buffer, size_t buffer_size);
+    void (*sleep)(void *ctx, DWORD ms);
+} CommandExecutor;
+
+/*
+ * Route run_netsh* through `executor` (copied); NULL restores the system
+ * executor. A NULL sleep keeps the real one.
+ */
+void process_set_executor(const CommandExecutor *executor);
 
 /* ============================================================================
  * PROCESS EXECUTION
@@ -36,6 +59,13 @@ int run_netsh(const wchar_t *args);
  */
 void run_netsh_silent(const wchar_t *args);
 
+/*
+ * Execute netsh command, retrying failures that `policy` marks transient
+ * with exponential backoff. The output of a final failure is printed.
+ * Returns 0 on success, the last exit code once retries are exhausted
+ */
+int run_netsh_retry(const RetryPolicy *policy, const wchar_t *args);
+
 /*
  * Execute netsh command and capture output
  * Returns 0 on success, output in buffer
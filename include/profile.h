@@ -0,0 +1,107 @@
+/*
+ * profile.h - Site profiles selected by network fingerprint
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "utils.h"
+#include "address.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define MAX_PROFILES            16
+#define PROFILE_NAME_LEN        64
+#define PROFILE_SUFFIX_LEN      256
+#define FINGERPRINT_MAX_ENTRIES 16
+
+/* ============================================================================
+ * PROFILE TYPES
+ * ============================================================================ */
+
+/*
+ * A [profile.NAME] section. Match criteria are parsed when the INI is
+ * read; a profile matches when every criterion it sets matches, and the
+ * profile with the most criteria wins. A profile without criteria is
+ * the fallback.
+ */
+typedef struct {
+    wchar_t name[PROFILE_NAME_LEN];
+
+    /* Fingerprint criteria (family 0 / empty = not set) */
+    IpAddr gateway;
+    BYTE gateway_mac[6];
+    int has_gateway_mac;
+    IpAddr subnet;                          /* Network address with prefix */
+    wchar_t dns_suffix[PROFILE_SUFFIX_LEN];
+
+    /* Settings applied when the profile is selected */
+    wchar_t ipv4_address[MAX_ADDR_LEN];
+    wchar_t ipv4_mask[MAX_ADDR_LEN];
+    wchar_t ipv4_gateway[MAX_ADDR_LEN];
+    wchar_t ipv6_address[MAX_ADDR_LEN];
+    wchar_t ipv6_prefix[16];
+    wchar_t ipv6_gateway[MAX_ADDR_LEN];
+    wchar_t provider[PROFILE_NAME_LEN];
+    int dns_only;
+} Profile;
+
+/*
+ * One snapshot of the interface, taken from a single adapter query and
+ * a single neighbor table read
+ */
+typedef struct {
+    IpAddr gateways[FINGERPRINT_MAX_ENTRIES];
+    BYTE gateway_macs[FINGERPRINT_MAX_ENTRIES][6];
+    int gateway_has_mac[FINGERPRINT_MAX_ENTRIES];
+    int gateway_count;
+    IpAddr addresses[FINGERPRINT_MAX_ENTRIES];  /* With on-link prefix length */
+    int address_count;
+    wchar_t dns_suffix[PROFILE_SUFFIX_LEN];
+} NetworkFingerprint;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Set one key of a [profile.NAME] section
+ * Returns 0 on success, -1 for an unknown key or invalid value
+ */
+int profile_set(Profile *profile, const wchar_t *key, const wchar_t *value);
+
+/*
+ * Parse "aa:bb:cc:dd:ee:ff" (':' or '-' separators)
+ * Returns 0 on success, -1 on failure
+ */
+int profile_parse_mac(const wchar_t *text, BYTE mac[6]);
+
+/*
+ * Score a profile against a fingerprint
+ * Returns the number of matching criteria, -1 if any criterion fails
+ */
+int profile_score(const Profile *profile, const NetworkFingerprint *fp);
+
+/*
+ * Pick the best profile in one pass (ties go to the first defined)
+ * Returns its index, or -1 if none matches
+ */
+int profile_select(const Profile *profiles, int count, const NetworkFingerprint *fp);
+
+/*
+ * Snapshot gateways, gateway MACs, subnets and DNS suffix of the
+ * configured interface
+ * Returns 0 on success, -1 on failure
+ */
+int profile_fingerprint(NetworkFingerprint *fp);
+
+/*
+ * Run profile mode: select a profile (or the one named by --profile)
+ * and apply it
+ * Returns 0 on success, 1 on failure
+ */
+int profile_run(void);
+
+#endif /* PROFILE_H */
@@ -0,0 +1,86 @@
+/*
+ * ready.h - Wait for applied static addresses to become usable (--wait-ready)
+ */
+
+#ifndef READY_H
+#define READY_H
+
+#include "utils.h"
+#include "address.h"
+#include "watch.h"
+#include <iphlpapi.h>
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define READY_DEFAULT_TIMEOUT_S 30
+#define READY_MAX_TIMEOUT_S     600
+#define READY_POLL_MS           1000    /* Re-check even without a notification */
+#define READY_MAX_TARGETS       2       /* One static address per family */
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+typedef struct {
+    IpAddr address;         /* Static address that must become preferred */
+    int need_route;         /* A default route of its family must exist */
+} ReadyTarget;
+
+typedef struct {
+    int preferred;          /* Duplicate address detection passed */
+    int duplicate;          /* Duplicate address detection failed */
+    int default_route;
+} ReadyState;
+
+/*
+ * Reads the current state of a target. The system probe asks the IP
+ * Helper API; tests plug in a simulated one.
+ * Returns 0 on success, -1 on failure
+ */
+typedef struct {
+    void *ctx;
+    int (*query)(void *ctx, const ReadyTarget *target, ReadyState *state);
+} ReadyProbe;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Initialize a source bound to address and route changes of `luid`
+ */
+void ready_source_system(WatchSource *source, const NET_LUID *luid);
+
+/*
+ * Initialize a probe reading the addresses and routes of `luid`
+ */
+void ready_probe_system(ReadyProbe *probe, const NET_LUID *luid);
+
+/*
+ * Wait until every target's address is preferred and its default route
+ * (if needed) exists, re-checking on each notification from `source`
+ * `elapsed_ms` receives the time since `since`, the timer_now() stamp of
+ * when the addresses were applied (0 = the start of the wait); the
+ * timeout counts from the start of the wait
+ * Returns 0 when ready, 1 on timeout, 2 on a duplicate address, -1 on failure
+ */
+int ready_wait(const WatchSource *source, const ReadyProbe *probe,
+               const ReadyTarget *targets, int count, LONGLONG since,
+               DWORD timeout_ms, double *elapsed_ms);
+
+/*
+ * Build the targets for the static addresses in g_config
+ * Returns the number of targets
+ */
+int ready_targets_from_config(ReadyTarget *targets);
+
+/*
+ * Wait for the interface's static addresses and report the time-to-ready,
+ * counted from `since` (see ready_wait)
+ * Returns 0 when ready, -1 otherwise
+ */
+int ready_run(LONGLONG since);
+
+#endif /* READY_H */
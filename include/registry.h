@@ -0,0 +1,42 @@
+/*
+ * registry.h - Registry access abstraction (HKLM)
+ */
+
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "utils.h"
+
+/* ============================================================================
+ * REGISTRY BACKEND
+ * ============================================================================ */
+
+/*
+ * All keys are paths relative to HKEY_LOCAL_MACHINE. The system backend
+ * calls the Win32 registry API; tests plug in an in-memory store.
+ *
+ * get_* return 0 on success, 1 if the value (or key) does not exist,
+ * -1 on error. Strings read from REG_MULTI_SZ values return the first
+ * entry. enum_subkeys returns 0 while `index` is valid, 1 past the end.
+ * The remaining functions return 0 on success, non-zero on failure.
+ */
+typedef struct {
+    void *ctx;
+    int (*get_dword)(void *ctx, const wchar_t *key, const wchar_t *name, DWORD *value);
+    int (*set_dword)(void *ctx, const wchar_t *key, const wchar_t *name, DWORD value);
+    int (*get_string)(void *ctx, const wchar_t *key, const wchar_t *name,
+                      wchar_t *buffer, size_t size);
+    int (*set_string)(void *ctx, const wchar_t *key, const wchar_t *name,
+                      const wchar_t *value, int multi);
+    int (*delete_value)(void *ctx, const wchar_t *key, const wchar_t *name);
+    int (*enum_subkeys)(void *ctx, const wchar_t *key, int index,
+                        wchar_t *name, size_t size);
+    int (*delete_key)(void *ctx, const wchar_t *key);
+} RegistryBackend;
+
+/*
+ * Initialize a backend bound to the local machine registry
+ */
+void registry_backend_system(RegistryBackend *backend);
+
+#endif /* REGISTRY_H */
@@ -0,0 +1,86 @@
+/*
+ * retry.h - Per-step retry policies for transient netsh failures
+ */
+
+#ifndef RETRY_H
+#define RETRY_H
+
+#include "utils.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define RETRY_MAX_ATTEMPTS      10
+#define RETRY_MAX_DELAY_MS      60000
+#define RETRY_MAX_CODES         8
+#define RETRY_MAX_PATTERNS      4
+#define RETRY_PATTERN_LEN       64
+#define RETRY_OUTPUT_SIZE       4096
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/*
+ * Operation types with their own policy ([retry.NAME] sections)
+ */
+typedef enum {
+    RETRY_ADDRESS,          /* "address": static IPv4/IPv6 address */
+    RETRY_DNS,              /* "dns": DNS server list */
+    RETRY_DOH,              /* "doh": DoH encryption templates */
+    RETRY_TCP,              /* "tcp": global TCP settings */
+    RETRY_STEP_COUNT
+} RetryStep;
+
+/*
+ * A failed command is tried again when its exit code is listed or its
+ * output contains one of the patterns (case-insensitive). The wait starts
+ * at delay_ms and doubles up to max_delay_ms.
+ */
+typedef struct {
+    int attempts;                   /* Total tries, 1 = no retry */
+    int delay_ms;
+    int max_delay_ms;
+    int exit_codes[RETRY_MAX_CODES];
+    int exit_code_count;
+    char patterns[RETRY_MAX_PATTERNS][RETRY_PATTERN_LEN];
+    int pattern_count;
+} RetryPolicy;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Fill in the default policy: 3 attempts, 500 ms doubling up to 4 s,
+ * retrying netsh's "Element not found" and "device is not ready" errors
+ */
+void retry_policy_init(RetryPolicy *policy);
+
+/*
+ * Map a section suffix ("address", "dns", "doh", "tcp") to its step
+ * Returns 0 on success, -1 for an unknown name
+ */
+int retry_step_from_name(const wchar_t *name, RetryStep *step);
+
+/*
+ * Apply one [retry.NAME] key: attempts, delay, max_delay (milliseconds),
+ * exit_codes (comma-separated) or patterns ('|'-separated); lists replace
+ * the defaults
+ * Returns 0 on success, -1 for an unknown key or invalid value
+ */
+int retry_set(RetryPolicy *policy, const wchar_t *key, const wchar_t *value);
+
+/*
+ * Check whether a failure with `exit_code` and `output` may be retried
+ * Returns 1 if it may, 0 otherwise
+ */
+int retry_is_retryable(const RetryPolicy *policy, int exit_code, const char *output);
+
+/*
+ * Wait before retry number `retry` (1 = after the first failure)
+ */
+int retry_delay_ms(const RetryPolicy *policy, int retry);
+
+#endif /* RETRY_H */
@@ -0,0 +1,111 @@
+/*
+ * route.h - Static route table management
+ */
+
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include "utils.h"
+#include "address.h"
+#include <iphlpapi.h>
+
+/* ============================================================================
+ * ROUTE TYPES
+ * ============================================================================ */
+
+typedef struct {
+    IpAddr dest;            /* Destination, prefix always set */
+    IpAddr nexthop;         /* All-zero bytes for an on-link route */
+    int metric;             /* Route metric, -1 if not specified */
+} RouteEntry;
+
+typedef struct {
+    RouteEntry *items;
+    int count;
+    int capacity;
+} RouteList;
+
+/*
+ * Forwarding table backend. The system backend talks to the IP Helper
+ * API; tests plug in an in-memory table.
+ * list() reports only the static routes of the managed interface.
+ * All functions return 0 on success, non-zero on failure.
+ */
+typedef struct {
+    void *ctx;
+    int (*list)(void *ctx, RouteList *out);
+    int (*add)(void *ctx, const RouteEntry *route);
+    int (*remove)(void *ctx, const RouteEntry *route);
+    int (*update)(void *ctx, const RouteEntry *route);
+} RouteBackend;
+
+typedef void (*RouteProgressFn)(int done, int total, void *ctx);
+
+typedef struct {
+    int added;
+    int removed;
+    int updated;
+    int unchanged;
+    int failed;
+} RouteSyncResult;
+
+/* ============================================================================
+ * PARSING
+ * ============================================================================ */
+
+/*
+ * Parse a route line: "DEST[/PREFIX] [via] [NEXTHOP] [metric N]"
+ * A destination without a prefix is a host route.
+ * Returns 0 on success, -1 on failure
+ */
+int route_parse(const wchar_t *text, RouteEntry *out);
+
+/*
+ * Format a route as "DEST/PREFIX via NEXTHOP metric N"
+ */
+void route_format(const RouteEntry *route, wchar_t *buffer, size_t size);
+
+/* ============================================================================
+ * ROUTE LISTS
+ * ============================================================================ */
+
+int route_list_add(RouteList *list, const RouteEntry *route);
+void route_list_free(RouteList *list);
+
+/*
+ * Load routes from a file, one per line (';' and '#' start comments)
+ * Returns number of routes loaded, or -1 if the file cannot be read
+ */
+int route_list_load_file(RouteList *list, const wchar_t *filepath);
+
+/*
+ * Compute the changes needed to turn `current` into `desired`
+ * Routes are keyed by destination, prefix and next hop; a metric
+ * difference is reported as an update. Both lists are sorted in place.
+ * Returns 0 on success, -1 on allocation failure
+ */
+int route_diff(RouteList *desired, RouteList *current,
+               RouteList *to_add, RouteList *to_remove, RouteList *to_update);
+
+/* ============================================================================
+ * SYNCHRONIZATION
+ * ============================================================================ */
+
+/*
+ * Diff `desired` against the backend and apply the result as one batch
+ * Routes to a listed destination through another next hop are always
+ * replaced; with `prune` set, static routes to unlisted destinations are
+ * removed as well. `progress` (optional) is called as operations complete.
+ * Returns 0 on success, -1 if listing failed or any operation failed
+ */
+int route_sync(const RouteBackend *backend, RouteList *desired, int prune,
+               RouteProgressFn progress, void *progress_ctx,
+               RouteSyncResult *result);
+
+/*
+ * Initialize a backend bound to the system forwarding table of `luid`
+ * The LUID must outlive the backend.
+ */
+void route_backend_system(RouteBackend *backend, NET_LUID *luid);
+
+#endif /* ROUTE_H */
@@ -0,0 +1,84 @@
+/*
+ * serve.h - Local status server (serve mode) and its status client
+ */
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "utils.h"
+#include "status.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define SERVE_DEFAULT_PIPE          L"static-ip-fix"
+#define SERVE_DEFAULT_INTERVAL_S    60
+#define SERVE_PIPE_NAME_LEN         64
+#define SERVE_REQUEST_SIZE          64
+#define SERVE_STALE_MARK_SIZE       40      /* " stale-since=<unix time>" */
+#define SERVE_RESPONSE_SIZE         (STATUS_JSON_SIZE + 16 + SERVE_STALE_MARK_SIZE)
+#define SERVE_CLIENT_TIMEOUT_MS     1000    /* Per read or write of a client */
+
+/* ============================================================================
+ * STATUS CACHE
+ * ============================================================================ */
+
+/*
+ * The last status report, pre-rendered in both formats so a query is a
+ * copy under a shared lock. Each response starts with a line holding
+ * the status mode exit code, followed by the report. While refreshes
+ * fail, that line also carries " stale-since=<unix time>".
+ */
+typedef struct {
+    SRWLOCK lock;
+    char text[SERVE_RESPONSE_SIZE];
+    int text_len;
+    char json[SERVE_RESPONSE_SIZE];
+    int json_len;
+    ULONGLONG refreshes;
+    ULONGLONG stale_since;  /* First failed refresh since the last good one, 0 = current */
+} StatusCache;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Initialize an empty cache
+ */
+void serve_cache_init(StatusCache *cache);
+
+/*
+ * Render a report and swap it into the cache
+ * Returns 0 on success, -1 if the report does not fit
+ */
+int serve_cache_update(StatusCache *cache, const StatusReport *report);
+
+/*
+ * Mark the cached report stale as of `now` (Unix seconds), unless it
+ * already is; the next successful update clears the mark
+ */
+void serve_cache_mark_stale(StatusCache *cache, ULONGLONG now);
+
+/*
+ * Answer one request ("text" or "json", surrounding whitespace ignored)
+ * Returns the response length, or -1 for an unknown request or an
+ * empty cache
+ */
+int serve_respond(StatusCache *cache, const char *request, char *out, size_t size);
+
+/*
+ * Ask a running server for its status report and print it
+ * Returns the status exit code, or -1 if no server answered
+ */
+int serve_query(int json);
+
+/*
+ * Run serve mode: keep the status of the interface current and answer
+ * queries on the named pipe until Ctrl+C
+ * Returns 0 on a clean stop, 1 on failure
+ */
+int serve_run(void);
+
+#endif /* SERVE_H */
@@ -6,7 +6,6 @@
 #define STATUS_H
 
 #include "utils.h"
-#include "config.h"
 
 /* ============================================================================
  * DNS SERVER INFO
@@ -14,11 +13,37 @@
 
 typedef struct {
     wchar_t address[MAX_ADDR_LEN];
+    wchar_t doh_template[256];      /* Empty if not reported */
     int has_template;
     int autoupgrade;
     int udpfallback;
 } DnsServerInfo;
 
+/* ============================================================================
+ * STATUS REPORT
+ * ============================================================================ */
+
+#define STATUS_MAX_SERVERS  4
+#define STATUS_TEXT_SIZE    4096
+#define STATUS_JSON_SIZE    8192
+#define STATUS_METRICS_SIZE 16384
+
+typedef struct {
+    wchar_t interface_name[MAX_IFACE_LEN];
+    FILETIME collected;                 /* UTC time of the snapshot */
+    DnsServerInfo ipv4[STATUS_MAX_SERVERS];
+    int ipv4_count;
+    DnsServerInfo ipv6[STATUS_MAX_SERVERS];
+    int ipv6_count;
+
+    /* Filled in by status_summarize() */
+    int ipv4_encrypted;
+    int ipv6_encrypted;
+    int any_fallback;
+    int any_unencrypted;
+    int fully_encrypted;
+} StatusReport;
+
 /* ============================================================================
  * FUNCTIONS
  * ============================================================================ */
@@ -35,6 +60,54 @@ void status_query_doh_info(const wchar_t *server, DnsServerInfo *info);
 int status_get_configured_dns(DnsServerInfo *ipv4_servers, int *ipv4_count,
                               DnsServerInfo *ipv6_servers, int *ipv6_count);
 
+/*
+ * Check whether a server has a DoH template, autoupgrade and no UDP fallback
+ */
+int status_server_encrypted(const DnsServerInfo *info);
+
+/*
+ * Compute the per-family and overall encryption summary of a report
+ */
+void status_summarize(StatusReport *report);
+
+/*
+ * Snapshot the configured interface (runs netsh)
+ */
+void status_collect(StatusReport *report);
+
+/*
+ * Returns 0 if fully encrypted, 1 otherwise (status mode exit code)
+ */
+int status_exit_code(const StatusReport *report);
+
+/*
+ * Format the report as status mode prints it, up to the summary
+ */
+void status_format_text(const StatusReport *report, wchar_t *buffer, size_t size);
+
+/*
+ * The closing "Overall result" line of the text report
+ */
+const wchar_t *status_overall_text(const StatusReport *report);
+
+/*
+ * Unix seconds of a FILETIME, as the JSON and Prometheus formats carry it
+ */
+ULONGLONG status_unix_seconds(const FILETIME *ft);
+
+/*
+ * Format the report as one line of UTF-8 JSON
+ * Returns the length written, or -1 if the buffer is too small
+ */
+int status_format_json(const StatusReport *report, char *buffer, size_t size);
+
+/*
+ * Format the report as Prometheus text exposition: per-server gauges
+ * (has_template, autoupgrade, udpfallback, encrypted) and interface totals
+ * Returns the length written, or -1 if the buffer is too small
+ */
+int status_format_prometheus(const StatusReport *report, char *buffer, size_t size);
+
 /*
  * Run status mode - display encryption status
  * Returns 0 if fully encrypted, 1 otherwise
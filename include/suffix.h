@@ -0,0 +1,102 @@
+/*
+ * suffix.h - DNS suffix search list ([dns] suffixes)
+ */
+
+#ifndef SUFFIX_H
+#define SUFFIX_H
+
+#include "utils.h"
+#include "registry.h"
+#include "probe.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define SUFFIX_MAX          16
+#define SUFFIX_LEN          256
+#define SUFFIX_LIST_LEN     (SUFFIX_MAX * SUFFIX_LEN)
+
+/* A single-label lookup asks for A and AAAA under every suffix */
+#define SUFFIX_QUERIES_PER_NAME 2
+
+/* Global search list used for every interface */
+#define SUFFIX_REGISTRY_KEY L"SYSTEM\\CurrentControlSet\\Services\\Tcpip\\Parameters"
+#define SUFFIX_VALUE_NAME   L"SearchList"
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/* Suffixes in search order, lower case, without leading or trailing dots */
+typedef struct {
+    wchar_t items[SUFFIX_MAX][SUFFIX_LEN];
+    int count;
+} SuffixList;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Parse a comma-, semicolon- or space-separated list; duplicates are
+ * dropped and an empty text is an empty list
+ * Returns 0 on success, -1 on an invalid name or too many suffixes
+ */
+int suffix_parse(const wchar_t *text, SuffixList *out);
+
+/*
+ * Join the list with commas, as the SearchList value holds it
+ */
+void suffix_format(const SuffixList *list, wchar_t *buffer, size_t size);
+
+/*
+ * Check whether two lists hold the same suffixes in the same order
+ */
+int suffix_equal(const SuffixList *a, const SuffixList *b);
+
+/*
+ * Worst-case queries a failing single-label lookup sends
+ */
+int suffix_worst_case_queries(const SuffixList *list);
+
+/*
+ * Read the search list; a missing value is an empty list
+ * Returns 0 on success, -1 on error
+ */
+int suffix_read(const RegistryBackend *reg, SuffixList *out);
+
+/*
+ * Write `desired` unless the registry already holds it; `previous`
+ * receives the list it replaces
+ * Returns 1 if written, 0 if already in place, -1 on error
+ */
+int suffix_sync(const RegistryBackend *reg, const SuffixList *desired, SuffixList *previous);
+
+/*
+ * Time a lookup of a name that does not exist under each suffix against
+ * `servers`, as a failing short-name lookup would. cost_ms[i] is the
+ * median answer time of the first server that answered, or timeout_ms
+ * if none did.
+ * Returns 0 on success, -1 if the probe cannot run
+ */
+int suffix_measure(const ProbeTarget *servers, int server_count, const SuffixList *list,
+                   int samples, int timeout_ms, double *cost_ms);
+
+/*
+ * Apply [dns] suffixes to the system, recording the list it replaces
+ * Returns 0 on success (or not configured), -1 on failure
+ */
+int suffix_apply(void);
+
+/*
+ * Put back the list replaced by the last suffix_apply, if any
+ */
+void suffix_rollback(void);
+
+/*
+ * Keep the search list set by the last suffix_apply
+ */
+void suffix_forget(void);
+
+#endif /* SUFFIX_H */
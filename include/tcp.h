@@ -0,0 +1,98 @@
+/*
+ * tcp.h - Global TCP/IP stack settings ([tcp])
+ */
+
+#ifndef TCP_H
+#define TCP_H
+
+#include "utils.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define TCP_VALUE_LEN       32
+
+typedef enum {
+    TCP_AUTOTUNING,         /* Receive window auto-tuning level */
+    TCP_RSS,                /* Receive-side scaling */
+    TCP_ECN,                /* ECN capability */
+    TCP_RSC,                /* Receive segment coalescing */
+    TCP_SETTING_COUNT
+} TcpSettingId;
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/*
+ * One value per setting, lower case as netsh prints it; an empty value
+ * is not configured (desired) or not reported (current)
+ */
+typedef struct {
+    wchar_t values[TCP_SETTING_COUNT][TCP_VALUE_LEN];
+} TcpSettings;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Set one value by its [tcp] key (autotuning, rss, ecn, rsc)
+ * Returns 0 on success, -1 on an unknown key or a value netsh does not take
+ */
+int tcp_set(TcpSettings *settings, const wchar_t *key, const wchar_t *value);
+
+/*
+ * Check whether any value is set
+ */
+int tcp_any(const TcpSettings *settings);
+
+/*
+ * [tcp] key and display label of a setting
+ */
+const wchar_t *tcp_key(TcpSettingId id);
+const wchar_t *tcp_label(TcpSettingId id);
+
+/*
+ * Read the values from "netsh interface tcp show global" output
+ */
+void tcp_parse_global(const char *output, TcpSettings *out);
+
+/*
+ * Keep in `changes` the desired values that differ from `current`
+ * Returns the number of differences
+ */
+int tcp_diff(const TcpSettings *desired, const TcpSettings *current, TcpSettings *changes);
+
+/*
+ * Build one "interface tcp set global k=v ..." command for every set value
+ * Returns 0 on success, -1 if nothing is set or the command does not fit
+ */
+int tcp_build_command(const TcpSettings *settings, wchar_t *args, size_t size);
+
+/*
+ * Read the effective global settings (runs netsh)
+ * Returns 0 on success, -1 on failure
+ */
+int tcp_read_global(TcpSettings *out);
+
+/*
+ * Apply the differences between [tcp] and the effective settings in one
+ * netsh call, recording the values they replace for tcp_rollback
+ * Returns 0 on success (or nothing to do), -1 on failure
+ */
+int tcp_apply(void);
+
+/*
+ * Put back the values replaced by the last tcp_apply, if any
+ */
+void tcp_rollback(void);
+
+/*
+ * Keep the globals set by the last tcp_apply; tcp_rollback no longer
+ * restores them
+ */
+void tcp_forget(void);
+
+#endif /* TCP_H */
@@ -37,6 +37,11 @@ void print_error(const wchar_t *msg);
 void print_info(const wchar_t *msg);
 void print_success(const wchar_t *msg);
 
+/*
+ * Write bytes (UTF-8 text such as JSON) to stdout as-is
+ */
+void print_raw(const char *data, size_t len);
+
 /* ============================================================================
  * STRING HELPERS
  * ============================================================================ */
@@ -59,6 +64,20 @@ char *find_ipv4(char *str);
  */
 char *find_ipv6(char *str);
 
+/* ============================================================================
+ * TIMING
+ * ============================================================================ */
+
+/*
+ * High-resolution timestamp for measuring short intervals
+ */
+LONGLONG timer_now(void);
+
+/*
+ * Milliseconds elapsed since a timer_now() timestamp
+ */
+double timer_elapsed_ms(LONGLONG start);
+
 /* ============================================================================
  * VALIDATION
  * ============================================================================ */
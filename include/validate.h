@@ -0,0 +1,53 @@
+/*
+ * validate.h - Offline pre-flight validation of the resolved configuration
+ */
+
+#ifndef VALIDATE_H
+#define VALIDATE_H
+
+#include "config.h"
+#include "dns.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define VALIDATE_MAX_ERRORS     32
+#define VALIDATE_MESSAGE_LEN    192
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+typedef struct {
+    wchar_t messages[VALIDATE_MAX_ERRORS][VALIDATE_MESSAGE_LEN];
+    int count;
+    int dropped;                    /* Errors past VALIDATE_MAX_ERRORS */
+} ValidationReport;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Check a DoH template URL: https, a host, an optional port and a path
+ * Returns NULL if it is usable, otherwise a short description of the problem
+ */
+const wchar_t *validate_doh_template(const wchar_t *url);
+
+/*
+ * Check everything `dns_run_provider` would apply from `config` and
+ * `provider` without touching the system: address syntax, netmask
+ * contiguity, gateways inside their subnet, the IPv6 prefix range, the
+ * DoH template and duplicate servers. Every problem is collected.
+ * Returns the number of problems found
+ */
+int validate_config(const Config *config, const DnsProvider *provider, ValidationReport *report);
+
+/*
+ * Validate g_config for `provider` and print every problem found
+ * Returns 0 if the configuration can be applied, -1 otherwise
+ */
+int validate_preflight(const DnsProvider *provider);
+
+#endif /* VALIDATE_H */
@@ -0,0 +1,81 @@
+/*
+ * warmup.h - Resolver cache warm-up after switching DNS providers
+ */
+
+#ifndef WARMUP_H
+#define WARMUP_H
+
+#include "utils.h"
+#include "probe.h"
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define WARMUP_MAX_NAMES            32
+#define WARMUP_DEFAULT_CONCURRENCY  8
+#define WARMUP_MAX_CONCURRENCY      32
+
+/* ============================================================================
+ * TYPES
+ * ============================================================================ */
+
+/*
+ * Resolves one name. The system resolver goes through the DNS Client
+ * service (and so fills its cache); tests plug in a direct UDP resolver.
+ * resolve returns 0 if the name was answered, -1 otherwise, and may be
+ * called from several threads at once.
+ */
+typedef struct {
+    void *ctx;
+    int (*resolve)(void *ctx, const char *name);
+} WarmupResolver;
+
+typedef struct {
+    char names[WARMUP_MAX_NAMES][PROBE_NAME_LEN];
+    int name_count;                 /* 0 = warm-up disabled */
+    int concurrency;                /* Names resolved at once */
+} WarmupOptions;
+
+typedef struct {
+    int ok;
+    double ms;
+} WarmupResult;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Fill in defaults: no names, WARMUP_DEFAULT_CONCURRENCY
+ */
+void warmup_options_init(WarmupOptions *opts);
+
+/*
+ * Replace the name list from a comma-separated value (ASCII host names)
+ * Returns 0 on success, -1 if some names were invalid or did not fit
+ * (the valid ones are kept)
+ */
+int warmup_set_names(WarmupOptions *opts, const wchar_t *value);
+
+/*
+ * Initialize a resolver using the system resolver (getaddrinfo)
+ */
+void warmup_resolver_system(WarmupResolver *resolver);
+
+/*
+ * Resolve every name with up to `opts->concurrency` in flight
+ * `results` has one entry per name; `total_ms` receives the wall time
+ * Returns the number of names answered, -1 if nothing could be started
+ */
+int warmup_resolve_all(const WarmupResolver *resolver, const WarmupOptions *opts,
+                       WarmupResult *results, double *total_ms);
+
+/*
+ * Warm the system resolver cache with the configured names and print
+ * per-name latency and the total time; failures are only reported
+ * Returns the number of names that failed
+ */
+int warmup_run(void);
+
+#endif /* WARMUP_H */
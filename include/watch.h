@@ -0,0 +1,111 @@
+/*
+ * watch.h - Re-enforce DNS/DoH settings on network change events (watch mode)
+ */
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "utils.h"
+#include "address.h"
+#include "dns.h"
+#include <iphlpapi.h>
+
+/* ============================================================================
+ * CONSTANTS
+ * ============================================================================ */
+
+#define WATCH_DEFAULT_DEBOUNCE_MS   2000
+#define WATCH_DEFAULT_MAX_DELAY_MS  30000
+#define WATCH_DEFAULT_INTERVAL_S    600
+
+/* ============================================================================
+ * EVENT SOURCE
+ * ============================================================================ */
+
+/*
+ * An event source sets `event` (auto-reset) whenever the watched
+ * interface may have changed. The system source subscribes to IP Helper
+ * interface and address notifications; tests plug in a simulated one.
+ * start returns 0 on success; stop must not return while a callback
+ * could still touch `event`.
+ */
+typedef struct {
+    void *ctx;
+    int (*start)(void *ctx, HANDLE event);
+    void (*stop)(void *ctx);
+} WatchSource;
+
+typedef enum {
+    WATCH_CHANGE,           /* A debounced burst of change events */
+    WATCH_PERIODIC          /* Startup or the periodic full check */
+} WatchReason;
+
+/*
+ * Called once per debounced burst and once per periodic check
+ * A non-zero return is reported by the handler itself; the loop goes on
+ */
+typedef int (*WatchHandler)(void *ctx, WatchReason reason);
+
+/*
+ * Reads one family's DNS servers of the interface, in resolver order
+ * The system reader is network_get_dns_servers; tests plug in canned lists.
+ */
+typedef int (*WatchServerReader)(int family, IpAddrList *out);
+
+typedef struct {
+    int debounce_ms;        /* Quiet time that ends a burst */
+    int max_delay_ms;       /* Act at the latest this long into a burst */
+    int interval_ms;        /* Periodic full check, 0 = never */
+} WatchOptions;
+
+/* ============================================================================
+ * FUNCTIONS
+ * ============================================================================ */
+
+/*
+ * Fill in default debounce, maximum delay and check interval
+ */
+void watch_options_init(WatchOptions *opts);
+
+/*
+ * Initialize a source bound to interface and address changes of `luid`
+ */
+void watch_source_system(WatchSource *source, const NET_LUID *luid);
+
+/*
+ * Block until `stop` is set, calling `handler` for every debounced burst
+ * of events and every `interval_ms`. Idle time is spent in a single wait.
+ * Returns 0 when stopped, -1 if the source could not be started
+ */
+int watch_loop(const WatchSource *source, const WatchOptions *opts, HANDLE stop,
+               WatchHandler handler, void *ctx);
+
+/*
+ * Check whether `current` (in resolver order) starts with the desired
+ * servers. Empty desired servers are skipped.
+ * Returns 1 if it does, 0 if the servers drifted
+ */
+int watch_servers_match(const wchar_t *primary, const wchar_t *secondary,
+                        const IpAddrList *current);
+
+/*
+ * Read the current servers through `reader`; NULL restores the system one
+ */
+void watch_set_server_reader(WatchServerReader reader);
+
+/*
+ * Re-apply the provider's DNS servers on each family where they drifted
+ * DoH templates are verified for re-applied families, and for all
+ * servers when `check_doh` is set
+ * Returns the number of settings re-applied, -1 on failure
+ */
+int watch_enforce(const DnsProvider *provider, int check_doh);
+
+/*
+ * Run watch mode: enforce `provider`'s DNS servers and DoH templates on
+ * the interface until Ctrl+C
+ * Returns 0 on a clean stop, 1 on failure
+ */
+int watch_run(const DnsProvider *provider);
+
+#endif /* WATCH_H */
@@ -0,0 +1,368 @@
+/*
+ * adapter.c - NIC advanced properties ([adapter])
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include "adapter.h"
+#include "config.h"
+#include "network.h"
+#include "process.h"
+
+/* ============================================================================
+ * PROPERTY LIST
+ * ============================================================================ */
+
+/* Short names for the standardized keywords most drivers implement */
+static const struct {
+    const wchar_t *name;
+    const wchar_t *keyword;
+} ADAPTER_ALIASES[] = {
+    { L"rss",                   L"*RSS" },
+    { L"rss_queues",            L"*NumRssQueues" },
+    { L"rss_processors",        L"*MaxRssProcessors" },
+    { L"interrupt_moderation",  L"*InterruptModeration" },
+    { L"jumbo_packet",          L"*JumboPacket" },
+    { L"receive_buffers",       L"*ReceiveBuffers" },
+    { L"transmit_buffers",      L"*TransmitBuffers" },
+    { L"lso_ipv4",              L"*LsoV2IPv4" },
+    { L"lso_ipv6",              L"*LsoV2IPv6" },
+    { L"checksum_ipv4",         L"*IPChecksumOffloadIPv4" },
+    { L"tcp_checksum_ipv4",     L"*TCPChecksumOffloadIPv4" },
+    { L"tcp_checksum_ipv6",     L"*TCPChecksumOffloadIPv6" },
+    { L"udp_checksum_ipv4",     L"*UDPChecksumOffloadIPv4" },
+    { L"udp_checksum_ipv6",     L"*UDPChecksumOffloadIPv6" },
+    { L"rsc_ipv4",              L"*RscIPv4" },
+    { L"rsc_ipv6",              L"*RscIPv6" },
+    { L"flow_control",          L"*FlowControl" },
+    { L"speed_duplex",          L"*SpeedDuplex" },
+    { NULL, NULL }
+};
+
+int adapter_property_set(AdapterPropertyList *list, const wchar_t *key, const wchar_t *value)
+{
+    const wchar_t *keyword = key;
+    AdapterProperty *prop = NULL;
+
+    for (int i = 0; ADAPTER_ALIASES[i].name; i++) {
+        if (_wcsicmp(key, ADAPTER_ALIASES[i].name) == 0) {
+            keyword = ADAPTER_ALIASES[i].keyword;
+            break;
+        }
+    }
+
+    if (*keyword == L'\0' || wcschr(keyword, L'\\')) {
+        return -1;
+    }
+
+    for (int i = 0; i < list->count && !prop; i++) {
+        if (_wcsicmp(list->items[i].keyword, keyword) == 0) {
+            prop = &list->items[i];
+        }
+    }
+    if (!prop) {
+        if (list->count == ADAPTER_MAX_PROPERTIES) {
+            return -1;
+        }
+        prop = &list->items[list->count];
+        if (FAILED(StringCchCopyW(prop->keyword, ADAPTER_KEYWORD_LEN, keyword))) {
+            return -1;
+        }
+        list->count++;
+    }
+
+    return FAILED(StringCchCopyW(prop->value, ADAPTER_VALUE_LEN, value)) ? -1 : 0;
+}
+
+/* ============================================================================
+ * REGISTRY ACCESS
+ * ============================================================================ */
+
+int adapter_find_key(const RegistryBackend *reg, const wchar_t *guid,
+                     wchar_t *key, size_t size)
+{
+    wchar_t subkey[MAX_PATH_LEN];
+    wchar_t id[64];
+    int ret;
+
+    for (int index = 0;
+         (ret = reg->enum_subkeys(reg->ctx, ADAPTER_CLASS_KEY, index, subkey, MAX_PATH_LEN)) == 0;
+         index++) {
+        StringCchPrintfW(key, size, L"%ls\\%ls", ADAPTER_CLASS_KEY, subkey);
+
+        /* "Properties" and other non-driver keys have no instance id */
+        if (reg->get_string(reg->ctx, key, L"NetCfgInstanceId", id, 64) == 0 &&
+            _wcsicmp(id, guid) == 0) {
+            return 0;
+        }
+    }
+
+    key[0] = L'\0';
+    return ret < 0 ? -1 : 1;
+}
+
+static int read_number(const RegistryBackend *reg, const wchar_t *key,
+                       const wchar_t *name, long *out)
+{
+    wchar_t text[ADAPTER_VALUE_LEN];
+    wchar_t *end;
+
+    if (reg->get_string(reg->ctx, key, name, text, ADAPTER_VALUE_LEN) != 0 || text[0] == L'\0') {
+        return -1;
+    }
+    *out = wcstol(text, &end, 10);
+    return *end == L'\0' ? 0 : -1;
+}
+
+int adapter_check_value(const RegistryBackend *reg, const wchar_t *key,
+                        const wchar_t *keyword, const wchar_t *value)
+{
+    wchar_t params[MAX_PATH_LEN];
+    wchar_t enum_key[MAX_PATH_LEN];
+    wchar_t type[16];
+    wchar_t text[ADAPTER_VALUE_LEN];
+
+    StringCchPrintfW(params, MAX_PATH_LEN, L"%ls\\Ndi\\Params\\%ls", key, keyword);
+    if (reg->get_string(reg->ctx, params, L"type", type, 16) != 0) {
+        return 1;
+    }
+
+    if (_wcsicmp(type, L"enum") == 0) {
+        StringCchPrintfW(enum_key, MAX_PATH_LEN, L"%ls\\enum", params);
+        return reg->get_string(reg->ctx, enum_key, value, text, ADAPTER_VALUE_LEN) == 0 ? 0 : -1;
+    }
+
+    if (_wcsicmp(type, L"int") == 0 || _wcsicmp(type, L"long") == 0 ||
+        _wcsicmp(type, L"word") == 0 || _wcsicmp(type, L"dword") == 0) {
+        long number, limit;
+        wchar_t *end;
+
+        number = wcstol(value, &end, 10);
+        if (value[0] == L'\0' || *end != L'\0') {
+            return -1;
+        }
+        if (read_number(reg, params, L"min", &limit) == 0 && number < limit) {
+            return -1;
+        }
+        if (read_number(reg, params, L"max", &limit) == 0 && number > limit) {
+            return -1;
+        }
+        return 0;
+    }
+
+    /* "edit" and vendor types take free text */
+    return 0;
+}
+
+int adapter_plan(const RegistryBackend *reg, const wchar_t *key,
+                 const AdapterPropertyList *desired, AdapterPlan *plan)
+{
+    wchar_t msg[256];
+    int problems = 0;
+
+    ZeroMemory(plan, sizeof(*plan));
+    StringCchCopyW(plan->key, MAX_PATH_LEN, key);
+
+    for (int i = 0; i < desired->count; i++) {
+        const AdapterProperty *prop = &desired->items[i];
+        AdapterChange *change = &plan->items[plan->count];
+        int ret = adapter_check_value(reg, key, prop->keyword, prop->value);
+
+        if (ret != 0) {
+            StringCchPrintfW(msg, 256, ret > 0
+                ? L"Adapter has no property %ls"
+                : L"Adapter property %ls does not accept %ls",
+                prop->keyword, prop->value);
+            print_error(msg);
+            problems++;
+            continue;
+        }
+
+        change->had_previous = reg->get_string(reg->ctx, key, prop->keyword,
+                                               change->previous, ADAPTER_VALUE_LEN) == 0;
+        if (change->had_previous && _wcsicmp(change->previous, prop->value) == 0) {
+            continue;
+        }
+
+        StringCchCopyW(change->keyword, ADAPTER_KEYWORD_LEN, prop->keyword);
+        StringCchCopyW(change->value, ADAPTER_VALUE_LEN, prop->value);
+        plan->count++;
+    }
+
+    return problems > 0 ? -1 : plan->count;
+}
+
+static int restore_change(const RegistryBackend *reg, const wchar_t *key,
+                          const AdapterChange *change)
+{
+    if (change->had_previous) {
+        return reg->set_string(reg->ctx, key, change->keyword, change->previous, 0);
+    }
+    return reg->delete_value(reg->ctx, key, change->keyword);
+}
+
+int adapter_write(const RegistryBackend *reg, AdapterPlan *plan)
+{
+    for (int i = 0; i < plan->count; i++) {
+        if (reg->set_string(reg->ctx, plan->key, plan->items[i].keyword,
+                            plan->items[i].value, 0) != 0) {
+            /* The driver has not seen any of them yet; leave it as it was */
+            while (--i >= 0) {
+                restore_change(reg, plan->key, &plan->items[i]);
+            }
+            return -1;
+        }
+    }
+    plan->written = plan->count > 0;
+    return 0;
+}
+
+int adapter_restore(const RegistryBackend *reg, AdapterPlan *plan)
+{
+    int ret = 0;
+
+    if (!plan->written) {
+        return 0;
+    }
+    for (int i = 0; i < plan->count; i++) {
+        if (restore_change(reg, plan->key, &plan->items[i]) != 0) {
+            ret = -1;
+        }
+    }
+    plan->written = 0;
+    return ret;
+}
+
+/* ============================================================================
+ * APPLY AND ROLLBACK
+ * ============================================================================ */
+
+/*
+ * Restart the interface so the driver reloads its properties
+ */
+static int reset_link(const wchar_t *interface_name)
+{
+    wchar_t cmd[CMD_BUFFER_SIZE];
+
+    StringCchPrintfW(cmd, CMD_BUFFER_SIZE,
+        L"interface set interface name=\"%ls\" admin=disabled", interface_name);
+    if (run_netsh(cmd) != 0) {
+        return -1;
+    }
+
+    StringCchPrintfW(cmd, CMD_BUFFER_SIZE,
+        L"interface set interface name=\"%ls\" admin=enabled", interface_name);
+    return run_netsh(cmd);
+}
+
+int adapter_sync(const RegistryBackend *reg, const wchar_t *guid,
+                 const AdapterPropertyList *desired, AdapterPlan *plan)
+{
+    wchar_t key[MAX_PATH_LEN];
+    wchar_t msg[256];
+    int count;
+
+    ZeroMemory(plan, sizeof(*plan));
+    if (desired->count == 0) {
+        return 0;
+    }
+
+    print_info(L"Checking adapter properties...");
+    if (adapter_find_key(reg, guid, key, MAX_PATH_LEN) != 0) {
+        print_error(L"Adapter driver settings not found");
+        return -1;
+    }
+
+    count = adapter_plan(reg, key, desired, plan);
+    if (count < 0) {
+        return -1;
+    }
+    if (count == 0) {
+        print_success(L"Adapter properties already in place");
+        return 0;
+    }
+    StringCchCopyW(plan->interface_name, MAX_IFACE_LEN, g_config.interface_name);
+
+    for (int i = 0; i < plan->count; i++) {
+        const AdapterChange *change = &plan->items[i];
+        wprintf(L"  %ls: %ls -> %ls\n", change->keyword,
+                change->had_previous ? change->previous : L"(driver default)", change->value);
+    }
+
+    StringCchPrintfW(msg, 256,
+        L"Warning: %d adapter property change(s) restart %ls; the link drops briefly",
+        count, g_config.interface_name);
+    print_error(msg);
+
+    if (adapter_write(reg, plan) != 0) {
+        print_error(L"Failed to write adapter properties");
+        return -1;
+    }
+
+    /* One restart picks up every value written above */
+    if (reset_link(plan->interface_name) != 0) {
+        print_error(L"Failed to restart the adapter");
+        adapter_undo(reg, plan);
+        return -1;
+    }
+
+    StringCchPrintfW(msg, 256, L"Adapter properties applied (%d changed)", count);
+    print_success(msg);
+    return 0;
+}
+
+void adapter_undo(const RegistryBackend *reg, AdapterPlan *plan)
+{
+    if (!plan->written) {
+        return;
+    }
+    if (adapter_restore(reg, plan) != 0) {
+        print_error(L"Failed to restore some adapter properties");
+    }
+
+    /* Also brings the link back up if the failed restart left it down */
+    if (reset_link(plan->interface_name) == 0) {
+        print_info(L"Adapter properties restored");
+    }
+}
+
+/* Plan of the last adapter_apply and the registry it wrote, kept for
+   adapter_rollback */
+static AdapterPlan g_adapter_plan;
+static RegistryBackend g_adapter_reg;
+
+int adapter_apply(void)
+{
+    RegistryBackend reg;
+    wchar_t guid[64];
+
+    ZeroMemory(&g_adapter_plan, sizeof(g_adapter_plan));
+    if (g_config.adapter.count == 0) {
+        return 0;
+    }
+
+    if (network_get_guid(guid, 64) != 0) {
+        print_error(L"Interface not found");
+        return -1;
+    }
+
+    registry_backend_system(&reg);
+    return adapter_apply_to(&reg, guid);
+}
+
+int adapter_apply_to(const RegistryBackend *reg, const wchar_t *guid)
+{
+    g_adapter_reg = *reg;
+    return adapter_sync(reg, guid, &g_config.adapter, &g_adapter_plan);
+}
+
+void adapter_rollback(void)
+{
+    adapter_undo(&g_adapter_reg, &g_adapter_plan);
+}
+
+void adapter_forget(void)
+{
+    ZeroMemory(&g_adapter_plan, sizeof(g_adapter_plan));
+}
@@ -0,0 +1,400 @@
+/*
+ * address.c - IP address parsing and bulk unicast address management
+ */
+
+#include <iphlpapi.h>
+#include "address.h"
+#include "network.h"
+
+/* ============================================================================
+ * PARSING AND FORMATTING
+ * ============================================================================ */
+
+int address_parse(const wchar_t *text, IpAddr *out)
+{
+    wchar_t buf[MAX_ADDR_LEN];
+    wchar_t *slash;
+
+    if (!text || !out) {
+        return -1;
+    }
+
+    ZeroMemory(out, sizeof(*out));
+    out->prefix = -1;
+
+    if (FAILED(StringCchCopyW(buf, MAX_ADDR_LEN, text))) {
+        return -1;
+    }
+
+    slash = wcschr(buf, L'/');
+    if (slash) {
+        wchar_t *end;
+        *slash = L'\0';
+        if (slash[1] == L'\0') {
+            return -1;
+        }
+        long prefix = wcstol(slash + 1, &end, 10);
+        if (*end != L'\0' || prefix < 0) {
+            return -1;
+        }
+        out->prefix = (int)prefix;
+    }
+
+    if (InetPtonW(AF_INET, trim(buf), out->bytes) == 1) {
+        out->family = AF_INET;
+        return out->prefix <= 32 ? 0 : -1;
+    }
+
+    if (InetPtonW(AF_INET6, trim(buf), out->bytes) == 1) {
+        out->family = AF_INET6;
+        return out->prefix <= 128 ? 0 : -1;
+    }
+
+    return -1;
+}
+
+void address_format(const IpAddr *addr, wchar_t *buffer, size_t size)
+{
+    wchar_t ip[MAX_ADDR_LEN];
+
+    if (!InetNtopW(addr->family, (void *)addr->bytes, ip, MAX_ADDR_LEN)) {
+        StringCchCopyW(buffer, size, L"(invalid)");
+        return;
+    }
+
+    if (addr->prefix >= 0) {
+        StringCchPrintfW(buffer, size, L"%ls/%d", ip, addr->prefix);
+    } else {
+        StringCchCopyW(buffer, size, ip);
+    }
+}
+
+int address_from_sockaddr(const SOCKADDR *sa, IpAddr *out)
+{
+    ZeroMemory(out, sizeof(*out));
+    out->prefix = -1;
+
+    if (sa->sa_family == AF_INET) {
+        out->family = AF_INET;
+        memcpy(out->bytes, &((const SOCKADDR_IN *)sa)->sin_addr, 4);
+        return 0;
+    }
+    if (sa->sa_family == AF_INET6) {
+        out->family = AF_INET6;
+        memcpy(out->bytes, &((const SOCKADDR_IN6 *)sa)->sin6_addr, 16);
+        return 0;
+    }
+    return -1;
+}
+
+int address_in_prefix(const IpAddr *addr, const IpAddr *network)
+{
+    int prefix = network->prefix;
+
+    if (addr->family != network->family) {
+        return 0;
+    }
+    if (prefix < 0) {
+        prefix = network->family == AF_INET ? 32 : 128;
+    }
+
+    for (int i = 0; prefix > 0; i++, prefix -= 8) {
+        BYTE mask = prefix >= 8 ? 0xFF : (BYTE)(0xFF << (8 - prefix));
+        if ((addr->bytes[i] & mask) != (network->bytes[i] & mask)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int address_compare(const IpAddr *a, const IpAddr *b)
+{
+    if (a->family != b->family) {
+        return a->family < b->family ? -1 : 1;
+    }
+    return memcmp(a->bytes, b->bytes, a->family == AF_INET ? 4 : 16);
+}
+
+int address_mask_to_prefix(const wchar_t *mask)
+{
+    BYTE bytes[4];
+    DWORD value;
+    int prefix = 0;
+
+    if (!mask || InetPtonW(AF_INET, mask, bytes) != 1) {
+        return -1;
+    }
+
+    value = ((DWORD)bytes[0] << 24) | ((DWORD)bytes[1] << 16) |
+            ((DWORD)bytes[2] << 8) | (DWORD)bytes[3];
+
+    while (value & 0x80000000u) {
+        prefix++;
+        value <<= 1;
+    }
+
+    /* Any bit left after the leading ones means a non-contiguous mask */
+    return value == 0 ? prefix : -1;
+}
+
+/* ============================================================================
+ * ADDRESS LISTS
+ * ============================================================================ */
+
+int address_list_add(IpAddrList *list, const IpAddr *addr)
+{
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 16;
+        IpAddr *items = (IpAddr *)realloc(list->items, (size_t)capacity * sizeof(IpAddr));
+        if (!items) {
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+
+    list->items[list->count++] = *addr;
+    return 0;
+}
+
+void address_list_free(IpAddrList *list)
+{
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    list->invalid = 0;
+}
+
+int address_list_load_file(IpAddrList *list, const wchar_t *filepath, int family)
+{
+    FILE *fp;
+    wchar_t line[CONFIG_LINE_SIZE];
+    int loaded = 0;
+
+    if (_wfopen_s(&fp, filepath, L"r, ccs=UTF-8") != 0 || !fp) {
+        return -1;
+    }
+
+    while (fgetws(line, CONFIG_LINE_SIZE, fp)) {
+        wchar_t *trimmed = trim(line);
+        IpAddr addr;
+
+        if (*trimmed == L'\0' || *trimmed == L';' || *trimmed == L'#') {
+            continue;
+        }
+
+        if (address_parse(trimmed, &addr) != 0 || addr.family != family) {
+            wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+            StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                L"Invalid address in %ls: %ls", filepath, trimmed);
+            print_error(errmsg);
+            list->invalid++;
+            continue;
+        }
+
+        if (address_list_add(list, &addr) != 0) {
+            fclose(fp);
+            return -1;
+        }
+        loaded++;
+    }
+
+    fclose(fp);
+    return loaded;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    return address_compare((const IpAddr *)a, (const IpAddr *)b);
+}
+
+int address_diff(IpAddrList *desired, IpAddrList *current,
+                 IpAddrList *to_add, IpAddrList *to_remove)
+{
+    int i = 0, j = 0;
+
+    if (desired->count > 0) {
+        qsort(desired->items, (size_t)desired->count, sizeof(IpAddr), compare_entries);
+    }
+    if (current->count > 0) {
+        qsort(current->items, (size_t)current->count, sizeof(IpAddr), compare_entries);
+    }
+
+    /* Single merge pass over both sorted lists */
+    while (i < desired->count || j < current->count) {
+        int cmp;
+
+        if (i < desired->count && i > 0 &&
+            address_compare(&desired->items[i], &desired->items[i - 1]) == 0) {
+            i++;                /* Skip duplicate desired entries */
+            continue;
+        }
+
+        if (i >= desired->count) {
+            cmp = 1;
+        } else if (j >= current->count) {
+            cmp = -1;
+        } else {
+            cmp = address_compare(&desired->items[i], &current->items[j]);
+        }
+
+        if (cmp < 0) {
+            if (address_list_add(to_add, &desired->items[i]) != 0) return -1;
+            i++;
+        } else if (cmp > 0) {
+            if (address_list_add(to_remove, &current->items[j]) != 0) return -1;
+            j++;
+        } else {
+            if (desired->items[i].prefix != current->items[j].prefix) {
+                if (address_list_add(to_remove, &current->items[j]) != 0) return -1;
+                if (address_list_add(to_add, &desired->items[i]) != 0) return -1;
+            }
+            i++;
+            j++;
+        }
+    }
+
+    return 0;
+}
+
+/* ============================================================================
+ * UNICAST TABLE SYNCHRONIZATION
+ * ============================================================================ */
+
+static void fill_row(MIB_UNICASTIPADDRESS_ROW *row, const NET_LUID *luid, const IpAddr *addr)
+{
+    InitializeUnicastIpAddressEntry(row);
+    row->InterfaceLuid = *luid;
+    row->OnLinkPrefixLength = (UCHAR)addr->prefix;
+
+    if (addr->family == AF_INET) {
+        row->Address.Ipv4.sin_family = AF_INET;
+        memcpy(&row->Address.Ipv4.sin_addr, addr->bytes, 4);
+    } else {
+        row->Address.Ipv6.sin6_family = AF_INET6;
+        memcpy(&row->Address.Ipv6.sin6_addr, addr->bytes, 16);
+    }
+}
+
+int address_get_manual(int family, IpAddrList *out)
+{
+    PMIB_UNICASTIPADDRESS_TABLE table = NULL;
+    NET_LUID luid;
+
+    if (network_get_luid(&luid) != 0) {
+        return -1;
+    }
+
+    if (GetUnicastIpAddressTable((ADDRESS_FAMILY)family, &table) != NO_ERROR) {
+        print_error(L"GetUnicastIpAddressTable failed");
+        return -1;
+    }
+
+    for (ULONG i = 0; i < table->NumEntries; i++) {
+        MIB_UNICASTIPADDRESS_ROW *row = &table->Table[i];
+        IpAddr addr;
+
+        if (row->InterfaceLuid.Value != luid.Value ||
+            row->PrefixOrigin != IpPrefixOriginManual) {
+            continue;
+        }
+
+        ZeroMemory(&addr, sizeof(addr));
+        addr.family = family;
+        addr.prefix = row->OnLinkPrefixLength;
+        if (family == AF_INET) {
+            memcpy(addr.bytes, &row->Address.Ipv4.sin_addr, 4);
+        } else {
+            memcpy(addr.bytes, &row->Address.Ipv6.sin6_addr, 16);
+        }
+
+        if (address_list_add(out, &addr) != 0) {
+            FreeMibTable(table);
+            return -1;
+        }
+    }
+
+    FreeMibTable(table);
+    return 0;
+}
+
+int address_sync(int family, const IpAddrList *desired)
+{
+    IpAddrList want = {0}, current = {0}, to_add = {0}, to_remove = {0};
+    const wchar_t *label = (family == AF_INET) ? L"IPv4" : L"IPv6";
+    wchar_t text[MAX_ADDR_LEN];
+    wchar_t msg[512];
+    NET_LUID luid;
+    int failed = 0;
+    DWORD err;
+
+    if (network_get_luid(&luid) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < desired->count; i++) {
+        if (address_list_add(&want, &desired->items[i]) != 0) {
+            goto oom;
+        }
+    }
+
+    if (address_get_manual(family, &current) != 0) {
+        address_list_free(&want);
+        return -1;
+    }
+
+    if (address_diff(&want, &current, &to_add, &to_remove) != 0) {
+        goto oom;
+    }
+
+    /* Removals first so a prefix change does not collide with the old entry */
+    for (int i = 0; i < to_remove.count; i++) {
+        MIB_UNICASTIPADDRESS_ROW row;
+        fill_row(&row, &luid, &to_remove.items[i]);
+        err = DeleteUnicastIpAddressEntry(&row);
+        if (err != NO_ERROR && err != ERROR_NOT_FOUND) {
+            address_format(&to_remove.items[i], text, MAX_ADDR_LEN);
+            StringCchPrintfW(msg, 512, L"Failed to remove %ls address %ls (error %lu)",
+                label, text, (unsigned long)err);
+            print_error(msg);
+            failed = 1;
+        }
+    }
+
+    for (int i = 0; i < to_add.count; i++) {
+        MIB_UNICASTIPADDRESS_ROW row;
+        fill_row(&row, &luid, &to_add.items[i]);
+        err = CreateUnicastIpAddressEntry(&row);
+        if (err != NO_ERROR && err != ERROR_OBJECT_ALREADY_EXISTS) {
+            address_format(&to_add.items[i], text, MAX_ADDR_LEN);
+            StringCchPrintfW(msg, 512, L"Failed to add %ls address %ls (error %lu)",
+                label, text, (unsigned long)err);
+            print_error(msg);
+            failed = 1;
+        }
+    }
+
+    StringCchPrintfW(msg, 512, L"%ls addresses: %d added, %d removed, %d unchanged",
+        label, to_add.count, to_remove.count,
+        current.count - to_remove.count);
+    if (failed) {
+        print_error(msg);
+    } else {
+        print_success(msg);
+    }
+
+    address_list_free(&want);
+    address_list_free(&current);
+    address_list_free(&to_add);
+    address_list_free(&to_remove);
+    return failed ? -1 : 0;
+
+oom:
+    print_error(L"Memory allocation failed");
+    address_list_free(&want);
+    address_list_free(&current);
+    address_list_free(&to_add);
+    address_list_free(&to_remove);
+    return -1;
+}
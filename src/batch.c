@@ -0,0 +1,505 @@
+/*
+ * batch.c - Batch mode: JSON Lines jobs from stdin, one result line each
+ */
+
+#include <string.h>
+#include <stdarg.h>
+#include <io.h>
+#include "batch.h"
+#include "config.h"
+#include "dns.h"
+#include "network.h"
+#include "status.h"
+#include <iphlpapi.h>
+
+/* ============================================================================
+ * JOB PARSING
+ * ============================================================================ */
+
+static void skip_ws(const char **p)
+{
+    while (**p == ' ' || **p == '\t' || **p == '\r' || **p == '\n') (*p)++;
+}
+
+static int hex4(const char *p, unsigned *value)
+{
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        *value <<= 4;
+        if (c >= '0' && c <= '9')      *value |= (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') *value |= (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') *value |= (unsigned)(c - 'A' + 10);
+        else return -1;
+    }
+    return 0;
+}
+
+static int put_utf8(char *out, size_t size, size_t *len, unsigned cp)
+{
+    char buf[4];
+    size_t n;
+
+    if (cp < 0x80) {
+        buf[0] = (char)cp; n = 1;
+    } else if (cp < 0x800) {
+        buf[0] = (char)(0xC0 | (cp >> 6)); buf[1] = (char)(0x80 | (cp & 0x3F)); n = 2;
+    } else if (cp < 0x10000) {
+        buf[0] = (char)(0xE0 | (cp >> 12)); buf[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        buf[2] = (char)(0x80 | (cp & 0x3F)); n = 3;
+    } else {
+        buf[0] = (char)(0xF0 | (cp >> 18)); buf[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        buf[2] = (char)(0x80 | ((cp >> 6) & 0x3F)); buf[3] = (char)(0x80 | (cp & 0x3F)); n = 4;
+    }
+    if (*len + n >= size) {
+        return -1;
+    }
+    memcpy(out + *len, buf, n);
+    *len += n;
+    return 0;
+}
+
+/*
+ * Parse a JSON string at *p into UTF-8
+ */
+static int parse_string(const char **p, char *out, size_t size)
+{
+    const char *s = *p;
+    size_t len = 0;
+
+    if (*s++ != '"') {
+        return -1;
+    }
+    while (*s != '"') {
+        unsigned cp = (unsigned char)*s;
+
+        if (cp == 0 || cp < 0x20) {
+            return -1;
+        }
+        if (cp == '\\') {
+            s++;
+            switch (*s) {
+            case '"':  cp = '"';  break;
+            case '\\': cp = '\\'; break;
+            case '/':  cp = '/';  break;
+            case 'b':  cp = '\b'; break;
+            case 'f':  cp = '\f'; break;
+            case 'n':  cp = '\n'; break;
+            case 'r':  cp = '\r'; break;
+            case 't':  cp = '\t'; break;
+            case 'u': {
+                unsigned low;
+                if (hex4(s + 1, &cp) != 0) {
+                    return -1;
+                }
+                s += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    if (s[1] != '\\' || s[2] != 'u' || hex4(s + 3, &low) != 0 ||
+                        low < 0xDC00 || low > 0xDFFF) {
+                        return -1;
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    s += 6;
+                }
+                break;
+            }
+            default:
+                return -1;
+            }
+            if (put_utf8(out, size, &len, cp) != 0) {
+                return -1;
+            }
+            s++;
+        } else {
+            if (len + 1 >= size) {
+                return -1;
+            }
+            out[len++] = *s++;
+        }
+    }
+    out[len] = '\0';
+    *p = s + 1;
+    return 0;
+}
+
+/*
+ * Skip a number, true, false or null
+ */
+static int skip_scalar(const char **p)
+{
+    const char *s = *p;
+
+    if (strncmp(s, "true", 4) == 0)  { *p = s + 4; return 0; }
+    if (strncmp(s, "false", 5) == 0) { *p = s + 5; return 0; }
+    if (strncmp(s, "null", 4) == 0)  { *p = s + 4; return 0; }
+
+    if (*s == '-') s++;
+    if (*s < '0' || *s > '9') {
+        return -1;
+    }
+    while ((*s >= '0' && *s <= '9') || *s == '.' || *s == 'e' || *s == 'E' ||
+           *s == '+' || *s == '-') {
+        s++;
+    }
+    *p = s;
+    return 0;
+}
+
+static int parse_field(const char **p, wchar_t *out, size_t size)
+{
+    char utf8[BATCH_LINE_SIZE];
+
+    if (parse_string(p, utf8, sizeof(utf8)) != 0) {
+        return -1;
+    }
+    return MultiByteToWideChar(CP_UTF8, 0, utf8, -1, out, (int)size) > 0 ? 0 : -1;
+}
+
+int batch_parse_job(const char *line, BatchJob *job, char *error, size_t error_size)
+{
+    const char *p = line;
+    wchar_t op[BATCH_FIELD_LEN] = L"";
+
+#define FAIL(msg) do { StringCchCopyA(error, error_size, msg); return -1; } while (0)
+
+    ZeroMemory(job, sizeof(*job));
+    job->dns_only = -1;
+
+    skip_ws(&p);
+    if (*p++ != '{') FAIL("expected a JSON object");
+    skip_ws(&p);
+
+    while (*p != '}') {
+        char key[32];
+        const char *value;
+
+        if (parse_string(&p, key, sizeof(key)) != 0) FAIL("expected a key");
+        skip_ws(&p);
+        if (*p++ != ':') FAIL("expected ':'");
+        skip_ws(&p);
+        value = p;
+
+        if (strcmp(key, "id") == 0) {
+            char scratch[BATCH_ID_LEN];
+            if (*p == '"' ? parse_string(&p, scratch, sizeof(scratch)) != 0
+                          : (*p != '-' && (*p < '0' || *p > '9')) || skip_scalar(&p) != 0) {
+                FAIL("id must be a string or a number");
+            }
+            if ((size_t)(p - value) >= BATCH_ID_LEN) FAIL("id too long");
+            memcpy(job->id, value, (size_t)(p - value));
+            job->id[p - value] = '\0';
+        }
+        else if (strcmp(key, "op") == 0) {
+            if (parse_field(&p, op, BATCH_FIELD_LEN) != 0) FAIL("op must be a string");
+        }
+        else if (strcmp(key, "interface") == 0) {
+            if (parse_field(&p, job->interface_name, MAX_IFACE_LEN) != 0) {
+                FAIL("interface must be a string");
+            }
+        }
+        else if (strcmp(key, "provider") == 0) {
+            if (parse_field(&p, job->provider, BATCH_FIELD_LEN) != 0) {
+                FAIL("provider must be a string");
+            }
+        }
+        else if (strcmp(key, "dns_only") == 0) {
+            if (strncmp(p, "true", 4) == 0)       { job->dns_only = 1; p += 4; }
+            else if (strncmp(p, "false", 5) == 0) { job->dns_only = 0; p += 5; }
+            else FAIL("dns_only must be true or false");
+        }
+        else if (*p == '"') {
+            char scratch[BATCH_LINE_SIZE];
+            if (parse_string(&p, scratch, sizeof(scratch)) != 0) FAIL("invalid string");
+        }
+        else if (skip_scalar(&p) != 0) {
+            FAIL("nested values are not supported");
+        }
+
+        skip_ws(&p);
+        if (*p == ',') {
+            p++;
+            skip_ws(&p);
+        } else if (*p != '}') {
+            FAIL("expected ',' or '}'");
+        }
+    }
+    p++;
+    skip_ws(&p);
+    if (*p != '\0') FAIL("trailing characters after the object");
+
+    if (_wcsicmp(op, L"apply") == 0) {
+        job->op = BATCH_OP_APPLY;
+        if (job->provider[0] == L'\0') FAIL("apply needs a provider");
+    } else if (_wcsicmp(op, L"status") == 0) {
+        job->op = BATCH_OP_STATUS;
+    } else {
+        FAIL(op[0] ? "unknown op (use apply or status)" : "missing op");
+    }
+    if (job->interface_name[0] == L'\0') FAIL("missing interface");
+
+#undef FAIL
+    return 0;
+}
+
+/* ============================================================================
+ * ADAPTER SNAPSHOT
+ * ============================================================================ */
+
+int batch_snapshot_adapters(AdapterSnapshot *snapshot)
+{
+    IP_ADAPTER_ADDRESSES *addrs;
+
+    ZeroMemory(snapshot, sizeof(*snapshot));
+
+    addrs = network_get_adapters(GAA_FLAG_SKIP_UNICAST | GAA_FLAG_SKIP_ANYCAST |
+                                 GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER);
+    if (!addrs) {
+        return -1;
+    }
+
+    for (IP_ADAPTER_ADDRESSES *a = addrs; a && snapshot->count < BATCH_MAX_INTERFACES; a = a->Next) {
+        StringCchCopyW(snapshot->names[snapshot->count++], MAX_IFACE_LEN, a->FriendlyName);
+    }
+
+    free(addrs);
+    return 0;
+}
+
+static int snapshot_has(const AdapterSnapshot *snapshot, const wchar_t *name)
+{
+    for (int i = 0; i < snapshot->count; i++) {
+        if (_wcsicmp(snapshot->names[i], name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * RESULTS
+ * ============================================================================ */
+
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t len;
+} ResultWriter;
+
+static void result_printf(ResultWriter *w, const char *format, ...)
+{
+    va_list args;
+    int n;
+
+    if (w->len >= w->size) {
+        return;
+    }
+    va_start(args, format);
+    n = vsnprintf(w->buffer + w->len, w->size - w->len, format, args);
+    va_end(args);
+    w->len = (n < 0 || (size_t)n >= w->size - w->len) ? w->size : w->len + (size_t)n;
+}
+
+static void result_string(ResultWriter *w, const char *utf8)
+{
+    result_printf(w, "\"");
+    for (const char *p = utf8; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            result_printf(w, "\\%c", c);
+        } else if (c < 0x20) {
+            result_printf(w, "\\u%04x", c);
+        } else {
+            result_printf(w, "%c", c);
+        }
+    }
+    result_printf(w, "\"");
+}
+
+static void result_wstring(ResultWriter *w, const wchar_t *value)
+{
+    char utf8[BATCH_LINE_SIZE];
+
+    if (WideCharToMultiByte(CP_UTF8, 0, value, -1, utf8, sizeof(utf8), NULL, NULL) == 0) {
+        utf8[0] = '\0';
+    }
+    result_string(w, utf8);
+}
+
+/*
+ * Close the result object; a line that did not fit is replaced by a
+ * short error so the output stays one valid JSON object per line
+ */
+static void result_finish(ResultWriter *w, const BatchJob *job, int ok, const char *error,
+                          LONGLONG start)
+{
+    if (!ok) {
+        result_printf(w, ",\"ok\":false,\"error\":");
+        result_string(w, error);
+    } else {
+        result_printf(w, ",\"ok\":true");
+    }
+    result_printf(w, ",\"ms\":%.1f}\n", timer_elapsed_ms(start));
+
+    if (w->len >= w->size) {
+        w->len = 0;
+        result_printf(w, "{\"id\":%s,\"ok\":false,\"error\":\"result too large\"}\n",
+                      job->id[0] ? job->id : "null");
+    }
+}
+
+/* ============================================================================
+ * JOBS
+ * ============================================================================ */
+
+int batch_run_job(const BatchJob *job, const AdapterSnapshot *snapshot, char *out, size_t size)
+{
+    static Config base;
+    ResultWriter w = { out, size, 0 };
+    LONGLONG start = timer_now();
+    const char *error = NULL;
+
+    result_printf(&w, "{\"id\":%s,\"op\":\"%s\",\"interface\":", job->id[0] ? job->id : "null",
+                  job->op == BATCH_OP_APPLY ? "apply" : "status");
+    result_wstring(&w, job->interface_name);
+
+    if (!validate_interface_alias(job->interface_name)) {
+        error = "invalid interface name";
+    } else if (!snapshot_has(snapshot, job->interface_name)) {
+        error = "interface not found";
+    }
+    if (error) {
+        result_finish(&w, job, 0, error, start);
+        return 1;
+    }
+
+    /* Every job starts from the configuration the batch was started with */
+    base = g_config;
+    StringCchCopyW(g_config.interface_name, MAX_IFACE_LEN, job->interface_name);
+    if (job->dns_only >= 0) {
+        g_config.dns_only = job->dns_only;
+    }
+
+    if (job->op == BATCH_OP_APPLY) {
+        DnsProvider provider;
+
+        if (dns_find_provider(job->provider, &provider) != 0) {
+            error = "unknown provider";
+        } else {
+            result_printf(&w, ",\"provider\":");
+            result_wstring(&w, provider.name);
+            if (dns_run_provider(&provider) != 0) {
+                /* Not every failure rolls back: pre-flight stops before any
+                   change, and --wait-ready runs after the last one */
+                error = "apply failed";
+            }
+        }
+    } else {
+        StatusReport report;
+        char json[STATUS_JSON_SIZE];
+        int len;
+
+        status_collect(&report);
+        len = status_format_json(&report, json, sizeof(json));
+        if (len < 0) {
+            error = "status report too large";
+        } else {
+            json[len - 1] = '\0';       /* Drop the newline */
+            result_printf(&w, ",\"exit\":%d,\"status\":%s", status_exit_code(&report), json);
+        }
+    }
+
+    g_config = base;
+    result_finish(&w, job, error == NULL, error, start);
+    return error ? 1 : 0;
+}
+
+int batch_run_stream(FILE *in, FILE *out, const AdapterSnapshot *snapshot)
+{
+    static char line[BATCH_LINE_SIZE];
+    static char result[BATCH_RESULT_SIZE];
+    int line_no = 0;
+    int failed = 0;
+
+    while (fgets(line, sizeof(line), in)) {
+        size_t len = strlen(line);
+        const char *start = line;
+        char error[128];
+        BatchJob job;
+
+        line_no++;
+
+        /* Swallow the rest of an over-long line and fail it as a whole */
+        if (len > 0 && line[len - 1] != '\n' && !feof(in)) {
+            int c;
+            while ((c = fgetc(in)) != EOF && c != '\n') {
+            }
+            fprintf(out, "{\"line\":%d,\"ok\":false,\"error\":\"line too long\"}\n", line_no);
+            fflush(out);
+            failed++;
+            continue;
+        }
+
+        if (line_no == 1 && strncmp(line, "\xEF\xBB\xBF", 3) == 0) {
+            start += 3;                 /* UTF-8 BOM */
+        }
+        skip_ws(&start);
+        if (*start == '\0') {
+            continue;
+        }
+
+        if (batch_parse_job(start, &job, error, sizeof(error)) != 0) {
+            ResultWriter w = { result, sizeof(result), 0 };
+            result_printf(&w, "{\"line\":%d,\"ok\":false,\"error\":", line_no);
+            result_string(&w, error);
+            result_printf(&w, "}\n");
+            failed++;
+        } else {
+            failed += batch_run_job(&job, snapshot, result, sizeof(result));
+        }
+
+        /* Stream each result as soon as the job is done */
+        fputs(result, out);
+        fflush(out);
+    }
+
+    return failed;
+}
+
+/* ============================================================================
+ * BATCH MODE
+ * ============================================================================ */
+
+int batch_run(void)
+{
+    static AdapterSnapshot snapshot;
+    FILE *results;
+    wchar_t msg[128];
+    int fd, failed;
+
+    if (batch_snapshot_adapters(&snapshot) != 0) {
+        print_error(L"Failed to enumerate network interfaces");
+        return 1;
+    }
+
+    /* stdout carries nothing but result lines: keep a copy of it for the
+       results and send the progress output of the jobs to stderr */
+    fflush(stdout);
+    fd = _dup(_fileno(stdout));
+    results = fd >= 0 ? _fdopen(fd, "w") : NULL;
+    if (!results) {
+        print_error(L"Failed to open the result stream");
+        return 1;
+    }
+    _dup2(_fileno(stderr), _fileno(stdout));
+
+    failed = batch_run_stream(stdin, results, &snapshot);
+    fclose(results);
+
+    StringCchPrintfW(msg, 128, L"Batch finished: %d failed jobs", failed);
+    if (failed) {
+        print_error(msg);
+    } else {
+        print_info(msg);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,475 @@
+/*
+ * bench.c - Resolver benchmark (dns-bench mode)
+ */
+
+#include "bench.h"
+#include "config.h"
+#include "status.h"
+#include <string.h>
+#include <winhttp.h>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "winhttp.lib")
+#pragma comment(lib, "ws2_32.lib")
+#endif
+
+#define DNS_HEADER_LEN      12
+#define DNS_MESSAGE_MAX     4096
+#define DNS_RCODE_SERVFAIL  2
+#define DNS_RCODE_REFUSED   5
+
+/* ============================================================================
+ * OPTIONS
+ * ============================================================================ */
+
+void bench_options_init(BenchOptions *opts)
+{
+    ZeroMemory(opts, sizeof(*opts));
+    opts->concurrency = BENCH_DEFAULT_CONCURRENCY;
+    opts->duration_ms = BENCH_DEFAULT_DURATION_MS;
+    opts->timeout_ms = BENCH_DEFAULT_TIMEOUT_MS;
+    opts->uncached_percent = BENCH_DEFAULT_UNCACHED;
+    StringCchCopyA(opts->names[0], PROBE_NAME_LEN, "example.com");
+    opts->name_count = 1;
+}
+
+/* ============================================================================
+ * TRANSPORTS
+ * ============================================================================ */
+
+typedef struct {
+    SOCKET sock;                        /* UDP */
+    HINTERNET session;                  /* DoH */
+    HINTERNET connect;
+    wchar_t path[BENCH_URL_LEN];
+    DWORD request_flags;
+} BenchConn;
+
+/*
+ * Returns 0 and the RCODE for a well-formed answer to `id`, -1 otherwise
+ */
+static int parse_answer(const unsigned char *buf, DWORD len, unsigned short id, int *rcode)
+{
+    if (len < DNS_HEADER_LEN || !(buf[2] & 0x80) ||
+        (unsigned short)((buf[0] << 8) | buf[1]) != id) {
+        return -1;
+    }
+    *rcode = buf[3] & 0x0F;
+    return 0;
+}
+
+static int udp_open(const BenchTarget *target, const BenchOptions *opts, BenchConn *conn)
+{
+    ProbeTarget probe = { target->server, target->port };
+    (void)opts;
+    conn->sock = probe_open_socket(&probe);
+    return conn->sock == INVALID_SOCKET ? -1 : 0;
+}
+
+/*
+ * Returns 0 when answered, 1 on timeout, -1 on error
+ */
+static int udp_query(BenchConn *conn, const unsigned char *query, int qlen,
+                     unsigned short id, int timeout_ms, int *rcode)
+{
+    unsigned char buf[DNS_MESSAGE_MAX];
+    LONGLONG start = timer_now();
+
+    if (send(conn->sock, (const char *)query, qlen, 0) != qlen) {
+        return -1;
+    }
+
+    for (;;) {
+        fd_set readable;
+        struct timeval tv;
+        double left = timeout_ms - timer_elapsed_ms(start);
+        int len, ready;
+
+        if (left <= 0) {
+            return 1;
+        }
+
+        FD_ZERO(&readable);
+        FD_SET(conn->sock, &readable);
+        tv.tv_sec = (long)(left / 1000);
+        tv.tv_usec = (long)((left - tv.tv_sec * 1000.0) * 1000);
+        ready = select((int)conn->sock + 1, &readable, NULL, NULL, &tv);
+        if (ready < 0) {
+            return -1;
+        }
+        if (ready == 0) {
+            continue;
+        }
+
+        len = recv(conn->sock, (char *)buf, sizeof(buf), 0);
+        if (len < 0) {
+            return -1;
+        }
+
+        /* Answers to earlier, timed-out queries are skipped */
+        if (parse_answer(buf, (DWORD)len, id, rcode) == 0) {
+            return 0;
+        }
+    }
+}
+
+static int doh_open(const BenchTarget *target, const BenchOptions *opts, BenchConn *conn)
+{
+    URL_COMPONENTS url;
+    wchar_t base[BENCH_URL_LEN];
+    wchar_t host[BENCH_URL_LEN];
+    wchar_t *brace;
+
+    /* Drop an RFC 8484 "{?dns}" URI template suffix */
+    StringCchCopyW(base, BENCH_URL_LEN, target->url);
+    brace = wcschr(base, L'{');
+    if (brace) *brace = L'\0';
+
+    ZeroMemory(&url, sizeof(url));
+    url.dwStructSize = sizeof(url);
+    url.lpszHostName = host;
+    url.dwHostNameLength = BENCH_URL_LEN;
+    url.lpszUrlPath = conn->path;
+    url.dwUrlPathLength = BENCH_URL_LEN;
+    if (!WinHttpCrackUrl(base, 0, 0, &url)) {
+        return -1;
+    }
+    if (conn->path[0] == L'\0') {
+        StringCchCopyW(conn->path, BENCH_URL_LEN, L"/");
+    }
+    conn->request_flags = url.nScheme == INTERNET_SCHEME_HTTPS ? WINHTTP_FLAG_SECURE : 0;
+
+    conn->session = WinHttpOpen(L"static-ip-fix", WINHTTP_ACCESS_TYPE_NO_PROXY,
+                                WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+    if (!conn->session) {
+        return -1;
+    }
+    WinHttpSetTimeouts(conn->session, opts->timeout_ms, opts->timeout_ms,
+                       opts->timeout_ms, opts->timeout_ms);
+
+    /* One connection handle per worker: WinHTTP keeps the connection alive */
+    conn->connect = WinHttpConnect(conn->session, host, url.nPort, 0);
+    return conn->connect ? 0 : -1;
+}
+
+static int doh_query(BenchConn *conn, const unsigned char *query, int qlen,
+                     unsigned short id, int timeout_ms, int *rcode)
+{
+    static const wchar_t headers[] =
+        L"Content-Type: application/dns-message\r\nAccept: application/dns-message";
+    unsigned char buf[DNS_MESSAGE_MAX];
+    DWORD status = 0, size = sizeof(status), total = 0, got;
+    HINTERNET request;
+    int ret = -1;
+
+    (void)timeout_ms;
+    request = WinHttpOpenRequest(conn->connect, L"POST", conn->path, NULL,
+                                 WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+                                 conn->request_flags);
+    if (!request) {
+        return -1;
+    }
+
+    if (!WinHttpSendRequest(request, headers, (DWORD)-1L, (LPVOID)query,
+                            (DWORD)qlen, (DWORD)qlen, 0) ||
+        !WinHttpReceiveResponse(request, NULL)) {
+        ret = GetLastError() == ERROR_WINHTTP_TIMEOUT ? 1 : -1;
+        WinHttpCloseHandle(request);
+        return ret;
+    }
+
+    if (WinHttpQueryHeaders(request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                            WINHTTP_HEADER_NAME_BY_INDEX, &status, &size,
+                            WINHTTP_NO_HEADER_INDEX) && status == 200) {
+        while (total < sizeof(buf) &&
+               WinHttpReadData(request, buf + total, (DWORD)sizeof(buf) - total, &got) &&
+               got > 0) {
+            total += got;
+        }
+        ret = parse_answer(buf, total, id, rcode);
+    }
+
+    WinHttpCloseHandle(request);
+    return ret;
+}
+
+static void conn_close(BenchConn *conn)
+{
+    if (conn->sock != INVALID_SOCKET) closesocket(conn->sock);
+    if (conn->connect) WinHttpCloseHandle(conn->connect);
+    if (conn->session) WinHttpCloseHandle(conn->session);
+}
+
+/* ============================================================================
+ * WORKERS
+ * ============================================================================ */
+
+typedef struct {
+    const BenchTarget *target;
+    const BenchOptions *opts;
+    LONGLONG start;
+    unsigned int seed;
+    int failed;                         /* Could not open the transport */
+    BenchResult result;
+} BenchWorker;
+
+static unsigned int next_random(unsigned int *state)
+{
+    /* xorshift32 */
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static DWORD WINAPI bench_worker(LPVOID param)
+{
+    BenchWorker *worker = (BenchWorker *)param;
+    const BenchOptions *opts = worker->opts;
+    BenchResult *result = &worker->result;
+    int doh = worker->target->transport == BENCH_DOH;
+    BenchConn conn;
+    ULONGLONG n = 0;
+
+    ZeroMemory(&conn, sizeof(conn));
+    conn.sock = INVALID_SOCKET;
+
+    if ((doh ? doh_open : udp_open)(worker->target, opts, &conn) != 0) {
+        conn_close(&conn);
+        worker->failed = 1;
+        return 0;
+    }
+
+    while (timer_elapsed_ms(worker->start) < opts->duration_ms) {
+        unsigned char query[DNS_MESSAGE_MAX];
+        char name[PROBE_NAME_LEN + 32];
+        const char *base = opts->names[n++ % (ULONGLONG)opts->name_count];
+        /* DoH uses ID 0 so answers stay cacheable (RFC 8484) */
+        unsigned short id = doh ? 0 : (unsigned short)next_random(&worker->seed);
+        int qlen, rcode = 0, ret;
+        LONGLONG sent_at;
+
+        /* Uncached: a random label the resolver has never seen */
+        if ((int)(next_random(&worker->seed) % 100) < opts->uncached_percent) {
+            StringCchPrintfA(name, sizeof(name), "%08x.%s",
+                             next_random(&worker->seed), base);
+        } else {
+            StringCchCopyA(name, sizeof(name), base);
+        }
+
+        qlen = probe_build_query(name, id, query, sizeof(query));
+        if (qlen < 0) {
+            worker->failed = 1;
+            break;
+        }
+
+        sent_at = timer_now();
+        ret = doh ? doh_query(&conn, query, qlen, id, opts->timeout_ms, &rcode)
+                  : udp_query(&conn, query, qlen, id, opts->timeout_ms, &rcode);
+        result->sent++;
+
+        if (ret == 0) {
+            result->answered++;
+            histogram_record(&result->latency,
+                             (ULONGLONG)(timer_elapsed_ms(sent_at) * 1000.0));
+            if (rcode == DNS_RCODE_SERVFAIL || rcode == DNS_RCODE_REFUSED) {
+                result->server_failures++;
+            }
+        } else if (ret > 0) {
+            result->timeouts++;
+        } else {
+            result->errors++;
+            /* Don't spin on a dead socket */
+            Sleep(1);
+        }
+    }
+
+    conn_close(&conn);
+    return 0;
+}
+
+int bench_measure(const BenchTarget *target, const BenchOptions *opts, BenchResult *result)
+{
+    WSADATA wsa;
+    BenchWorker *workers;
+    HANDLE threads[BENCH_MAX_CONCURRENCY];
+    int started = 0, failed = 0;
+    LONGLONG start;
+
+    ZeroMemory(result, sizeof(*result));
+
+    if (opts->concurrency < 1 || opts->concurrency > BENCH_MAX_CONCURRENCY ||
+        opts->duration_ms <= 0 || opts->name_count <= 0) {
+        return -1;
+    }
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        return -1;
+    }
+
+    workers = (BenchWorker *)calloc((size_t)opts->concurrency, sizeof(BenchWorker));
+    if (!workers) {
+        WSACleanup();
+        return -1;
+    }
+
+    start = timer_now();
+    for (int i = 0; i < opts->concurrency; i++) {
+        workers[i].target = target;
+        workers[i].opts = opts;
+        workers[i].start = start;
+        workers[i].seed = (unsigned int)(start ^ (start >> 32)) * 2654435761u + (unsigned int)i * 40503u + 1;
+        histogram_init(&workers[i].result.latency);
+
+        threads[started] = CreateThread(NULL, 0, bench_worker, &workers[i], 0, NULL);
+        if (threads[started]) {
+            started++;
+        }
+    }
+
+    if (started > 0) {
+        WaitForMultipleObjects((DWORD)started, threads, TRUE, INFINITE);
+    }
+    result->elapsed_ms = timer_elapsed_ms(start);
+
+    for (int i = 0; i < started; i++) {
+        CloseHandle(threads[i]);
+    }
+
+    histogram_init(&result->latency);
+    for (int i = 0; i < opts->concurrency; i++) {
+        const BenchResult *part = &workers[i].result;
+        histogram_merge(&result->latency, &part->latency);
+        result->sent += part->sent;
+        result->answered += part->answered;
+        result->timeouts += part->timeouts;
+        result->errors += part->errors;
+        result->server_failures += part->server_failures;
+        failed += workers[i].failed;
+    }
+
+    free(workers);
+    WSACleanup();
+    return (started == 0 || failed == started) ? -1 : 0;
+}
+
+/* ============================================================================
+ * REPORTING
+ * ============================================================================ */
+
+void bench_print_result(const BenchTarget *target, const BenchResult *result)
+{
+    double seconds = result->elapsed_ms / 1000.0;
+    ULONGLONG failures = result->timeouts + result->errors + result->server_failures;
+
+    if (target->transport == BENCH_DOH) {
+        wprintf(L"  %ls (DoH %ls)\n", target->server, target->url);
+    } else {
+        wprintf(L"  %ls (UDP)\n", target->server);
+    }
+    wprintf(L"    queries    %llu sent, %llu answered, %.1f answers/s\n",
+            (unsigned long long)result->sent, (unsigned long long)result->answered,
+            seconds > 0 ? (double)result->answered / seconds : 0.0);
+    wprintf(L"    errors     %llu timeouts, %llu failed, %llu SERVFAIL/REFUSED (%.2f%%)\n",
+            (unsigned long long)result->timeouts, (unsigned long long)result->errors,
+            (unsigned long long)result->server_failures,
+            result->sent ? 100.0 * (double)failures / (double)result->sent : 0.0);
+    wprintf(L"    latency\n");
+    histogram_print(&result->latency, 1000.0, L"ms");
+    wprintf(L"\n");
+}
+
+/* ============================================================================
+ * DNS-BENCH MODE
+ * ============================================================================ */
+
+static int add_targets(BenchTarget *targets, int count, const DnsServerInfo *servers, int n)
+{
+    for (int i = 0; i < n; i++) {
+        BenchTarget *t = &targets[count++];
+        ZeroMemory(t, sizeof(*t));
+        t->transport = BENCH_UDP;
+        StringCchCopyW(t->server, MAX_ADDR_LEN, servers[i].address);
+
+        if (servers[i].doh_template[0] == L'\0') {
+            continue;
+        }
+
+        /* Servers of one provider usually share a template: bench it once */
+        int seen = 0;
+        for (int k = 0; k < count && !seen; k++) {
+            seen = targets[k].transport == BENCH_DOH &&
+                   _wcsicmp(targets[k].url, servers[i].doh_template) == 0;
+        }
+        if (!seen) {
+            t = &targets[count++];
+            ZeroMemory(t, sizeof(*t));
+            t->transport = BENCH_DOH;
+            StringCchCopyW(t->server, MAX_ADDR_LEN, servers[i].address);
+            StringCchCopyW(t->url, BENCH_URL_LEN, servers[i].doh_template);
+        }
+    }
+    return count;
+}
+
+int bench_run(void)
+{
+    DnsServerInfo ipv4_servers[4], ipv6_servers[4];
+    int ipv4_count = 0, ipv6_count = 0;
+    BenchTarget targets[16];
+    BenchOptions opts;
+    BenchResult *result;
+    int count = 0, failed = 0;
+
+    bench_options_init(&opts);
+    if (g_config.bench_concurrency > 0) {
+        opts.concurrency = g_config.bench_concurrency;
+    }
+    if (g_config.bench_duration > 0) {
+        opts.duration_ms = g_config.bench_duration * 1000;
+    }
+    for (int i = 0; i < g_config.probe.name_count; i++) {
+        StringCchCopyA(opts.names[i], PROBE_NAME_LEN, g_config.probe.names[i]);
+    }
+    opts.name_count = g_config.probe.name_count;
+
+    wprintf(L"\n");
+    wprintf(L"========================================\n");
+    wprintf(L"  DNS Benchmark\n");
+    wprintf(L"  Interface: %ls\n", g_config.interface_name);
+    wprintf(L"  %d workers, %d s per server\n", opts.concurrency, opts.duration_ms / 1000);
+    wprintf(L"========================================\n\n");
+
+    status_get_configured_dns(ipv4_servers, &ipv4_count, ipv6_servers, &ipv6_count);
+    count = add_targets(targets, count, ipv4_servers, ipv4_count);
+    count = add_targets(targets, count, ipv6_servers, ipv6_count);
+
+    if (count == 0) {
+        print_error(L"No DNS servers configured on the interface");
+        return 1;
+    }
+
+    result = (BenchResult *)malloc(sizeof(BenchResult));
+    if (!result) {
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        wchar_t msg[MAX_ADDR_LEN + 64];
+        StringCchPrintfW(msg, MAX_ADDR_LEN + 64, L"Benchmarking %ls over %ls...",
+                         targets[i].server, targets[i].transport == BENCH_DOH ? L"DoH" : L"UDP");
+        print_info(msg);
+
+        if (bench_measure(&targets[i], &opts, result) != 0) {
+            print_error(L"Benchmark could not be started");
+            failed++;
+            continue;
+        }
+        wprintf(L"\n");
+        bench_print_result(&targets[i], result);
+    }
+
+    free(result);
+    return failed ? 1 : 0;
+}
@@ -3,6 +3,7 @@
  */
 
 #include "config.h"
+#include "bench.h"
 
 /* Global configuration instance */
 Config g_config;
@@ -14,12 +15,210 @@ Config g_config;
 void config_init(void)
 {
     ZeroMemory(&g_config, sizeof(g_config));
+    probe_options_init(&g_config.probe);
+    watch_options_init(&g_config.watch);
+    health_options_init(&g_config.health);
+    metrics_options_init(&g_config.metrics);
+    mtu_options_init(&g_config.mtu);
+    StringCchCopyW(g_config.serve_pipe, SERVE_PIPE_NAME_LEN, SERVE_DEFAULT_PIPE);
+    g_config.serve_interval = SERVE_DEFAULT_INTERVAL_S;
+    g_config.export_format = EXPORT_PROMETHEUS;
+    g_config.export_interval = EXPORT_DEFAULT_INTERVAL_S;
+    g_config.history_capacity = HISTORY_DEFAULT_CAPACITY;
+    g_config.ready_timeout = READY_DEFAULT_TIMEOUT_S;
+    warmup_options_init(&g_config.warmup);
+    for (int i = 0; i < RETRY_STEP_COUNT; i++) {
+        retry_policy_init(&g_config.retry[i]);
+    }
 }
 
 /* ============================================================================
  * INI FILE PARSING
  * ============================================================================ */
 
+/*
+ * Address list sections accept one address per line, or "file = path"
+ * to pull the entries from a separate file
+ */
+static IpAddrList *address_list_for_section(const wchar_t *section, int *family)
+{
+    if (_wcsicmp(section, L"ipv4.addresses") == 0) {
+        *family = AF_INET;
+        return &g_config.ipv4_addresses;
+    }
+    if (_wcsicmp(section, L"ipv6.addresses") == 0) {
+        *family = AF_INET6;
+        return &g_config.ipv6_addresses;
+    }
+    return NULL;
+}
+
+static void parse_address_entry(IpAddrList *list, int family,
+                                const wchar_t *section, const wchar_t *value)
+{
+    IpAddr addr;
+
+    if (address_parse(value, &addr) != 0 || addr.family != family ||
+        address_list_add(list, &addr) != 0) {
+        wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+        StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+            L"Invalid address in [%ls]: %ls", section, value);
+        print_error(errmsg);
+        list->invalid++;
+    }
+}
+
+static void parse_route_entry(const wchar_t *value)
+{
+    RouteEntry route;
+
+    if (route_parse(value, &route) != 0 ||
+        route_list_add(&g_config.routes, &route) != 0) {
+        wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+        StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+            L"Invalid route in [routes]: %ls", value);
+        print_error(errmsg);
+    }
+}
+
+/*
+ * Split "primary, secondary" server lists as used by [dns] and [provider.NAME]
+ */
+static void parse_server_pair(wchar_t *value, wchar_t *primary, wchar_t *secondary)
+{
+    wchar_t *comma = wcschr(value, L',');
+    if (comma) {
+        *comma = L'\0';
+        StringCchCopyW(secondary, MAX_ADDR_LEN, trim(comma + 1));
+    }
+    StringCchCopyW(primary, MAX_ADDR_LEN, trim(value));
+}
+
+/*
+ * Find or create the provider for a [provider.NAME] section
+ */
+static ProviderConfig *provider_for_section(const wchar_t *section)
+{
+    const wchar_t *name = section + wcslen(L"provider.");
+    ProviderConfig *provider;
+
+    for (int i = 0; i < g_config.provider_count; i++) {
+        if (_wcsicmp(g_config.providers[i].name, name) == 0) {
+            return &g_config.providers[i];
+        }
+    }
+
+    if (*name == L'\0' || g_config.provider_count == MAX_PROVIDERS) {
+        return NULL;
+    }
+
+    provider = &g_config.providers[g_config.provider_count++];
+    ZeroMemory(provider, sizeof(*provider));
+    StringCchCopyW(provider->name, MAX_PROVIDER_NAME, name);
+    return provider;
+}
+
+/*
+ * Find or create the profile for a [profile.NAME] section
+ */
+static Profile *profile_for_section(const wchar_t *section)
+{
+    const wchar_t *name = section + 8;     /* Skip "profile." */
+    Profile *profile;
+
+    for (int i = 0; i < g_config.profile_count; i++) {
+        if (_wcsicmp(g_config.profiles[i].name, name) == 0) {
+            return &g_config.profiles[i];
+        }
+    }
+
+    if (*name == L'\0' || g_config.profile_count == MAX_PROFILES) {
+        return NULL;
+    }
+
+    profile = &g_config.profiles[g_config.profile_count++];
+    ZeroMemory(profile, sizeof(*profile));
+    StringCchCopyW(profile->name, PROFILE_NAME_LEN, name);
+    return profile;
+}
+
+/*
+ * Parse the comma-separated probe query names (ASCII host names)
+ */
+static void parse_probe_names(wchar_t *value)
+{
+    wchar_t *token, *context = NULL;
+
+    g_config.probe.name_count = 0;
+    for (token = wcstok_s(value, L", ", &context);
+         token && g_config.probe.name_count < PROBE_MAX_NAMES;
+         token = wcstok_s(NULL, L", ", &context)) {
+        char *name = g_config.probe.names[g_config.probe.name_count];
+        size_t len = wcslen(token);
+        int ascii = len < PROBE_NAME_LEN;
+
+        for (size_t i = 0; ascii && i < len; i++) {
+            ascii = token[i] > 0x20 && token[i] < 0x7F;
+            name[i] = (char)token[i];
+        }
+        if (!ascii) {
+            wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+            StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                L"Invalid probe name in [probe]: %ls", token);
+            print_error(errmsg);
+            continue;
+        }
+        name[len] = '\0';
+        g_config.probe.name_count++;
+    }
+
+    if (g_config.probe.name_count == 0) {
+        probe_options_init(&g_config.probe);
+    }
+}
+
+/*
+ * Parse one [health] key
+ * Returns 0 on success, -1 on an unknown key or out-of-range value
+ */
+static int parse_health_setting(const wchar_t *key, const wchar_t *value)
+{
+    HealthOptions *opts = &g_config.health;
+    int n = _wtoi(value);
+
+    if (_wcsicmp(key, L"provider") == 0) {
+        StringCchCopyW(g_config.provider_name, MAX_PROVIDER_NAME, value);
+    }
+    else if (_wcsicmp(key, L"fallback") == 0) {
+        StringCchCopyW(g_config.health_fallback, MAX_PROVIDER_NAME, value);
+    }
+    else if (_wcsicmp(key, L"interval") == 0 && n >= 1 && n <= 3600) {
+        opts->interval_ms = n * 1000;
+    }
+    else if (_wcsicmp(key, L"timeout") == 0 && n >= 1 && n <= 10000) {
+        opts->timeout_ms = n;
+    }
+    else if (_wcsicmp(key, L"window") == 0 && n >= 1 && n <= HEALTH_MAX_WINDOW) {
+        opts->window = n;
+    }
+    else if (_wcsicmp(key, L"max_latency") == 0 && n >= 1) {
+        opts->max_latency_ms = n;
+    }
+    else if (_wcsicmp(key, L"max_loss") == 0 && n >= 0 && n <= 100) {
+        opts->max_loss_pct = n;
+    }
+    else if (_wcsicmp(key, L"fail_after") == 0 && n >= 1) {
+        opts->fail_after = n;
+    }
+    else if (_wcsicmp(key, L"recover_after") == 0 && n >= 1) {
+        opts->recover_after = n;
+    }
+    else {
+        return -1;
+    }
+    return 0;
+}
+
 int config_parse_file(const wchar_t *filepath)
 {
     FILE *fp;
@@ -50,6 +249,19 @@ int config_parse_file(const wchar_t *filepath)
 
         /* Key = Value */
         wchar_t *eq = wcschr(trimmed, L'=');
+        int list_family = 0;
+        IpAddrList *list = address_list_for_section(section, &list_family);
+
+        if (list && !eq) {
+            parse_address_entry(list, list_family, section, trimmed);
+            continue;
+        }
+
+        if (_wcsicmp(section, L"routes") == 0 && !eq) {
+            parse_route_entry(trimmed);
+            continue;
+        }
+
         if (eq) {
             *eq = L'\0';
             wchar_t *key = trim(trimmed);
@@ -64,7 +276,55 @@ int config_parse_file(const wchar_t *filepath)
             }
 
             /* Parse based on section */
-            if (_wcsicmp(section, L"interface") == 0) {
+            if (list) {
+                if (_wcsicmp(key, L"file") == 0) {
+                    if (address_list_load_file(list, value, list_family) < 0) {
+                        wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                        StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                            L"Cannot read address file: %ls", value);
+                        print_error(errmsg);
+                        list->invalid++;
+                    }
+                }
+                else if (_wcsicmp(key, L"address") == 0) {
+                    parse_address_entry(list, list_family, section, value);
+                }
+            }
+            else if (_wcsicmp(section, L"routes") == 0) {
+                if (_wcsicmp(key, L"file") == 0) {
+                    if (route_list_load_file(&g_config.routes, value) < 0) {
+                        wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                        StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                            L"Cannot read route file: %ls", value);
+                        print_error(errmsg);
+                    }
+                }
+                else if (_wcsicmp(key, L"route") == 0) {
+                    parse_route_entry(value);
+                }
+                else if (_wcsicmp(key, L"prune") == 0) {
+                    g_config.routes_prune = (_wcsicmp(value, L"yes") == 0 || _wcsicmp(value, L"true") == 0 || _wcsicmp(value, L"1") == 0);
+                }
+            }
+            else if (_wcsicmp(section, L"nrpt") == 0) {
+                NrptRule rule;
+                if (_wcsicmp(key, L"file") == 0) {
+                    if (nrpt_list_load_file(&g_config.nrpt_rules, value) < 0) {
+                        wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                        StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                            L"Cannot read NRPT rule file: %ls", value);
+                        print_error(errmsg);
+                    }
+                }
+                else if (nrpt_parse_rule(key, value, &rule) != 0 ||
+                         nrpt_list_add(&g_config.nrpt_rules, &rule) != 0) {
+                    wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                    StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                        L"Invalid NRPT rule in [nrpt]: %ls", key);
+                    print_error(errmsg);
+                }
+            }
+            else if (_wcsicmp(section, L"interface") == 0) {
                 if (_wcsicmp(key, L"name") == 0) {
                     StringCchCopyW(g_config.interface_name, MAX_IFACE_LEN, value);
                 }
@@ -96,25 +356,244 @@ int config_parse_file(const wchar_t *filepath)
             else if (_wcsicmp(section, L"dns") == 0) {
                 if (_wcsicmp(key, L"ipv4_servers") == 0) {
                     /* Parse comma-separated: "1.1.1.1, 1.0.0.1" */
-                    wchar_t *comma = wcschr(value, L',');
-                    if (comma) {
-                        *comma = L'\0';
-                        StringCchCopyW(g_config.dns_ipv4_primary, MAX_ADDR_LEN, trim(value));
-                        StringCchCopyW(g_config.dns_ipv4_secondary, MAX_ADDR_LEN, trim(comma + 1));
-                    } else {
-                        StringCchCopyW(g_config.dns_ipv4_primary, MAX_ADDR_LEN, trim(value));
-                    }
+                    parse_server_pair(value, g_config.dns_ipv4_primary,
+                                      g_config.dns_ipv4_secondary);
                     g_config.has_custom_dns = 1;
                 }
                 else if (_wcsicmp(key, L"ipv6_servers") == 0) {
-                    /* Parse comma-separated IPv6 addresses */
-                    wchar_t *comma = wcschr(value, L',');
-                    if (comma) {
-                        *comma = L'\0';
-                        StringCchCopyW(g_config.dns_ipv6_primary, MAX_ADDR_LEN, trim(value));
-                        StringCchCopyW(g_config.dns_ipv6_secondary, MAX_ADDR_LEN, trim(comma + 1));
+                    parse_server_pair(value, g_config.dns_ipv6_primary,
+                                      g_config.dns_ipv6_secondary);
+                }
+                else if (_wcsicmp(key, L"fast_path") == 0) {
+                    if (fastpath_scope_parse(value, &g_config.fast_path) != 0) {
+                        wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                        StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                            L"Invalid fast_path in [dns]: %ls (no, interface or global)", value);
+                        print_error(errmsg);
+                    }
+                }
+                else if (_wcsicmp(key, L"suffixes") == 0) {
+                    if (suffix_parse(value, &g_config.dns_suffixes) == 0) {
+                        g_config.has_suffixes = 1;
                     } else {
-                        StringCchCopyW(g_config.dns_ipv6_primary, MAX_ADDR_LEN, trim(value));
+                        wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                        StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                            L"Invalid DNS suffix list in [dns]: %ls", value);
+                        print_error(errmsg);
+                    }
+                }
+            }
+            else if (_wcsnicmp(section, L"provider.", 9) == 0) {
+                ProviderConfig *provider = provider_for_section(section);
+                if (!provider) {
+                    wchar_t errmsg[128];
+                    StringCchPrintfW(errmsg, 128, L"Ignoring [%ls]: invalid name or too many providers",
+                                     section);
+                    print_error(errmsg);
+                }
+                else if (_wcsicmp(key, L"ipv4_servers") == 0) {
+                    parse_server_pair(value, provider->ipv4_primary, provider->ipv4_secondary);
+                }
+                else if (_wcsicmp(key, L"ipv6_servers") == 0) {
+                    parse_server_pair(value, provider->ipv6_primary, provider->ipv6_secondary);
+                }
+                else if (_wcsicmp(key, L"template") == 0) {
+                    StringCchCopyW(provider->doh_template, 256, value);
+                }
+            }
+            else if (_wcsnicmp(section, L"profile.", 8) == 0) {
+                Profile *profile = profile_for_section(section);
+                if (!profile) {
+                    wchar_t errmsg[128];
+                    StringCchPrintfW(errmsg, 128, L"Ignoring [%ls]: invalid name or too many profiles",
+                                     section);
+                    print_error(errmsg);
+                }
+                else if (profile_set(profile, key, value) != 0) {
+                    wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                    StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                        L"Invalid setting in [%ls]: %ls = %ls", section, key, value);
+                    print_error(errmsg);
+                }
+            }
+            else if (_wcsnicmp(section, L"retry.", 6) == 0) {
+                RetryStep step;
+                if (retry_step_from_name(section + 6, &step) != 0 ||
+                    retry_set(&g_config.retry[step], key, value) != 0) {
+                    wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                    StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                        L"Invalid setting in [%ls]: %ls = %ls", section, key, value);
+                    print_error(errmsg);
+                }
+            }
+            else if (_wcsicmp(section, L"probe") == 0) {
+                if (_wcsicmp(key, L"count") == 0) {
+                    int count = _wtoi(value);
+                    if (count >= 1 && count <= PROBE_MAX_COUNT) {
+                        g_config.probe.count = count;
+                    }
+                }
+                else if (_wcsicmp(key, L"timeout") == 0) {
+                    int timeout = _wtoi(value);
+                    if (timeout > 0) {
+                        g_config.probe.timeout_ms = timeout;
+                    }
+                }
+                else if (_wcsicmp(key, L"names") == 0) {
+                    parse_probe_names(value);
+                }
+            }
+            else if (_wcsicmp(section, L"watch") == 0) {
+                if (_wcsicmp(key, L"provider") == 0) {
+                    StringCchCopyW(g_config.provider_name, MAX_PROVIDER_NAME, value);
+                }
+                else if (_wcsicmp(key, L"debounce") == 0) {
+                    int debounce = _wtoi(value);
+                    if (debounce >= 0) {
+                        g_config.watch.debounce_ms = debounce;
+                    }
+                }
+                else if (_wcsicmp(key, L"interval") == 0) {
+                    int interval = _wtoi(value);
+                    if (interval >= 0 && interval <= 86400) {
+                        g_config.watch.interval_ms = interval * 1000;
+                    }
+                }
+            }
+            else if (_wcsicmp(section, L"health") == 0) {
+                if (parse_health_setting(key, value) != 0) {
+                    wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                    StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                        L"Invalid setting in [health]: %ls = %ls", key, value);
+                    print_error(errmsg);
+                }
+            }
+            else if (_wcsicmp(section, L"tcp") == 0) {
+                if (tcp_set(&g_config.tcp, key, value) != 0) {
+                    wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                    StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                        L"Invalid setting in [tcp]: %ls = %ls", key, value);
+                    print_error(errmsg);
+                }
+            }
+            else if (_wcsicmp(section, L"adapter") == 0) {
+                if (adapter_property_set(&g_config.adapter, key, value) != 0) {
+                    wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                    StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                        L"Invalid setting in [adapter]: %ls = %ls", key, value);
+                    print_error(errmsg);
+                }
+            }
+            else if (_wcsicmp(section, L"prefix_policy") == 0) {
+                int ok;
+                if (_wcsicmp(key, L"preference") == 0) {
+                    ok = prefix_preference_parse(value, &g_config.prefix_preference) == 0;
+                } else if (_wcsicmp(key, L"policy") == 0) {
+                    /* Policy lines alone mean a custom table */
+                    ok = prefix_policy_add(&g_config.prefix_policies, value) == 0;
+                    if (ok && g_config.prefix_preference == PREFIX_NONE) {
+                        g_config.prefix_preference = PREFIX_CUSTOM;
+                    }
+                } else {
+                    ok = 0;
+                }
+                if (!ok) {
+                    wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                    StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                        L"Invalid setting in [prefix_policy]: %ls = %ls", key, value);
+                    print_error(errmsg);
+                }
+            }
+            else if (_wcsicmp(section, L"resolver_cache") == 0) {
+                if (dnscache_set(&g_config.resolver_cache, key, value) != 0) {
+                    wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                    StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                        L"Invalid setting in [resolver_cache]: %ls = %ls", key, value);
+                    print_error(errmsg);
+                }
+            }
+            else if (_wcsicmp(section, L"metrics") == 0) {
+                int n = _wtoi(value);
+                if (_wcsicmp(key, L"pings") == 0 && n >= 1 && n <= METRICS_MAX_PINGS) {
+                    g_config.metrics.pings = n;
+                }
+                else if (_wcsicmp(key, L"timeout") == 0 && n >= 1 && n <= 10000) {
+                    g_config.metrics.timeout_ms = n;
+                }
+                else if (_wcsicmp(key, L"base") == 0 && n >= 1 && n <= 9999) {
+                    g_config.metrics.base = n;
+                }
+                else if (_wcsicmp(key, L"step") == 0 && n >= 1 && n <= 999) {
+                    g_config.metrics.step = n;
+                }
+            }
+            else if (_wcsicmp(section, L"mtu") == 0) {
+                int n = _wtoi(value);
+                if (_wcsicmp(key, L"targets") == 0) {
+                    StringCchCopyW(g_config.mtu.targets, MTU_TARGETS_LEN, value);
+                }
+                else if (_wcsicmp(key, L"min") == 0 && n >= MTU_MIN_IPV4 && n <= MTU_MAX) {
+                    g_config.mtu.min = n;
+                }
+                else if (_wcsicmp(key, L"max") == 0 && n >= MTU_MIN_IPV4 && n <= MTU_MAX) {
+                    g_config.mtu.max = n;
+                }
+                else if (_wcsicmp(key, L"timeout") == 0 && n >= 1 && n <= 10000) {
+                    g_config.mtu.timeout_ms = n;
+                }
+                else if (_wcsicmp(key, L"attempts") == 0 && n >= 1 && n <= MTU_MAX_ATTEMPTS) {
+                    g_config.mtu.attempts = n;
+                }
+            }
+            else if (_wcsicmp(section, L"warmup") == 0) {
+                if (_wcsicmp(key, L"names") == 0) {
+                    if (warmup_set_names(&g_config.warmup, value) != 0) {
+                        wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+                        StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                            L"Ignoring invalid names in [warmup]: %ls", value);
+                        print_error(errmsg);
+                    }
+                }
+                else if (_wcsicmp(key, L"concurrency") == 0) {
+                    int concurrency = _wtoi(value);
+                    if (concurrency >= 1 && concurrency <= WARMUP_MAX_CONCURRENCY) {
+                        g_config.warmup.concurrency = concurrency;
+                    }
+                }
+            }
+            else if (_wcsicmp(section, L"serve") == 0) {
+                if (_wcsicmp(key, L"pipe") == 0 && value[0] != L'\0' && !wcschr(value, L'\\')) {
+                    StringCchCopyW(g_config.serve_pipe, SERVE_PIPE_NAME_LEN, value);
+                }
+                else if (_wcsicmp(key, L"interval") == 0) {
+                    int interval = _wtoi(value);
+                    if (interval >= 1 && interval <= 86400) {
+                        g_config.serve_interval = interval;
+                    }
+                }
+            }
+            else if (_wcsicmp(section, L"export") == 0) {
+                if (_wcsicmp(key, L"file") == 0) {
+                    StringCchCopyW(g_config.export_file, MAX_PATH_LEN, value);
+                }
+                else if (_wcsicmp(key, L"format") == 0) {
+                    export_parse_format(value, &g_config.export_format);
+                }
+                else if (_wcsicmp(key, L"interval") == 0) {
+                    int interval = _wtoi(value);
+                    if (interval >= 0 && interval <= 86400) {
+                        g_config.export_interval = interval;
+                    }
+                }
+            }
+            else if (_wcsicmp(section, L"history") == 0) {
+                if (_wcsicmp(key, L"file") == 0) {
+                    StringCchCopyW(g_config.history_file, MAX_PATH_LEN, value);
+                }
+                else if (_wcsicmp(key, L"capacity") == 0) {
+                    int capacity = _wtoi(value);
+                    if (capacity >= 16 && capacity <= HISTORY_MAX_CAPACITY) {
+                        g_config.history_capacity = capacity;
                     }
                 }
             }
@@ -133,6 +612,16 @@ int config_parse_file(const wchar_t *filepath)
     }
 
     fclose(fp);
+
+    /* Both ends are known only now; either may come first in the file */
+    if (g_config.mtu.min >= g_config.mtu.max) {
+        wchar_t errmsg[128];
+        StringCchPrintfW(errmsg, 128, L"Invalid [mtu] range: min %d is not below max %d",
+                         g_config.mtu.min, g_config.mtu.max);
+        print_error(errmsg);
+        g_config.mtu.min = MTU_MIN_IPV4;
+        g_config.mtu.max = MTU_DEFAULT_MAX;
+    }
     return 0;
 }
 
@@ -186,6 +675,145 @@ RunMode config_parse_args(int argc, wchar_t *argv[], wchar_t *config_file)
             continue;
         }
 
+        /* Wait for address readiness after a static apply */
+        if (_wcsicmp(arg, L"--wait-ready") == 0) {
+            g_config.wait_ready = 1;
+            continue;
+        }
+        if (_wcsicmp(arg, L"--wait-timeout") == 0) {
+            int value = (i + 1 < argc) ? _wtoi(argv[i + 1]) : 0;
+            if (value < 1 || value > READY_MAX_TIMEOUT_S) {
+                print_error(L"--wait-timeout requires a number of seconds (1-600)");
+                return MODE_NONE;
+            }
+            g_config.ready_timeout = value;
+            i++;
+            continue;
+        }
+
+        /* Provider for watch mode */
+        if (_wcsicmp(arg, L"--provider") == 0) {
+            if (i + 1 < argc) {
+                StringCchCopyW(g_config.provider_name, MAX_PROVIDER_NAME, argv[++i]);
+            } else {
+                print_error(L"--provider requires a name");
+                return MODE_NONE;
+            }
+            continue;
+        }
+
+        /* Global TCP settings: --tcp-autotuning, --tcp-rss, --tcp-ecn, --tcp-rsc */
+        if (_wcsnicmp(arg, L"--tcp-", 6) == 0) {
+            if (i + 1 >= argc || tcp_set(&g_config.tcp, arg + 6, argv[i + 1]) != 0) {
+                wchar_t errmsg[256];
+                StringCchPrintfW(errmsg, 256, L"Invalid value for %ls", arg);
+                print_error(errmsg);
+                return MODE_NONE;
+            }
+            i++;
+            continue;
+        }
+
+        /* Fallback provider for health mode */
+        if (_wcsicmp(arg, L"--fallback") == 0) {
+            if (i + 1 < argc) {
+                StringCchCopyW(g_config.health_fallback, MAX_PROVIDER_NAME, argv[++i]);
+            } else {
+                print_error(L"--fallback requires a name");
+                return MODE_NONE;
+            }
+            continue;
+        }
+
+        /* Force a profile for profile mode */
+        if (_wcsicmp(arg, L"--profile") == 0) {
+            if (i + 1 < argc) {
+                StringCchCopyW(g_config.profile_name, PROFILE_NAME_LEN, argv[++i]);
+            } else {
+                print_error(L"--profile requires a name");
+                return MODE_NONE;
+            }
+            continue;
+        }
+
+        /* Status output */
+        if (_wcsicmp(arg, L"--json") == 0) {
+            g_config.status_json = 1;
+            continue;
+        }
+        if (_wcsicmp(arg, L"--server") == 0) {
+            g_config.status_server = 1;
+            continue;
+        }
+        if (_wcsicmp(arg, L"--suffix-cost") == 0) {
+            g_config.suffix_cost = 1;
+            continue;
+        }
+
+        /* Status history file */
+        if (_wcsicmp(arg, L"--history") == 0) {
+            if (i + 1 < argc) {
+                StringCchCopyW(g_config.history_file, MAX_PATH_LEN, argv[++i]);
+            } else {
+                print_error(L"--history requires a file name");
+                return MODE_NONE;
+            }
+            continue;
+        }
+
+        /* export options */
+        if (_wcsicmp(arg, L"--output") == 0) {
+            if (i + 1 < argc) {
+                StringCchCopyW(g_config.export_file, MAX_PATH_LEN, argv[++i]);
+            } else {
+                print_error(L"--output requires a file name");
+                return MODE_NONE;
+            }
+            continue;
+        }
+        if (_wcsicmp(arg, L"--format") == 0) {
+            if (i + 1 >= argc || export_parse_format(argv[i + 1], &g_config.export_format) != 0) {
+                print_error(L"--format requires prometheus or json");
+                return MODE_NONE;
+            }
+            i++;
+            continue;
+        }
+        if (_wcsicmp(arg, L"--interval") == 0) {
+            int value = (i + 1 < argc) ? _wtoi(argv[i + 1]) : -1;
+            if (i + 1 >= argc || value < 0 || value > 86400) {
+                print_error(L"--interval requires a number of seconds (0 writes once)");
+                return MODE_NONE;
+            }
+            g_config.export_interval = value;
+            i++;
+            continue;
+        }
+
+        /* dns-bench options */
+        if (_wcsicmp(arg, L"--concurrency") == 0 || _wcsicmp(arg, L"--duration") == 0) {
+            int value = (i + 1 < argc) ? _wtoi(argv[i + 1]) : 0;
+            int is_concurrency = _wcsicmp(arg, L"--concurrency") == 0;
+            if (value < 1 || (is_concurrency && value > BENCH_MAX_CONCURRENCY)) {
+                wchar_t errmsg[128];
+                if (is_concurrency) {
+                    StringCchPrintfW(errmsg, 128, L"--concurrency requires a number from 1 to %d",
+                                     BENCH_MAX_CONCURRENCY);
+                } else {
+                    StringCchCopyW(errmsg, 128, L"--duration requires a number of seconds");
+                }
+                print_error(errmsg);
+                return MODE_NONE;
+            }
+            if (is_concurrency) {
+                g_config.bench_concurrency = value;
+            } else {
+                g_config.bench_duration = value;
+            }
+            i++;
+            continue;
+        }
+
         /* IPv4 overrides */
         if (_wcsicmp(arg, L"--ipv4") == 0) {
             if (i + 1 < argc) {
@@ -241,6 +869,58 @@ RunMode config_parse_args(int argc, wchar_t *argv[], wchar_t *config_file)
             mode = MODE_CUSTOM;
             continue;
         }
+        if (_wcsicmp(arg, L"auto") == 0) {
+            mode = MODE_AUTO;
+            continue;
+        }
+        if (_wcsicmp(arg, L"dns-bench") == 0) {
+            mode = MODE_BENCH;
+            continue;
+        }
+        if (_wcsicmp(arg, L"watch") == 0) {
+            mode = MODE_WATCH;
+            continue;
+        }
+        if (_wcsicmp(arg, L"health") == 0) {
+            mode = MODE_HEALTH;
+            continue;
+        }
+        if (_wcsicmp(arg, L"metrics") == 0) {
+            mode = MODE_METRICS;
+            continue;
+        }
+        if (_wcsicmp(arg, L"metrics-restore") == 0) {
+            mode = MODE_METRICS_RESTORE;
+            continue;
+        }
+        if (_wcsicmp(arg, L"mtu") == 0) {
+            mode = MODE_MTU;
+            continue;
+        }
+        if (_wcsicmp(arg, L"prefix-probe") == 0) {
+            mode = MODE_PREFIX_PROBE;
+            continue;
+        }
+        if (_wcsicmp(arg, L"profile") == 0) {
+            mode = MODE_PROFILE;
+            continue;
+        }
+        if (_wcsicmp(arg, L"serve") == 0) {
+            mode = MODE_SERVE;
+            continue;
+        }
+        if (_wcsicmp(arg, L"export") == 0) {
+            mode = MODE_EXPORT;
+            continue;
+        }
+        if (_wcsicmp(arg, L"history") == 0) {
+            mode = MODE_HISTORY;
+            continue;
+        }
+        if (_wcsicmp(arg, L"batch") == 0) {
+            mode = MODE_BATCH;
+            continue;
+        }
         if (_wcsicmp(arg, L"status") == 0) {
             mode = MODE_STATUS;
             continue;
@@ -272,6 +952,19 @@ void config_print_help(void)
     wprintf(L"    cloudflare    Configure DNS with Cloudflare (1.1.1.1) + DoH\n");
     wprintf(L"    google        Configure DNS with Google (8.8.8.8) + DoH\n");
     wprintf(L"    custom        Configure DNS with custom servers from config file\n");
+    wprintf(L"    auto          Probe all providers and configure the fastest one\n");
+    wprintf(L"    dns-bench     Benchmark the DNS servers configured on the interface\n");
+    wprintf(L"    watch         Keep a provider's DNS + DoH in place across network changes\n");
+    wprintf(L"    health        Probe a provider and fail over to --fallback while it degrades\n");
+    wprintf(L"    metrics       Measure each gateway and set interface metrics, fastest first\n");
+    wprintf(L"    metrics-restore  Put back the metrics saved by the first metrics run\n");
+    wprintf(L"    mtu           Probe the path MTU to the gateway and DNS servers and set it\n");
+    wprintf(L"    prefix-probe  Compare IPv4 and IPv6 connect latency, recommend a prefix policy\n");
+    wprintf(L"    profile       Apply the [profile.NAME] that matches the current network\n");
+    wprintf(L"    serve         Keep the status in memory and answer status --server\n");
+    wprintf(L"    export        Write the status to a file for monitoring (Prometheus/JSON)\n");
+    wprintf(L"    history       Show DNS status transitions recorded in the history file\n");
+    wprintf(L"    batch         Run JSON Lines jobs from stdin, one result line per job\n");
     wprintf(L"    status        Show current DNS encryption status\n");
     wprintf(L"\n");
     wprintf(L"OPTIONS:\n");
@@ -280,12 +973,31 @@ void config_print_help(void)
     wprintf(L"    -l, --list-interfaces   List available network interfaces\n");
     wprintf(L"    -i, --interface NAME    Specify network interface name\n");
     wprintf(L"    --dns-only              Only configure DNS (skip static IP setup)\n");
+    wprintf(L"    --wait-ready            Wait until the static addresses are usable\n");
+    wprintf(L"    --wait-timeout SECONDS  --wait-ready: give up after SECONDS (default 30)\n");
+    wprintf(L"    --tcp-autotuning LEVEL  Receive window auto-tuning (disabled, normal, ...)\n");
+    wprintf(L"    --tcp-rss STATE         Receive-side scaling (enabled, disabled)\n");
+    wprintf(L"    --tcp-ecn STATE         ECN capability (enabled, disabled, default)\n");
+    wprintf(L"    --tcp-rsc STATE         Receive segment coalescing (enabled, disabled)\n");
+    wprintf(L"    --concurrency N         dns-bench: parallel queries (default 4)\n");
+    wprintf(L"    --duration SECONDS      dns-bench: time per server (default 10)\n");
+    wprintf(L"    --provider NAME         watch, health: cloudflare, google, custom or a [provider.NAME]\n");
+    wprintf(L"    --fallback NAME         health: provider to fail over to\n");
+    wprintf(L"    --profile NAME          profile: apply NAME instead of matching\n");
+    wprintf(L"    --json                  status: print the report as JSON\n");
+    wprintf(L"    --server                status: ask a running serve instance\n");
+    wprintf(L"    --suffix-cost           status: time a failing lookup under each DNS suffix\n");
+    wprintf(L"    --history FILE          Record every status snapshot in FILE (ring buffer)\n");
+    wprintf(L"    --output FILE           export: file to replace atomically\n");
+    wprintf(L"    --format FORMAT         export: prometheus (default) or json\n");
+    wprintf(L"    --interval SECONDS      export: rewrite period, 0 writes once (default 60)\n");
     wprintf(L"\n");
     wprintf(L"IP OVERRIDE OPTIONS:\n");
-    wprintf(L"    --ipv4 ADDR             IPv4 address (e.g., 192.168.1.100)\n");
+    wprintf(L"    --ipv4 ADDR             IPv4 address (e.g., 192.168.1.100, or\n");
+    wprintf(L"                            auto:192.168.1.0/24 for the first free one)\n");
     wprintf(L"    --ipv4-mask MASK        IPv4 subnet mask (e.g., 255.255.255.0)\n");
     wprintf(L"    --ipv4-gateway GW       IPv4 gateway (e.g., 192.168.1.1)\n");
-    wprintf(L"    --ipv6 ADDR             IPv6 address\n");
+    wprintf(L"    --ipv6 ADDR             IPv6 address, or auto:RANGE\n");
     wprintf(L"    --ipv6-prefix LEN       IPv6 prefix length (e.g., 64)\n");
     wprintf(L"    --ipv6-gateway GW       IPv6 gateway (link-local address)\n");
     wprintf(L"\n");
@@ -297,10 +1009,25 @@ void config_print_help(void)
     wprintf(L"    static-ip-fix.exe -l\n");
     wprintf(L"    static-ip-fix.exe -i \"Wi-Fi\" --dns-only cloudflare\n");
     wprintf(L"    static-ip-fix.exe -c myconfig.ini cloudflare\n");
+    wprintf(L"    static-ip-fix.exe -i Ethernet --dns-only auto\n");
+    wprintf(L"    static-ip-fix.exe -i Ethernet --concurrency 16 --duration 30 dns-bench\n");
+    wprintf(L"    static-ip-fix.exe -i Ethernet --provider cloudflare watch\n");
+    wprintf(L"    static-ip-fix.exe -i Ethernet --provider cloudflare --fallback google health\n");
+    wprintf(L"    static-ip-fix.exe metrics\n");
+    wprintf(L"    static-ip-fix.exe metrics-restore\n");
+    wprintf(L"    static-ip-fix.exe -i \"VPN\" mtu\n");
+    wprintf(L"    static-ip-fix.exe -i Ethernet prefix-probe\n");
+    wprintf(L"    static-ip-fix.exe -c sites.ini profile\n");
     wprintf(L"    static-ip-fix.exe --interface Ethernet status\n");
+    wprintf(L"    static-ip-fix.exe --server --json status\n");
+    wprintf(L"    static-ip-fix.exe -i Ethernet --output C:\\metrics\\dns.prom export\n");
+    wprintf(L"    static-ip-fix.exe --history dns.hist history\n");
+    wprintf(L"    static-ip-fix.exe -c fleet.ini batch < jobs.jsonl\n");
     wprintf(L"\n");
     wprintf(L"NOTE:\n");
-    wprintf(L"    The cloudflare and google modes require Administrator privileges.\n");
+    wprintf(L"    The cloudflare, google, custom, auto, watch, health, metrics,\n");
+    wprintf(L"    metrics-restore, mtu, profile and batch modes require Administrator\n");
+    wprintf(L"    privileges.\n");
     wprintf(L"\n");
 }
 
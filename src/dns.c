@@ -5,6 +5,18 @@
 #include "dns.h"
 #include "config.h"
 #include "network.h"
+#include "probe.h"
+#include "ready.h"
+#include "tcp.h"
+#include "adapter.h"
+#include "dnscache.h"
+#include "fastpath.h"
+#include "freeaddr.h"
+#include "prefix.h"
+#include "suffix.h"
+#include "warmup.h"
+#include "validate.h"
+#include "watch.h"
 
 /* ============================================================================
  * BUILT-IN PROVIDERS
@@ -32,6 +44,111 @@ const DnsProvider DNS_GOOGLE = {
  * PROVIDER FUNCTIONS
  * ============================================================================ */
 
+/*
+ * One step of the apply pipeline; the first failure rolls back the steps
+ * before it
+ */
+typedef struct {
+    int (*apply)(void);
+    int addresses;          /* Interface addresses: skipped in DNS-only mode */
+} ApplyStep;
+
+/* Global settings first, so they are applied in DNS-only mode too; the
+   restart adapter properties need comes before the addresses */
+static const ApplyStep STEPS_BEFORE_DNS[] = {
+    { tcp_apply,                         0 },
+    { dnscache_apply,                    0 },
+    { prefix_policy_apply,               0 },
+    { adapter_apply,                     1 },
+    { network_apply_static_ipv4,         1 },
+    { network_apply_static_ipv6,         1 },
+    { network_apply_secondary_addresses, 1 },
+    { network_apply_routes,              1 },
+};
+
+static const ApplyStep STEPS_AFTER_DNS[] = {
+    { fastpath_apply,     0 },
+    { suffix_apply,       0 },
+    { network_apply_nrpt, 0 },
+};
+
+/* When the last address step finished: --wait-ready's time-to-ready
+   counts from here, not from after the DNS steps */
+static LONGLONG g_addresses_applied;
+
+static int run_steps(const ApplyStep *steps, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (steps[i].addresses && g_config.dns_only) {
+            continue;
+        }
+        if (steps[i].apply() != 0) {
+            return -1;
+        }
+        if (steps[i].addresses) {
+            g_addresses_applied = timer_now();
+        }
+    }
+    return 0;
+}
+
+static int apply_servers(const DnsProvider *provider, int keep_in_place)
+{
+    if (keep_in_place) {
+        return watch_enforce(provider, 1) < 0 ? -1 : 0;
+    }
+
+    if (network_apply_dns_ipv4(provider->ipv4_primary, provider->ipv4_secondary) != 0 ||
+        network_apply_dns_ipv6(provider->ipv6_primary, provider->ipv6_secondary) != 0) {
+        return -1;
+    }
+    return network_apply_doh(provider->ipv4_primary, provider->ipv4_secondary,
+                             provider->ipv6_primary, provider->ipv6_secondary,
+                             provider->doh_template);
+}
+
+int dns_apply(const DnsProvider *provider, int keep_in_place)
+{
+    /* A step skipped or not reached in this run must not roll back an
+       earlier run's changes, possibly to another interface */
+    network_rollback_forget();
+    g_addresses_applied = 0;
+
+    /* Before pre-flight, which then checks the address that was picked */
+    if (!g_config.dns_only && freeaddr_resolve() != 0) {
+        return 1;
+    }
+
+    /* A typo found here costs nothing; found by netsh it costs a rollback */
+    if (validate_preflight(provider) != 0) {
+        return 1;
+    }
+
+    if (run_steps(STEPS_BEFORE_DNS, (int)(sizeof(STEPS_BEFORE_DNS) / sizeof(STEPS_BEFORE_DNS[0]))) != 0 ||
+        apply_servers(provider, keep_in_place) != 0 ||
+        run_steps(STEPS_AFTER_DNS, (int)(sizeof(STEPS_AFTER_DNS) / sizeof(STEPS_AFTER_DNS[0]))) != 0) {
+        network_rollback();
+        return 1;
+    }
+    network_rollback_forget();
+
+    wprintf(L"\n");
+    print_success(L"Configuration complete!");
+    wprintf(L"\n");
+
+    /* Everything is applied; a slow or conflicting address is reported,
+       not rolled back */
+    if (g_config.wait_ready && !g_config.dns_only && ready_run(g_addresses_applied) != 0) {
+        return 1;
+    }
+
+    /* Prime the DNS Client cache through the new upstream; misses are
+       only reported */
+    warmup_run();
+
+    return 0;
+}
+
 int dns_run_provider(const DnsProvider *provider) {
     wprintf(L"\n");
     wprintf(L"========================================\n");
@@ -43,38 +160,139 @@ int dns_run_provider(const DnsProvider *provider) {
     wprintf(L"  Interface: %ls\n", g_config.interface_name);
     wprintf(L"========================================\n\n");
 
-    if (!g_config.dns_only) {
-        if (network_apply_static_ipv4() != 0) {
-            network_rollback();
-            return 1;
-        }
+    return dns_apply(provider, 0);
+}
+
+/* ============================================================================
+ * PROVIDER LOOKUP
+ * ============================================================================ */
+
+static void provider_from_config(const ProviderConfig *p, DnsProvider *out)
+{
+    out->name = p->name;
+    out->ipv4_primary = p->ipv4_primary;
+    out->ipv4_secondary = p->ipv4_secondary;
+    out->ipv6_primary = p->ipv6_primary;
+    out->ipv6_secondary = p->ipv6_secondary;
+    out->doh_template = p->doh_template;
+}
+
+static void provider_custom(DnsProvider *out)
+{
+    out->name = L"Custom";
+    out->ipv4_primary = g_config.dns_ipv4_primary;
+    out->ipv4_secondary = g_config.dns_ipv4_secondary;
+    out->ipv6_primary = g_config.dns_ipv6_primary;
+    out->ipv6_secondary = g_config.dns_ipv6_secondary;
+    out->doh_template = g_config.doh_template;
+}
 
-        if (network_apply_static_ipv6() != 0) {
-            network_rollback();
-            return 1;
+int dns_find_provider(const wchar_t *name, DnsProvider *out)
+{
+    if (_wcsicmp(name, L"cloudflare") == 0) {
+        *out = DNS_CLOUDFLARE;
+        return 0;
+    }
+    if (_wcsicmp(name, L"google") == 0) {
+        *out = DNS_GOOGLE;
+        return 0;
+    }
+    if (_wcsicmp(name, L"custom") == 0 && g_config.has_custom_dns) {
+        provider_custom(out);
+        return 0;
+    }
+    for (int i = 0; i < g_config.provider_count; i++) {
+        if (_wcsicmp(g_config.providers[i].name, name) == 0) {
+            provider_from_config(&g_config.providers[i], out);
+            return 0;
         }
     }
+    return -1;
+}
 
-    if (network_apply_dns_ipv4(provider->ipv4_primary, provider->ipv4_secondary) != 0) {
-        network_rollback();
-        return 1;
+/* ============================================================================
+ * AUTO SELECTION
+ * ============================================================================ */
+
+static int add_candidate(DnsProvider *candidates, int count, const DnsProvider *provider)
+{
+    if (count == PROBE_MAX_TARGETS) {
+        return count;
+    }
+    if ((!provider->ipv4_primary || provider->ipv4_primary[0] == L'\0') &&
+        (!provider->ipv6_primary || provider->ipv6_primary[0] == L'\0')) {
+        return count;
     }
+    if (!provider->doh_template || provider->doh_template[0] == L'\0') {
+        wchar_t msg[128];
+        StringCchPrintfW(msg, 128, L"Skipping provider %ls: no DoH template", provider->name);
+        print_info(msg);
+        return count;
+    }
+    candidates[count] = *provider;
+    return count + 1;
+}
 
-    if (network_apply_dns_ipv6(provider->ipv6_primary, provider->ipv6_secondary) != 0) {
-        network_rollback();
-        return 1;
+int dns_run_auto(void)
+{
+    DnsProvider candidates[PROBE_MAX_TARGETS];
+    ProbeTarget targets[PROBE_MAX_TARGETS];
+    ProbeStats stats[PROBE_MAX_TARGETS];
+    wchar_t msg[256];
+    int count = 0;
+    int best;
+
+    count = add_candidate(candidates, count, &DNS_CLOUDFLARE);
+    count = add_candidate(candidates, count, &DNS_GOOGLE);
+
+    if (g_config.has_custom_dns) {
+        DnsProvider custom;
+        provider_custom(&custom);
+        count = add_candidate(candidates, count, &custom);
     }
 
-    if (network_apply_doh(provider->ipv4_primary, provider->ipv4_secondary,
-                          provider->ipv6_primary, provider->ipv6_secondary,
-                          provider->doh_template) != 0) {
-        network_rollback();
+    for (int i = 0; i < g_config.provider_count; i++) {
+        DnsProvider provider;
+        provider_from_config(&g_config.providers[i], &provider);
+        count = add_candidate(candidates, count, &provider);
+    }
+
+    /* Each provider is probed through its primary server */
+    for (int i = 0; i < count; i++) {
+        targets[i].server = candidates[i].ipv4_primary[0] != L'\0'
+            ? candidates[i].ipv4_primary : candidates[i].ipv6_primary;
+        targets[i].port = 0;
+    }
+
+    StringCchPrintfW(msg, 256, L"Probing %d providers (%d queries each)...",
+                     count, g_config.probe.count);
+    print_info(msg);
+
+    if (probe_run(targets, count, &g_config.probe, stats) != 0) {
+        print_error(L"Failed to probe DNS providers");
         return 1;
     }
 
     wprintf(L"\n");
-    print_success(L"Configuration complete!");
+    for (int i = 0; i < count; i++) {
+        if (stats[i].answered == 0) {
+            wprintf(L"  %-16ls %-24ls no answer\n", candidates[i].name, targets[i].server);
+            continue;
+        }
+        wprintf(L"  %-16ls %-24ls median %6.1f ms  p95 %6.1f ms  (%d/%d answered)\n",
+                candidates[i].name, targets[i].server, stats[i].median_ms,
+                stats[i].p95_ms, stats[i].answered, stats[i].sent);
+    }
     wprintf(L"\n");
 
-    return 0;
+    best = probe_pick_best(stats, count);
+    if (best < 0) {
+        print_error(L"No DNS provider answered enough probe queries");
+        return 1;
+    }
+
+    StringCchPrintfW(msg, 256, L"Fastest provider: %ls", candidates[best].name);
+    print_success(msg);
+
+    return dns_run_provider(&candidates[best]);
 }
@@ -0,0 +1,240 @@
+/*
+ * dnscache.c - DNS Client resolver cache tuning ([resolver_cache])
+ */
+
+#include "dnscache.h"
+#include "config.h"
+#include <string.h>
+
+/* ============================================================================
+ * SETTING TABLE
+ * ============================================================================ */
+
+typedef struct {
+    const wchar_t *key;             /* [resolver_cache] key */
+    const wchar_t *label;           /* Shown by status */
+    const wchar_t *value_name;      /* DWORD under DNSCACHE_REGISTRY_KEY */
+    DWORD default_value;            /* What the service uses without it */
+    DWORD min, max;
+} DnsCacheField;
+
+static const DnsCacheField DNSCACHE_FIELDS[DNSCACHE_SETTING_COUNT] = {
+    { L"max_ttl", L"Max TTL (s)", L"MaxCacheTtl", 86400, 1, 2592000 },
+    { L"max_negative_ttl", L"Max negative TTL (s)", L"MaxNegativeCacheTtl", 900, 0, 86400 },
+    { L"table_size", L"Hash table size", L"CacheHashTableSize", 211, 1, 65536 },
+    { L"bucket_size", L"Entries per bucket", L"CacheHashTableBucketSize", 10, 1, 1024 },
+};
+
+/* Changes made by the last dnscache_apply and the values they replaced */
+static DnsCacheSettings g_dnscache_changes;
+static DnsCacheSettings g_dnscache_previous;
+static int g_dnscache_changed;
+
+const wchar_t *dnscache_label(DnsCacheSettingId id)
+{
+    return DNSCACHE_FIELDS[id].label;
+}
+
+const wchar_t *dnscache_value_name(DnsCacheSettingId id)
+{
+    return DNSCACHE_FIELDS[id].value_name;
+}
+
+DWORD dnscache_default(DnsCacheSettingId id)
+{
+    return DNSCACHE_FIELDS[id].default_value;
+}
+
+int dnscache_set(DnsCacheSettings *settings, const wchar_t *key, const wchar_t *value)
+{
+    for (int i = 0; i < DNSCACHE_SETTING_COUNT; i++) {
+        wchar_t *end;
+        unsigned long n;
+
+        if (_wcsicmp(key, DNSCACHE_FIELDS[i].key) != 0) {
+            continue;
+        }
+        n = wcstoul(value, &end, 10);
+        while (*end == L' ' || *end == L'\t') end++;
+        if (end == value || *end != L'\0' || value[0] == L'-' ||
+            n < DNSCACHE_FIELDS[i].min || n > DNSCACHE_FIELDS[i].max) {
+            return -1;
+        }
+        settings->values[i] = (DWORD)n;
+        settings->set[i] = 1;
+        return 0;
+    }
+    return -1;
+}
+
+int dnscache_any(const DnsCacheSettings *settings)
+{
+    for (int i = 0; i < DNSCACHE_SETTING_COUNT; i++) {
+        if (settings->set[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * REGISTRY
+ * ============================================================================ */
+
+int dnscache_read(const RegistryBackend *reg, DnsCacheSettings *out)
+{
+    ZeroMemory(out, sizeof(*out));
+    for (int i = 0; i < DNSCACHE_SETTING_COUNT; i++) {
+        int ret = reg->get_dword(reg->ctx, DNSCACHE_REGISTRY_KEY,
+                                 DNSCACHE_FIELDS[i].value_name, &out->values[i]);
+        if (ret < 0) {
+            return -1;
+        }
+        out->set[i] = ret == 0;
+    }
+    return 0;
+}
+
+int dnscache_diff(const DnsCacheSettings *desired, const DnsCacheSettings *current,
+                  DnsCacheSettings *changes)
+{
+    int count = 0;
+
+    ZeroMemory(changes, sizeof(*changes));
+    for (int i = 0; i < DNSCACHE_SETTING_COUNT; i++) {
+        /* Writing the default explicitly still counts: defaults move
+           between Windows releases */
+        if (desired->set[i] && (!current->set[i] || current->values[i] != desired->values[i])) {
+            changes->values[i] = desired->values[i];
+            changes->set[i] = 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+static int restore_value(const RegistryBackend *reg, int i, const DnsCacheSettings *previous)
+{
+    if (previous->set[i]) {
+        return reg->set_dword(reg->ctx, DNSCACHE_REGISTRY_KEY, DNSCACHE_FIELDS[i].value_name,
+                              previous->values[i]);
+    }
+    return reg->delete_value(reg->ctx, DNSCACHE_REGISTRY_KEY, DNSCACHE_FIELDS[i].value_name);
+}
+
+int dnscache_write(const RegistryBackend *reg, const DnsCacheSettings *changes,
+                   const DnsCacheSettings *previous)
+{
+    for (int i = 0; i < DNSCACHE_SETTING_COUNT; i++) {
+        if (!changes->set[i]) {
+            continue;
+        }
+        if (reg->set_dword(reg->ctx, DNSCACHE_REGISTRY_KEY, DNSCACHE_FIELDS[i].value_name,
+                           changes->values[i]) != 0) {
+            while (--i >= 0) {
+                if (changes->set[i]) {
+                    restore_value(reg, i, previous);
+                }
+            }
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int dnscache_restore(const RegistryBackend *reg, const DnsCacheSettings *changes,
+                     const DnsCacheSettings *previous)
+{
+    int ret = 0;
+
+    for (int i = 0; i < DNSCACHE_SETTING_COUNT; i++) {
+        if (changes->set[i] && restore_value(reg, i, previous) != 0) {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+/* ============================================================================
+ * APPLY AND ROLLBACK
+ * ============================================================================ */
+
+int dnscache_apply(void)
+{
+    RegistryBackend reg;
+    DnsCacheSettings current, changes;
+    wchar_t before[32];
+    wchar_t msg[256];
+    int count;
+
+    /* An apply that changes nothing leaves dnscache_rollback nothing to
+       restore, even if a previous apply in this process did */
+    g_dnscache_changed = 0;
+
+    if (!dnscache_any(&g_config.resolver_cache)) {
+        return 0;
+    }
+
+    print_info(L"Checking resolver cache settings...");
+    registry_backend_system(&reg);
+    if (dnscache_read(&reg, &current) != 0) {
+        print_error(L"Failed to read resolver cache settings");
+        return -1;
+    }
+
+    count = dnscache_diff(&g_config.resolver_cache, &current, &changes);
+    if (count == 0) {
+        print_success(L"Resolver cache settings already in place");
+        return 0;
+    }
+
+    for (int i = 0; i < DNSCACHE_SETTING_COUNT; i++) {
+        if (!changes.set[i]) {
+            continue;
+        }
+        if (current.set[i]) {
+            StringCchPrintfW(before, 32, L"%lu", current.values[i]);
+        } else {
+            StringCchPrintfW(before, 32, L"(default %lu)", DNSCACHE_FIELDS[i].default_value);
+        }
+        wprintf(L"  %ls: %ls -> %lu\n", DNSCACHE_FIELDS[i].value_name, before, changes.values[i]);
+    }
+
+    if (dnscache_write(&reg, &changes, &current) != 0) {
+        print_error(L"Failed to write resolver cache settings");
+        return -1;
+    }
+    g_dnscache_changes = changes;
+    g_dnscache_previous = current;
+    g_dnscache_changed = 1;
+
+    StringCchPrintfW(msg, 256, L"Resolver cache settings applied (%d changed)", count);
+    print_success(msg);
+
+    /* The service reads them only at start, and Windows does not let it be
+       stopped by hand */
+    print_info(L"The DNS Client service picks them up at its next start (reboot)");
+    return 0;
+}
+
+void dnscache_rollback(void)
+{
+    RegistryBackend reg;
+
+    if (!g_dnscache_changed) {
+        return;
+    }
+    g_dnscache_changed = 0;
+
+    registry_backend_system(&reg);
+    if (dnscache_restore(&reg, &g_dnscache_changes, &g_dnscache_previous) != 0) {
+        print_error(L"Failed to restore some resolver cache settings");
+        return;
+    }
+    print_info(L"Resolver cache settings restored");
+}
+
+void dnscache_forget(void)
+{
+    g_dnscache_changed = 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * export.c - Status exporter (export mode) for monitoring agents
+ */
+
+#include <string.h>
+#include "export.h"
+#include "config.h"
+#include "network.h"
+#include "watch.h"
+
+/* ============================================================================
+ * FORMATS
+ * ============================================================================ */
+
+int export_parse_format(const wchar_t *text, ExportFormat *format)
+{
+    if (_wcsicmp(text, L"prometheus") == 0 || _wcsicmp(text, L"prom") == 0) {
+        *format = EXPORT_PROMETHEUS;
+        return 0;
+    }
+    if (_wcsicmp(text, L"json") == 0) {
+        *format = EXPORT_JSON;
+        return 0;
+    }
+    return -1;
+}
+
+int export_format(const StatusReport *report, ExportFormat format, char *buffer, size_t size)
+{
+    if (format == EXPORT_JSON) {
+        return status_format_json(report, buffer, size);
+    }
+    return status_format_prometheus(report, buffer, size);
+}
+
+/* ============================================================================
+ * ATOMIC FILE WRITE
+ * ============================================================================ */
+
+int export_write_file(const wchar_t *path, const char *data, size_t len)
+{
+    wchar_t tmp[MAX_PATH_LEN];
+    FILE *fp = NULL;
+    int ok;
+
+    /* The textfile collector only reads *.prom, so it skips the temp file */
+    if (FAILED(StringCchPrintfW(tmp, MAX_PATH_LEN, L"%ls.tmp", path))) {
+        return -1;
+    }
+    if (_wfopen_s(&fp, tmp, L"wb") != 0 || !fp) {
+        return -1;
+    }
+    ok = fwrite(data, 1, len, fp) == len;
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok || !MoveFileExW(tmp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFileW(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * EXPORT MODE
+ * ============================================================================ */
+
+typedef struct {
+    int writes;
+    int failures;
+} ExportState;
+
+static HANDLE g_stop_event;
+
+static BOOL WINAPI on_console_ctrl(DWORD type)
+{
+    (void)type;
+    SetEvent(g_stop_event);
+    return TRUE;
+}
+
+/*
+ * Collect the status and replace the export file
+ */
+static int export_once(void *ctx, WatchReason reason)
+{
+    static char buffer[STATUS_METRICS_SIZE];
+    ExportState *state = (ExportState *)ctx;
+    StatusReport report;
+    int len;
+
+    (void)reason;
+    status_collect(&report);
+
+    len = export_format(&report, g_config.export_format, buffer, sizeof(buffer));
+    if (len < 0) {
+        print_error(L"Status report too large to export");
+        state->failures++;
+        return -1;
+    }
+    if (export_write_file(g_config.export_file, buffer, (size_t)len) != 0) {
+        wchar_t msg[MAX_PATH_LEN + 64];
+        StringCchPrintfW(msg, MAX_PATH_LEN + 64, L"Failed to write %ls", g_config.export_file);
+        print_error(msg);
+        state->failures++;
+        return -1;
+    }
+
+    state->writes++;
+    return 0;
+}
+
+int export_run(void)
+{
+    ExportState state = { 0, 0 };
+    WatchOptions opts = g_config.watch;
+    WatchSource source;
+    NET_LUID luid;
+    wchar_t msg[MAX_PATH_LEN + 128];
+    int ret;
+
+    if (g_config.export_file[0] == L'\0') {
+        print_error(L"Export mode requires --output FILE or [export] file");
+        return 1;
+    }
+
+    if (export_once(&state, WATCH_PERIODIC) != 0) {
+        return 1;
+    }
+    StringCchPrintfW(msg, MAX_PATH_LEN + 128, L"Wrote %ls status of %ls to %ls",
+                     g_config.export_format == EXPORT_JSON ? L"JSON" : L"Prometheus",
+                     g_config.interface_name, g_config.export_file);
+    print_success(msg);
+
+    if (g_config.export_interval == 0) {
+        return 0;
+    }
+    if (network_get_luid(&luid) != 0) {
+        return 1;
+    }
+
+    g_stop_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!g_stop_event) {
+        print_error(L"Failed to create stop event");
+        return 1;
+    }
+    SetConsoleCtrlHandler(on_console_ctrl, TRUE);
+
+    StringCchPrintfW(msg, MAX_PATH_LEN + 128, L"Rewriting on network changes and every %d s",
+                     g_config.export_interval);
+    print_info(msg);
+    print_info(L"Press Ctrl+C to stop.");
+
+    /* Same change notifications as watch mode, with the export interval */
+    opts.interval_ms = g_config.export_interval * 1000;
+    watch_source_system(&source, &luid);
+    ret = watch_loop(&source, &opts, g_stop_event, export_once, &state);
+
+    SetConsoleCtrlHandler(on_console_ctrl, FALSE);
+    CloseHandle(g_stop_event);
+
+    if (ret != 0) {
+        print_error(L"Failed to subscribe to network change notifications");
+        return 1;
+    }
+
+    wprintf(L"\n");
+    StringCchPrintfW(msg, MAX_PATH_LEN + 128, L"Stopped after %d writes (%d failed)",
+                     state.writes, state.failures);
+    print_success(msg);
+    return 0;
+}
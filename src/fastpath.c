@@ -0,0 +1,285 @@
+/*
+ * fastpath.c - Resolver fast path: LLMNR, NetBIOS and mDNS fallbacks ([dns] fast_path)
+ */
+
+#include <winsock2.h>
+#include "fastpath.h"
+#include "config.h"
+#include "network.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================================================
+ * NAMES
+ * ============================================================================ */
+
+int fastpath_scope_parse(const wchar_t *text, FastPathScope *scope)
+{
+    if (_wcsicmp(text, L"no") == 0 || _wcsicmp(text, L"off") == 0) {
+        *scope = FASTPATH_OFF;
+    } else if (_wcsicmp(text, L"interface") == 0) {
+        *scope = FASTPATH_INTERFACE;
+    } else if (_wcsicmp(text, L"global") == 0) {
+        *scope = FASTPATH_GLOBAL;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const wchar_t *fastpath_label(FallbackId id)
+{
+    static const wchar_t *LABELS[FALLBACK_COUNT] = { L"LLMNR", L"NetBIOS over TCP/IP", L"mDNS" };
+    return LABELS[id];
+}
+
+const wchar_t *fastpath_state_text(FallbackState state)
+{
+    switch (state) {
+    case FALLBACK_DISABLED:  return L"DISABLED";
+    case FALLBACK_FROM_DHCP: return L"FROM DHCP";
+    default:                 return L"ENABLED";
+    }
+}
+
+/* ============================================================================
+ * REGISTRY
+ * ============================================================================ */
+
+static int netbt_key(const wchar_t *guid, wchar_t *key, size_t size)
+{
+    return SUCCEEDED(StringCchPrintfW(key, size, L"%ls\\Tcpip_%ls", FASTPATH_NETBT_KEY, guid))
+        ? 0 : -1;
+}
+
+/*
+ * A missing value reads as `missing`
+ */
+static int read_dword(const RegistryBackend *reg, const wchar_t *key, const wchar_t *name,
+                      DWORD missing, DWORD *value)
+{
+    int ret = reg->get_dword(reg->ctx, key, name, value);
+
+    if (ret > 0) {
+        *value = missing;
+    }
+    return ret < 0 ? -1 : 0;
+}
+
+int fastpath_read_state(const RegistryBackend *reg, const wchar_t *guid,
+                        FallbackState states[FALLBACK_COUNT])
+{
+    wchar_t key[MAX_PATH_LEN];
+    DWORD value;
+
+    if (read_dword(reg, FASTPATH_LLMNR_KEY, L"EnableMulticast", 1, &value) != 0) {
+        return -1;
+    }
+    states[FALLBACK_LLMNR] = value == 0 ? FALLBACK_DISABLED : FALLBACK_ENABLED;
+
+    if (read_dword(reg, FASTPATH_MDNS_KEY, L"EnableMDNS", 1, &value) != 0) {
+        return -1;
+    }
+    states[FALLBACK_MDNS] = value == 0 ? FALLBACK_DISABLED : FALLBACK_ENABLED;
+
+    if (netbt_key(guid, key, MAX_PATH_LEN) != 0 ||
+        read_dword(reg, key, L"NetbiosOptions", 0, &value) != 0) {
+        return -1;
+    }
+    states[FALLBACK_NETBIOS] = value == 2 ? FALLBACK_DISABLED :
+                               value == 1 ? FALLBACK_ENABLED : FALLBACK_FROM_DHCP;
+    return 0;
+}
+
+static int plan_value(const RegistryBackend *reg, FastPathPlan *plan, const wchar_t *key,
+                      const wchar_t *name, DWORD value)
+{
+    FastPathChange *change;
+    DWORD previous;
+    int ret = reg->get_dword(reg->ctx, key, name, &previous);
+
+    if (ret < 0) {
+        return -1;
+    }
+    if (ret == 0 && previous == value) {
+        return 0;
+    }
+
+    if (plan->count == plan->capacity) {
+        int capacity = plan->capacity ? plan->capacity * 2 : 8;
+        FastPathChange *items = (FastPathChange *)realloc(plan->items,
+                                                          (size_t)capacity * sizeof(FastPathChange));
+        if (!items) {
+            print_error(L"Memory allocation failed");
+            return -1;
+        }
+        plan->items = items;
+        plan->capacity = capacity;
+    }
+
+    change = &plan->items[plan->count];
+    change->previous = previous;
+    change->had_previous = ret == 0;
+    StringCchCopyW(change->key, MAX_PATH_LEN, key);
+    StringCchCopyW(change->name, 32, name);
+    change->value = value;
+    plan->count++;
+    return 0;
+}
+
+int fastpath_plan(const RegistryBackend *reg, FastPathScope scope, const wchar_t *guid,
+                  FastPathPlan *plan)
+{
+    wchar_t key[MAX_PATH_LEN];
+    wchar_t sub[MAX_PATH_LEN];
+
+    ZeroMemory(plan, sizeof(*plan));
+    if (scope == FASTPATH_OFF) {
+        return 0;
+    }
+
+    if (plan_value(reg, plan, FASTPATH_LLMNR_KEY, L"EnableMulticast", 0) != 0 ||
+        plan_value(reg, plan, FASTPATH_MDNS_KEY, L"EnableMDNS", 0) != 0) {
+        return -1;
+    }
+
+    if (scope == FASTPATH_INTERFACE) {
+        if (netbt_key(guid, key, MAX_PATH_LEN) != 0 ||
+            plan_value(reg, plan, key, L"NetbiosOptions", 2) != 0) {
+            return -1;
+        }
+        return plan->count;
+    }
+
+    /* Every interface NetBT is bound to, the configured one included */
+    for (int i = 0; ; i++) {
+        int ret = reg->enum_subkeys(reg->ctx, FASTPATH_NETBT_KEY, i, sub, MAX_PATH_LEN);
+
+        if (ret > 0) {
+            break;
+        }
+        if (ret < 0 ||
+            FAILED(StringCchPrintfW(key, MAX_PATH_LEN, L"%ls\\%ls", FASTPATH_NETBT_KEY, sub))) {
+            return -1;
+        }
+        if (_wcsnicmp(sub, L"Tcpip_", 6) == 0 &&
+            plan_value(reg, plan, key, L"NetbiosOptions", 2) != 0) {
+            return -1;
+        }
+    }
+    return plan->count;
+}
+
+void fastpath_plan_free(FastPathPlan *plan)
+{
+    free(plan->items);
+    ZeroMemory(plan, sizeof(*plan));
+}
+
+static int restore_change(const RegistryBackend *reg, const FastPathChange *change)
+{
+    if (change->had_previous) {
+        return reg->set_dword(reg->ctx, change->key, change->name, change->previous);
+    }
+    return reg->delete_value(reg->ctx, change->key, change->name);
+}
+
+int fastpath_write(const RegistryBackend *reg, FastPathPlan *plan)
+{
+    for (int i = 0; i < plan->count; i++) {
+        if (reg->set_dword(reg->ctx, plan->items[i].key, plan->items[i].name,
+                           plan->items[i].value) != 0) {
+            while (--i >= 0) {
+                restore_change(reg, &plan->items[i]);
+            }
+            return -1;
+        }
+    }
+    plan->written = plan->count > 0;
+    return 0;
+}
+
+int fastpath_restore(const RegistryBackend *reg, FastPathPlan *plan)
+{
+    int ret = 0;
+
+    if (!plan->written) {
+        return 0;
+    }
+    for (int i = 0; i < plan->count; i++) {
+        if (restore_change(reg, &plan->items[i]) != 0) {
+            ret = -1;
+        }
+    }
+    plan->written = 0;
+    return ret;
+}
+
+/* ============================================================================
+ * APPLY AND ROLLBACK
+ * ============================================================================ */
+
+/* Plan of the last fastpath_apply, kept for fastpath_rollback */
+static FastPathPlan g_fastpath_plan;
+
+int fastpath_apply(void)
+{
+    RegistryBackend reg;
+    wchar_t guid[64];
+    wchar_t msg[256];
+    int count;
+
+    fastpath_plan_free(&g_fastpath_plan);
+    if (g_config.fast_path == FASTPATH_OFF) {
+        return 0;
+    }
+
+    print_info(L"Disabling LLMNR, NetBIOS and mDNS fallbacks...");
+    if (network_get_guid(guid, 64) != 0) {
+        print_error(L"Interface not found");
+        return -1;
+    }
+
+    registry_backend_system(&reg);
+    count = fastpath_plan(&reg, g_config.fast_path, guid, &g_fastpath_plan);
+    if (count < 0) {
+        print_error(L"Failed to read name resolution fallback settings");
+        return -1;
+    }
+    if (count == 0) {
+        print_success(L"Name resolution fallbacks already disabled");
+        return 0;
+    }
+
+    if (fastpath_write(&reg, &g_fastpath_plan) != 0) {
+        print_error(L"Failed to disable name resolution fallbacks");
+        return -1;
+    }
+
+    StringCchPrintfW(msg, 256, L"Name resolution fallbacks disabled (%d value(s) changed)", count);
+    print_success(msg);
+    print_info(L"Some of them take effect only once the adapter and the DNS Client service "
+               L"restart (reboot)");
+    return 0;
+}
+
+void fastpath_rollback(void)
+{
+    RegistryBackend reg;
+
+    if (!g_fastpath_plan.written) {
+        return;
+    }
+
+    registry_backend_system(&reg);
+    if (fastpath_restore(&reg, &g_fastpath_plan) != 0) {
+        print_error(L"Failed to restore some name resolution fallback settings");
+        return;
+    }
+    print_info(L"Name resolution fallbacks restored");
+}
+
+void fastpath_forget(void)
+{
+    fastpath_plan_free(&g_fastpath_plan);
+}
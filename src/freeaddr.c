@@ -0,0 +1,376 @@
+/*
+ * freeaddr.c - Free address discovery for --ipv4/--ipv6 auto:RANGE
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include "freeaddr.h"
+#include "config.h"
+#include "network.h"
+
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#pragma comment(lib, "iphlpapi.lib")
+#endif
+
+#define DISCARD_PORT    9       /* Nothing listens; the datagram only starts ARP/ND */
+
+/* ============================================================================
+ * RANGES
+ * ============================================================================ */
+
+int freeaddr_is_auto(const wchar_t *text)
+{
+    return _wcsnicmp(text, FREEADDR_PREFIX, wcslen(FREEADDR_PREFIX)) == 0;
+}
+
+/*
+ * Candidates differ only in their last 32 bits, so ranges walk those as a
+ * number; the rest of the address is shared
+ */
+static int addr_offset(const IpAddr *addr)
+{
+    return addr->family == AF_INET ? 0 : 12;
+}
+
+static DWORD low32(const IpAddr *addr)
+{
+    const BYTE *b = addr->bytes + addr_offset(addr);
+    return ((DWORD)b[0] << 24) | ((DWORD)b[1] << 16) | ((DWORD)b[2] << 8) | (DWORD)b[3];
+}
+
+static void set_low32(IpAddr *addr, DWORD value)
+{
+    BYTE *b = addr->bytes + addr_offset(addr);
+    b[0] = (BYTE)(value >> 24);
+    b[1] = (BYTE)(value >> 16);
+    b[2] = (BYTE)(value >> 8);
+    b[3] = (BYTE)value;
+}
+
+static int range_size_ok(const FreeAddrRange *range)
+{
+    if (range->first.family == AF_INET6 &&
+        memcmp(range->first.bytes, range->last.bytes, 12) != 0) {
+        return 0;
+    }
+    return low32(&range->first) <= low32(&range->last) &&
+           low32(&range->last) - low32(&range->first) < FREEADDR_MAX_CANDIDATES;
+}
+
+int freeaddr_parse_range(const wchar_t *text, int family, FreeAddrRange *out)
+{
+    wchar_t buf[2 * MAX_ADDR_LEN];
+    wchar_t *dash;
+    int bits = family == AF_INET ? 32 : 128;
+
+    if (FAILED(StringCchCopyW(buf, 2 * MAX_ADDR_LEN, text))) {
+        return -1;
+    }
+
+    dash = wcschr(buf, L'-');
+    if (dash) {
+        *dash = L'\0';
+        if (address_parse(buf, &out->first) != 0 || address_parse(dash + 1, &out->last) != 0 ||
+            out->first.family != family || out->last.family != family ||
+            out->first.prefix >= 0 || out->last.prefix >= 0) {
+            return -1;
+        }
+        return range_size_ok(out) ? 0 : -1;
+    }
+
+    if (address_parse(buf, &out->first) != 0 || out->first.family != family ||
+        out->first.prefix < 0 || bits - out->first.prefix > 31) {
+        return -1;
+    }
+
+    /* Clear the host part, then set it to all ones for the last address */
+    {
+        int host_bits = bits - out->first.prefix;
+        DWORD host_mask = host_bits == 0 ? 0 : (1u << host_bits) - 1;
+        DWORD network = low32(&out->first) & ~host_mask;
+
+        out->first.prefix = -1;
+        out->last = out->first;
+        set_low32(&out->first, network);
+        set_low32(&out->last, network | host_mask);
+
+        /* Network and broadcast (IPv4), subnet-router anycast (IPv6) */
+        if (family == AF_INET && host_bits >= 2) {
+            set_low32(&out->first, network + 1);
+            set_low32(&out->last, (network | host_mask) - 1);
+        } else if (family == AF_INET6 && host_bits >= 1) {
+            set_low32(&out->first, network + 1);
+        }
+    }
+    return range_size_ok(out) ? 0 : -1;
+}
+
+static int listed(const IpAddr *addr, const IpAddr *list, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (address_compare(addr, &list[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int freeaddr_candidates(const FreeAddrRange *range, const IpAddr *exclude, int exclude_count,
+                        IpAddr *out, int max)
+{
+    DWORD first = low32(&range->first), last = low32(&range->last);
+    int count = 0;
+
+    for (DWORD value = first; count < max; value++) {
+        out[count] = range->first;
+        set_low32(&out[count], value);
+        if (!listed(&out[count], exclude, exclude_count)) {
+            count++;
+        }
+        if (value == last) {
+            break;
+        }
+    }
+    return count;
+}
+
+/* ============================================================================
+ * DISCOVERY
+ * ============================================================================ */
+
+int freeaddr_find(const FreeAddrBackend *backend, const IpAddr *candidates, int count,
+                  const IpAddr *current, int current_count, int wait_ms, IpAddr *out)
+{
+    int in_use[FREEADDR_BATCH];
+
+    /* Already ours: keep it, so a rerun does not move the interface */
+    for (int i = 0; i < count; i++) {
+        if (listed(&candidates[i], current, current_count)) {
+            *out = candidates[i];
+            return 0;
+        }
+    }
+
+    for (int start = 0; start < count; start += FREEADDR_BATCH) {
+        int batch = count - start < FREEADDR_BATCH ? count - start : FREEADDR_BATCH;
+
+        if (backend->probe(backend->ctx, candidates + start, batch, wait_ms, in_use) != 0) {
+            return -1;
+        }
+        for (int i = 0; i < batch; i++) {
+            if (!in_use[i]) {
+                *out = candidates[start + i];
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* ============================================================================
+ * SYSTEM BACKEND
+ * ============================================================================ */
+
+static int neighbor_answered(const MIB_IPNET_ROW2 *row)
+{
+    switch (row->State) {
+    case NlnsReachable:
+    case NlnsStale:
+    case NlnsDelay:
+    case NlnsProbe:
+    case NlnsPermanent:
+        return row->PhysicalAddressLength > 0;
+    default:
+        return 0;
+    }
+}
+
+static void send_probe(SOCKET sock, const IpAddr *addr)
+{
+    SOCKADDR_STORAGE sa;
+    int salen;
+    char payload = 0;
+
+    ZeroMemory(&sa, sizeof(sa));
+    if (addr->family == AF_INET) {
+        SOCKADDR_IN *sin = (SOCKADDR_IN *)&sa;
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(DISCARD_PORT);
+        memcpy(&sin->sin_addr, addr->bytes, 4);
+        salen = sizeof(SOCKADDR_IN);
+    } else {
+        SOCKADDR_IN6 *sin6 = (SOCKADDR_IN6 *)&sa;
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(DISCARD_PORT);
+        memcpy(&sin6->sin6_addr, addr->bytes, 16);
+        salen = sizeof(SOCKADDR_IN6);
+    }
+
+    /* Errors are expected: the stack holds one datagram per unresolved neighbor */
+    sendto(sock, &payload, 1, 0, (SOCKADDR *)&sa, salen);
+}
+
+/*
+ * One datagram per candidate makes the stack send every ARP request or
+ * neighbor solicitation at once; after the wait, owners that answered
+ * are in the neighbor table and the rest are still incomplete
+ */
+static int system_probe(void *ctx, const IpAddr *candidates, int count, int wait_ms, int *in_use)
+{
+    PMIB_IPNET_TABLE2 table = NULL;
+    NET_LUID luid;
+    SOCKET sock;
+    u_long nonblocking = 1;
+    int family = candidates[0].family;
+    int seen = 0;
+
+    (void)ctx;
+    if (network_get_luid(&luid) != 0) {
+        return -1;
+    }
+
+    sock = socket(family, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET) {
+        print_error(L"Failed to open a probe socket");
+        return -1;
+    }
+    ioctlsocket(sock, FIONBIO, &nonblocking);
+    for (int i = 0; i < count; i++) {
+        send_probe(sock, &candidates[i]);
+    }
+    closesocket(sock);
+
+    Sleep((DWORD)wait_ms);
+
+    if (GetIpNetTable2((ADDRESS_FAMILY)family, &table) != NO_ERROR) {
+        print_error(L"GetIpNetTable2 failed");
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        in_use[i] = 0;
+    }
+    for (ULONG r = 0; r < table->NumEntries; r++) {
+        MIB_IPNET_ROW2 *row = &table->Table[r];
+        IpAddr addr;
+
+        if (row->InterfaceLuid.Value != luid.Value ||
+            address_from_sockaddr((const SOCKADDR *)&row->Address, &addr) != 0) {
+            continue;
+        }
+        for (int i = 0; i < count; i++) {
+            if (address_compare(&addr, &candidates[i]) == 0) {
+                in_use[i] = neighbor_answered(row);
+                seen++;
+                break;
+            }
+        }
+    }
+    FreeMibTable(table);
+
+    /* Not even an incomplete entry: the datagrams went to a router */
+    if (seen == 0) {
+        print_error(L"Range is not on-link for this interface");
+        return -1;
+    }
+    return 0;
+}
+
+void freeaddr_backend_system(FreeAddrBackend *backend)
+{
+    backend->ctx = NULL;
+    backend->probe = system_probe;
+}
+
+/* ============================================================================
+ * CONFIGURATION
+ * ============================================================================ */
+
+/*
+ * Resolve one family's "auto:RANGE" address in place
+ */
+static int resolve_family(int family, wchar_t *address, const wchar_t *gateway,
+                          const IpAddrList *secondary)
+{
+    static IpAddr candidates[FREEADDR_MAX_CANDIDATES];
+    const wchar_t *label = family == AF_INET ? L"IPv4" : L"IPv6";
+    IpAddrList exclude = {0}, current = {0};
+    FreeAddrRange range;
+    FreeAddrBackend backend;
+    IpAddr chosen, gw;
+    WSADATA wsa;
+    LONGLONG start;
+    wchar_t msg[256], text[MAX_ADDR_LEN];
+    int count, ret;
+
+    if (freeaddr_parse_range(address + wcslen(FREEADDR_PREFIX), family, &range) != 0) {
+        StringCchPrintfW(msg, 256, L"Invalid %ls range (at most %d addresses): %ls",
+                         label, FREEADDR_MAX_CANDIDATES, address);
+        print_error(msg);
+        return -1;
+    }
+
+    /* The gateway and secondary addresses are taken by definition */
+    if (gateway[0] != L'\0' && address_parse(gateway, &gw) == 0) {
+        address_list_add(&exclude, &gw);
+    }
+    for (int i = 0; i < secondary->count; i++) {
+        address_list_add(&exclude, &secondary->items[i]);
+    }
+
+    count = freeaddr_candidates(&range, exclude.items, exclude.count,
+                                candidates, FREEADDR_MAX_CANDIDATES);
+    address_list_free(&exclude);
+    if (count == 0 || address_get_manual(family, &current) != 0) {
+        StringCchPrintfW(msg, 256, L"No %ls address to probe in %ls", label, address);
+        print_error(msg);
+        address_list_free(&current);
+        return -1;
+    }
+
+    StringCchPrintfW(msg, 256, L"Probing %d %ls candidate(s) for a free address...", count, label);
+    print_info(msg);
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        print_error(L"WSAStartup failed");
+        address_list_free(&current);
+        return -1;
+    }
+    freeaddr_backend_system(&backend);
+    start = timer_now();
+    ret = freeaddr_find(&backend, candidates, count, current.items, current.count,
+                        FREEADDR_WAIT_MS, &chosen);
+    WSACleanup();
+    address_list_free(&current);
+
+    if (ret != 0) {
+        StringCchPrintfW(msg, 256, ret > 0 ? L"Every %ls address in %ls is in use"
+                                           : L"Could not probe %ls range %ls", label, address);
+        print_error(msg);
+        return -1;
+    }
+
+    address_format(&chosen, text, MAX_ADDR_LEN);
+    StringCchCopyW(address, MAX_ADDR_LEN, text);
+    StringCchPrintfW(msg, 256, L"Free %ls address: %ls (%.0f ms)", label, text,
+                     timer_elapsed_ms(start));
+    print_success(msg);
+    return 0;
+}
+
+int freeaddr_resolve(void)
+{
+    if (g_config.has_ipv4 && freeaddr_is_auto(g_config.ipv4_address) &&
+        resolve_family(AF_INET, g_config.ipv4_address, g_config.ipv4_gateway,
+                       &g_config.ipv4_addresses) != 0) {
+        return -1;
+    }
+    if (g_config.has_ipv6 && freeaddr_is_auto(g_config.ipv6_address) &&
+        resolve_family(AF_INET6, g_config.ipv6_address, g_config.ipv6_gateway,
+                       &g_config.ipv6_addresses) != 0) {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,304 @@
+/*
+ * health.c - Resolver health probing with automatic provider failover
+ */
+
+#include "health.h"
+#include "config.h"
+
+/* ============================================================================
+ * OPTIONS
+ * ============================================================================ */
+
+void health_options_init(HealthOptions *opts)
+{
+    opts->interval_ms = HEALTH_DEFAULT_INTERVAL_MS;
+    opts->timeout_ms = HEALTH_DEFAULT_TIMEOUT_MS;
+    opts->window = HEALTH_DEFAULT_WINDOW;
+    opts->max_latency_ms = HEALTH_DEFAULT_MAX_LATENCY_MS;
+    opts->max_loss_pct = HEALTH_DEFAULT_MAX_LOSS_PCT;
+    opts->fail_after = HEALTH_DEFAULT_FAIL_AFTER;
+    opts->recover_after = HEALTH_DEFAULT_RECOVER_AFTER;
+}
+
+/*
+ * Probe the first server the provider configures, IPv4 before IPv6
+ */
+static int upstream_init(HealthUpstream *up, const DnsProvider *provider)
+{
+    const wchar_t *servers[4] = {
+        provider->ipv4_primary, provider->ipv4_secondary,
+        provider->ipv6_primary, provider->ipv6_secondary
+    };
+
+    ZeroMemory(up, sizeof(*up));
+    up->provider = *provider;
+    for (int i = 0; i < 4; i++) {
+        if (servers[i] && servers[i][0] != L'\0') {
+            up->target.server = servers[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int health_monitor_init(HealthMonitor *mon, const DnsProvider *primary,
+                        const DnsProvider *fallback)
+{
+    ZeroMemory(mon, sizeof(*mon));
+    mon->active = HEALTH_PRIMARY;
+    if (upstream_init(&mon->upstreams[HEALTH_PRIMARY], primary) != 0 ||
+        upstream_init(&mon->upstreams[HEALTH_FALLBACK], fallback) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * ROLLING WINDOW
+ * ============================================================================ */
+
+void health_record(HealthUpstream *up, const HealthOptions *opts, int ok, double ms)
+{
+    int window = opts->window < HEALTH_MAX_WINDOW ? opts->window : HEALTH_MAX_WINDOW;
+
+    up->window[up->next].ok = ok;
+    up->window[up->next].ms = ms;
+    up->next = (up->next + 1) % window;
+    if (up->count < window) {
+        up->count++;
+    }
+}
+
+void health_summarize(const HealthUpstream *up, HealthSummary *out)
+{
+    double samples[HEALTH_MAX_WINDOW];
+    ProbeStats stats;
+    int answered = 0;
+
+    for (int i = 0; i < up->count; i++) {
+        if (up->window[i].ok) {
+            samples[answered++] = up->window[i].ms;
+        }
+    }
+    probe_compute_stats(samples, answered, &stats);
+
+    out->samples = up->count;
+    out->loss_pct = up->count ? (up->count - answered) * 100 / up->count : 0;
+    out->median_ms = stats.median_ms;
+}
+
+HealthVerdict health_judge(const HealthSummary *summary, const HealthOptions *opts, int pct)
+{
+    if (summary->samples * 2 < opts->window) {
+        return HEALTH_UNKNOWN;
+    }
+    if (summary->loss_pct * 100 > opts->max_loss_pct * pct ||
+        summary->median_ms * 100.0 > (double)opts->max_latency_ms * pct) {
+        return HEALTH_DEGRADED;
+    }
+    return HEALTH_GOOD;
+}
+
+/* ============================================================================
+ * FAILOVER DECISION
+ * ============================================================================ */
+
+HealthAction health_evaluate(HealthMonitor *mon, const HealthOptions *opts)
+{
+    HealthSummary primary, fallback;
+
+    health_summarize(&mon->upstreams[HEALTH_PRIMARY], &primary);
+    health_summarize(&mon->upstreams[HEALTH_FALLBACK], &fallback);
+
+    if (mon->active == HEALTH_PRIMARY) {
+        if (health_judge(&primary, opts, 100) == HEALTH_DEGRADED) {
+            mon->bad_streak++;
+        } else {
+            mon->bad_streak = 0;
+        }
+        /* Switching to an upstream that is no better only adds churn */
+        if (mon->bad_streak >= opts->fail_after &&
+            health_judge(&fallback, opts, 100) != HEALTH_DEGRADED) {
+            return HEALTH_FAILOVER;
+        }
+        return HEALTH_STAY;
+    }
+
+    /* Recovery is judged against tighter thresholds so a primary that
+       hovers around the limits does not flap back and forth */
+    if (health_judge(&primary, opts, HEALTH_RECOVER_PCT) == HEALTH_GOOD) {
+        mon->good_streak++;
+    } else {
+        mon->good_streak = 0;
+    }
+    return mon->good_streak >= opts->recover_after ? HEALTH_FAILBACK : HEALTH_STAY;
+}
+
+/* ============================================================================
+ * PROBE LOOP
+ * ============================================================================ */
+
+static void report_switch(const HealthMonitor *mon, HealthAction action)
+{
+    const HealthUpstream *primary = &mon->upstreams[HEALTH_PRIMARY];
+    const HealthUpstream *fallback = &mon->upstreams[HEALTH_FALLBACK];
+    HealthSummary summary;
+    wchar_t msg[256];
+
+    health_summarize(primary, &summary);
+    if (action == HEALTH_FAILOVER) {
+        StringCchPrintfW(msg, 256, L"%ls degraded (median %.1f ms, %d%% lost), failing over to %ls",
+                         primary->provider.name, summary.median_ms, summary.loss_pct,
+                         fallback->provider.name);
+        print_error(msg);
+    } else {
+        StringCchPrintfW(msg, 256, L"%ls healthy again (median %.1f ms, %d%% lost), failing back",
+                         primary->provider.name, summary.median_ms, summary.loss_pct);
+        print_info(msg);
+    }
+}
+
+/*
+ * A failed apply rolls DNS back to DHCP and drops the DoH templates, so
+ * put the provider that was active back before trying again
+ */
+static void restore_active(const HealthMonitor *mon, HealthSwitch on_switch, void *ctx)
+{
+    const DnsProvider *active = &mon->upstreams[mon->active].provider;
+    wchar_t msg[256];
+
+    StringCchPrintfW(msg, 256, L"Switch failed, re-applying %ls", active->name);
+    print_error(msg);
+    if (on_switch(ctx, active) != 0) {
+        StringCchPrintfW(msg, 256, L"Failed to re-apply %ls; DNS is left on DHCP until the next switch",
+                         active->name);
+        print_error(msg);
+    }
+}
+
+int health_loop(HealthMonitor *mon, const HealthOptions *opts, const ProbeOptions *probe,
+                HANDLE stop, HealthSwitch on_switch, void *ctx)
+{
+    ProbeOptions once = *probe;
+    ProbeTarget targets[2];
+    double left;
+
+    once.count = 1;
+    once.timeout_ms = opts->timeout_ms;
+    targets[HEALTH_PRIMARY] = mon->upstreams[HEALTH_PRIMARY].target;
+    targets[HEALTH_FALLBACK] = mon->upstreams[HEALTH_FALLBACK].target;
+
+    do {
+        LONGLONG start = timer_now();
+        ProbeStats stats[2];
+        HealthAction action;
+
+        /* Both upstreams in the same round, so they see the same network */
+        if (probe_run(targets, 2, &once, stats) != 0) {
+            return -1;
+        }
+        for (int i = 0; i < 2; i++) {
+            health_record(&mon->upstreams[i], opts, stats[i].answered > 0, stats[i].median_ms);
+        }
+
+        action = health_evaluate(mon, opts);
+        if (action != HEALTH_STAY) {
+            int to = action == HEALTH_FAILOVER ? HEALTH_FALLBACK : HEALTH_PRIMARY;
+
+            report_switch(mon, action);
+            if (on_switch(ctx, &mon->upstreams[to].provider) == 0) {
+                mon->active = to;
+                mon->switches++;
+            } else {
+                restore_active(mon, on_switch, ctx);
+            }
+            mon->bad_streak = 0;
+            mon->good_streak = 0;
+        }
+
+        left = opts->interval_ms - timer_elapsed_ms(start);
+        if (left < 0.0) {
+            left = 0.0;
+        }
+    } while (WaitForSingleObject(stop, (DWORD)left) == WAIT_TIMEOUT);
+
+    return 0;
+}
+
+/* ============================================================================
+ * HEALTH MODE
+ * ============================================================================ */
+
+static HANDLE g_stop_event;
+
+static BOOL WINAPI on_console_ctrl(DWORD type)
+{
+    (void)type;
+    SetEvent(g_stop_event);
+    return TRUE;
+}
+
+/*
+ * Switch through the normal apply path; only DNS changes hands
+ */
+static int apply_provider(void *ctx, const DnsProvider *provider)
+{
+    (void)ctx;
+    g_config.dns_only = 1;
+    if (dns_run_provider(provider) != 0) {
+        wchar_t msg[128];
+        StringCchPrintfW(msg, 128, L"Failed to apply %ls", provider->name);
+        print_error(msg);
+        return -1;
+    }
+    return 0;
+}
+
+int health_run(const DnsProvider *primary, const DnsProvider *fallback)
+{
+    const HealthOptions *opts = &g_config.health;
+    HealthMonitor mon;
+    wchar_t msg[256];
+    int ret;
+
+    wprintf(L"\n");
+    wprintf(L"========================================\n");
+    wprintf(L"  Health check: %ls, fallback %ls\n", primary->name, fallback->name);
+    wprintf(L"  Interface: %ls\n", g_config.interface_name);
+    wprintf(L"========================================\n\n");
+
+    if (health_monitor_init(&mon, primary, fallback) != 0) {
+        print_error(L"Health mode requires providers with DNS servers to probe");
+        return 1;
+    }
+
+    g_stop_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!g_stop_event) {
+        print_error(L"Failed to create stop event");
+        return 1;
+    }
+    SetConsoleCtrlHandler(on_console_ctrl, TRUE);
+
+    StringCchPrintfW(msg, 256,
+        L"Probing %ls and %ls every %d s (limits %d ms median, %d%% lost over %d samples)",
+        mon.upstreams[HEALTH_PRIMARY].target.server, mon.upstreams[HEALTH_FALLBACK].target.server,
+        opts->interval_ms / 1000, opts->max_latency_ms, opts->max_loss_pct, opts->window);
+    print_info(msg);
+    print_info(L"Press Ctrl+C to stop.");
+
+    ret = health_loop(&mon, opts, &g_config.probe, g_stop_event, apply_provider, NULL);
+
+    SetConsoleCtrlHandler(on_console_ctrl, FALSE);
+    CloseHandle(g_stop_event);
+
+    if (ret != 0) {
+        print_error(L"Failed to set up resolver probes");
+        return 1;
+    }
+
+    wprintf(L"\n");
+    StringCchPrintfW(msg, 256, L"Stopped on %ls after %d switches",
+                     mon.upstreams[mon.active].provider.name, mon.switches);
+    print_success(msg);
+    return 0;
+}
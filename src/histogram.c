@@ -0,0 +1,132 @@
+/*
+ * histogram.c - Log-linear latency histogram (HDR-style)
+ */
+
+#include "histogram.h"
+
+/* ============================================================================
+ * BUCKET MAPPING
+ * ============================================================================ */
+
+static int highest_bit(ULONGLONG value)
+{
+    int bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+}
+
+static int bucket_index(ULONGLONG value)
+{
+    int bit, shift;
+
+    if (value < HIST_LINEAR) {
+        return (int)value;
+    }
+
+    /* Top 6 bits select the bucket: 32 buckets per power of two */
+    bit = highest_bit(value);
+    shift = bit - 5;
+    return HIST_LINEAR + (bit - 6) * HIST_SUB_BUCKETS +
+           (int)((value >> shift) - HIST_SUB_BUCKETS);
+}
+
+static ULONGLONG bucket_upper(int index)
+{
+    int octave, shift;
+    ULONGLONG sub;
+
+    if (index < HIST_LINEAR) {
+        return (ULONGLONG)index;
+    }
+
+    octave = (index - HIST_LINEAR) / HIST_SUB_BUCKETS;
+    sub = HIST_SUB_BUCKETS + (ULONGLONG)((index - HIST_LINEAR) % HIST_SUB_BUCKETS);
+    shift = octave + 1;
+    return ((sub + 1) << shift) - 1;
+}
+
+/* ============================================================================
+ * RECORDING
+ * ============================================================================ */
+
+void histogram_init(Histogram *hist)
+{
+    ZeroMemory(hist, sizeof(*hist));
+}
+
+void histogram_record(Histogram *hist, ULONGLONG value)
+{
+    hist->counts[bucket_index(value)]++;
+    if (hist->total == 0 || value < hist->min) hist->min = value;
+    if (value > hist->max) hist->max = value;
+    hist->total++;
+    hist->sum += (double)value;
+}
+
+void histogram_merge(Histogram *dst, const Histogram *src)
+{
+    if (src->total == 0) {
+        return;
+    }
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    if (dst->total == 0 || src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+    dst->total += src->total;
+    dst->sum += src->sum;
+}
+
+/* ============================================================================
+ * QUERIES
+ * ============================================================================ */
+
+ULONGLONG histogram_percentile(const Histogram *hist, double percentile)
+{
+    ULONGLONG rank, seen = 0;
+
+    if (hist->total == 0) {
+        return 0;
+    }
+
+    /* Nearest rank, at least the first value */
+    rank = (ULONGLONG)(percentile / 100.0 * (double)hist->total + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > hist->total) rank = hist->total;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            ULONGLONG upper = bucket_upper(i);
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+double histogram_mean(const Histogram *hist)
+{
+    return hist->total ? hist->sum / (double)hist->total : 0.0;
+}
+
+void histogram_print(const Histogram *hist, double scale, const wchar_t *unit)
+{
+    static const double percentiles[] = { 50.0, 75.0, 90.0, 99.0, 99.9, 99.99 };
+
+    if (hist->total == 0) {
+        wprintf(L"    (no samples)\n");
+        return;
+    }
+
+    wprintf(L"    min    %10.3f %ls\n", (double)hist->min / scale, unit);
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        wprintf(L"    p%-5g %10.3f %ls\n", percentiles[i],
+                (double)histogram_percentile(hist, percentiles[i]) / scale, unit);
+    }
+    wprintf(L"    max    %10.3f %ls\n", (double)hist->max / scale, unit);
+    wprintf(L"    mean   %10.3f %ls  (%llu samples)\n", histogram_mean(hist) / scale,
+            unit, (unsigned long long)hist->total);
+}
@@ -0,0 +1,416 @@
+/*
+ * history.c - Status history ring in a memory-mapped file
+ */
+
+#include <string.h>
+#include "history.h"
+#include "config.h"
+
+/* ============================================================================
+ * RING
+ * ============================================================================ */
+
+size_t history_file_size(DWORD capacity)
+{
+    return sizeof(HistoryHeader) + (size_t)capacity * sizeof(HistoryRecord);
+}
+
+int history_attach(HistoryRing *ring, void *base, size_t size, DWORD capacity)
+{
+    HistoryHeader *header = (HistoryHeader *)base;
+
+    if (size < sizeof(HistoryHeader)) {
+        return -1;
+    }
+
+    if (header->magic == 0) {
+        if (capacity == 0 || size < history_file_size(capacity)) {
+            return -1;
+        }
+        header->version = HISTORY_VERSION;
+        header->record_size = sizeof(HistoryRecord);
+        header->capacity = capacity;
+        header->next = 0;
+        MemoryBarrier();
+        header->magic = HISTORY_MAGIC;
+    }
+
+    if (header->magic != HISTORY_MAGIC || header->version != HISTORY_VERSION ||
+        header->record_size != sizeof(HistoryRecord) || header->capacity == 0 ||
+        size < history_file_size(header->capacity)) {
+        return -1;
+    }
+
+    ring->header = header;
+    ring->records = (HistoryRecord *)(header + 1);
+    return 0;
+}
+
+int history_open(HistoryRing *ring, const wchar_t *path, DWORD capacity, int create)
+{
+    LARGE_INTEGER size;
+    size_t map_size;
+    void *view;
+
+    ZeroMemory(ring, sizeof(*ring));
+    ring->file = CreateFileW(path, GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                             create ? OPEN_ALWAYS : OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, NULL);
+    if (ring->file == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+
+    /* A new file is sized for `capacity`, an existing one keeps its size */
+    if (!GetFileSizeEx(ring->file, &size)) {
+        history_close(ring);
+        return -1;
+    }
+    map_size = size.QuadPart > 0 ? (size_t)size.QuadPart : history_file_size(capacity);
+
+    ring->mapping = CreateFileMappingW(ring->file, NULL, PAGE_READWRITE,
+                                       (DWORD)((ULONGLONG)map_size >> 32), (DWORD)map_size, NULL);
+    if (!ring->mapping) {
+        history_close(ring);
+        return -1;
+    }
+    view = MapViewOfFile(ring->mapping, FILE_MAP_ALL_ACCESS, 0, 0, map_size);
+    if (!view) {
+        history_close(ring);
+        return -1;
+    }
+
+    if (history_attach(ring, view, map_size, capacity) != 0) {
+        UnmapViewOfFile(view);
+        history_close(ring);
+        return -1;
+    }
+    return 0;
+}
+
+void history_close(HistoryRing *ring)
+{
+    if (ring->header) {
+        UnmapViewOfFile(ring->header);
+    }
+    if (ring->mapping) {
+        CloseHandle(ring->mapping);
+    }
+    if (ring->file && ring->file != INVALID_HANDLE_VALUE) {
+        CloseHandle(ring->file);
+    }
+    ZeroMemory(ring, sizeof(*ring));
+}
+
+DWORD history_count(const HistoryRing *ring)
+{
+    ULONGLONG next = (ULONGLONG)ring->header->next;
+    return next < ring->header->capacity ? (DWORD)next : ring->header->capacity;
+}
+
+const HistoryRecord *history_get(const HistoryRing *ring, DWORD index)
+{
+    ULONGLONG next = (ULONGLONG)ring->header->next;
+    ULONGLONG seq = next - history_count(ring) + 1 + index;
+    const HistoryRecord *record = &ring->records[(seq - 1) % ring->header->capacity];
+
+    return record->sequence == seq ? record : NULL;
+}
+
+/* ============================================================================
+ * RECORDS
+ * ============================================================================ */
+
+static BYTE server_flags(const DnsServerInfo *info)
+{
+    return (BYTE)((info->has_template ? HISTORY_SERVER_TEMPLATE : 0) |
+                  (info->autoupgrade ? HISTORY_SERVER_AUTOUPGRADE : 0) |
+                  (info->udpfallback ? HISTORY_SERVER_FALLBACK : 0) |
+                  (status_server_encrypted(info) ? HISTORY_SERVER_ENCRYPTED : 0));
+}
+
+static DWORD fnv1a(DWORD hash, const wchar_t *text)
+{
+    for (; *text; text++) {
+        hash = (hash ^ (DWORD)*text) * 16777619u;
+    }
+    return (hash ^ L',') * 16777619u;
+}
+
+/*
+ * Everything but the change bitmap
+ */
+static void fill_record(const StatusReport *report, HistoryRecord *record)
+{
+    char name[MAX_IFACE_LEN * 3];
+    DWORD hash = 2166136261u;
+    size_t len;
+
+    ZeroMemory(record, sizeof(*record));
+    record->timestamp = ((ULONGLONG)report->collected.dwHighDateTime << 32) |
+                        report->collected.dwLowDateTime;
+
+    /* Truncate on a UTF-8 sequence boundary */
+    if (WideCharToMultiByte(CP_UTF8, 0, report->interface_name, -1, name, sizeof(name),
+                            NULL, NULL) == 0) {
+        name[0] = '\0';
+    }
+    len = strlen(name);
+    if (len >= HISTORY_IFACE_LEN) {
+        len = HISTORY_IFACE_LEN - 1;
+        while (len > 0 && (name[len] & 0xC0) == 0x80) {
+            len--;
+        }
+    }
+    memcpy(record->interface_name, name, len);
+
+    record->ipv4_count = (BYTE)report->ipv4_count;
+    record->ipv6_count = (BYTE)report->ipv6_count;
+    for (int i = 0; i < report->ipv4_count; i++) {
+        record->server_flags[i] = server_flags(&report->ipv4[i]);
+        hash = fnv1a(hash, report->ipv4[i].address);
+    }
+    hash = fnv1a(hash, L"");
+    for (int i = 0; i < report->ipv6_count; i++) {
+        record->server_flags[STATUS_MAX_SERVERS + i] = server_flags(&report->ipv6[i]);
+        hash = fnv1a(hash, report->ipv6[i].address);
+    }
+    record->servers_hash = hash;
+
+    record->flags = (BYTE)((report->fully_encrypted ? HISTORY_FULLY_ENCRYPTED : 0) |
+                           (report->any_fallback ? HISTORY_ANY_FALLBACK : 0) |
+                           (report->any_unencrypted ? HISTORY_ANY_UNENCRYPTED : 0));
+}
+
+static DWORD diff_records(const HistoryRecord *record, const HistoryRecord *prev)
+{
+    DWORD changes = 0;
+    BYTE flags = record->flags ^ prev->flags;
+
+    if (record->servers_hash != prev->servers_hash ||
+        record->ipv4_count != prev->ipv4_count || record->ipv6_count != prev->ipv6_count) {
+        changes |= HISTORY_CHANGE_SERVERS;
+    }
+    if (flags & HISTORY_FULLY_ENCRYPTED) changes |= HISTORY_CHANGE_ENCRYPTED;
+    if (flags & HISTORY_ANY_FALLBACK)    changes |= HISTORY_CHANGE_FALLBACK;
+    if (flags & HISTORY_ANY_UNENCRYPTED) changes |= HISTORY_CHANGE_UNENCRYPTED;
+
+    for (int i = 0; i < HISTORY_SERVER_SLOTS; i++) {
+        if (record->server_flags[i] != prev->server_flags[i]) {
+            changes |= HISTORY_CHANGE_SLOT(i);
+        }
+    }
+    return changes;
+}
+
+void history_make_record(const StatusReport *report, const HistoryRecord *prev,
+                         HistoryRecord *record)
+{
+    fill_record(report, record);
+    record->changes = prev ? diff_records(record, prev) : HISTORY_CHANGE_FIRST;
+}
+
+/*
+ * Newest published record of an interface; with one interface per host
+ * this is the first slot looked at
+ */
+static const HistoryRecord *find_previous(const HistoryRing *ring, const char *interface_name)
+{
+    DWORD count = history_count(ring);
+
+    for (DWORD i = count; i > 0; i--) {
+        const HistoryRecord *record = history_get(ring, i - 1);
+        if (record && strcmp(record->interface_name, interface_name) == 0) {
+            return record;
+        }
+    }
+    return NULL;
+}
+
+int history_append(HistoryRing *ring, const StatusReport *report)
+{
+    HistoryRecord record;
+    const HistoryRecord *prev;
+    HistoryRecord *slot;
+    ULONGLONG seq;
+
+    fill_record(report, &record);
+    prev = find_previous(ring, record.interface_name);
+    record.changes = prev ? diff_records(&record, prev) : HISTORY_CHANGE_FIRST;
+
+    /* Claim a slot, fill it, then publish it with its sequence number */
+    seq = (ULONGLONG)InterlockedIncrement64(&ring->header->next);
+    slot = &ring->records[(seq - 1) % ring->header->capacity];
+    slot->sequence = 0;
+    MemoryBarrier();
+    *slot = record;
+    MemoryBarrier();
+    slot->sequence = seq;
+
+    return 0;
+}
+
+/* ============================================================================
+ * FORMAT
+ * ============================================================================ */
+
+static void append(wchar_t *buffer, size_t size, const wchar_t *text)
+{
+    if (buffer[0] != L'\0') {
+        StringCchCatW(buffer, size, L", ");
+    }
+    StringCchCatW(buffer, size, text);
+}
+
+void history_format_record(const HistoryRecord *record, wchar_t *buffer, size_t size)
+{
+    FILETIME ft;
+    SYSTEMTIME st;
+    wchar_t name[HISTORY_IFACE_LEN];
+    wchar_t changes[256] = L"";
+    const wchar_t *state;
+    int encrypted[2] = { 0, 0 };
+
+    ft.dwLowDateTime = (DWORD)record->timestamp;
+    ft.dwHighDateTime = (DWORD)(record->timestamp >> 32);
+    FileTimeToSystemTime(&ft, &st);
+    MultiByteToWideChar(CP_UTF8, 0, record->interface_name, -1, name, HISTORY_IFACE_LEN);
+
+    for (int i = 0; i < HISTORY_SERVER_SLOTS; i++) {
+        if (record->server_flags[i] & HISTORY_SERVER_ENCRYPTED) {
+            encrypted[i / STATUS_MAX_SERVERS]++;
+        }
+    }
+
+    if (record->ipv4_count == 0 && record->ipv6_count == 0) {
+        state = L"NO DNS CONFIGURED";
+    } else if (record->flags & HISTORY_FULLY_ENCRYPTED) {
+        state = L"ENCRYPTED";
+    } else {
+        state = L"NOT FULLY ENCRYPTED";
+    }
+
+    if (record->changes & HISTORY_CHANGE_FIRST) {
+        append(changes, 256, L"first sample");
+    } else {
+        if (record->changes & HISTORY_CHANGE_SERVERS) {
+            append(changes, 256, L"servers changed");
+        }
+        if (record->changes & HISTORY_CHANGE_ENCRYPTED) {
+            append(changes, 256, (record->flags & HISTORY_FULLY_ENCRYPTED)
+                ? L"now fully encrypted" : L"no longer fully encrypted");
+        }
+        if (record->changes & HISTORY_CHANGE_FALLBACK) {
+            append(changes, 256, (record->flags & HISTORY_ANY_FALLBACK)
+                ? L"fallback enabled" : L"fallback disabled");
+        }
+        if (record->changes & HISTORY_CHANGE_UNENCRYPTED) {
+            append(changes, 256, (record->flags & HISTORY_ANY_UNENCRYPTED)
+                ? L"unencrypted server appeared" : L"unencrypted servers gone");
+        }
+        for (int i = 0; i < HISTORY_SERVER_SLOTS; i++) {
+            if (record->changes & HISTORY_CHANGE_SLOT(i) && !(record->changes & HISTORY_CHANGE_SERVERS)) {
+                wchar_t slot[48];
+                StringCchPrintfW(slot, 48, L"IPv%d #%d %ls", i < STATUS_MAX_SERVERS ? 4 : 6,
+                    i % STATUS_MAX_SERVERS + 1,
+                    (record->server_flags[i] & HISTORY_SERVER_ENCRYPTED) ? L"encrypted" : L"not encrypted");
+                append(changes, 256, slot);
+            }
+        }
+    }
+
+    StringCchPrintfW(buffer, size,
+        L"%04u-%02u-%02u %02u:%02u:%02uZ  %-16ls  %-19ls  IPv4 %d/%u  IPv6 %d/%u  %ls",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, name, state,
+        encrypted[0], record->ipv4_count, encrypted[1], record->ipv6_count, changes);
+}
+
+/* ============================================================================
+ * STATUS CODE PATH
+ * ============================================================================ */
+
+void history_record(const StatusReport *report)
+{
+    static HistoryRing ring;
+    static int state;                   /* 0 = not opened, 1 = open, -1 = failed */
+
+    if (g_config.history_file[0] == L'\0' || state < 0) {
+        return;
+    }
+    if (state == 0) {
+        if (history_open(&ring, g_config.history_file, (DWORD)g_config.history_capacity, 1) != 0) {
+            wchar_t msg[MAX_PATH_LEN + 64];
+            StringCchPrintfW(msg, MAX_PATH_LEN + 64, L"Cannot open history file %ls",
+                             g_config.history_file);
+            print_error(msg);
+            state = -1;
+            return;
+        }
+        state = 1;
+    }
+    history_append(&ring, report);
+}
+
+/* ============================================================================
+ * HISTORY MODE
+ * ============================================================================ */
+
+int history_run(void)
+{
+    HistoryRing ring;
+    char filter[HISTORY_IFACE_LEN] = "";
+    wchar_t line[512];
+    DWORD count, transitions = 0;
+
+    if (g_config.history_file[0] == L'\0') {
+        print_error(L"History mode requires [history] file or --history FILE");
+        return 1;
+    }
+    /* Reading must not leave an empty ring file behind */
+    if (history_open(&ring, g_config.history_file, (DWORD)g_config.history_capacity, 0) != 0) {
+        if (GetLastError() == ERROR_FILE_NOT_FOUND) {
+            StringCchPrintfW(line, 512, L"No history yet: %ls does not exist", g_config.history_file);
+            print_info(line);
+            return 0;
+        }
+        StringCchPrintfW(line, 512, L"Cannot open history file %ls", g_config.history_file);
+        print_error(line);
+        return 1;
+    }
+
+    /* Compare in the stored, truncated form */
+    if (g_config.interface_name[0] != L'\0') {
+        StatusReport report;
+        HistoryRecord probe;
+
+        ZeroMemory(&report, sizeof(report));
+        StringCchCopyW(report.interface_name, MAX_IFACE_LEN, g_config.interface_name);
+        fill_record(&report, &probe);
+        StringCchCopyA(filter, HISTORY_IFACE_LEN, probe.interface_name);
+    }
+
+    wprintf(L"\n");
+    wprintf(L"DNS status transitions (%ls):\n", g_config.history_file);
+    wprintf(L"----------------------------------------\n");
+
+    count = history_count(&ring);
+    for (DWORD i = 0; i < count; i++) {
+        const HistoryRecord *record = history_get(&ring, i);
+
+        if (!record || record->changes == 0 ||
+            (filter[0] && strcmp(record->interface_name, filter) != 0)) {
+            continue;
+        }
+        history_format_record(record, line, 512);
+        wprintf(L"  %ls\n", line);
+        transitions++;
+    }
+
+    wprintf(L"\n");
+    StringCchPrintfW(line, 512, L"%lu samples, %lu transitions (ring holds %lu)",
+                     count, transitions, ring.header->capacity);
+    print_info(line);
+
+    history_close(&ring);
+    return 0;
+}
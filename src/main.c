@@ -7,6 +7,19 @@
  * Modes:
  *   cloudflare   - Configure DNS with Cloudflare + DoH
  *   google       - Configure DNS with Google + DoH
+ *   auto         - Configure the provider with the lowest measured latency
+ *   dns-bench    - Benchmark the configured DNS servers (UDP and DoH)
+ *   watch        - Keep a provider's DNS + DoH in place across network changes
+ *   health       - Probe a provider and fail over to a fallback while it degrades
+ *   metrics      - Set interface metrics from measured gateway latency
+ *   metrics-restore - Put back the metrics saved by the first metrics run
+ *   mtu          - Probe the path MTU to the gateway and DNS servers and set it
+ *   prefix-probe - Compare IPv4 and IPv6 connect latency, recommend a prefix policy
+ *   profile      - Apply the site profile that matches the current network
+ *   serve        - Answer status queries from memory over a named pipe
+ *   export       - Write the status to a Prometheus textfile or JSON file
+ *   history      - Show DNS status transitions from the history ring file
+ *   batch        - Run JSON Lines jobs from stdin in one process
  *   status       - Show current DNS encryption status
  *
  * Requires Administrator privileges for cloudflare/google modes.
@@ -14,11 +27,22 @@
  * Build: make (MinGW-w64)
  */
 
+#include "batch.h"
+#include "bench.h"
 #include "config.h"
 #include "dns.h"
+#include "export.h"
+#include "health.h"
+#include "history.h"
+#include "metrics.h"
+#include "mtu.h"
+#include "prefix.h"
 #include "network.h"
+#include "profile.h"
+#include "serve.h"
 #include "status.h"
 #include "utils.h"
+#include "watch.h"
 
 /* ============================================================================
  * MAIN ENTRY POINT
@@ -46,7 +70,8 @@ int wmain(int argc, wchar_t *argv[]) {
         return 0;
     }
 
-    /* Load config file */
+    /* Load config file; JSON output modes keep stdout for their data */
+    int quiet = g_config.status_json || mode == MODE_BATCH;
     if (config_file[0] != L'\0') {
         if (config_parse_file(config_file) != 0) {
             wchar_t errmsg[512];
@@ -57,10 +82,12 @@ int wmain(int argc, wchar_t *argv[]) {
         }
         wchar_t msg[512];
         StringCchPrintfW(msg, 512, L"Loaded config from: %ls", config_file);
-        print_info(msg);
+        if (!quiet) {
+            print_info(msg);
+        }
     } else {
         /* Try default config file (optional) */
-        if (config_parse_file(DEFAULT_CONFIG_FILE) == 0) {
+        if (config_parse_file(DEFAULT_CONFIG_FILE) == 0 && !quiet) {
             print_info(L"Loaded config from: static-ip-fix.ini");
         }
     }
@@ -75,6 +102,37 @@ int wmain(int argc, wchar_t *argv[]) {
         return 1;
     }
 
+    /* The status client needs no interface: the server already has one.
+       With --json, stdout carries nothing but the report. */
+    if (mode == MODE_STATUS && g_config.status_server) {
+        int ret = serve_query(g_config.status_json);
+        if (ret >= 0) {
+            return ret;
+        }
+        if (!g_config.status_json) {
+            print_info(L"No status server running, querying directly");
+        }
+    }
+
+    /* History needs no interface; with one it only shows that interface */
+    if (mode == MODE_HISTORY) {
+        return history_run();
+    }
+
+    /* Batch jobs name their own interfaces */
+    if (mode == MODE_BATCH) {
+        config_set_defaults();
+        return batch_run();
+    }
+
+    /* Metrics mode ranks every interface with a gateway */
+    if (mode == MODE_METRICS) {
+        return metrics_run();
+    }
+    if (mode == MODE_METRICS_RESTORE) {
+        return metrics_restore_run();
+    }
+
     /* Validate interface */
     if (g_config.interface_name[0] == L'\0') {
         print_error(
@@ -115,6 +173,54 @@ int wmain(int argc, wchar_t *argv[]) {
             .doh_template = g_config.doh_template
         };
         return dns_run_provider(&custom);
+    case MODE_AUTO:
+        return dns_run_auto();
+    case MODE_BENCH:
+        return bench_run();
+    case MODE_MTU:
+        return mtu_run();
+    case MODE_PREFIX_PROBE:
+        return prefix_probe_run();
+    case MODE_WATCH: {
+        DnsProvider provider;
+        if (g_config.provider_name[0] == L'\0') {
+            print_error(L"Watch mode requires --provider or [watch] provider.");
+            return 1;
+        }
+        if (dns_find_provider(g_config.provider_name, &provider) != 0) {
+            wchar_t errmsg[128];
+            StringCchPrintfW(errmsg, 128, L"Unknown provider: %ls", g_config.provider_name);
+            print_error(errmsg);
+            return 1;
+        }
+        return watch_run(&provider);
+    }
+    case MODE_HEALTH: {
+        DnsProvider primary, fallback;
+        if (g_config.provider_name[0] == L'\0' || g_config.health_fallback[0] == L'\0') {
+            print_error(L"Health mode requires --provider and --fallback (or [health]).");
+            return 1;
+        }
+        if (dns_find_provider(g_config.provider_name, &primary) != 0) {
+            wchar_t errmsg[128];
+            StringCchPrintfW(errmsg, 128, L"Unknown provider: %ls", g_config.provider_name);
+            print_error(errmsg);
+            return 1;
+        }
+        if (dns_find_provider(g_config.health_fallback, &fallback) != 0) {
+            wchar_t errmsg[128];
+            StringCchPrintfW(errmsg, 128, L"Unknown provider: %ls", g_config.health_fallback);
+            print_error(errmsg);
+            return 1;
+        }
+        return health_run(&primary, &fallback);
+    }
+    case MODE_PROFILE:
+        return profile_run();
+    case MODE_SERVE:
+        return serve_run();
+    case MODE_EXPORT:
+        return export_run();
     case MODE_STATUS:
         return status_run();
     default:
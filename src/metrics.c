@@ -0,0 +1,542 @@
+/*
+ * metrics.c - Interface metric tuning from measured gateway latency
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include <icmpapi.h>
+#include "metrics.h"
+#include "config.h"
+#include "network.h"
+#include <string.h>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "iphlpapi.lib")
+#endif
+
+#define ECHO_PAYLOAD_LEN    32
+
+static const int FAMILIES[METRICS_FAMILIES] = { AF_INET, AF_INET6 };
+
+/* ============================================================================
+ * OPTIONS
+ * ============================================================================ */
+
+void metrics_options_init(MetricsOptions *opts)
+{
+    opts->pings = METRICS_DEFAULT_PINGS;
+    opts->timeout_ms = METRICS_DEFAULT_TIMEOUT_MS;
+    opts->base = METRICS_DEFAULT_BASE;
+    opts->step = METRICS_DEFAULT_STEP;
+}
+
+/* ============================================================================
+ * SYSTEM BACKEND
+ * ============================================================================ */
+
+static int system_ping(void *ctx, const MetricLink *link, int timeout_ms, double *rtt_ms)
+{
+    BYTE payload[ECHO_PAYLOAD_LEN] = {0};
+    BYTE reply[sizeof(ICMP_ECHO_REPLY) + ECHO_PAYLOAD_LEN + 8];
+    HANDLE icmp;
+    IPAddr dest;
+    LONGLONG start;
+    DWORD replies;
+
+    (void)ctx;
+    icmp = IcmpCreateFile();
+    if (icmp == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+
+    memcpy(&dest, link->gateway.bytes, 4);
+    start = timer_now();
+    replies = IcmpSendEcho(icmp, dest, payload, sizeof(payload), NULL,
+                           reply, sizeof(reply), (DWORD)timeout_ms);
+    *rtt_ms = timer_elapsed_ms(start);
+    IcmpCloseHandle(icmp);
+
+    /* RoundTripTime is whole milliseconds; the local timer resolves
+       the sub-millisecond differences between LAN links */
+    return replies > 0 && ((PICMP_ECHO_REPLY)reply)->Status == IP_SUCCESS ? 0 : -1;
+}
+
+static int system_get(void *ctx, const MetricLink *link, int family, MetricSetting *out)
+{
+    MIB_IPINTERFACE_ROW row;
+
+    (void)ctx;
+    InitializeIpInterfaceEntry(&row);
+    row.Family = (ADDRESS_FAMILY)family;
+    row.InterfaceLuid = link->luid;
+    if (GetIpInterfaceEntry(&row) != NO_ERROR) {
+        return -1;
+    }
+    out->automatic = row.UseAutomaticMetric;
+    out->metric = row.Metric;
+    return 0;
+}
+
+static int system_set(void *ctx, const MetricLink *link, int family, const MetricSetting *setting)
+{
+    MIB_IPINTERFACE_ROW row;
+
+    (void)ctx;
+    InitializeIpInterfaceEntry(&row);
+    row.Family = (ADDRESS_FAMILY)family;
+    row.InterfaceLuid = link->luid;
+    if (GetIpInterfaceEntry(&row) != NO_ERROR) {
+        return -1;
+    }
+
+    row.UseAutomaticMetric = setting->automatic ? TRUE : FALSE;
+    row.Metric = setting->metric;
+    /* IPv4 rows are rejected unless the site prefix is cleared */
+    if (family == AF_INET) {
+        row.SitePrefixLength = 0;
+    }
+    return SetIpInterfaceEntry(&row) == NO_ERROR ? 0 : -1;
+}
+
+void metrics_backend_system(MetricsBackend *backend)
+{
+    backend->ctx = NULL;
+    backend->ping = system_ping;
+    backend->get = system_get;
+    backend->set = system_set;
+}
+
+int metrics_list_links(MetricLink *links, int max)
+{
+    PIP_ADAPTER_ADDRESSES pAddresses;
+    PIP_ADAPTER_ADDRESSES pCurrAddr;
+    int count = 0;
+
+    pAddresses = network_get_adapters(GAA_FLAG_INCLUDE_GATEWAYS | GAA_FLAG_SKIP_ANYCAST |
+                                      GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER);
+    if (!pAddresses) {
+        return -1;
+    }
+
+    for (pCurrAddr = pAddresses; pCurrAddr && count < max; pCurrAddr = pCurrAddr->Next) {
+        PIP_ADAPTER_GATEWAY_ADDRESS_LH pGateway;
+
+        if (!network_adapter_listed(pCurrAddr)) {
+            continue;
+        }
+        for (pGateway = pCurrAddr->FirstGatewayAddress; pGateway; pGateway = pGateway->Next) {
+            MetricLink *link = &links[count];
+
+            ZeroMemory(link, sizeof(*link));
+            if (address_from_sockaddr(pGateway->Address.lpSockaddr, &link->gateway) == 0 &&
+                link->gateway.family == AF_INET) {
+                StringCchCopyW(link->name, MAX_IFACE_LEN, pCurrAddr->FriendlyName);
+                link->luid = pCurrAddr->Luid;
+                count++;
+                break;
+            }
+        }
+    }
+
+    free(pAddresses);
+    return count;
+}
+
+/* ============================================================================
+ * MEASUREMENT
+ * ============================================================================ */
+
+typedef struct {
+    const MetricsBackend *backend;
+    const MetricsOptions *opts;
+    MetricLink *link;
+} MeasureJob;
+
+static DWORD WINAPI measure_worker(LPVOID param)
+{
+    MeasureJob *job = (MeasureJob *)param;
+    MetricLink *link = job->link;
+    double samples[METRICS_MAX_PINGS];
+
+    ZeroMemory(&link->rtt, sizeof(link->rtt));
+    for (int i = 0; i < job->opts->pings && i < METRICS_MAX_PINGS; i++) {
+        double rtt;
+
+        link->rtt.sent++;
+        if (job->backend->ping(job->backend->ctx, link, job->opts->timeout_ms, &rtt) == 0) {
+            samples[link->rtt.answered++] = rtt;
+        }
+    }
+    probe_compute_stats(samples, link->rtt.answered, &link->rtt);
+    return 0;
+}
+
+int metrics_measure(const MetricsBackend *backend, MetricLink *links, int count,
+                    const MetricsOptions *opts)
+{
+    MeasureJob jobs[METRICS_MAX_LINKS];
+    HANDLE threads[METRICS_MAX_LINKS];
+    int started = 0;
+
+    if (count < 1 || count > METRICS_MAX_LINKS) {
+        return -1;
+    }
+
+    /* One thread per link, so every gateway is measured at the same time
+       and the run takes as long as the slowest link rather than the sum */
+    for (int i = 0; i < count; i++) {
+        jobs[i].backend = backend;
+        jobs[i].opts = opts;
+        jobs[i].link = &links[i];
+        threads[started] = CreateThread(NULL, 0, measure_worker, &jobs[i], 0, NULL);
+        if (!threads[started]) {
+            measure_worker(&jobs[i]);
+            continue;
+        }
+        started++;
+    }
+
+    if (started > 0) {
+        WaitForMultipleObjects((DWORD)started, threads, TRUE, INFINITE);
+    }
+    for (int i = 0; i < started; i++) {
+        CloseHandle(threads[i]);
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * RANKING
+ * ============================================================================ */
+
+static int link_usable(const MetricLink *link)
+{
+    return link->rtt.answered > 0 && link->rtt.answered * 2 >= link->rtt.sent;
+}
+
+/*
+ * Returns non-zero if link a ranks before link b
+ */
+static int link_faster(const MetricLink *a, const MetricLink *b)
+{
+    if (link_usable(a) != link_usable(b)) {
+        return link_usable(a);
+    }
+    if (a->rtt.median_ms != b->rtt.median_ms) {
+        return a->rtt.median_ms < b->rtt.median_ms;
+    }
+    return a->rtt.p95_ms < b->rtt.p95_ms;
+}
+
+void metrics_assign(MetricLink *links, int count, const MetricsOptions *opts, int *order)
+{
+    /* Insertion sort: a handful of links, and ties keep adapter order */
+    for (int i = 0; i < count; i++) {
+        int j = i;
+        while (j > 0 && link_faster(&links[i], &links[order[j - 1]])) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    for (int rank = 0; rank < count; rank++) {
+        links[order[rank]].metric = (ULONG)(opts->base + rank * opts->step);
+    }
+}
+
+/* ============================================================================
+ * APPLY AND ROLLBACK
+ * ============================================================================ */
+
+int metrics_restore(const MetricsBackend *backend, const MetricLink *links, int count)
+{
+    int failed = 0;
+
+    for (int i = 0; i < count; i++) {
+        for (int f = 0; f < METRICS_FAMILIES; f++) {
+            if (links[i].has_family[f] &&
+                backend->set(backend->ctx, &links[i], FAMILIES[f], &links[i].previous[f]) != 0) {
+                failed++;
+            }
+        }
+    }
+    return failed;
+}
+
+int metrics_apply(const MetricsBackend *backend, MetricLink *links, int count)
+{
+    /* Record everything before the first write, so a failure part way
+       through can put every link back */
+    for (int i = 0; i < count; i++) {
+        for (int f = 0; f < METRICS_FAMILIES; f++) {
+            links[i].has_family[f] =
+                backend->get(backend->ctx, &links[i], FAMILIES[f], &links[i].previous[f]) == 0;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        MetricSetting setting = { 0, links[i].metric };
+
+        for (int f = 0; f < METRICS_FAMILIES; f++) {
+            if (!links[i].has_family[f]) {
+                continue;
+            }
+            if (backend->set(backend->ctx, &links[i], FAMILIES[f], &setting) != 0) {
+                wchar_t msg[128];
+                StringCchPrintfW(msg, 128, L"Failed to set the %ls metric of %ls",
+                                 FAMILIES[f] == AF_INET ? L"IPv4" : L"IPv6", links[i].name);
+                print_error(msg);
+                metrics_restore(backend, links, count);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * SAVED STATE
+ * ============================================================================ */
+
+/* Value names under each interface's subkey, in FAMILIES order */
+static const wchar_t *STATE_VALUES[METRICS_FAMILIES] = { L"IPv4", L"IPv6" };
+
+#define STATE_AUTOMATIC     L"automatic"
+
+static void state_key(const wchar_t *name, wchar_t *key, size_t size)
+{
+    StringCchPrintfW(key, size, L"%ls\\%ls", METRICS_STATE_KEY, name);
+}
+
+int metrics_save_state(const RegistryBackend *reg, const MetricLink *links, int count)
+{
+    wchar_t key[MAX_PATH_LEN], value[32];
+
+    for (int i = 0; i < count; i++) {
+        state_key(links[i].name, key, MAX_PATH_LEN);
+        for (int f = 0; f < METRICS_FAMILIES; f++) {
+            const MetricSetting *previous = &links[i].previous[f];
+
+            if (!links[i].has_family[f] ||
+                reg->get_string(reg->ctx, key, STATE_VALUES[f], value, 32) != 1) {
+                continue;
+            }
+            if (previous->automatic) {
+                StringCchCopyW(value, 32, STATE_AUTOMATIC);
+            } else {
+                StringCchPrintfW(value, 32, L"%lu", previous->metric);
+            }
+            if (reg->set_string(reg->ctx, key, STATE_VALUES[f], value, 0) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int metrics_load_state(const RegistryBackend *reg, MetricLink *links, int max)
+{
+    wchar_t key[MAX_PATH_LEN], value[32];
+    int count = 0;
+
+    for (int index = 0; count < max; index++) {
+        MetricLink *link = &links[count];
+        int ret;
+
+        ZeroMemory(link, sizeof(*link));
+        ret = reg->enum_subkeys(reg->ctx, METRICS_STATE_KEY, index, link->name, MAX_IFACE_LEN);
+        if (ret == 1) {
+            break;
+        }
+        if (ret != 0) {
+            return -1;
+        }
+
+        state_key(link->name, key, MAX_PATH_LEN);
+        for (int f = 0; f < METRICS_FAMILIES; f++) {
+            wchar_t *end;
+
+            if (reg->get_string(reg->ctx, key, STATE_VALUES[f], value, 32) != 0) {
+                continue;
+            }
+            if (_wcsicmp(value, STATE_AUTOMATIC) == 0) {
+                link->previous[f].automatic = 1;
+            } else {
+                link->previous[f].metric = wcstoul(value, &end, 10);
+                if (end == value || *end != L'\0') {
+                    continue;
+                }
+            }
+            link->has_family[f] = 1;
+        }
+        if (link->has_family[0] || link->has_family[1]) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int metrics_clear_state(const RegistryBackend *reg, const MetricLink *link)
+{
+    wchar_t key[MAX_PATH_LEN];
+
+    state_key(link->name, key, MAX_PATH_LEN);
+    return reg->delete_key(reg->ctx, key) == 0 ? 0 : -1;
+}
+
+/* ============================================================================
+ * METRICS MODE
+ * ============================================================================ */
+
+static void format_setting(const MetricSetting *setting, wchar_t *buf, size_t size)
+{
+    if (setting->automatic) {
+        StringCchPrintfW(buf, size, L"automatic (%lu)", setting->metric);
+    } else {
+        StringCchPrintfW(buf, size, L"%lu", setting->metric);
+    }
+}
+
+int metrics_run(void)
+{
+    MetricLink links[METRICS_MAX_LINKS];
+    int order[METRICS_MAX_LINKS];
+    MetricsBackend backend;
+    RegistryBackend reg;
+    int count;
+
+    wprintf(L"\n");
+    wprintf(L"========================================\n");
+    wprintf(L"  Tuning interface metrics\n");
+    wprintf(L"========================================\n\n");
+
+    count = metrics_list_links(links, METRICS_MAX_LINKS);
+    if (count < 0) {
+        print_error(L"GetAdaptersAddresses failed");
+        return 1;
+    }
+    if (count < 2) {
+        print_info(L"Fewer than two interfaces have an IPv4 gateway, nothing to tune");
+        return 0;
+    }
+
+    print_info(L"Measuring gateway round trips...");
+    metrics_backend_system(&backend);
+    if (metrics_measure(&backend, links, count, &g_config.metrics) != 0) {
+        print_error(L"Failed to start the measurement");
+        return 1;
+    }
+    metrics_assign(links, count, &g_config.metrics, order);
+
+    wprintf(L"\n  %-24ls %-16ls %10ls %8ls %7ls\n", L"Interface", L"Gateway", L"Median", L"Answers", L"Metric");
+    for (int rank = 0; rank < count; rank++) {
+        const MetricLink *link = &links[order[rank]];
+        wchar_t gateway[MAX_ADDR_LEN];
+
+        address_format(&link->gateway, gateway, MAX_ADDR_LEN);
+        if (link->rtt.answered > 0) {
+            wprintf(L"  %-24ls %-16ls %7.2f ms %5d/%-2d %7lu\n", link->name, gateway,
+                    link->rtt.median_ms, link->rtt.answered, link->rtt.sent, link->metric);
+        } else {
+            wprintf(L"  %-24ls %-16ls %10ls %5d/%-2d %7lu\n", link->name, gateway,
+                    L"-", link->rtt.answered, link->rtt.sent, link->metric);
+        }
+    }
+    wprintf(L"\n");
+
+    if (metrics_apply(&backend, links, count) != 0) {
+        print_error(L"Interface metrics not changed, previous metrics restored");
+        return 1;
+    }
+
+    /* The metrics are changed already; without the saved state they can
+       still be put back by hand from the lines below */
+    registry_backend_system(&reg);
+    if (metrics_save_state(&reg, links, count) != 0) {
+        print_error(L"Warning: failed to save the previous metrics, metrics-restore cannot undo this run");
+    }
+
+    for (int i = 0; i < count; i++) {
+        for (int f = 0; f < METRICS_FAMILIES; f++) {
+            wchar_t before[32];
+
+            if (!links[i].has_family[f]) {
+                continue;
+            }
+            format_setting(&links[i].previous[f], before, 32);
+            wprintf(L"  %-24ls %ls metric %ls -> %lu\n", links[i].name,
+                    FAMILIES[f] == AF_INET ? L"IPv4" : L"IPv6", before, links[i].metric);
+        }
+    }
+
+    print_success(L"Interface metrics set, fastest link preferred");
+    return 0;
+}
+
+int metrics_restore_run(void)
+{
+    MetricLink links[METRICS_MAX_LINKS];
+    MetricsBackend backend;
+    RegistryBackend reg;
+    wchar_t msg[256];
+    int count, failed = 0;
+
+    wprintf(L"\n");
+    wprintf(L"========================================\n");
+    wprintf(L"  Restoring interface metrics\n");
+    wprintf(L"========================================\n\n");
+
+    registry_backend_system(&reg);
+    count = metrics_load_state(&reg, links, METRICS_MAX_LINKS);
+    if (count < 0) {
+        print_error(L"Failed to read the saved metrics");
+        return 1;
+    }
+    if (count == 0) {
+        print_info(L"No saved metrics, nothing to restore");
+        return 0;
+    }
+
+    metrics_backend_system(&backend);
+    for (int i = 0; i < count; i++) {
+        MetricLink *link = &links[i];
+
+        /* Kept for a later run if the interface is gone for now */
+        if (ConvertInterfaceAliasToLuid(link->name, &link->luid) != NO_ERROR) {
+            StringCchPrintfW(msg, 256, L"Interface not found: %ls, its saved metrics are kept",
+                             link->name);
+            print_error(msg);
+            failed++;
+            continue;
+        }
+        if (metrics_restore(&backend, link, 1) != 0) {
+            StringCchPrintfW(msg, 256, L"Failed to restore the metrics of %ls", link->name);
+            print_error(msg);
+            failed++;
+            continue;
+        }
+
+        for (int f = 0; f < METRICS_FAMILIES; f++) {
+            wchar_t after[32];
+
+            if (link->has_family[f]) {
+                format_setting(&link->previous[f], after, 32);
+                wprintf(L"  %-24ls %ls metric -> %ls\n", link->name,
+                        FAMILIES[f] == AF_INET ? L"IPv4" : L"IPv6", after);
+            }
+        }
+        if (metrics_clear_state(&reg, link) != 0) {
+            StringCchPrintfW(msg, 256, L"Warning: failed to clear the saved metrics of %ls",
+                             link->name);
+            print_error(msg);
+        }
+    }
+
+    if (failed > 0) {
+        return 1;
+    }
+    print_success(L"Interface metrics restored");
+    return 0;
+}
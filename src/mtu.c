@@ -0,0 +1,355 @@
+/*
+ * mtu.c - Path MTU probing and interface MTU ([mtu])
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include <icmpapi.h>
+#include "mtu.h"
+#include "config.h"
+#include "network.h"
+#include "process.h"
+#include "status.h"
+#include <string.h>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "iphlpapi.lib")
+#endif
+
+/* ============================================================================
+ * OPTIONS
+ * ============================================================================ */
+
+void mtu_options_init(MtuOptions *opts)
+{
+    opts->min = MTU_MIN_IPV4;
+    opts->max = MTU_DEFAULT_MAX;
+    opts->timeout_ms = MTU_DEFAULT_TIMEOUT_MS;
+    opts->attempts = MTU_DEFAULT_ATTEMPTS;
+    StringCchCopyW(opts->targets, MTU_TARGETS_LEN, L"gateway, dns");
+}
+
+/* ============================================================================
+ * SYSTEM BACKEND
+ * ============================================================================ */
+
+static MtuProbeResult system_probe(void *ctx, const IpAddr *target, int size, int timeout_ms)
+{
+    static BYTE payload[MTU_MAX];
+    BYTE *reply;
+    DWORD reply_size = sizeof(ICMP_ECHO_REPLY) + MTU_MAX + 8;
+    IP_OPTION_INFORMATION options;
+    HANDLE icmp;
+    IPAddr dest;
+    DWORD replies;
+    ULONG status;
+
+    (void)ctx;
+    reply = (BYTE *)malloc(reply_size);
+    if (!reply) {
+        return MTU_PROBE_LOST;
+    }
+    icmp = IcmpCreateFile();
+    if (icmp == INVALID_HANDLE_VALUE) {
+        free(reply);
+        return MTU_PROBE_LOST;
+    }
+
+    ZeroMemory(&options, sizeof(options));
+    options.Ttl = 128;
+    options.Flags = IP_FLAG_DF;
+
+    memcpy(&dest, target->bytes, 4);
+    replies = IcmpSendEcho(icmp, dest, payload, (WORD)(size - MTU_ECHO_OVERHEAD), &options,
+                           reply, reply_size, (DWORD)timeout_ms);
+    status = replies > 0 ? ((PICMP_ECHO_REPLY)reply)->Status : GetLastError();
+    IcmpCloseHandle(icmp);
+    free(reply);
+
+    /* IP_PACKET_TOO_BIG comes back both from the local stack (larger than
+       the interface MTU) and from a router that cannot forward it */
+    if (status == IP_SUCCESS) {
+        return MTU_PROBE_FITS;
+    }
+    return status == IP_PACKET_TOO_BIG ? MTU_PROBE_TOO_BIG : MTU_PROBE_LOST;
+}
+
+void mtu_backend_system(MtuBackend *backend)
+{
+    backend->ctx = NULL;
+    backend->probe = system_probe;
+}
+
+/* ============================================================================
+ * TARGETS
+ * ============================================================================ */
+
+static int add_target(IpAddr *out, int count, int max, const IpAddr *addr)
+{
+    for (int i = 0; i < count; i++) {
+        if (address_compare(&out[i], addr) == 0) {
+            return count;
+        }
+    }
+    if (count < max) {
+        out[count++] = *addr;
+    }
+    return count;
+}
+
+int mtu_resolve_targets(const wchar_t *spec, const IpAddr *gateway,
+                        const IpAddr *dns, int dns_count, IpAddr *out, int max)
+{
+    wchar_t buf[MTU_TARGETS_LEN];
+    wchar_t *p;
+    int count = 0;
+
+    if (FAILED(StringCchCopyW(buf, MTU_TARGETS_LEN, spec))) {
+        return -1;
+    }
+
+    /* Entries are separated by commas or whitespace */
+    p = buf;
+    while (*p) {
+        wchar_t *start;
+        IpAddr addr;
+
+        while (*p && (iswspace(*p) || *p == L',')) p++;
+        if (*p == L'\0') break;
+
+        start = p;
+        while (*p && !iswspace(*p) && *p != L',') p++;
+        if (*p) *p++ = L'\0';
+
+        if (_wcsicmp(start, L"gateway") == 0) {
+            if (gateway) {
+                count = add_target(out, count, max, gateway);
+            }
+        } else if (_wcsicmp(start, L"dns") == 0) {
+            for (int i = 0; i < dns_count; i++) {
+                count = add_target(out, count, max, &dns[i]);
+            }
+        } else if (address_parse(start, &addr) == 0 && addr.family == AF_INET &&
+                   addr.prefix < 0) {
+            count = add_target(out, count, max, &addr);
+        } else {
+            return -1;
+        }
+    }
+    return count;
+}
+
+/* ============================================================================
+ * PROBING
+ * ============================================================================ */
+
+/*
+ * A size fits once any attempt is answered; a size the path refuses, or
+ * drops on every attempt, does not
+ */
+static int size_fits(const MtuBackend *backend, const IpAddr *target, int size,
+                     const MtuOptions *opts, int *probes)
+{
+    for (int attempt = 0; attempt < opts->attempts; attempt++) {
+        MtuProbeResult result = backend->probe(backend->ctx, target, size, opts->timeout_ms);
+
+        (*probes)++;
+        if (result != MTU_PROBE_LOST) {
+            return result == MTU_PROBE_FITS;
+        }
+    }
+    return 0;
+}
+
+int mtu_probe_path(const MtuBackend *backend, const IpAddr *target,
+                   const MtuOptions *opts, int *probes)
+{
+    int low = opts->min, high = opts->max;
+
+    *probes = 0;
+    if (!size_fits(backend, target, low, opts, probes)) {
+        return -1;
+    }
+    if (high <= low || size_fits(backend, target, high, opts, probes)) {
+        return high > low ? high : low;
+    }
+
+    /* low fits and high does not */
+    while (high - low > 1) {
+        int mid = low + (high - low) / 2;
+
+        if (size_fits(backend, target, mid, opts, probes)) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+int mtu_discover(const MtuBackend *backend, const IpAddr *targets, int count,
+                 const MtuOptions *opts)
+{
+    int path_mtu = -1;
+
+    for (int i = 0; i < count; i++) {
+        wchar_t target[MAX_ADDR_LEN];
+        int probes;
+        int mtu = mtu_probe_path(backend, &targets[i], opts, &probes);
+
+        address_format(&targets[i], target, MAX_ADDR_LEN);
+        if (mtu < 0) {
+            wprintf(L"  %-40ls no answer at %d bytes (%d probes)\n", target, opts->min, probes);
+            continue;
+        }
+        wprintf(L"  %-40ls %5d bytes (%d probes)\n", target, mtu, probes);
+
+        if (path_mtu < 0 || mtu < path_mtu) {
+            path_mtu = mtu;
+        }
+    }
+    return path_mtu;
+}
+
+/* ============================================================================
+ * INTERFACE MTU
+ * ============================================================================ */
+
+int mtu_read(int family, ULONG *mtu)
+{
+    MIB_IPINTERFACE_ROW row;
+
+    InitializeIpInterfaceEntry(&row);
+    row.Family = (ADDRESS_FAMILY)family;
+    if (ConvertInterfaceAliasToLuid(g_config.interface_name, &row.InterfaceLuid) != NO_ERROR ||
+        GetIpInterfaceEntry(&row) != NO_ERROR) {
+        return -1;
+    }
+    *mtu = row.NlMtu;
+    return 0;
+}
+
+int mtu_set(int mtu)
+{
+    wchar_t cmd[CMD_BUFFER_SIZE];
+
+    StringCchPrintfW(cmd, CMD_BUFFER_SIZE,
+        L"interface ipv4 set subinterface \"%ls\" mtu=%d store=persistent",
+        g_config.interface_name, mtu);
+    if (run_netsh_retry(&g_config.retry[RETRY_ADDRESS], cmd) != 0) {
+        return -1;
+    }
+
+    /* IPv6 may be unbound from the interface; that is not an error */
+    if (mtu >= MTU_MIN_IPV6) {
+        StringCchPrintfW(cmd, CMD_BUFFER_SIZE,
+            L"interface ipv6 set subinterface \"%ls\" mtu=%d store=persistent",
+            g_config.interface_name, mtu);
+        run_netsh_silent(cmd);
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * MTU MODE
+ * ============================================================================ */
+
+/*
+ * IPv4 default gateway: the configured one, else the interface's current one
+ */
+static int interface_gateway(IpAddr *out)
+{
+    IP_ADAPTER_ADDRESSES *adapters, *a;
+    int found = 0;
+
+    if (g_config.ipv4_gateway[0] != L'\0') {
+        return address_parse(g_config.ipv4_gateway, out) == 0 ? 0 : -1;
+    }
+
+    adapters = network_get_adapters(GAA_FLAG_INCLUDE_GATEWAYS | GAA_FLAG_SKIP_ANYCAST |
+                                    GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER);
+    for (a = adapters; a && !found; a = a->Next) {
+        if (_wcsicmp(a->FriendlyName, g_config.interface_name) != 0) {
+            continue;
+        }
+        for (PIP_ADAPTER_GATEWAY_ADDRESS_LH gw = a->FirstGatewayAddress; gw && !found; gw = gw->Next) {
+            found = gw->Address.lpSockaddr->sa_family == AF_INET &&
+                    address_from_sockaddr(gw->Address.lpSockaddr, out) == 0;
+        }
+    }
+    free(adapters);
+    return found ? 0 : -1;
+}
+
+int mtu_run(void)
+{
+    DnsServerInfo ipv4[STATUS_MAX_SERVERS], ipv6[STATUS_MAX_SERVERS];
+    IpAddr dns[STATUS_MAX_SERVERS], gateway, targets[MTU_MAX_TARGETS];
+    int ipv4_count = 0, ipv6_count = 0, dns_count = 0, count, path_mtu;
+    int has_gateway;
+    MtuBackend backend;
+    ULONG current;
+    wchar_t msg[256];
+
+    wprintf(L"\n");
+    wprintf(L"========================================\n");
+    wprintf(L"  Probing path MTU\n");
+    wprintf(L"  Interface: %ls\n", g_config.interface_name);
+    wprintf(L"========================================\n\n");
+
+    has_gateway = interface_gateway(&gateway) == 0;
+    if (status_get_configured_dns(ipv4, &ipv4_count, ipv6, &ipv6_count) == 0) {
+        for (int i = 0; i < ipv4_count; i++) {
+            if (address_parse(ipv4[i].address, &dns[dns_count]) == 0) {
+                dns_count++;
+            }
+        }
+    }
+
+    count = mtu_resolve_targets(g_config.mtu.targets, has_gateway ? &gateway : NULL,
+                                dns, dns_count, targets, MTU_MAX_TARGETS);
+    if (count < 0) {
+        StringCchPrintfW(msg, 256, L"Invalid MTU probe target list: %ls", g_config.mtu.targets);
+        print_error(msg);
+        return 1;
+    }
+    if (count == 0) {
+        print_error(L"No MTU probe target: the interface has no IPv4 gateway or DNS server");
+        return 1;
+    }
+
+    StringCchPrintfW(msg, 256, L"Probing %d target(s) between %d and %d bytes...",
+                     count, g_config.mtu.min, g_config.mtu.max);
+    print_info(msg);
+
+    mtu_backend_system(&backend);
+    path_mtu = mtu_discover(&backend, targets, count, &g_config.mtu);
+    wprintf(L"\n");
+    if (path_mtu < 0) {
+        print_error(L"No target answered, MTU not changed");
+        return 1;
+    }
+
+    if (mtu_read(AF_INET, &current) != 0) {
+        current = 0;
+    }
+    if (current == (ULONG)path_mtu) {
+        StringCchPrintfW(msg, 256, L"Interface MTU already %d", path_mtu);
+        print_success(msg);
+        return 0;
+    }
+
+    if (mtu_set(path_mtu) != 0) {
+        print_error(L"Failed to set the interface MTU");
+        return 1;
+    }
+
+    if (current > 0) {
+        StringCchPrintfW(msg, 256, L"Interface MTU set to %d (was %lu)", path_mtu, current);
+    } else {
+        StringCchPrintfW(msg, 256, L"Interface MTU set to %d", path_mtu);
+    }
+    print_success(msg);
+    return 0;
+}
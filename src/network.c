@@ -7,6 +7,13 @@
 #include <iphlpapi.h>
 #include "network.h"
 #include "process.h"
+#include "status.h"
+#include "tcp.h"
+#include "adapter.h"
+#include "dnscache.h"
+#include "fastpath.h"
+#include "prefix.h"
+#include "suffix.h"
 
 #ifdef _MSC_VER
 #pragma comment(lib, "iphlpapi.lib")
@@ -41,39 +48,46 @@ const wchar_t *ALL_DNS_SERVERS[] = {
  * INTERFACE LISTING
  * ============================================================================ */
 
-void network_list_interfaces(void)
+IP_ADAPTER_ADDRESSES *network_get_adapters(ULONG flags)
 {
     ULONG bufLen = 15000;
     PIP_ADAPTER_ADDRESSES pAddresses = NULL;
-    PIP_ADAPTER_ADDRESSES pCurrAddr = NULL;
-    ULONG ret;
-    int count = 0;
-
-    pAddresses = (IP_ADAPTER_ADDRESSES *)HeapAlloc(GetProcessHeap(), 0, bufLen);
-    if (!pAddresses) {
-        print_error(L"Memory allocation failed");
-        return;
-    }
+    ULONG ret = ERROR_BUFFER_OVERFLOW;
 
-    ret = GetAdaptersAddresses(AF_UNSPEC,
-        GAA_FLAG_INCLUDE_PREFIX | GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST,
-        NULL, pAddresses, &bufLen);
-
-    if (ret == ERROR_BUFFER_OVERFLOW) {
-        HeapFree(GetProcessHeap(), 0, pAddresses);
-        pAddresses = (IP_ADAPTER_ADDRESSES *)HeapAlloc(GetProcessHeap(), 0, bufLen);
+    /* Two tries: the table can grow between the size query and the read */
+    for (int attempt = 0; attempt < 2 && ret == ERROR_BUFFER_OVERFLOW; attempt++) {
+        free(pAddresses);
+        pAddresses = (IP_ADAPTER_ADDRESSES *)malloc(bufLen);
         if (!pAddresses) {
-            print_error(L"Memory allocation failed");
-            return;
+            return NULL;
         }
-        ret = GetAdaptersAddresses(AF_UNSPEC,
-            GAA_FLAG_INCLUDE_PREFIX | GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST,
-            NULL, pAddresses, &bufLen);
+        ret = GetAdaptersAddresses(AF_UNSPEC, flags, NULL, pAddresses, &bufLen);
     }
 
     if (ret != NO_ERROR) {
+        free(pAddresses);
+        return NULL;
+    }
+    return pAddresses;
+}
+
+int network_adapter_listed(const IP_ADAPTER_ADDRESSES *adapter)
+{
+    return adapter->IfType != IF_TYPE_SOFTWARE_LOOPBACK &&
+           adapter->IfType != IF_TYPE_TUNNEL &&
+           adapter->OperStatus == IfOperStatusUp;
+}
+
+void network_list_interfaces(void)
+{
+    PIP_ADAPTER_ADDRESSES pAddresses;
+    PIP_ADAPTER_ADDRESSES pCurrAddr;
+    int count = 0;
+
+    pAddresses = network_get_adapters(
+        GAA_FLAG_INCLUDE_PREFIX | GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST);
+    if (!pAddresses) {
         print_error(L"GetAdaptersAddresses failed");
-        HeapFree(GetProcessHeap(), 0, pAddresses);
         return;
     }
 
@@ -82,9 +96,7 @@ void network_list_interfaces(void)
 
     pCurrAddr = pAddresses;
     while (pCurrAddr) {
-        if (pCurrAddr->IfType != IF_TYPE_SOFTWARE_LOOPBACK &&
-            pCurrAddr->IfType != IF_TYPE_TUNNEL &&
-            pCurrAddr->OperStatus == IfOperStatusUp) {
+        if (network_adapter_listed(pCurrAddr)) {
 
             count++;
             wprintf(L"  [%d] %ls\n", count, pCurrAddr->FriendlyName);
@@ -130,13 +142,70 @@ void network_list_interfaces(void)
         wprintf(L"  No active network interfaces found.\n\n");
     }
 
-    HeapFree(GetProcessHeap(), 0, pAddresses);
+    free(pAddresses);
+}
+
+int network_get_luid(NET_LUID *luid)
+{
+    if (ConvertInterfaceAliasToLuid(g_config.interface_name, luid) != NO_ERROR) {
+        wchar_t errmsg[256];
+        StringCchPrintfW(errmsg, 256, L"Interface not found: %ls", g_config.interface_name);
+        print_error(errmsg);
+        return -1;
+    }
+    return 0;
+}
+
+int network_get_guid(wchar_t *guid, size_t size)
+{
+    IP_ADAPTER_ADDRESSES *adapters, *a;
+    int ret = -1;
+
+    adapters = network_get_adapters(GAA_FLAG_SKIP_UNICAST | GAA_FLAG_SKIP_ANYCAST |
+                                    GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER);
+    for (a = adapters; a; a = a->Next) {
+        if (_wcsicmp(a->FriendlyName, g_config.interface_name) == 0) {
+            ret = SUCCEEDED(StringCchPrintfW(guid, size, L"%hs", a->AdapterName)) ? 0 : -1;
+            break;
+        }
+    }
+    free(adapters);
+    return ret;
 }
 
 /* ============================================================================
  * ROLLBACK
  * ============================================================================ */
 
+/* Managed NRPT rules as they were before network_apply_nrpt wrote them */
+static NrptRuleList g_nrpt_previous;
+static int g_nrpt_changed;
+
+static void nrpt_rollback(void)
+{
+    RegistryBackend reg;
+    NrptSyncResult result;
+
+    if (!g_nrpt_changed) {
+        return;
+    }
+    g_nrpt_changed = 0;
+
+    registry_backend_system(&reg);
+    if (nrpt_sync(&reg, &g_nrpt_previous, &result) != 0) {
+        print_error(L"Warning: failed to restore some NRPT rules");
+    } else {
+        print_info(L"NRPT rules restored");
+    }
+    nrpt_list_free(&g_nrpt_previous);
+}
+
+static void nrpt_forget(void)
+{
+    g_nrpt_changed = 0;
+    nrpt_list_free(&g_nrpt_previous);
+}
+
 void network_rollback(void)
 {
     wchar_t cmd[CMD_BUFFER_SIZE];
@@ -167,13 +236,82 @@ void network_rollback(void)
     }
     print_info(L"DoH encryption templates removed");
 
+    nrpt_rollback();
+    suffix_rollback();
+    fastpath_rollback();
+
+    adapter_rollback();
+    prefix_policy_rollback();
+    dnscache_rollback();
+    tcp_rollback();
+
     print_info(L"Rollback complete");
 }
 
+void network_rollback_forget(void)
+{
+    nrpt_forget();
+    suffix_forget();
+    fastpath_forget();
+    adapter_forget();
+    prefix_policy_forget();
+    dnscache_forget();
+    tcp_forget();
+}
+
 /* ============================================================================
  * STATIC IP CONFIGURATION
  * ============================================================================ */
 
+/*
+ * Check whether the primary IPv4 address and default gateway are already
+ * configured. "set address static" replaces every address on the interface,
+ * so re-running it would wipe the secondary addresses we are about to diff.
+ */
+static int ipv4_primary_in_place(void)
+{
+    IpAddrList current = {0};
+    PMIB_IPFORWARD_TABLE2 routes = NULL;
+    NET_LUID luid;
+    IpAddr primary, gateway;
+    int found = 0;
+
+    if (address_parse(g_config.ipv4_address, &primary) != 0 ||
+        ConvertInterfaceAliasToLuid(g_config.interface_name, &luid) != NO_ERROR) {
+        return 0;
+    }
+    primary.prefix = address_mask_to_prefix(g_config.ipv4_mask);
+
+    if (address_get_manual(AF_INET, &current) != 0) {
+        return 0;
+    }
+    for (int i = 0; i < current.count && !found; i++) {
+        found = address_compare(&current.items[i], &primary) == 0 &&
+                current.items[i].prefix == primary.prefix;
+    }
+    address_list_free(&current);
+
+    if (!found || g_config.ipv4_gateway[0] == L'\0') {
+        return found;
+    }
+
+    if (address_parse(g_config.ipv4_gateway, &gateway) != 0 ||
+        GetIpForwardTable2(AF_INET, &routes) != NO_ERROR) {
+        return 0;
+    }
+
+    found = 0;
+    for (ULONG i = 0; i < routes->NumEntries && !found; i++) {
+        MIB_IPFORWARD_ROW2 *row = &routes->Table[i];
+        found = row->InterfaceLuid.Value == luid.Value &&
+                row->DestinationPrefix.PrefixLength == 0 &&
+                memcmp(&row->NextHop.Ipv4.sin_addr, gateway.bytes, 4) == 0;
+    }
+    FreeMibTable(routes);
+
+    return found;
+}
+
 int network_apply_static_ipv4(void)
 {
     wchar_t cmd[CMD_BUFFER_SIZE];
@@ -184,6 +322,11 @@ int network_apply_static_ipv4(void)
         return 0;
     }
 
+    if (g_config.ipv4_addresses.count > 0 && ipv4_primary_in_place()) {
+        print_info(L"Static IPv4 address already configured, keeping it");
+        return 0;
+    }
+
     print_info(L"Configuring static IPv4 address...");
 
     StringCchPrintfW(cmd, CMD_BUFFER_SIZE,
@@ -191,7 +334,7 @@ int network_apply_static_ipv4(void)
         g_config.interface_name, g_config.ipv4_address,
         g_config.ipv4_mask, g_config.ipv4_gateway);
 
-    ret = run_netsh(cmd);
+    ret = run_netsh_retry(&g_config.retry[RETRY_ADDRESS], cmd);
     if (ret != 0) {
         print_error(L"Failed to set static IPv4 address");
         return -1;
@@ -205,6 +348,32 @@ int network_apply_static_ipv4(void)
     return 0;
 }
 
+static int ipv6_set_default_route(void)
+{
+    RouteList desired = {0};
+    RouteBackend backend;
+    RouteSyncResult result;
+    RouteEntry route;
+    wchar_t spec[CONFIG_LINE_SIZE];
+    NET_LUID luid;
+    int ret;
+
+    if (network_get_luid(&luid) != 0) {
+        return -1;
+    }
+
+    StringCchPrintfW(spec, CONFIG_LINE_SIZE, L"::/0 via %ls", g_config.ipv6_gateway);
+    if (route_parse(spec, &route) != 0 || route_list_add(&desired, &route) != 0) {
+        route_list_free(&desired);
+        return -1;
+    }
+
+    route_backend_system(&backend, &luid);
+    ret = route_sync(&backend, &desired, 0, NULL, NULL, &result);
+    route_list_free(&desired);
+    return ret;
+}
+
 int network_apply_static_ipv6(void)
 {
     wchar_t cmd[CMD_BUFFER_SIZE];
@@ -221,26 +390,15 @@ int network_apply_static_ipv6(void)
         L"interface ipv6 set address interface=\"%ls\" address=%ls/%ls",
         g_config.interface_name, g_config.ipv6_address, g_config.ipv6_prefix);
 
-    ret = run_netsh(cmd);
+    ret = run_netsh_retry(&g_config.retry[RETRY_ADDRESS], cmd);
     if (ret != 0) {
         print_error(L"Failed to set static IPv6 address");
         return -1;
     }
 
-    /* Add default route via link-local gateway */
+    /* Add default route via link-local gateway (replaces any other ::/0 here) */
     if (g_config.ipv6_gateway[0] != L'\0') {
-        wchar_t delcmd[CMD_BUFFER_SIZE];
-        StringCchPrintfW(delcmd, CMD_BUFFER_SIZE,
-            L"interface ipv6 delete route ::/0 interface=\"%ls\"",
-            g_config.interface_name);
-        run_netsh_silent(delcmd);
-
-        StringCchPrintfW(cmd, CMD_BUFFER_SIZE,
-            L"interface ipv6 add route ::/0 interface=\"%ls\" nexthop=%ls",
-            g_config.interface_name, g_config.ipv6_gateway);
-
-        ret = run_netsh(cmd);
-        if (ret != 0) {
+        if (ipv6_set_default_route() != 0) {
             print_error(L"Warning: Could not add IPv6 default route");
         }
     }
@@ -253,10 +411,204 @@ int network_apply_static_ipv6(void)
     return 0;
 }
 
+/* ============================================================================
+ * SECONDARY ADDRESSES
+ * ============================================================================ */
+
+static int sync_secondary(int family, const IpAddrList *secondary,
+                          const wchar_t *primary, int default_prefix)
+{
+    IpAddrList desired = {0};
+    IpAddr addr;
+    int ret;
+
+    /* The primary address belongs to the desired set so it is never removed */
+    if (address_parse(primary, &addr) == 0) {
+        if (addr.prefix < 0) addr.prefix = default_prefix;
+        if (address_list_add(&desired, &addr) != 0) goto oom;
+    }
+
+    for (int i = 0; i < secondary->count; i++) {
+        addr = secondary->items[i];
+        if (addr.prefix < 0) addr.prefix = default_prefix;
+        if (address_list_add(&desired, &addr) != 0) goto oom;
+    }
+
+    ret = address_sync(family, &desired);
+    address_list_free(&desired);
+    return ret;
+
+oom:
+    print_error(L"Memory allocation failed");
+    address_list_free(&desired);
+    return -1;
+}
+
+int network_apply_secondary_addresses(void)
+{
+    if (g_config.ipv4_addresses.count > 0) {
+        if (!g_config.has_ipv4) {
+            print_error(L"[ipv4.addresses] requires a static [ipv4] address");
+            return -1;
+        }
+        print_info(L"Synchronizing IPv4 secondary addresses...");
+        if (sync_secondary(AF_INET, &g_config.ipv4_addresses, g_config.ipv4_address,
+                           address_mask_to_prefix(g_config.ipv4_mask)) != 0) {
+            return -1;
+        }
+    }
+
+    if (g_config.ipv6_addresses.count > 0) {
+        if (!g_config.has_ipv6) {
+            print_error(L"[ipv6.addresses] requires a static [ipv6] address");
+            return -1;
+        }
+        print_info(L"Synchronizing IPv6 secondary addresses...");
+        if (sync_secondary(AF_INET6, &g_config.ipv6_addresses, g_config.ipv6_address,
+                           _wtoi(g_config.ipv6_prefix)) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* ============================================================================
+ * STATIC ROUTES
+ * ============================================================================ */
+
+static void print_route_progress(int done, int total, void *ctx)
+{
+    int *last_decile = (int *)ctx;
+    int decile = (done * 10) / total;
+
+    if (decile != *last_decile) {
+        wchar_t msg[128];
+        *last_decile = decile;
+        StringCchPrintfW(msg, 128, L"Routes: %d/%d applied", done, total);
+        print_info(msg);
+    }
+}
+
+static int add_default_route(RouteList *desired, const wchar_t *prefix, const wchar_t *gateway)
+{
+    wchar_t spec[CONFIG_LINE_SIZE];
+    RouteEntry route;
+
+    if (gateway[0] == L'\0') {
+        return 0;
+    }
+
+    StringCchPrintfW(spec, CONFIG_LINE_SIZE, L"%ls via %ls", prefix, gateway);
+    if (route_parse(spec, &route) != 0) {
+        return 0;
+    }
+    return route_list_add(desired, &route);
+}
+
+int network_apply_routes(void)
+{
+    RouteList desired = {0};
+    RouteBackend backend;
+    RouteSyncResult result;
+    NET_LUID luid;
+    ULONGLONG start;
+    int last_decile = 0;
+    int ret;
+
+    if (g_config.routes.count == 0) {
+        return 0;
+    }
+
+    if (network_get_luid(&luid) != 0) {
+        return -1;
+    }
+
+    wchar_t msg[256];
+    StringCchPrintfW(msg, 256, L"Synchronizing %d static routes...", g_config.routes.count);
+    print_info(msg);
+
+    for (int i = 0; i < g_config.routes.count; i++) {
+        if (route_list_add(&desired, &g_config.routes.items[i]) != 0) {
+            route_list_free(&desired);
+            print_error(L"Memory allocation failed");
+            return -1;
+        }
+    }
+
+    /* Default gateways are part of the desired table so prune keeps them */
+    if ((g_config.has_ipv4 && add_default_route(&desired, L"0.0.0.0/0", g_config.ipv4_gateway) != 0) ||
+        (g_config.has_ipv6 && add_default_route(&desired, L"::/0", g_config.ipv6_gateway) != 0)) {
+        route_list_free(&desired);
+        print_error(L"Memory allocation failed");
+        return -1;
+    }
+
+    start = GetTickCount64();
+    route_backend_system(&backend, &luid);
+    ret = route_sync(&backend, &desired, g_config.routes_prune,
+                     print_route_progress, &last_decile, &result);
+    route_list_free(&desired);
+
+    StringCchPrintfW(msg, 256,
+        L"Routes: %d added, %d removed, %d updated, %d unchanged (%llu ms)",
+        result.added, result.removed, result.updated, result.unchanged,
+        (unsigned long long)(GetTickCount64() - start));
+    if (ret != 0) {
+        print_error(msg);
+        return -1;
+    }
+
+    print_success(msg);
+    return 0;
+}
+
 /* ============================================================================
  * DNS CONFIGURATION
  * ============================================================================ */
 
+int network_get_dns_servers(int family, IpAddrList *out)
+{
+    PIP_ADAPTER_ADDRESSES pAddresses;
+    PIP_ADAPTER_ADDRESSES pCurrAddr;
+    NET_LUID luid;
+
+    out->count = 0;
+    if (ConvertInterfaceAliasToLuid(g_config.interface_name, &luid) != NO_ERROR) {
+        return -1;
+    }
+
+    pAddresses = network_get_adapters(GAA_FLAG_SKIP_UNICAST | GAA_FLAG_SKIP_ANYCAST |
+                                      GAA_FLAG_SKIP_MULTICAST);
+    if (!pAddresses) {
+        return -1;
+    }
+
+    for (pCurrAddr = pAddresses; pCurrAddr; pCurrAddr = pCurrAddr->Next) {
+        PIP_ADAPTER_DNS_SERVER_ADDRESS pDns;
+
+        if (pCurrAddr->Luid.Value != luid.Value) {
+            continue;
+        }
+        for (pDns = pCurrAddr->FirstDnsServerAddress; pDns; pDns = pDns->Next) {
+            IpAddr addr;
+
+            if (address_from_sockaddr(pDns->Address.lpSockaddr, &addr) != 0 ||
+                addr.family != family) {
+                continue;
+            }
+            if (address_list_add(out, &addr) != 0) {
+                free(pAddresses);
+                return -1;
+            }
+        }
+        break;
+    }
+
+    free(pAddresses);
+    return 0;
+}
+
 int network_apply_dns_ipv4(const wchar_t *dns1, const wchar_t *dns2)
 {
     wchar_t cmd[CMD_BUFFER_SIZE];
@@ -268,7 +620,7 @@ int network_apply_dns_ipv4(const wchar_t *dns1, const wchar_t *dns2)
         L"interface ipv4 set dnsservers name=\"%ls\" static %ls primary validate=no",
         g_config.interface_name, dns1);
 
-    ret = run_netsh(cmd);
+    ret = run_netsh_retry(&g_config.retry[RETRY_DNS], cmd);
     if (ret != 0) {
         print_error(L"Failed to set primary IPv4 DNS");
         return -1;
@@ -278,7 +630,7 @@ int network_apply_dns_ipv4(const wchar_t *dns1, const wchar_t *dns2)
         L"interface ipv4 add dnsservers name=\"%ls\" %ls index=2 validate=no",
         g_config.interface_name, dns2);
 
-    ret = run_netsh(cmd);
+    ret = run_netsh_retry(&g_config.retry[RETRY_DNS], cmd);
     if (ret != 0) {
         print_error(L"Failed to add secondary IPv4 DNS");
         return -1;
@@ -302,7 +654,7 @@ int network_apply_dns_ipv6(const wchar_t *dns1, const wchar_t *dns2)
         L"interface ipv6 set dnsservers name=\"%ls\" static %ls primary validate=no",
         g_config.interface_name, dns1);
 
-    ret = run_netsh(cmd);
+    ret = run_netsh_retry(&g_config.retry[RETRY_DNS], cmd);
     if (ret != 0) {
         print_error(L"Failed to set primary IPv6 DNS");
         return -1;
@@ -312,7 +664,7 @@ int network_apply_dns_ipv6(const wchar_t *dns1, const wchar_t *dns2)
         L"interface ipv6 add dnsservers name=\"%ls\" %ls index=2 validate=no",
         g_config.interface_name, dns2);
 
-    ret = run_netsh(cmd);
+    ret = run_netsh_retry(&g_config.retry[RETRY_DNS], cmd);
     if (ret != 0) {
         print_error(L"Failed to add secondary IPv6 DNS");
         return -1;
@@ -342,7 +694,7 @@ static int add_doh_template(const wchar_t *server, const wchar_t *doh_template)
         L"dns add encryption server=%ls dohtemplate=%ls autoupgrade=yes udpfallback=no",
         server, doh_template);
 
-    ret = run_netsh(cmd);
+    ret = run_netsh_retry(&g_config.retry[RETRY_DOH], cmd);
     if (ret != 0) {
         wchar_t errmsg[512];
         StringCchPrintfW(errmsg, 512, L"Failed to add DoH template for %ls", server);
@@ -353,6 +705,19 @@ static int add_doh_template(const wchar_t *server, const wchar_t *doh_template)
     return 0;
 }
 
+int network_ensure_doh(const wchar_t *server, const wchar_t *doh_template)
+{
+    DnsServerInfo info;
+
+    status_query_doh_info(server, &info);
+    if (info.has_template && info.autoupgrade && !info.udpfallback &&
+        _wcsicmp(info.doh_template, doh_template) == 0) {
+        return 0;
+    }
+
+    return add_doh_template(server, doh_template) == 0 ? 1 : -1;
+}
+
 int network_apply_doh(const wchar_t *dns_ipv4_1, const wchar_t *dns_ipv4_2,
                       const wchar_t *dns_ipv6_1, const wchar_t *dns_ipv6_2,
                       const wchar_t *doh_template)
@@ -370,3 +735,93 @@ int network_apply_doh(const wchar_t *dns_ipv4_1, const wchar_t *dns_ipv4_2,
 
     return 0;
 }
+
+/* ============================================================================
+ * NAME RESOLUTION POLICY
+ * ============================================================================ */
+
+/*
+ * Check whether `server` is one of the entries of a ';'-separated list
+ */
+static int server_listed(const wchar_t *servers, const wchar_t *server)
+{
+    size_t len = wcslen(server);
+    const wchar_t *p = servers;
+
+    while (p && *p) {
+        if (_wcsnicmp(p, server, len) == 0 && (p[len] == L';' || p[len] == L'\0')) {
+            return 1;
+        }
+        p = wcschr(p, L';');
+        if (p) p++;
+    }
+    return 0;
+}
+
+int network_apply_nrpt(void)
+{
+    RegistryBackend reg;
+    NrptSyncResult result;
+    wchar_t msg[256];
+    int ret;
+
+    /* A rollback after an earlier run must not restore that run's rules */
+    g_nrpt_changed = 0;
+    nrpt_list_free(&g_nrpt_previous);
+
+    if (g_config.nrpt_rules.count == 0) {
+        return 0;
+    }
+
+    StringCchPrintfW(msg, 256, L"Synchronizing %d NRPT rules...", g_config.nrpt_rules.count);
+    print_info(msg);
+
+    registry_backend_system(&reg);
+    if (nrpt_read_rules(&reg, &g_nrpt_previous) != 0) {
+        print_error(L"Failed to read NRPT rules");
+        return -1;
+    }
+    g_nrpt_changed = 1;
+    ret = nrpt_sync(&reg, &g_config.nrpt_rules, &result);
+
+    StringCchPrintfW(msg, 256, L"NRPT: %d added, %d updated, %d removed, %d unchanged",
+        result.added, result.updated, result.removed, result.unchanged);
+    if (ret != 0) {
+        print_error(msg);
+        return -1;
+    }
+    print_success(msg);
+
+    /* DoH rules need an encryption template for each of their servers;
+       many rules share servers, so register each server once */
+    for (int i = 0; i < g_config.nrpt_rules.count; i++) {
+        const NrptRule *rule = &g_config.nrpt_rules.items[i];
+        wchar_t servers[NRPT_SERVERS_LEN];
+        wchar_t *server, *next;
+
+        if (rule->doh_template[0] == L'\0') {
+            continue;
+        }
+
+        StringCchCopyW(servers, NRPT_SERVERS_LEN, rule->servers);
+        for (server = servers; server && *server; server = next) {
+            int seen = 0;
+
+            next = wcschr(server, L';');
+            if (next) *next++ = L'\0';
+
+            for (int k = 0; k < i && !seen; k++) {
+                const NrptRule *prev = &g_config.nrpt_rules.items[k];
+                seen = prev->doh_template[0] != L'\0' && server_listed(prev->servers, server);
+            }
+
+            /* Only servers whose template differs are rewritten, so a
+               rerun never drops encryption, even briefly */
+            if (!seen && network_ensure_doh(server, rule->doh_template) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
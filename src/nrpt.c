@@ -0,0 +1,308 @@
+/*
+ * nrpt.c - Name Resolution Policy Table (per-namespace DNS) rules
+ */
+
+#include "nrpt.h"
+
+/* Registry value names and constants of a DnsPolicyConfig rule */
+#define NRPT_VALUE_NAME         L"Name"
+#define NRPT_VALUE_SERVERS      L"GenericDNSServers"
+#define NRPT_VALUE_OPTIONS      L"ConfigOptions"
+#define NRPT_VALUE_VERSION      L"Version"
+#define NRPT_VALUE_IPSEC        L"IPSECCARestriction"
+#define NRPT_VALUE_COMMENT      L"Comment"
+#define NRPT_VALUE_DOH          L"StaticIpFixDohTemplate"
+
+#define NRPT_OPTION_GENERIC_DNS 0x8
+#define NRPT_RULE_VERSION       2
+
+/* ============================================================================
+ * PARSING
+ * ============================================================================ */
+
+int nrpt_parse_rule(const wchar_t *name_space, const wchar_t *value, NrptRule *out)
+{
+    wchar_t buf[CONFIG_LINE_SIZE];
+    wchar_t *p;
+
+    ZeroMemory(out, sizeof(*out));
+
+    if (!name_space || *name_space == L'\0' || wcschr(name_space, L'\\') ||
+        FAILED(StringCchCopyW(out->name_space, NRPT_NAMESPACE_LEN, name_space)) ||
+        FAILED(StringCchCopyW(buf, CONFIG_LINE_SIZE, value))) {
+        return -1;
+    }
+
+    /* Tokens are separated by commas, semicolons or whitespace */
+    p = buf;
+    while (*p) {
+        wchar_t *start;
+
+        while (*p && (iswspace(*p) || *p == L',' || *p == L';')) p++;
+        if (*p == L'\0') break;
+
+        start = p;
+        while (*p && !iswspace(*p) && *p != L',' && *p != L';') p++;
+        if (*p) *p++ = L'\0';
+
+        if (_wcsnicmp(start, L"doh=", 4) == 0) {
+            if (FAILED(StringCchCopyW(out->doh_template, NRPT_TEMPLATE_LEN, start + 4))) {
+                return -1;
+            }
+            continue;
+        }
+
+        if (out->servers[0] != L'\0' &&
+            FAILED(StringCchCatW(out->servers, NRPT_SERVERS_LEN, L";"))) {
+            return -1;
+        }
+        if (FAILED(StringCchCatW(out->servers, NRPT_SERVERS_LEN, start))) {
+            return -1;
+        }
+    }
+
+    return out->servers[0] != L'\0' ? 0 : -1;
+}
+
+int nrpt_list_add(NrptRuleList *list, const NrptRule *rule)
+{
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 32;
+        NrptRule *items = (NrptRule *)realloc(list->items, (size_t)capacity * sizeof(NrptRule));
+        if (!items) {
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+
+    list->items[list->count++] = *rule;
+    return 0;
+}
+
+void nrpt_list_free(NrptRuleList *list)
+{
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+int nrpt_list_load_file(NrptRuleList *list, const wchar_t *filepath)
+{
+    FILE *fp;
+    wchar_t line[CONFIG_LINE_SIZE];
+    int loaded = 0;
+
+    if (_wfopen_s(&fp, filepath, L"r, ccs=UTF-8") != 0 || !fp) {
+        return -1;
+    }
+
+    while (fgetws(line, CONFIG_LINE_SIZE, fp)) {
+        wchar_t *trimmed = trim(line);
+        wchar_t *eq;
+        NrptRule rule;
+
+        if (*trimmed == L'\0' || *trimmed == L';' || *trimmed == L'#') {
+            continue;
+        }
+
+        eq = wcschr(trimmed, L'=');
+        if (eq) {
+            *eq = L'\0';
+        }
+
+        if (!eq || nrpt_parse_rule(trim(trimmed), trim(eq + 1), &rule) != 0) {
+            wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+            StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                L"Invalid NRPT rule in %ls: %ls", filepath, trimmed);
+            print_error(errmsg);
+            continue;
+        }
+
+        if (nrpt_list_add(list, &rule) != 0) {
+            fclose(fp);
+            return -1;
+        }
+        loaded++;
+    }
+
+    fclose(fp);
+    return loaded;
+}
+
+static int compare_rules(const void *a, const void *b)
+{
+    return _wcsicmp(((const NrptRule *)a)->name_space, ((const NrptRule *)b)->name_space);
+}
+
+const NrptRule *nrpt_find(const NrptRuleList *list, const wchar_t *name_space)
+{
+    int lo = 0, hi = list->count - 1;
+
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int cmp = _wcsicmp(list->items[mid].name_space, name_space);
+        if (cmp == 0) return &list->items[mid];
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * STORE ACCESS
+ * ============================================================================ */
+
+static void rule_key(const NrptRule *rule, wchar_t *key, size_t size)
+{
+    StringCchPrintfW(key, size, L"%ls\\%ls%ls", NRPT_REGISTRY_KEY,
+                     NRPT_RULE_PREFIX, rule->name_space);
+}
+
+int nrpt_read_rules(const RegistryBackend *reg, NrptRuleList *out)
+{
+    size_t prefix_len = wcslen(NRPT_RULE_PREFIX);
+    wchar_t subkey[MAX_PATH_LEN];
+    wchar_t key[MAX_PATH_LEN];
+    int ret;
+
+    for (int index = 0;
+         (ret = reg->enum_subkeys(reg->ctx, NRPT_REGISTRY_KEY, index, subkey, MAX_PATH_LEN)) == 0;
+         index++) {
+        NrptRule rule;
+
+        if (_wcsnicmp(subkey, NRPT_RULE_PREFIX, prefix_len) != 0) {
+            continue;
+        }
+
+        ZeroMemory(&rule, sizeof(rule));
+        StringCchPrintfW(key, MAX_PATH_LEN, L"%ls\\%ls", NRPT_REGISTRY_KEY, subkey);
+
+        if (reg->get_string(reg->ctx, key, NRPT_VALUE_NAME,
+                            rule.name_space, NRPT_NAMESPACE_LEN) != 0) {
+            StringCchCopyW(rule.name_space, NRPT_NAMESPACE_LEN, subkey + prefix_len);
+        }
+        reg->get_string(reg->ctx, key, NRPT_VALUE_SERVERS, rule.servers, NRPT_SERVERS_LEN);
+        reg->get_string(reg->ctx, key, NRPT_VALUE_DOH, rule.doh_template, NRPT_TEMPLATE_LEN);
+
+        if (nrpt_list_add(out, &rule) != 0) {
+            return -1;
+        }
+    }
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    if (out->count > 0) {
+        qsort(out->items, (size_t)out->count, sizeof(NrptRule), compare_rules);
+    }
+    return 0;
+}
+
+static int write_rule(const RegistryBackend *reg, const NrptRule *rule)
+{
+    wchar_t key[MAX_PATH_LEN];
+
+    rule_key(rule, key, MAX_PATH_LEN);
+
+    if (reg->set_string(reg->ctx, key, NRPT_VALUE_NAME, rule->name_space, 1) != 0 ||
+        reg->set_string(reg->ctx, key, NRPT_VALUE_SERVERS, rule->servers, 0) != 0 ||
+        reg->set_dword(reg->ctx, key, NRPT_VALUE_OPTIONS, NRPT_OPTION_GENERIC_DNS) != 0 ||
+        reg->set_dword(reg->ctx, key, NRPT_VALUE_VERSION, NRPT_RULE_VERSION) != 0 ||
+        reg->set_string(reg->ctx, key, NRPT_VALUE_IPSEC, L"", 0) != 0 ||
+        reg->set_string(reg->ctx, key, NRPT_VALUE_COMMENT, L"Managed by static-ip-fix", 0) != 0) {
+        return -1;
+    }
+
+    if (rule->doh_template[0] != L'\0') {
+        return reg->set_string(reg->ctx, key, NRPT_VALUE_DOH, rule->doh_template, 0);
+    }
+    return reg->delete_value(reg->ctx, key, NRPT_VALUE_DOH);
+}
+
+static void report_failure(const wchar_t *action, const NrptRule *rule)
+{
+    wchar_t errmsg[NRPT_NAMESPACE_LEN + 64];
+    StringCchPrintfW(errmsg, NRPT_NAMESPACE_LEN + 64, L"Failed to %ls NRPT rule %ls",
+                     action, rule->name_space);
+    print_error(errmsg);
+}
+
+int nrpt_sync(const RegistryBackend *reg, NrptRuleList *desired, NrptSyncResult *result)
+{
+    NrptRuleList current = {0};
+    wchar_t key[MAX_PATH_LEN];
+    int i = 0, j = 0;
+
+    ZeroMemory(result, sizeof(*result));
+
+    if (nrpt_read_rules(reg, &current) != 0) {
+        print_error(L"Failed to read NRPT rules");
+        nrpt_list_free(&current);
+        return -1;
+    }
+
+    if (desired->count > 0) {
+        qsort(desired->items, (size_t)desired->count, sizeof(NrptRule), compare_rules);
+    }
+
+    /* Merge the two sorted lists; duplicate namespaces collapse to one rule */
+    while (i < desired->count || j < current.count) {
+        int cmp;
+
+        if (i + 1 < desired->count &&
+            compare_rules(&desired->items[i], &desired->items[i + 1]) == 0) {
+            i++;
+            continue;
+        }
+
+        if (i >= desired->count) {
+            cmp = 1;
+        } else if (j >= current.count) {
+            cmp = -1;
+        } else {
+            cmp = compare_rules(&desired->items[i], &current.items[j]);
+        }
+
+        if (cmp < 0) {
+            if (write_rule(reg, &desired->items[i]) != 0) {
+                report_failure(L"add", &desired->items[i]);
+                result->failed++;
+            } else {
+                result->added++;
+            }
+            i++;
+        } else if (cmp > 0) {
+            rule_key(&current.items[j], key, MAX_PATH_LEN);
+            if (reg->delete_key(reg->ctx, key) != 0) {
+                report_failure(L"remove", &current.items[j]);
+                result->failed++;
+            } else {
+                result->removed++;
+            }
+            j++;
+        } else {
+            const NrptRule *want = &desired->items[i];
+            const NrptRule *have = &current.items[j];
+
+            if (_wcsicmp(want->servers, have->servers) != 0 ||
+                _wcsicmp(want->doh_template, have->doh_template) != 0) {
+                if (write_rule(reg, want) != 0) {
+                    report_failure(L"update", want);
+                    result->failed++;
+                } else {
+                    result->updated++;
+                }
+            } else {
+                result->unchanged++;
+            }
+            i++;
+            j++;
+        }
+    }
+
+    nrpt_list_free(&current);
+    return result->failed ? -1 : 0;
+}
@@ -0,0 +1,563 @@
+/*
+ * prefix.c - IPv6 prefix policies for address selection ([prefix_policy])
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "prefix.h"
+#include "config.h"
+#include "probe.h"
+#include "process.h"
+#include "status.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+
+/* ============================================================================
+ * PRESETS
+ * ============================================================================ */
+
+typedef struct {
+    const wchar_t *prefix;
+    int precedence;
+    int label;
+} PresetRow;
+
+/* The RFC 6724 table Windows ships with */
+static const PresetRow DEFAULT_TABLE[] = {
+    { L"::1/128",       50,  0 },
+    { L"::/0",          40,  1 },
+    { L"::ffff:0:0/96", 35,  4 },
+    { L"2002::/16",     30,  2 },
+    { L"2001::/32",      5,  5 },
+    { L"fc00::/7",       3, 13 },
+    { L"fec0::/10",      1, 11 },
+    { L"3ffe::/16",      1, 12 },
+    { L"::/96",          1,  3 },
+};
+
+#define V4_MAPPED_PREFIX        L"::ffff:0:0/96"
+#define V4_MAPPED_PREFER_V4     45      /* Above ::/0, below ::1 */
+
+int prefix_preference_parse(const wchar_t *text, PrefixPreference *out)
+{
+    if (_wcsicmp(text, L"prefer_v4") == 0) {
+        *out = PREFIX_PREFER_V4;
+    } else if (_wcsicmp(text, L"prefer_v6") == 0) {
+        *out = PREFIX_PREFER_V6;
+    } else if (_wcsicmp(text, L"custom") == 0) {
+        *out = PREFIX_CUSTOM;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const wchar_t *prefix_preference_name(PrefixPreference preference)
+{
+    switch (preference) {
+    case PREFIX_PREFER_V4: return L"prefer_v4";
+    case PREFIX_PREFER_V6: return L"prefer_v6";
+    case PREFIX_CUSTOM:    return L"custom";
+    default:               return L"none";
+    }
+}
+
+static int same_prefix(const IpAddr *a, const IpAddr *b)
+{
+    return a->prefix == b->prefix && address_compare(a, b) == 0;
+}
+
+/*
+ * Returns the row index of `prefix`, or -1
+ */
+static int find_policy(const PrefixPolicyTable *table, const IpAddr *prefix)
+{
+    for (int i = 0; i < table->count; i++) {
+        if (same_prefix(&table->items[i].prefix, prefix)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Add or replace one row
+ * Returns 0 on success, -1 if the prefix is invalid or the table is full
+ */
+static int put_policy(PrefixPolicyTable *table, const wchar_t *text, int precedence, int label)
+{
+    PrefixPolicy *policy;
+    IpAddr prefix;
+    int index;
+
+    if (address_parse(text, &prefix) != 0 || prefix.family != AF_INET6 || prefix.prefix < 0) {
+        return -1;
+    }
+    index = find_policy(table, &prefix);
+    if (index < 0) {
+        if (table->count == PREFIX_POLICY_MAX) {
+            return -1;
+        }
+        index = table->count++;
+    }
+    policy = &table->items[index];
+    StringCchCopyW(policy->text, MAX_ADDR_LEN, text);
+    policy->prefix = prefix;
+    policy->precedence = precedence;
+    policy->label = label;
+    return 0;
+}
+
+void prefix_policy_preset(PrefixPreference preference, PrefixPolicyTable *table)
+{
+    ZeroMemory(table, sizeof(*table));
+    for (size_t i = 0; i < sizeof(DEFAULT_TABLE) / sizeof(DEFAULT_TABLE[0]); i++) {
+        int precedence = DEFAULT_TABLE[i].precedence;
+
+        if (preference == PREFIX_PREFER_V4 && wcscmp(DEFAULT_TABLE[i].prefix, V4_MAPPED_PREFIX) == 0) {
+            precedence = V4_MAPPED_PREFER_V4;
+        }
+        put_policy(table, DEFAULT_TABLE[i].prefix, precedence, DEFAULT_TABLE[i].label);
+    }
+}
+
+int prefix_policy_add(PrefixPolicyTable *table, const wchar_t *line)
+{
+    wchar_t text[MAX_ADDR_LEN];
+    int precedence, label;
+    wchar_t extra;
+
+    if (swscanf(line, L"%63ls %d %d %lc", text, &precedence, &label, &extra) != 3 ||
+        precedence < 0 || label < 0) {
+        return -1;
+    }
+    return put_policy(table, text, precedence, label);
+}
+
+void prefix_policy_parse_netsh(const char *output, PrefixPolicyTable *out)
+{
+    ZeroMemory(out, sizeof(*out));
+
+    for (const char *line = output; line && *line; ) {
+        const char *end = strchr(line, '\n');
+        char row[128] = "";
+        char prefix[MAX_ADDR_LEN];
+        int precedence, label;
+        size_t len = end ? (size_t)(end - line) : strlen(line);
+
+        /* "        50      0  ::1/128"; headers and rules do not scan */
+        if (len < sizeof(row)) {
+            memcpy(row, line, len);
+            row[len] = '\0';
+            if (sscanf(row, "%d %d %63s", &precedence, &label, prefix) == 3) {
+                wchar_t text[MAX_ADDR_LEN];
+
+                StringCchPrintfW(text, MAX_ADDR_LEN, L"%hs", prefix);
+                put_policy(out, text, precedence, label);
+            }
+        }
+
+        line = end ? end + 1 : NULL;
+    }
+}
+
+PrefixPreference prefix_policy_classify(const PrefixPolicyTable *table)
+{
+    PrefixPolicyTable preset;
+    PrefixPlan plan;
+
+    prefix_policy_preset(PREFIX_PREFER_V6, &preset);
+    if (prefix_policy_diff(&preset, table, &plan) == 0) {
+        return PREFIX_PREFER_V6;
+    }
+    prefix_policy_preset(PREFIX_PREFER_V4, &preset);
+    if (prefix_policy_diff(&preset, table, &plan) == 0) {
+        return PREFIX_PREFER_V4;
+    }
+    return PREFIX_CUSTOM;
+}
+
+/* ============================================================================
+ * DIFF
+ * ============================================================================ */
+
+int prefix_policy_diff(const PrefixPolicyTable *desired, const PrefixPolicyTable *current,
+                       PrefixPlan *plan)
+{
+    ZeroMemory(plan, sizeof(*plan));
+
+    for (int i = 0; i < current->count; i++) {
+        if (find_policy(desired, &current->items[i].prefix) < 0) {
+            plan->items[plan->count].kind = PREFIX_OP_DELETE;
+            plan->items[plan->count++].policy = current->items[i];
+        }
+    }
+
+    for (int i = 0; i < desired->count; i++) {
+        const PrefixPolicy *want = &desired->items[i];
+        int have = find_policy(current, &want->prefix);
+
+        if (have < 0) {
+            plan->items[plan->count].kind = PREFIX_OP_ADD;
+        } else if (current->items[have].precedence != want->precedence ||
+                   current->items[have].label != want->label) {
+            plan->items[plan->count].kind = PREFIX_OP_SET;
+        } else {
+            continue;
+        }
+        plan->items[plan->count++].policy = *want;
+    }
+    return plan->count;
+}
+
+int prefix_policy_command(const PrefixOp *op, wchar_t *args, size_t size)
+{
+    const PrefixPolicy *p = &op->policy;
+    HRESULT hr;
+
+    if (op->kind == PREFIX_OP_DELETE) {
+        hr = StringCchPrintfW(args, size,
+            L"interface ipv6 delete prefixpolicy prefix=%ls store=persistent", p->text);
+    } else {
+        hr = StringCchPrintfW(args, size,
+            L"interface ipv6 %ls prefixpolicy prefix=%ls precedence=%d label=%d store=persistent",
+            op->kind == PREFIX_OP_ADD ? L"add" : L"set", p->text, p->precedence, p->label);
+    }
+    return SUCCEEDED(hr) ? 0 : -1;
+}
+
+/* ============================================================================
+ * APPLY AND ROLLBACK
+ * ============================================================================ */
+
+/* Table replaced by the last prefix_policy_apply */
+static PrefixPolicyTable g_prefix_previous;
+static int g_prefix_changed;
+
+int prefix_policy_read(PrefixPolicyTable *out)
+{
+    char buffer[PIPE_BUFFER_SIZE];
+
+    if (run_netsh_capture(L"interface ipv6 show prefixpolicies", buffer, sizeof(buffer)) != 0) {
+        ZeroMemory(out, sizeof(*out));
+        return -1;
+    }
+    prefix_policy_parse_netsh(buffer, out);
+    return 0;
+}
+
+int prefix_policy_desired(PrefixPolicyTable *out)
+{
+    if (g_config.prefix_preference == PREFIX_CUSTOM) {
+        *out = g_config.prefix_policies;
+        return out->count > 0 ? 0 : -1;
+    }
+    prefix_policy_preset(g_config.prefix_preference, out);
+    return 0;
+}
+
+/*
+ * Run the plan's commands; the first failure stops it
+ */
+static int run_plan(const PrefixPlan *plan, int silent)
+{
+    wchar_t args[CMD_BUFFER_SIZE];
+
+    for (int i = 0; i < plan->count; i++) {
+        if (prefix_policy_command(&plan->items[i], args, CMD_BUFFER_SIZE) != 0) {
+            return -1;
+        }
+        if (silent) {
+            run_netsh_silent(args);
+        } else if (run_netsh_retry(&g_config.retry[RETRY_ADDRESS], args) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int prefix_policy_apply(void)
+{
+    static const wchar_t *VERBS[] = { L"delete", L"set", L"add" };
+    PrefixPolicyTable desired, current;
+    PrefixPlan plan;
+    wchar_t msg[256];
+    int count;
+
+    /* Armed again only once the plan is about to run; an earlier
+       table must not be restored over one this run left alone */
+    g_prefix_changed = 0;
+
+    if (g_config.prefix_preference == PREFIX_NONE) {
+        return 0;
+    }
+
+    print_info(L"Checking IPv6 prefix policies...");
+    if (prefix_policy_desired(&desired) != 0) {
+        print_error(L"[prefix_policy] preference = custom needs at least one policy line");
+        return -1;
+    }
+    if (prefix_policy_read(&current) != 0 || current.count == 0) {
+        print_error(L"Failed to read IPv6 prefix policies");
+        return -1;
+    }
+
+    count = prefix_policy_diff(&desired, &current, &plan);
+    if (count == 0) {
+        StringCchPrintfW(msg, 256, L"IPv6 prefix policies already in place (%ls)",
+                         prefix_preference_name(g_config.prefix_preference));
+        print_success(msg);
+        return 0;
+    }
+
+    for (int i = 0; i < plan.count; i++) {
+        const PrefixPolicy *p = &plan.items[i].policy;
+
+        if (plan.items[i].kind == PREFIX_OP_DELETE) {
+            wprintf(L"  %-7ls %ls\n", VERBS[plan.items[i].kind], p->text);
+        } else {
+            wprintf(L"  %-7ls %ls precedence %d label %d\n",
+                    VERBS[plan.items[i].kind], p->text, p->precedence, p->label);
+        }
+    }
+
+    /* A failed command may follow others that went through */
+    g_prefix_previous = current;
+    g_prefix_changed = 1;
+    if (run_plan(&plan, 0) != 0) {
+        print_error(L"Failed to set IPv6 prefix policies");
+        return -1;
+    }
+
+    StringCchPrintfW(msg, 256, L"IPv6 prefix policies applied: %ls (%d changed)",
+                     prefix_preference_name(g_config.prefix_preference), count);
+    print_success(msg);
+    return 0;
+}
+
+void prefix_policy_rollback(void)
+{
+    PrefixPolicyTable current;
+    PrefixPlan plan;
+
+    if (!g_prefix_changed) {
+        return;
+    }
+    g_prefix_changed = 0;
+
+    /* Diff against what is active now: the apply may have stopped halfway */
+    if (prefix_policy_read(&current) != 0) {
+        print_error(L"Failed to read IPv6 prefix policies, not restored");
+        return;
+    }
+    if (prefix_policy_diff(&g_prefix_previous, &current, &plan) > 0) {
+        run_plan(&plan, 1);
+    }
+    print_info(L"IPv6 prefix policies restored");
+}
+
+void prefix_policy_forget(void)
+{
+    g_prefix_changed = 0;
+}
+
+/* ============================================================================
+ * PROBE
+ * ============================================================================ */
+
+static double system_connect(void *ctx, const IpAddr *server, int timeout_ms)
+{
+    SOCKADDR_STORAGE sa;
+    int salen;
+    SOCKET sock;
+    u_long nonblocking = 1;
+    fd_set writable, failed;
+    struct timeval tv;
+    LONGLONG start;
+    double elapsed = -1;
+    int error = 0, error_len = sizeof(error);
+
+    (void)ctx;
+    ZeroMemory(&sa, sizeof(sa));
+    if (server->family == AF_INET) {
+        SOCKADDR_IN *sin = (SOCKADDR_IN *)&sa;
+        sin->sin_family = AF_INET;
+        sin->sin_port = htons(DNS_PORT);
+        memcpy(&sin->sin_addr, server->bytes, 4);
+        salen = sizeof(SOCKADDR_IN);
+    } else {
+        SOCKADDR_IN6 *sin6 = (SOCKADDR_IN6 *)&sa;
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = htons(DNS_PORT);
+        memcpy(&sin6->sin6_addr, server->bytes, 16);
+        salen = sizeof(SOCKADDR_IN6);
+    }
+
+    sock = socket(server->family, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == INVALID_SOCKET) {
+        return -1;
+    }
+    if (ioctlsocket(sock, FIONBIO, &nonblocking) != 0) {
+        closesocket(sock);
+        return -1;
+    }
+
+    start = timer_now();
+    if (connect(sock, (SOCKADDR *)&sa, salen) != 0 && WSAGetLastError() != WSAEWOULDBLOCK) {
+        closesocket(sock);
+        return -1;
+    }
+
+    /* Windows reports a refused connect in the exception set */
+    FD_ZERO(&writable);
+    FD_ZERO(&failed);
+    FD_SET(sock, &writable);
+    FD_SET(sock, &failed);
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    if (select((int)sock + 1, NULL, &writable, &failed, &tv) > 0 && FD_ISSET(sock, &writable) &&
+        getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&error, &error_len) == 0 && error == 0) {
+        elapsed = timer_elapsed_ms(start);
+    }
+    closesocket(sock);
+    return elapsed;
+}
+
+void prefix_probe_backend_system(PrefixProbeBackend *backend)
+{
+    backend->ctx = NULL;
+    backend->connect = system_connect;
+}
+
+void prefix_measure(const PrefixProbeBackend *backend, const IpAddr *servers, int count,
+                    int attempts, int timeout_ms, FamilyLatency *out)
+{
+    double samples[PREFIX_MAX_SERVERS * PROBE_MAX_COUNT];
+    ProbeStats stats;
+
+    ZeroMemory(out, sizeof(*out));
+    if (count > PREFIX_MAX_SERVERS) count = PREFIX_MAX_SERVERS;
+    if (attempts > PROBE_MAX_COUNT) attempts = PROBE_MAX_COUNT;
+
+    for (int round = 0; round < attempts; round++) {
+        for (int i = 0; i < count; i++) {
+            double ms = backend->connect(backend->ctx, &servers[i], timeout_ms);
+
+            out->attempts++;
+            if (ms >= 0) {
+                samples[out->connected++] = ms;
+            }
+        }
+    }
+
+    if (out->connected > 0) {
+        probe_compute_stats(samples, out->connected, &stats);
+        out->median_ms = stats.median_ms;
+    }
+}
+
+int prefix_recommend(const FamilyLatency *v4, const FamilyLatency *v6, PrefixPreference *out)
+{
+    double v4_loss, v6_loss;
+
+    if (v4->attempts == 0 || v6->attempts == 0 || (v4->connected == 0 && v6->connected == 0)) {
+        return -1;
+    }
+
+    v4_loss = 1.0 - (double)v4->connected / v4->attempts;
+    v6_loss = 1.0 - (double)v6->connected / v6->attempts;
+    if (v6_loss > v4_loss) {
+        *out = PREFIX_PREFER_V4;
+    } else if (v4_loss > v6_loss) {
+        *out = PREFIX_PREFER_V6;
+    } else {
+        *out = v6->median_ms > v4->median_ms + PREFIX_V6_SLOWER_MS
+            ? PREFIX_PREFER_V4 : PREFIX_PREFER_V6;
+    }
+    return 0;
+}
+
+static void print_family(const wchar_t *label, int servers, const FamilyLatency *latency)
+{
+    if (servers == 0) {
+        wprintf(L"  %-6ls no DNS server configured\n", label);
+    } else if (latency->connected == 0) {
+        wprintf(L"  %-6ls %d server(s), no connect succeeded (%d tried)\n",
+                label, servers, latency->attempts);
+    } else {
+        wprintf(L"  %-6ls %d server(s), %d/%d connected, median %.1f ms\n",
+                label, servers, latency->connected, latency->attempts, latency->median_ms);
+    }
+}
+
+int prefix_probe_run(void)
+{
+    DnsServerInfo ipv4[STATUS_MAX_SERVERS], ipv6[STATUS_MAX_SERVERS];
+    IpAddr v4_servers[PREFIX_MAX_SERVERS], v6_servers[PREFIX_MAX_SERVERS];
+    int ipv4_count = 0, ipv6_count = 0, v4_count = 0, v6_count = 0;
+    FamilyLatency v4, v6;
+    PrefixPolicyTable active;
+    PrefixPreference recommended;
+    PrefixProbeBackend backend;
+    WSADATA wsa;
+    wchar_t msg[256];
+
+    wprintf(L"\n");
+    wprintf(L"========================================\n");
+    wprintf(L"  Comparing IPv4 and IPv6 connect latency\n");
+    wprintf(L"  Interface: %ls\n", g_config.interface_name);
+    wprintf(L"========================================\n\n");
+
+    if (status_get_configured_dns(ipv4, &ipv4_count, ipv6, &ipv6_count) != 0) {
+        print_error(L"Failed to read the interface's DNS servers");
+        return 1;
+    }
+    for (int i = 0; i < ipv4_count && v4_count < PREFIX_MAX_SERVERS; i++) {
+        if (address_parse(ipv4[i].address, &v4_servers[v4_count]) == 0) {
+            v4_count++;
+        }
+    }
+    for (int i = 0; i < ipv6_count && v6_count < PREFIX_MAX_SERVERS; i++) {
+        if (address_parse(ipv6[i].address, &v6_servers[v6_count]) == 0) {
+            v6_count++;
+        }
+    }
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        print_error(L"Failed to initialize Winsock");
+        return 1;
+    }
+    StringCchPrintfW(msg, 256, L"Connecting %d time(s) to TCP port 53 of each DNS server...",
+                     g_config.probe.count);
+    print_info(msg);
+
+    prefix_probe_backend_system(&backend);
+    prefix_measure(&backend, v4_servers, v4_count, g_config.probe.count,
+                   g_config.probe.timeout_ms, &v4);
+    prefix_measure(&backend, v6_servers, v6_count, g_config.probe.count,
+                   g_config.probe.timeout_ms, &v6);
+    WSACleanup();
+
+    print_family(L"IPv4", v4_count, &v4);
+    print_family(L"IPv6", v6_count, &v6);
+    wprintf(L"\n");
+
+    if (prefix_policy_read(&active) == 0 && active.count > 0) {
+        StringCchPrintfW(msg, 256, L"Active prefix policies: %ls",
+                         prefix_preference_name(prefix_policy_classify(&active)));
+        print_info(msg);
+    }
+
+    if (prefix_recommend(&v4, &v6, &recommended) != 0) {
+        print_error(L"Nothing to compare: both families need a DNS server, and one must answer");
+        return 1;
+    }
+    StringCchPrintfW(msg, 256, L"Recommended: [prefix_policy] preference = %ls",
+                     prefix_preference_name(recommended));
+    print_success(msg);
+    return 0;
+}
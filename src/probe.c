@@ -0,0 +1,300 @@
+/*
+ * probe.c - Resolver latency probing over plain UDP DNS
+ */
+
+#include "probe.h"
+#include <string.h>
+
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+
+#define DNS_HEADER_LEN      12
+#define DNS_QUERY_MAX       (DNS_HEADER_LEN + PROBE_NAME_LEN + 4)
+#define DNS_RESPONSE_MAX    1232
+
+/* ============================================================================
+ * QUERY ENCODING
+ * ============================================================================ */
+
+void probe_options_init(ProbeOptions *opts)
+{
+    ZeroMemory(opts, sizeof(*opts));
+    opts->count = PROBE_DEFAULT_COUNT;
+    opts->timeout_ms = PROBE_DEFAULT_TIMEOUT_MS;
+    StringCchCopyA(opts->names[0], PROBE_NAME_LEN, "example.com");
+    opts->name_count = 1;
+}
+
+int probe_build_query(const char *name, unsigned short id, unsigned char *buf, size_t size)
+{
+    size_t pos = DNS_HEADER_LEN;
+    const char *label = name;
+
+    if (!name || *name == '\0' || size < DNS_HEADER_LEN) {
+        return -1;
+    }
+
+    ZeroMemory(buf, DNS_HEADER_LEN);
+    buf[0] = (unsigned char)(id >> 8);
+    buf[1] = (unsigned char)(id & 0xFF);
+    buf[2] = 0x01;      /* RD: recursion desired */
+    buf[5] = 0x01;      /* QDCOUNT = 1 */
+
+    /* QNAME: length-prefixed labels, a trailing dot is optional */
+    while (*label) {
+        const char *dot = strchr(label, '.');
+        size_t len = dot ? (size_t)(dot - label) : strlen(label);
+
+        if (len == 0 || len > 63 || pos + 1 + len >= size) {
+            return -1;
+        }
+        buf[pos++] = (unsigned char)len;
+        memcpy(buf + pos, label, len);
+        pos += len;
+
+        if (!dot) break;
+        label = dot + 1;
+    }
+
+    if (pos + 5 > size) {
+        return -1;
+    }
+    buf[pos++] = 0x00;
+    buf[pos++] = 0x00; buf[pos++] = 0x01;   /* QTYPE = A */
+    buf[pos++] = 0x00; buf[pos++] = 0x01;   /* QCLASS = IN */
+
+    return (int)pos;
+}
+
+/* ============================================================================
+ * STATISTICS
+ * ============================================================================ */
+
+static int compare_samples(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void probe_compute_stats(double *samples, int n, ProbeStats *out)
+{
+    out->median_ms = 0.0;
+    out->p95_ms = 0.0;
+    if (n <= 0) {
+        return;
+    }
+
+    qsort(samples, (size_t)n, sizeof(double), compare_samples);
+
+    if (n % 2) {
+        out->median_ms = samples[n / 2];
+    } else {
+        out->median_ms = (samples[n / 2 - 1] + samples[n / 2]) / 2.0;
+    }
+
+    /* Nearest rank: ceil(0.95 * n) */
+    out->p95_ms = samples[(95 * n + 99) / 100 - 1];
+}
+
+int probe_pick_best(const ProbeStats *stats, int count)
+{
+    int best = -1;
+
+    for (int i = 0; i < count; i++) {
+        if (stats[i].answered == 0 || stats[i].answered * 2 < stats[i].sent) {
+            continue;
+        }
+        if (best < 0 ||
+            stats[i].median_ms < stats[best].median_ms ||
+            (stats[i].median_ms == stats[best].median_ms &&
+             stats[i].p95_ms < stats[best].p95_ms)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/* ============================================================================
+ * PROBE ENGINE
+ * ============================================================================ */
+
+typedef struct {
+    SOCKET sock;
+    unsigned short id;      /* Transaction ID of the outstanding query */
+    int pending;
+    LONGLONG sent_at;
+    double *samples;
+} ProbeSlot;
+
+/*
+ * The socket is connected so that only the target's answers are received
+ */
+SOCKET probe_open_socket(const ProbeTarget *target)
+{
+    SOCKADDR_STORAGE sa;
+    int salen;
+    IpAddr addr;
+    SOCKET sock;
+    unsigned short port = htons(target->port ? target->port : DNS_PORT);
+    u_long nonblocking = 1;
+
+    if (address_parse(target->server, &addr) != 0) {
+        return INVALID_SOCKET;
+    }
+
+    ZeroMemory(&sa, sizeof(sa));
+    if (addr.family == AF_INET) {
+        SOCKADDR_IN *sin = (SOCKADDR_IN *)&sa;
+        sin->sin_family = AF_INET;
+        sin->sin_port = port;
+        memcpy(&sin->sin_addr, addr.bytes, 4);
+        salen = sizeof(SOCKADDR_IN);
+    } else {
+        SOCKADDR_IN6 *sin6 = (SOCKADDR_IN6 *)&sa;
+        sin6->sin6_family = AF_INET6;
+        sin6->sin6_port = port;
+        memcpy(&sin6->sin6_addr, addr.bytes, 16);
+        salen = sizeof(SOCKADDR_IN6);
+    }
+
+    sock = socket(addr.family, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+
+    if (connect(sock, (SOCKADDR *)&sa, salen) != 0 ||
+        ioctlsocket(sock, FIONBIO, &nonblocking) != 0) {
+        closesocket(sock);
+        return INVALID_SOCKET;
+    }
+    return sock;
+}
+
+/*
+ * Read every queued datagram on a slot; a matching answer completes it
+ */
+static void drain_slot(ProbeSlot *slot, ProbeStats *stats)
+{
+    unsigned char buf[DNS_RESPONSE_MAX];
+    int len;
+
+    while ((len = recv(slot->sock, (char *)buf, sizeof(buf), 0)) > 0) {
+        unsigned short id = (unsigned short)((buf[0] << 8) | buf[1]);
+
+        /* Late answers from earlier rounds carry an older ID */
+        if (len < DNS_HEADER_LEN || !(buf[2] & 0x80) || !slot->pending || id != slot->id) {
+            continue;
+        }
+
+        slot->samples[stats->answered++] = timer_elapsed_ms(slot->sent_at);
+        slot->pending = 0;
+    }
+}
+
+int probe_run(const ProbeTarget *targets, int count, const ProbeOptions *opts,
+              ProbeStats *stats)
+{
+    WSADATA wsa;
+    ProbeSlot *slots;
+    unsigned short base_id;
+    int ret = 0;
+
+    if (count <= 0 || count > PROBE_MAX_TARGETS || opts->count <= 0 ||
+        opts->count > PROBE_MAX_COUNT || opts->name_count <= 0) {
+        return -1;
+    }
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        return -1;
+    }
+
+    slots = (ProbeSlot *)calloc((size_t)count, sizeof(ProbeSlot));
+    if (!slots) {
+        WSACleanup();
+        return -1;
+    }
+
+    ZeroMemory(stats, (size_t)count * sizeof(ProbeStats));
+    for (int t = 0; t < count; t++) {
+        /* A target that cannot be reached just never answers */
+        slots[t].sock = probe_open_socket(&targets[t]);
+        slots[t].samples = (double *)calloc((size_t)opts->count, sizeof(double));
+        if (!slots[t].samples) {
+            ret = -1;
+        }
+    }
+
+    base_id = (unsigned short)(GetTickCount64() * 2654435761u >> 16);
+
+    for (int round = 0; ret == 0 && round < opts->count; round++) {
+        unsigned char query[DNS_QUERY_MAX];
+        unsigned short id = (unsigned short)(base_id + round);
+        const char *name = opts->names[round % opts->name_count];
+        int qlen = probe_build_query(name, id, query, sizeof(query));
+        LONGLONG round_start;
+
+        if (qlen < 0) {
+            ret = -1;
+            break;
+        }
+
+        /* Fire the query at every target back to back */
+        for (int t = 0; t < count; t++) {
+            slots[t].id = id;
+            slots[t].sent_at = timer_now();
+            slots[t].pending = slots[t].sock != INVALID_SOCKET &&
+                send(slots[t].sock, (const char *)query, qlen, 0) == qlen;
+            stats[t].sent++;
+        }
+
+        round_start = timer_now();
+        for (;;) {
+            fd_set readable;
+            struct timeval tv;
+            SOCKET max_sock = 0;
+            int waiting = 0, ready;
+            double left = opts->timeout_ms - timer_elapsed_ms(round_start);
+
+            FD_ZERO(&readable);
+            for (int t = 0; t < count; t++) {
+                if (slots[t].pending) {
+                    FD_SET(slots[t].sock, &readable);
+                    if (slots[t].sock > max_sock) max_sock = slots[t].sock;
+                    waiting++;
+                }
+            }
+            if (waiting == 0 || left <= 0) {
+                break;
+            }
+
+            tv.tv_sec = (long)(left / 1000);
+            tv.tv_usec = (long)((left - tv.tv_sec * 1000.0) * 1000);
+            ready = select((int)max_sock + 1, &readable, NULL, NULL, &tv);
+            if (ready < 0) {
+                break;
+            }
+            if (ready == 0) {
+                continue;
+            }
+
+            for (int t = 0; t < count; t++) {
+                if (slots[t].pending && FD_ISSET(slots[t].sock, &readable)) {
+                    drain_slot(&slots[t], &stats[t]);
+                }
+            }
+        }
+    }
+
+    for (int t = 0; t < count; t++) {
+        probe_compute_stats(slots[t].samples, stats[t].answered, &stats[t]);
+        if (slots[t].sock != INVALID_SOCKET) {
+            closesocket(slots[t].sock);
+        }
+        free(slots[t].samples);
+    }
+
+    free(slots);
+    WSACleanup();
+    return ret;
+}
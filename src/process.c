@@ -4,6 +4,45 @@
 
 #include "process.h"
 
+/* ============================================================================
+ * COMMAND EXECUTOR
+ * ============================================================================ */
+
+static int system_run(void *ctx, wchar_t *cmdline, int silent)
+{
+    (void)ctx;
+    return run_process(cmdline, silent);
+}
+
+static int system_capture(void *ctx, wchar_t *cmdline, char *buffer, size_t buffer_size)
+{
+    (void)ctx;
+    return run_process_capture(cmdline, buffer, buffer_size);
+}
+
+static void system_sleep(void *ctx, DWORD ms)
+{
+    (void)ctx;
+    Sleep(ms);
+}
+
+static CommandExecutor g_executor = { NULL, system_run, system_capture, system_sleep };
+
+void process_set_executor(const CommandExecutor *executor)
+{
+    if (executor) {
+        g_executor = *executor;
+        if (!g_executor.sleep) {
+            g_executor.sleep = system_sleep;
+        }
+    } else {
+        g_executor.ctx = NULL;
+        g_executor.run = system_run;
+        g_executor.capture = system_capture;
+        g_executor.sleep = system_sleep;
+    }
+}
+
 /* ============================================================================
  * PROCESS EXECUTION
  * ============================================================================ */
@@ -113,7 +152,7 @@ int run_netsh(const wchar_t *args)
         return -1;
     }
 
-    return run_process(cmdline, 0);
+    return g_executor.run(g_executor.ctx, cmdline, 0);
 }
 
 void run_netsh_silent(const wchar_t *args)
@@ -121,7 +160,56 @@ void run_netsh_silent(const wchar_t *args)
     wchar_t cmdline[CMD_BUFFER_SIZE];
 
     if (SUCCEEDED(StringCchPrintfW(cmdline, CMD_BUFFER_SIZE, L"netsh.exe %ls", args))) {
-        run_process(cmdline, 1);
+        g_executor.run(g_executor.ctx, cmdline, 1);
+    }
+}
+
+/*
+ * First non-empty line of netsh output, for log messages
+ */
+static void first_line(const char *output, wchar_t *line, size_t size)
+{
+    char buf[256];
+    size_t len = 0;
+
+    while (*output == '\r' || *output == '\n' || *output == ' ') output++;
+    while (output[len] && output[len] != '\r' && output[len] != '\n' && len < sizeof(buf) - 1) {
+        buf[len] = output[len];
+        len++;
+    }
+    buf[len] = '\0';
+    if (MultiByteToWideChar(CP_OEMCP, 0, buf, -1, line, (int)size) == 0) {
+        line[0] = L'\0';
+    }
+}
+
+int run_netsh_retry(const RetryPolicy *policy, const wchar_t *args)
+{
+    char output[RETRY_OUTPUT_SIZE];
+    wchar_t reason[256];
+    wchar_t msg[512];
+
+    for (int attempt = 1; ; attempt++) {
+        int ret = run_netsh_capture(args, output, sizeof(output));
+        if (ret == 0) {
+            return 0;
+        }
+
+        first_line(output, reason, 256);
+        if (attempt >= policy->attempts || !retry_is_retryable(policy, ret, output)) {
+            if (reason[0] != L'\0') {
+                StringCchPrintfW(msg, 512, L"netsh: %ls", reason);
+                print_error(msg);
+            }
+            return ret;
+        }
+
+        DWORD delay = (DWORD)retry_delay_ms(policy, attempt);
+        StringCchPrintfW(msg, 512, L"netsh failed (%ls), retrying in %lu ms (attempt %d of %d)",
+                         reason[0] ? reason : L"no output", (unsigned long)delay,
+                         attempt + 1, policy->attempts);
+        print_info(msg);
+        g_executor.sleep(g_executor.ctx, delay);
     }
 }
 
@@ -134,5 +222,9 @@ int run_netsh_capture(const wchar_t *args, char *buffer, size_t buffer_size)
         return -1;
     }
 
-    return run_process_capture(cmdline, buffer, buffer_size);
+    if (!buffer || buffer_size == 0) {
+        return -1;
+    }
+    buffer[0] = '\0';
+    return g_executor.capture(g_executor.ctx, cmdline, buffer, buffer_size);
 }
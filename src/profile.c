@@ -0,0 +1,393 @@
+/*
+ * profile.c - Site profiles selected by network fingerprint
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include "profile.h"
+#include "config.h"
+#include "dns.h"
+#include "network.h"
+
+/* ============================================================================
+ * PARSING
+ * ============================================================================ */
+
+static int hex_value(wchar_t c)
+{
+    if (c >= L'0' && c <= L'9') return c - L'0';
+    if (c >= L'a' && c <= L'f') return c - L'a' + 10;
+    if (c >= L'A' && c <= L'F') return c - L'A' + 10;
+    return -1;
+}
+
+int profile_parse_mac(const wchar_t *text, BYTE mac[6])
+{
+    for (int i = 0; i < 6; i++) {
+        int hi = hex_value(text[0]);
+        int lo = hi < 0 ? -1 : hex_value(text[1]);
+
+        if (lo < 0) {
+            return -1;
+        }
+        mac[i] = (BYTE)(hi << 4 | lo);
+        text += 2;
+
+        if (i < 5) {
+            if (*text != L':' && *text != L'-') {
+                return -1;
+            }
+            text++;
+        }
+    }
+    return *text == L'\0' ? 0 : -1;
+}
+
+static int copy_address(wchar_t *dest, const wchar_t *value, int family)
+{
+    IpAddr addr;
+
+    if (address_parse(value, &addr) != 0 || addr.family != family || addr.prefix >= 0) {
+        return -1;
+    }
+    StringCchCopyW(dest, MAX_ADDR_LEN, value);
+    return 0;
+}
+
+int profile_set(Profile *profile, const wchar_t *key, const wchar_t *value)
+{
+    if (_wcsicmp(key, L"match_gateway") == 0) {
+        return address_parse(value, &profile->gateway) == 0 && profile->gateway.prefix < 0 ? 0 : -1;
+    }
+    if (_wcsicmp(key, L"match_gateway_mac") == 0) {
+        profile->has_gateway_mac = profile_parse_mac(value, profile->gateway_mac) == 0;
+        return profile->has_gateway_mac ? 0 : -1;
+    }
+    if (_wcsicmp(key, L"match_subnet") == 0) {
+        return address_parse(value, &profile->subnet) == 0 && profile->subnet.prefix >= 0 ? 0 : -1;
+    }
+    if (_wcsicmp(key, L"match_suffix") == 0) {
+        StringCchCopyW(profile->dns_suffix, PROFILE_SUFFIX_LEN, value);
+        return 0;
+    }
+
+    if (_wcsicmp(key, L"ipv4_address") == 0) {
+        return copy_address(profile->ipv4_address, value, AF_INET);
+    }
+    if (_wcsicmp(key, L"ipv4_mask") == 0 || _wcsicmp(key, L"ipv4_netmask") == 0) {
+        if (address_mask_to_prefix(value) < 0) {
+            return -1;
+        }
+        StringCchCopyW(profile->ipv4_mask, MAX_ADDR_LEN, value);
+        return 0;
+    }
+    if (_wcsicmp(key, L"ipv4_gateway") == 0) {
+        return copy_address(profile->ipv4_gateway, value, AF_INET);
+    }
+    if (_wcsicmp(key, L"ipv6_address") == 0) {
+        return copy_address(profile->ipv6_address, value, AF_INET6);
+    }
+    if (_wcsicmp(key, L"ipv6_prefix") == 0) {
+        int prefix = _wtoi(value);
+        if (prefix < 1 || prefix > 128) {
+            return -1;
+        }
+        StringCchCopyW(profile->ipv6_prefix, 16, value);
+        return 0;
+    }
+    if (_wcsicmp(key, L"ipv6_gateway") == 0) {
+        return copy_address(profile->ipv6_gateway, value, AF_INET6);
+    }
+    if (_wcsicmp(key, L"provider") == 0) {
+        StringCchCopyW(profile->provider, PROFILE_NAME_LEN, value);
+        return 0;
+    }
+    if (_wcsicmp(key, L"dns_only") == 0) {
+        profile->dns_only = (_wcsicmp(value, L"yes") == 0 || _wcsicmp(value, L"true") == 0 || _wcsicmp(value, L"1") == 0);
+        return 0;
+    }
+
+    return -1;
+}
+
+/* ============================================================================
+ * MATCHING
+ * ============================================================================ */
+
+int profile_score(const Profile *profile, const NetworkFingerprint *fp)
+{
+    int score = 0;
+
+    if (profile->gateway.family != 0 || profile->has_gateway_mac) {
+        int found = 0;
+        for (int i = 0; i < fp->gateway_count && !found; i++) {
+            found = (profile->gateway.family == 0 ||
+                     address_compare(&fp->gateways[i], &profile->gateway) == 0) &&
+                    (!profile->has_gateway_mac ||
+                     (fp->gateway_has_mac[i] &&
+                      memcmp(fp->gateway_macs[i], profile->gateway_mac, 6) == 0));
+        }
+        if (!found) {
+            return -1;
+        }
+        score += (profile->gateway.family != 0) + profile->has_gateway_mac;
+    }
+
+    if (profile->subnet.family != 0) {
+        int found = 0;
+        for (int i = 0; i < fp->address_count && !found; i++) {
+            found = address_in_prefix(&fp->addresses[i], &profile->subnet);
+        }
+        if (!found) {
+            return -1;
+        }
+        score++;
+    }
+
+    if (profile->dns_suffix[0] != L'\0') {
+        if (_wcsicmp(fp->dns_suffix, profile->dns_suffix) != 0) {
+            return -1;
+        }
+        score++;
+    }
+
+    return score;
+}
+
+int profile_select(const Profile *profiles, int count, const NetworkFingerprint *fp)
+{
+    int best = -1, best_score = -1;
+
+    for (int i = 0; i < count; i++) {
+        int score = profile_score(&profiles[i], fp);
+        if (score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+/* ============================================================================
+ * FINGERPRINT
+ * ============================================================================ */
+
+/*
+ * Fill in gateway MACs from one read of the neighbor cache (no ARP/ND
+ * traffic; a gateway that was never contacted has no MAC)
+ */
+static void fingerprint_gateway_macs(NetworkFingerprint *fp, const NET_LUID *luid)
+{
+    PMIB_IPNET_TABLE2 table = NULL;
+
+    if (fp->gateway_count == 0 || GetIpNetTable2(AF_UNSPEC, &table) != NO_ERROR) {
+        return;
+    }
+
+    for (ULONG i = 0; i < table->NumEntries; i++) {
+        MIB_IPNET_ROW2 *row = &table->Table[i];
+        IpAddr addr;
+
+        if (row->InterfaceLuid.Value != luid->Value || row->PhysicalAddressLength != 6 ||
+            address_from_sockaddr((const SOCKADDR *)&row->Address, &addr) != 0) {
+            continue;
+        }
+        for (int g = 0; g < fp->gateway_count; g++) {
+            if (address_compare(&fp->gateways[g], &addr) == 0) {
+                memcpy(fp->gateway_macs[g], row->PhysicalAddress, 6);
+                fp->gateway_has_mac[g] = 1;
+            }
+        }
+    }
+    FreeMibTable(table);
+}
+
+int profile_fingerprint(NetworkFingerprint *fp)
+{
+    PIP_ADAPTER_ADDRESSES pAddresses;
+    PIP_ADAPTER_ADDRESSES pCurrAddr;
+    NET_LUID luid;
+
+    ZeroMemory(fp, sizeof(*fp));
+    if (ConvertInterfaceAliasToLuid(g_config.interface_name, &luid) != NO_ERROR) {
+        return -1;
+    }
+
+    pAddresses = network_get_adapters(GAA_FLAG_INCLUDE_GATEWAYS | GAA_FLAG_SKIP_ANYCAST |
+                                      GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER);
+    if (!pAddresses) {
+        return -1;
+    }
+
+    for (pCurrAddr = pAddresses; pCurrAddr; pCurrAddr = pCurrAddr->Next) {
+        PIP_ADAPTER_UNICAST_ADDRESS pUnicast;
+        PIP_ADAPTER_GATEWAY_ADDRESS_LH pGateway;
+
+        if (pCurrAddr->Luid.Value != luid.Value) {
+            continue;
+        }
+
+        for (pUnicast = pCurrAddr->FirstUnicastAddress;
+             pUnicast && fp->address_count < FINGERPRINT_MAX_ENTRIES;
+             pUnicast = pUnicast->Next) {
+            IpAddr *addr = &fp->addresses[fp->address_count];
+            if (address_from_sockaddr(pUnicast->Address.lpSockaddr, addr) == 0) {
+                addr->prefix = pUnicast->OnLinkPrefixLength;
+                fp->address_count++;
+            }
+        }
+
+        for (pGateway = pCurrAddr->FirstGatewayAddress;
+             pGateway && fp->gateway_count < FINGERPRINT_MAX_ENTRIES;
+             pGateway = pGateway->Next) {
+            if (address_from_sockaddr(pGateway->Address.lpSockaddr,
+                                      &fp->gateways[fp->gateway_count]) == 0) {
+                fp->gateway_count++;
+            }
+        }
+
+        if (pCurrAddr->DnsSuffix) {
+            StringCchCopyW(fp->dns_suffix, PROFILE_SUFFIX_LEN, pCurrAddr->DnsSuffix);
+        }
+        break;
+    }
+
+    free(pAddresses);
+    fingerprint_gateway_macs(fp, &luid);
+    return 0;
+}
+
+static void print_fingerprint(const NetworkFingerprint *fp)
+{
+    wchar_t text[MAX_ADDR_LEN + 8];
+
+    for (int i = 0; i < fp->gateway_count; i++) {
+        address_format(&fp->gateways[i], text, MAX_ADDR_LEN + 8);
+        if (fp->gateway_has_mac[i]) {
+            const BYTE *mac = fp->gateway_macs[i];
+            wprintf(L"  Gateway:    %ls (%02x:%02x:%02x:%02x:%02x:%02x)\n", text,
+                    mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        } else {
+            wprintf(L"  Gateway:    %ls\n", text);
+        }
+    }
+    for (int i = 0; i < fp->address_count; i++) {
+        address_format(&fp->addresses[i], text, MAX_ADDR_LEN + 8);
+        wprintf(L"  Address:    %ls\n", text);
+    }
+    if (fp->dns_suffix[0] != L'\0') {
+        wprintf(L"  DNS suffix: %ls\n", fp->dns_suffix);
+    }
+    wprintf(L"\n");
+}
+
+/* ============================================================================
+ * PROFILE MODE
+ * ============================================================================ */
+
+/*
+ * Overlay the profile's settings on the base configuration
+ */
+static void load_profile(const Profile *profile)
+{
+    if (profile->ipv4_address[0] != L'\0') {
+        StringCchCopyW(g_config.ipv4_address, MAX_ADDR_LEN, profile->ipv4_address);
+        StringCchCopyW(g_config.ipv4_mask, MAX_ADDR_LEN, profile->ipv4_mask);
+        StringCchCopyW(g_config.ipv4_gateway, MAX_ADDR_LEN, profile->ipv4_gateway);
+        g_config.has_ipv4 = 1;
+    }
+    if (profile->ipv6_address[0] != L'\0') {
+        StringCchCopyW(g_config.ipv6_address, MAX_ADDR_LEN, profile->ipv6_address);
+        StringCchCopyW(g_config.ipv6_prefix, 16, profile->ipv6_prefix);
+        StringCchCopyW(g_config.ipv6_gateway, MAX_ADDR_LEN, profile->ipv6_gateway);
+        g_config.has_ipv6 = 1;
+    }
+    if (profile->dns_only) {
+        g_config.dns_only = 1;
+    }
+    config_set_defaults();
+}
+
+int profile_run(void)
+{
+    NetworkFingerprint fp;
+    DnsProvider provider;
+    const Profile *profile = NULL;
+    const wchar_t *provider_name;
+    LONGLONG start = timer_now();
+    wchar_t msg[256];
+
+    if (g_config.profile_count == 0) {
+        print_error(L"Profile mode requires at least one [profile.NAME] section.");
+        return 1;
+    }
+
+    if (profile_fingerprint(&fp) != 0) {
+        print_error(L"Failed to read the interface configuration");
+        return 1;
+    }
+
+    wprintf(L"\nNetwork fingerprint of %ls:\n", g_config.interface_name);
+    print_fingerprint(&fp);
+
+    if (g_config.profile_name[0] != L'\0') {
+        for (int i = 0; i < g_config.profile_count && !profile; i++) {
+            if (_wcsicmp(g_config.profiles[i].name, g_config.profile_name) == 0) {
+                profile = &g_config.profiles[i];
+            }
+        }
+        if (!profile) {
+            StringCchPrintfW(msg, 256, L"Unknown profile: %ls", g_config.profile_name);
+            print_error(msg);
+            return 1;
+        }
+    } else {
+        int index = profile_select(g_config.profiles, g_config.profile_count, &fp);
+        if (index < 0) {
+            print_error(L"No profile matches this network");
+            return 1;
+        }
+        profile = &g_config.profiles[index];
+    }
+
+    StringCchPrintfW(msg, 256, L"Selected profile: %ls (%.1f ms)",
+                     profile->name, timer_elapsed_ms(start));
+    print_success(msg);
+
+    /* --provider fills in for profiles that do not name one */
+    provider_name = profile->provider[0] != L'\0' ? profile->provider : g_config.provider_name;
+    if (provider_name[0] == L'\0') {
+        StringCchPrintfW(msg, 256, L"[profile.%ls] has no provider; set provider or use --provider",
+                         profile->name);
+        print_error(msg);
+        return 1;
+    }
+    if (dns_find_provider(provider_name, &provider) != 0) {
+        StringCchPrintfW(msg, 256, L"Unknown provider: %ls", provider_name);
+        print_error(msg);
+        return 1;
+    }
+
+    load_profile(profile);
+
+    wprintf(L"\n");
+    wprintf(L"========================================\n");
+    wprintf(L"  Profile %ls: %ls%ls DNS + DoH\n", profile->name,
+            g_config.dns_only ? L"" : L"Static IP + ", provider.name);
+    wprintf(L"  Interface: %ls\n", g_config.interface_name);
+    wprintf(L"========================================\n\n");
+
+    /* The provider modes' pipeline, with the profile overlaid; DNS
+       servers and DoH templates already in place are left alone, so
+       returning to a known site is cheap */
+    if (dns_apply(&provider, 1) != 0) {
+        return 1;
+    }
+
+    wprintf(L"\n");
+    StringCchPrintfW(msg, 256, L"Profile applied in %.0f ms", timer_elapsed_ms(start));
+    print_success(msg);
+    wprintf(L"\n");
+    return 0;
+}
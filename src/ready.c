@@ -0,0 +1,265 @@
+/*
+ * ready.c - Wait for applied static addresses to become usable (--wait-ready)
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include "ready.h"
+#include "config.h"
+#include "network.h"
+
+/* ============================================================================
+ * SYSTEM EVENT SOURCE
+ * ============================================================================ */
+
+typedef struct {
+    NET_LUID luid;
+    HANDLE event;
+    HANDLE address_handle;
+    HANDLE route_handle;
+} ReadySource;
+
+static ReadySource g_ready_source;
+
+/*
+ * DAD progress shows up as address changes, the default route as a route
+ * change; other interfaces and the initial notification are ignored
+ */
+static void NTAPI on_address_change(PVOID ctx, PMIB_UNICASTIPADDRESS_ROW row,
+                                    MIB_NOTIFICATION_TYPE type)
+{
+    ReadySource *src = (ReadySource *)ctx;
+
+    if (row && type != MibInitialNotification && row->InterfaceLuid.Value == src->luid.Value) {
+        SetEvent(src->event);
+    }
+}
+
+static void NTAPI on_route_change(PVOID ctx, PMIB_IPFORWARD_ROW2 row,
+                                  MIB_NOTIFICATION_TYPE type)
+{
+    ReadySource *src = (ReadySource *)ctx;
+
+    if (row && type != MibInitialNotification && row->InterfaceLuid.Value == src->luid.Value) {
+        SetEvent(src->event);
+    }
+}
+
+static void source_stop(void *ctx)
+{
+    ReadySource *src = (ReadySource *)ctx;
+
+    if (src->address_handle) {
+        CancelMibChangeNotify2(src->address_handle);
+        src->address_handle = NULL;
+    }
+    if (src->route_handle) {
+        CancelMibChangeNotify2(src->route_handle);
+        src->route_handle = NULL;
+    }
+}
+
+static int source_start(void *ctx, HANDLE event)
+{
+    ReadySource *src = (ReadySource *)ctx;
+
+    src->event = event;
+    if (NotifyUnicastIpAddressChange(AF_UNSPEC, on_address_change, src, FALSE,
+                                     &src->address_handle) != NO_ERROR ||
+        NotifyRouteChange2(AF_UNSPEC, on_route_change, src, FALSE,
+                           &src->route_handle) != NO_ERROR) {
+        source_stop(src);
+        return -1;
+    }
+    return 0;
+}
+
+void ready_source_system(WatchSource *source, const NET_LUID *luid)
+{
+    ZeroMemory(&g_ready_source, sizeof(g_ready_source));
+    g_ready_source.luid = *luid;
+
+    source->ctx = &g_ready_source;
+    source->start = source_start;
+    source->stop = source_stop;
+}
+
+/* ============================================================================
+ * SYSTEM PROBE
+ * ============================================================================ */
+
+static NET_LUID g_probe_luid;
+
+static int probe_query(void *ctx, const ReadyTarget *target, ReadyState *state)
+{
+    const NET_LUID *luid = (const NET_LUID *)ctx;
+    MIB_UNICASTIPADDRESS_ROW row;
+    PMIB_IPFORWARD_TABLE2 table = NULL;
+
+    ZeroMemory(state, sizeof(*state));
+
+    InitializeUnicastIpAddressEntry(&row);
+    row.InterfaceLuid = *luid;
+    row.Address.si_family = (ADDRESS_FAMILY)target->address.family;
+    if (target->address.family == AF_INET) {
+        memcpy(&row.Address.Ipv4.sin_addr, target->address.bytes, 4);
+    } else {
+        memcpy(&row.Address.Ipv6.sin6_addr, target->address.bytes, 16);
+    }
+
+    /* Not found yet is not an error: the address may still be on its way */
+    if (GetUnicastIpAddressEntry(&row) == NO_ERROR) {
+        state->preferred = row.DadState == IpDadStatePreferred;
+        state->duplicate = row.DadState == IpDadStateDuplicate;
+    }
+
+    if (!target->need_route) {
+        return 0;
+    }
+    if (GetIpForwardTable2((ADDRESS_FAMILY)target->address.family, &table) != NO_ERROR) {
+        return -1;
+    }
+    for (ULONG i = 0; i < table->NumEntries && !state->default_route; i++) {
+        state->default_route = table->Table[i].InterfaceLuid.Value == luid->Value &&
+                               table->Table[i].DestinationPrefix.PrefixLength == 0;
+    }
+    FreeMibTable(table);
+    return 0;
+}
+
+void ready_probe_system(ReadyProbe *probe, const NET_LUID *luid)
+{
+    g_probe_luid = *luid;
+    probe->ctx = &g_probe_luid;
+    probe->query = probe_query;
+}
+
+/* ============================================================================
+ * WAITING
+ * ============================================================================ */
+
+/*
+ * Returns 1 when every target is ready, 0 if not yet, 2 on a duplicate
+ * address, -1 on probe failure
+ */
+static int check_targets(const ReadyProbe *probe, const ReadyTarget *targets, int count)
+{
+    int ready = 1;
+
+    for (int i = 0; i < count; i++) {
+        ReadyState state;
+
+        if (probe->query(probe->ctx, &targets[i], &state) != 0) {
+            return -1;
+        }
+        if (state.duplicate) {
+            return 2;
+        }
+        if (!state.preferred || (targets[i].need_route && !state.default_route)) {
+            ready = 0;
+        }
+    }
+    return ready;
+}
+
+int ready_wait(const WatchSource *source, const ReadyProbe *probe,
+               const ReadyTarget *targets, int count, LONGLONG since,
+               DWORD timeout_ms, double *elapsed_ms)
+{
+    HANDLE event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    LONGLONG start = timer_now();
+    int ret;
+
+    *elapsed_ms = 0.0;
+    if (!event) {
+        return -1;
+    }
+
+    /* Subscribe before the first check so no change slips in between */
+    if (source->start(source->ctx, event) != 0) {
+        CloseHandle(event);
+        return -1;
+    }
+
+    for (;;) {
+        double left;
+
+        ret = check_targets(probe, targets, count);
+        if (ret != 0) {
+            ret = ret == 1 ? 0 : ret;
+            break;
+        }
+
+        left = (double)timeout_ms - timer_elapsed_ms(start);
+        if (left <= 0.0) {
+            ret = 1;
+            break;
+        }
+        WaitForSingleObject(event, left < READY_POLL_MS ? (DWORD)left + 1 : READY_POLL_MS);
+    }
+
+    *elapsed_ms = timer_elapsed_ms(since ? since : start);
+    source->stop(source->ctx);
+    CloseHandle(event);
+    return ret;
+}
+
+int ready_targets_from_config(ReadyTarget *targets)
+{
+    int count = 0;
+
+    if (g_config.has_ipv4 && address_parse(g_config.ipv4_address, &targets[count].address) == 0) {
+        targets[count].need_route = g_config.ipv4_gateway[0] != L'\0';
+        count++;
+    }
+    if (g_config.has_ipv6 && address_parse(g_config.ipv6_address, &targets[count].address) == 0) {
+        targets[count].need_route = g_config.ipv6_gateway[0] != L'\0';
+        count++;
+    }
+    return count;
+}
+
+int ready_run(LONGLONG since)
+{
+    ReadyTarget targets[READY_MAX_TARGETS];
+    WatchSource source;
+    ReadyProbe probe;
+    NET_LUID luid;
+    double elapsed;
+    wchar_t msg[256];
+    int count = ready_targets_from_config(targets);
+    int ret;
+
+    if (count == 0) {
+        print_info(L"No static address to wait for");
+        return 0;
+    }
+    if (network_get_luid(&luid) != 0) {
+        print_error(L"Cannot resolve interface for --wait-ready");
+        return -1;
+    }
+
+    print_info(L"Waiting for the addresses to become ready...");
+    ready_source_system(&source, &luid);
+    ready_probe_system(&probe, &luid);
+    ret = ready_wait(&source, &probe, targets, count, since,
+                     (DWORD)g_config.ready_timeout * 1000, &elapsed);
+
+    if (ret == 0) {
+        StringCchPrintfW(msg, 256, L"Interface ready after %.0f ms", elapsed);
+        print_success(msg);
+        return 0;
+    }
+    if (ret == 1) {
+        StringCchPrintfW(msg, 256, L"Interface not ready after %d s (address not preferred or no default route)",
+                         g_config.ready_timeout);
+    } else if (ret == 2) {
+        StringCchPrintfW(msg, 256, L"Address conflict: duplicate address detection failed after %.0f ms",
+                         elapsed);
+    } else {
+        StringCchCopyW(msg, 256, L"Cannot watch the interface for --wait-ready");
+    }
+    print_error(msg);
+    return -1;
+}
@@ -0,0 +1,144 @@
+/*
+ * registry.c - Registry access abstraction (HKLM)
+ */
+
+#include "registry.h"
+
+#ifdef _MSC_VER
+#pragma comment(lib, "advapi32.lib")
+#endif
+
+/* ============================================================================
+ * SYSTEM BACKEND
+ * ============================================================================ */
+
+static int system_get_dword(void *ctx, const wchar_t *key, const wchar_t *name, DWORD *value)
+{
+    DWORD size = sizeof(DWORD);
+    LSTATUS status;
+
+    (void)ctx;
+    status = RegGetValueW(HKEY_LOCAL_MACHINE, key, name, RRF_RT_REG_DWORD,
+                          NULL, value, &size);
+    if (status == ERROR_FILE_NOT_FOUND) return 1;
+    return status == ERROR_SUCCESS ? 0 : -1;
+}
+
+static int system_set_dword(void *ctx, const wchar_t *key, const wchar_t *name, DWORD value)
+{
+    HKEY hkey;
+    LSTATUS status;
+
+    (void)ctx;
+    status = RegCreateKeyExW(HKEY_LOCAL_MACHINE, key, 0, NULL, REG_OPTION_NON_VOLATILE,
+                             KEY_SET_VALUE, NULL, &hkey, NULL);
+    if (status != ERROR_SUCCESS) return -1;
+
+    status = RegSetValueExW(hkey, name, 0, REG_DWORD, (const BYTE *)&value, sizeof(value));
+    RegCloseKey(hkey);
+    return status == ERROR_SUCCESS ? 0 : -1;
+}
+
+static int system_get_string(void *ctx, const wchar_t *key, const wchar_t *name,
+                             wchar_t *buffer, size_t size)
+{
+    DWORD bytes = (DWORD)(size * sizeof(wchar_t));
+    LSTATUS status;
+
+    (void)ctx;
+    buffer[0] = L'\0';
+    status = RegGetValueW(HKEY_LOCAL_MACHINE, key, name,
+                          RRF_RT_REG_SZ | RRF_RT_REG_MULTI_SZ, NULL, buffer, &bytes);
+    if (status == ERROR_FILE_NOT_FOUND) return 1;
+    if (status != ERROR_SUCCESS) return -1;
+
+    buffer[size - 1] = L'\0';
+    return 0;
+}
+
+static int system_set_string(void *ctx, const wchar_t *key, const wchar_t *name,
+                             const wchar_t *value, int multi)
+{
+    HKEY hkey;
+    LSTATUS status;
+    size_t len = wcslen(value);
+    wchar_t *data;
+    DWORD bytes;
+
+    (void)ctx;
+
+    /* REG_MULTI_SZ needs a second terminator after the last string */
+    data = (wchar_t *)calloc(len + 2, sizeof(wchar_t));
+    if (!data) return -1;
+    memcpy(data, value, len * sizeof(wchar_t));
+    bytes = (DWORD)((len + (multi ? 2 : 1)) * sizeof(wchar_t));
+
+    status = RegCreateKeyExW(HKEY_LOCAL_MACHINE, key, 0, NULL, REG_OPTION_NON_VOLATILE,
+                             KEY_SET_VALUE, NULL, &hkey, NULL);
+    if (status == ERROR_SUCCESS) {
+        status = RegSetValueExW(hkey, name, 0, multi ? REG_MULTI_SZ : REG_SZ,
+                                (const BYTE *)data, bytes);
+        RegCloseKey(hkey);
+    }
+
+    free(data);
+    return status == ERROR_SUCCESS ? 0 : -1;
+}
+
+static int system_delete_value(void *ctx, const wchar_t *key, const wchar_t *name)
+{
+    HKEY hkey;
+    LSTATUS status;
+
+    (void)ctx;
+    status = RegOpenKeyExW(HKEY_LOCAL_MACHINE, key, 0, KEY_SET_VALUE, &hkey);
+    if (status == ERROR_FILE_NOT_FOUND) return 0;
+    if (status != ERROR_SUCCESS) return -1;
+
+    status = RegDeleteValueW(hkey, name);
+    RegCloseKey(hkey);
+    return (status == ERROR_SUCCESS || status == ERROR_FILE_NOT_FOUND) ? 0 : -1;
+}
+
+static int system_enum_subkeys(void *ctx, const wchar_t *key, int index,
+                               wchar_t *name, size_t size)
+{
+    HKEY hkey;
+    LSTATUS status;
+    DWORD len = (DWORD)size;
+
+    (void)ctx;
+    status = RegOpenKeyExW(HKEY_LOCAL_MACHINE, key, 0, KEY_ENUMERATE_SUB_KEYS, &hkey);
+    if (status == ERROR_FILE_NOT_FOUND) return 1;
+    if (status != ERROR_SUCCESS) return -1;
+
+    status = RegEnumKeyExW(hkey, (DWORD)index, name, &len, NULL, NULL, NULL, NULL);
+    RegCloseKey(hkey);
+
+    if (status == ERROR_NO_MORE_ITEMS) return 1;
+    return status == ERROR_SUCCESS ? 0 : -1;
+}
+
+static int system_delete_key(void *ctx, const wchar_t *key)
+{
+    LSTATUS status;
+
+    (void)ctx;
+    status = RegDeleteTreeW(HKEY_LOCAL_MACHINE, key);
+    if (status == ERROR_SUCCESS) {
+        status = RegDeleteKeyW(HKEY_LOCAL_MACHINE, key);
+    }
+    return (status == ERROR_SUCCESS || status == ERROR_FILE_NOT_FOUND) ? 0 : -1;
+}
+
+void registry_backend_system(RegistryBackend *backend)
+{
+    backend->ctx = NULL;
+    backend->get_dword = system_get_dword;
+    backend->set_dword = system_set_dword;
+    backend->get_string = system_get_string;
+    backend->set_string = system_set_string;
+    backend->delete_value = system_delete_value;
+    backend->enum_subkeys = system_enum_subkeys;
+    backend->delete_key = system_delete_key;
+}
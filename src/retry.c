@@ -0,0 +1,161 @@
+/*
+ * retry.c - Per-step retry policies for transient netsh failures
+ */
+
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "retry.h"
+
+/* ============================================================================
+ * POLICIES
+ * ============================================================================ */
+
+void retry_policy_init(RetryPolicy *policy)
+{
+    ZeroMemory(policy, sizeof(*policy));
+    policy->attempts = 3;
+    policy->delay_ms = 500;
+    policy->max_delay_ms = 4000;
+
+    /* Seen while the interface re-initializes after an address change */
+    StringCchCopyA(policy->patterns[policy->pattern_count++], RETRY_PATTERN_LEN, "Element not found");
+    StringCchCopyA(policy->patterns[policy->pattern_count++], RETRY_PATTERN_LEN, "device is not ready");
+}
+
+int retry_step_from_name(const wchar_t *name, RetryStep *step)
+{
+    static const wchar_t *names[RETRY_STEP_COUNT] = { L"address", L"dns", L"doh", L"tcp" };
+
+    for (int i = 0; i < RETRY_STEP_COUNT; i++) {
+        if (_wcsicmp(name, names[i]) == 0) {
+            *step = (RetryStep)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int parse_int(const wchar_t *value, int min, int max, int *out)
+{
+    wchar_t *end;
+    long n = wcstol(value, &end, 10);
+
+    while (*end == L' ' || *end == L'\t') end++;
+    if (end == value || *end != L'\0' || n < min || n > max) {
+        return -1;
+    }
+    *out = (int)n;
+    return 0;
+}
+
+static int parse_exit_codes(RetryPolicy *policy, const wchar_t *value)
+{
+    wchar_t buf[CONFIG_LINE_SIZE];
+    wchar_t *token, *context = NULL;
+    RetryPolicy parsed = *policy;
+
+    StringCchCopyW(buf, CONFIG_LINE_SIZE, value);
+    parsed.exit_code_count = 0;
+    for (token = wcstok_s(buf, L", ", &context); token; token = wcstok_s(NULL, L", ", &context)) {
+        if (parsed.exit_code_count == RETRY_MAX_CODES ||
+            parse_int(token, INT_MIN, INT_MAX, &parsed.exit_codes[parsed.exit_code_count]) != 0) {
+            return -1;
+        }
+        parsed.exit_code_count++;
+    }
+    *policy = parsed;
+    return 0;
+}
+
+static int parse_patterns(RetryPolicy *policy, const wchar_t *value)
+{
+    wchar_t buf[CONFIG_LINE_SIZE];
+    wchar_t *token, *context = NULL;
+    RetryPolicy parsed = *policy;
+
+    StringCchCopyW(buf, CONFIG_LINE_SIZE, value);
+    parsed.pattern_count = 0;
+    for (token = wcstok_s(buf, L"|", &context); token; token = wcstok_s(NULL, L"|", &context)) {
+        char *pattern = parsed.patterns[parsed.pattern_count];
+        token = trim(token);
+        if (*token == L'\0') {
+            continue;
+        }
+        if (parsed.pattern_count == RETRY_MAX_PATTERNS ||
+            WideCharToMultiByte(CP_ACP, 0, token, -1, pattern, RETRY_PATTERN_LEN, NULL, NULL) == 0) {
+            return -1;
+        }
+        parsed.pattern_count++;
+    }
+    *policy = parsed;
+    return 0;
+}
+
+int retry_set(RetryPolicy *policy, const wchar_t *key, const wchar_t *value)
+{
+    if (_wcsicmp(key, L"attempts") == 0) {
+        return parse_int(value, 1, RETRY_MAX_ATTEMPTS, &policy->attempts);
+    }
+    if (_wcsicmp(key, L"delay") == 0) {
+        return parse_int(value, 0, RETRY_MAX_DELAY_MS, &policy->delay_ms);
+    }
+    if (_wcsicmp(key, L"max_delay") == 0) {
+        return parse_int(value, 0, RETRY_MAX_DELAY_MS, &policy->max_delay_ms);
+    }
+    if (_wcsicmp(key, L"exit_codes") == 0) {
+        return parse_exit_codes(policy, value);
+    }
+    if (_wcsicmp(key, L"patterns") == 0) {
+        return parse_patterns(policy, value);
+    }
+    return -1;
+}
+
+/* ============================================================================
+ * DECISIONS
+ * ============================================================================ */
+
+static int contains_nocase(const char *haystack, const char *needle)
+{
+    size_t n = strlen(needle);
+
+    for (; *haystack; haystack++) {
+        size_t i = 0;
+        while (i < n && tolower((unsigned char)haystack[i]) == tolower((unsigned char)needle[i])) {
+            i++;
+        }
+        if (i == n) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int retry_is_retryable(const RetryPolicy *policy, int exit_code, const char *output)
+{
+    if (exit_code == 0) {
+        return 0;
+    }
+    for (int i = 0; i < policy->exit_code_count; i++) {
+        if (policy->exit_codes[i] == exit_code) {
+            return 1;
+        }
+    }
+    for (int i = 0; output && i < policy->pattern_count; i++) {
+        if (contains_nocase(output, policy->patterns[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int retry_delay_ms(const RetryPolicy *policy, int retry)
+{
+    long long delay = policy->delay_ms;
+
+    for (int i = 1; i < retry && delay < policy->max_delay_ms; i++) {
+        delay *= 2;
+    }
+    return delay > policy->max_delay_ms ? policy->max_delay_ms : (int)delay;
+}
@@ -0,0 +1,467 @@
+/*
+ * route.c - Static route table management
+ */
+
+#include "route.h"
+
+/* ============================================================================
+ * PARSING
+ * ============================================================================ */
+
+/*
+ * Return the next whitespace-separated token, or NULL at end of string
+ */
+static wchar_t *next_token(wchar_t **cursor)
+{
+    wchar_t *p = *cursor;
+    wchar_t *start;
+
+    while (*p && iswspace(*p)) p++;
+    if (*p == L'\0') {
+        *cursor = p;
+        return NULL;
+    }
+
+    start = p;
+    while (*p && !iswspace(*p)) p++;
+    if (*p) {
+        *p++ = L'\0';
+    }
+
+    *cursor = p;
+    return start;
+}
+
+/*
+ * Clear host bits beyond the prefix so "10.1.2.3/8" matches the table's "10.0.0.0/8"
+ */
+static void mask_host_bits(IpAddr *addr)
+{
+    int total = (addr->family == AF_INET) ? 32 : 128;
+
+    for (int bit = addr->prefix; bit < total; bit++) {
+        addr->bytes[bit / 8] &= (BYTE)~(0x80 >> (bit % 8));
+    }
+}
+
+int route_parse(const wchar_t *text, RouteEntry *out)
+{
+    wchar_t buf[CONFIG_LINE_SIZE];
+    wchar_t *cursor = buf;
+    wchar_t *token;
+
+    if (!text || !out || FAILED(StringCchCopyW(buf, CONFIG_LINE_SIZE, text))) {
+        return -1;
+    }
+
+    ZeroMemory(out, sizeof(*out));
+    out->metric = -1;
+    out->nexthop.prefix = -1;
+
+    token = next_token(&cursor);
+    if (!token || address_parse(token, &out->dest) != 0) {
+        return -1;
+    }
+    if (out->dest.prefix < 0) {
+        out->dest.prefix = (out->dest.family == AF_INET) ? 32 : 128;
+    }
+    mask_host_bits(&out->dest);
+    out->nexthop.family = out->dest.family;
+
+    while ((token = next_token(&cursor)) != NULL) {
+        if (_wcsicmp(token, L"via") == 0 || _wcsicmp(token, L"nexthop") == 0) {
+            token = next_token(&cursor);
+            if (!token) return -1;
+        }
+
+        if (_wcsicmp(token, L"metric") == 0) {
+            wchar_t *end;
+            token = next_token(&cursor);
+            if (!token) return -1;
+            long metric = wcstol(token, &end, 10);
+            if (*end != L'\0' || metric < 0) return -1;
+            out->metric = (int)metric;
+            continue;
+        }
+
+        if (address_parse(token, &out->nexthop) != 0 ||
+            out->nexthop.family != out->dest.family ||
+            out->nexthop.prefix >= 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void route_format(const RouteEntry *route, wchar_t *buffer, size_t size)
+{
+    wchar_t dest[MAX_ADDR_LEN];
+    wchar_t hop[MAX_ADDR_LEN];
+
+    address_format(&route->dest, dest, MAX_ADDR_LEN);
+    address_format(&route->nexthop, hop, MAX_ADDR_LEN);
+
+    if (route->metric >= 0) {
+        StringCchPrintfW(buffer, size, L"%ls via %ls metric %d", dest, hop, route->metric);
+    } else {
+        StringCchPrintfW(buffer, size, L"%ls via %ls", dest, hop);
+    }
+}
+
+/* ============================================================================
+ * ROUTE LISTS
+ * ============================================================================ */
+
+int route_list_add(RouteList *list, const RouteEntry *route)
+{
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        RouteEntry *items = (RouteEntry *)realloc(list->items,
+                                                  (size_t)capacity * sizeof(RouteEntry));
+        if (!items) {
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+
+    list->items[list->count++] = *route;
+    return 0;
+}
+
+void route_list_free(RouteList *list)
+{
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+int route_list_load_file(RouteList *list, const wchar_t *filepath)
+{
+    FILE *fp;
+    wchar_t line[CONFIG_LINE_SIZE];
+    int loaded = 0;
+
+    if (_wfopen_s(&fp, filepath, L"r, ccs=UTF-8") != 0 || !fp) {
+        return -1;
+    }
+
+    while (fgetws(line, CONFIG_LINE_SIZE, fp)) {
+        wchar_t *trimmed = trim(line);
+        RouteEntry route;
+
+        if (*trimmed == L'\0' || *trimmed == L';' || *trimmed == L'#') {
+            continue;
+        }
+
+        if (route_parse(trimmed, &route) != 0) {
+            wchar_t errmsg[CONFIG_LINE_SIZE + 64];
+            StringCchPrintfW(errmsg, CONFIG_LINE_SIZE + 64,
+                L"Invalid route in %ls: %ls", filepath, trimmed);
+            print_error(errmsg);
+            continue;
+        }
+
+        if (route_list_add(list, &route) != 0) {
+            fclose(fp);
+            return -1;
+        }
+        loaded++;
+    }
+
+    fclose(fp);
+    return loaded;
+}
+
+/* ============================================================================
+ * DIFF
+ * ============================================================================ */
+
+static int compare_destination(const RouteEntry *a, const RouteEntry *b)
+{
+    int cmp = address_compare(&a->dest, &b->dest);
+    if (cmp != 0) return cmp;
+    return a->dest.prefix - b->dest.prefix;
+}
+
+static int compare_routes(const void *pa, const void *pb)
+{
+    const RouteEntry *a = (const RouteEntry *)pa;
+    const RouteEntry *b = (const RouteEntry *)pb;
+    int cmp = compare_destination(a, b);
+    if (cmp != 0) return cmp;
+    return address_compare(&a->nexthop, &b->nexthop);
+}
+
+int route_diff(RouteList *desired, RouteList *current,
+               RouteList *to_add, RouteList *to_remove, RouteList *to_update)
+{
+    int i = 0, j = 0;
+
+    if (desired->count > 0) {
+        qsort(desired->items, (size_t)desired->count, sizeof(RouteEntry), compare_routes);
+    }
+    if (current->count > 0) {
+        qsort(current->items, (size_t)current->count, sizeof(RouteEntry), compare_routes);
+    }
+
+    while (i < desired->count || j < current->count) {
+        int cmp;
+
+        if (i < desired->count && i > 0 &&
+            compare_routes(&desired->items[i], &desired->items[i - 1]) == 0) {
+            i++;                /* Skip duplicate desired entries */
+            continue;
+        }
+
+        if (i >= desired->count) {
+            cmp = 1;
+        } else if (j >= current->count) {
+            cmp = -1;
+        } else {
+            cmp = compare_routes(&desired->items[i], &current->items[j]);
+        }
+
+        if (cmp < 0) {
+            if (route_list_add(to_add, &desired->items[i]) != 0) return -1;
+            i++;
+        } else if (cmp > 0) {
+            if (route_list_add(to_remove, &current->items[j]) != 0) return -1;
+            j++;
+        } else {
+            if (desired->items[i].metric >= 0 &&
+                desired->items[i].metric != current->items[j].metric) {
+                if (route_list_add(to_update, &desired->items[i]) != 0) return -1;
+            }
+            i++;
+            j++;
+        }
+    }
+
+    return 0;
+}
+
+/* ============================================================================
+ * SYNCHRONIZATION
+ * ============================================================================ */
+
+/*
+ * Check whether a destination appears in the (sorted) desired list
+ */
+static int destination_listed(const RouteList *desired, const RouteEntry *route)
+{
+    int lo = 0, hi = desired->count - 1;
+
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int cmp = compare_destination(&desired->items[mid], route);
+        if (cmp == 0) return 1;
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return 0;
+}
+
+static void report_failure(const wchar_t *action, const RouteEntry *route)
+{
+    wchar_t text[256];
+    wchar_t errmsg[320];
+
+    route_format(route, text, 256);
+    StringCchPrintfW(errmsg, 320, L"Failed to %ls route %ls", action, text);
+    print_error(errmsg);
+}
+
+int route_sync(const RouteBackend *backend, RouteList *desired, int prune,
+               RouteProgressFn progress, void *progress_ctx,
+               RouteSyncResult *result)
+{
+    RouteList current = {0}, to_add = {0}, to_remove = {0}, to_update = {0};
+    int total, done = 0;
+    int matched;
+
+    ZeroMemory(result, sizeof(*result));
+
+    if (backend->list(backend->ctx, &current) != 0) {
+        print_error(L"Failed to read the routing table");
+        return -1;
+    }
+
+    if (route_diff(desired, &current, &to_add, &to_remove, &to_update) != 0) {
+        print_error(L"Memory allocation failed");
+        route_list_free(&current);
+        route_list_free(&to_add);
+        route_list_free(&to_remove);
+        route_list_free(&to_update);
+        return -1;
+    }
+
+    matched = current.count - to_remove.count;
+
+    /* Without prune, leave routes to destinations we do not manage alone */
+    if (!prune) {
+        int kept = 0;
+        for (int i = 0; i < to_remove.count; i++) {
+            if (destination_listed(desired, &to_remove.items[i])) {
+                to_remove.items[kept++] = to_remove.items[i];
+            }
+        }
+        to_remove.count = kept;
+    }
+
+    total = to_remove.count + to_add.count + to_update.count;
+
+    for (int i = 0; i < to_remove.count; i++, done++) {
+        if (backend->remove(backend->ctx, &to_remove.items[i]) != 0) {
+            report_failure(L"remove", &to_remove.items[i]);
+            result->failed++;
+        } else {
+            result->removed++;
+        }
+        if (progress) progress(done + 1, total, progress_ctx);
+    }
+
+    for (int i = 0; i < to_add.count; i++, done++) {
+        if (backend->add(backend->ctx, &to_add.items[i]) != 0) {
+            report_failure(L"add", &to_add.items[i]);
+            result->failed++;
+        } else {
+            result->added++;
+        }
+        if (progress) progress(done + 1, total, progress_ctx);
+    }
+
+    for (int i = 0; i < to_update.count; i++, done++) {
+        if (backend->update(backend->ctx, &to_update.items[i]) != 0) {
+            report_failure(L"update", &to_update.items[i]);
+            result->failed++;
+        } else {
+            result->updated++;
+        }
+        if (progress) progress(done + 1, total, progress_ctx);
+    }
+
+    result->unchanged = matched - to_update.count;
+
+    route_list_free(&current);
+    route_list_free(&to_add);
+    route_list_free(&to_remove);
+    route_list_free(&to_update);
+
+    return result->failed ? -1 : 0;
+}
+
+/* ============================================================================
+ * SYSTEM BACKEND
+ * ============================================================================ */
+
+static void fill_sockaddr(SOCKADDR_INET *sa, const IpAddr *addr)
+{
+    ZeroMemory(sa, sizeof(*sa));
+    if (addr->family == AF_INET) {
+        sa->Ipv4.sin_family = AF_INET;
+        memcpy(&sa->Ipv4.sin_addr, addr->bytes, 4);
+    } else {
+        sa->Ipv6.sin6_family = AF_INET6;
+        memcpy(&sa->Ipv6.sin6_addr, addr->bytes, 16);
+    }
+}
+
+static void read_sockaddr(const SOCKADDR_INET *sa, IpAddr *addr)
+{
+    ZeroMemory(addr, sizeof(*addr));
+    addr->prefix = -1;
+    addr->family = sa->si_family;
+    if (sa->si_family == AF_INET) {
+        memcpy(addr->bytes, &sa->Ipv4.sin_addr, 4);
+    } else {
+        memcpy(addr->bytes, &sa->Ipv6.sin6_addr, 16);
+    }
+}
+
+static void fill_route_row(MIB_IPFORWARD_ROW2 *row, const NET_LUID *luid,
+                           const RouteEntry *route)
+{
+    InitializeIpForwardEntry(row);
+    row->InterfaceLuid = *luid;
+    fill_sockaddr(&row->DestinationPrefix.Prefix, &route->dest);
+    row->DestinationPrefix.PrefixLength = (UCHAR)route->dest.prefix;
+    fill_sockaddr(&row->NextHop, &route->nexthop);
+    row->Metric = route->metric >= 0 ? (ULONG)route->metric : 0;
+    row->Protocol = MIB_IPPROTO_NETMGMT;
+    row->Origin = NlroManual;
+}
+
+static int system_list(void *ctx, RouteList *out)
+{
+    const NET_LUID *luid = (const NET_LUID *)ctx;
+    PMIB_IPFORWARD_TABLE2 table = NULL;
+
+    if (GetIpForwardTable2(AF_UNSPEC, &table) != NO_ERROR) {
+        return -1;
+    }
+
+    for (ULONG i = 0; i < table->NumEntries; i++) {
+        MIB_IPFORWARD_ROW2 *row = &table->Table[i];
+        RouteEntry route;
+
+        /* Static routes only; DHCP and router-advertised routes are not ours */
+        if (row->InterfaceLuid.Value != luid->Value ||
+            row->Protocol != MIB_IPPROTO_NETMGMT ||
+            row->Origin != NlroManual) {
+            continue;
+        }
+
+        read_sockaddr(&row->DestinationPrefix.Prefix, &route.dest);
+        route.dest.prefix = row->DestinationPrefix.PrefixLength;
+        read_sockaddr(&row->NextHop, &route.nexthop);
+        route.metric = (int)row->Metric;
+
+        if (route_list_add(out, &route) != 0) {
+            FreeMibTable(table);
+            return -1;
+        }
+    }
+
+    FreeMibTable(table);
+    return 0;
+}
+
+static int system_add(void *ctx, const RouteEntry *route)
+{
+    MIB_IPFORWARD_ROW2 row;
+    DWORD err;
+
+    fill_route_row(&row, (const NET_LUID *)ctx, route);
+    err = CreateIpForwardEntry2(&row);
+    return (err == NO_ERROR || err == ERROR_OBJECT_ALREADY_EXISTS) ? 0 : -1;
+}
+
+static int system_remove(void *ctx, const RouteEntry *route)
+{
+    MIB_IPFORWARD_ROW2 row;
+    DWORD err;
+
+    fill_route_row(&row, (const NET_LUID *)ctx, route);
+    err = DeleteIpForwardEntry2(&row);
+    return (err == NO_ERROR || err == ERROR_NOT_FOUND) ? 0 : -1;
+}
+
+static int system_update(void *ctx, const RouteEntry *route)
+{
+    MIB_IPFORWARD_ROW2 row;
+
+    fill_route_row(&row, (const NET_LUID *)ctx, route);
+    return SetIpForwardEntry2(&row) == NO_ERROR ? 0 : -1;
+}
+
+void route_backend_system(RouteBackend *backend, NET_LUID *luid)
+{
+    backend->ctx = luid;
+    backend->list = system_list;
+    backend->add = system_add;
+    backend->remove = system_remove;
+    backend->update = system_update;
+}
@@ -0,0 +1,383 @@
+/*
+ * serve.c - Local status server (serve mode) and its status client
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sddl.h>
+#include "serve.h"
+#include "config.h"
+#include "network.h"
+#include "watch.h"
+
+#ifdef _MSC_VER
+#pragma comment(lib, "advapi32.lib")
+#endif
+
+/* ============================================================================
+ * STATUS CACHE
+ * ============================================================================ */
+
+void serve_cache_init(StatusCache *cache)
+{
+    ZeroMemory(cache, sizeof(*cache));
+    InitializeSRWLock(&cache->lock);
+}
+
+int serve_cache_update(StatusCache *cache, const StatusReport *report)
+{
+    /* Room is left for the stale mark serve_respond may add */
+    const int limit = SERVE_RESPONSE_SIZE - SERVE_STALE_MARK_SIZE;
+    char text[SERVE_RESPONSE_SIZE];
+    char json[SERVE_RESPONSE_SIZE];
+    wchar_t wide[STATUS_TEXT_SIZE];
+    int header, text_len, json_len;
+
+    /* Render outside the lock; queries only wait for the copy */
+    header = sprintf(text, "%d\n", status_exit_code(report));
+    status_format_text(report, wide, STATUS_TEXT_SIZE);
+    StringCchCatW(wide, STATUS_TEXT_SIZE, status_overall_text(report));
+    text_len = WideCharToMultiByte(CP_UTF8, 0, wide, -1, text + header,
+                                   limit - header, NULL, NULL);
+    if (text_len == 0) {
+        return -1;
+    }
+    text_len += header - 1;             /* Without the terminator */
+
+    header = sprintf(json, "%d\n", status_exit_code(report));
+    json_len = status_format_json(report, json + header, (size_t)(limit - header));
+    if (json_len < 0) {
+        return -1;
+    }
+    json_len += header;
+
+    AcquireSRWLockExclusive(&cache->lock);
+    memcpy(cache->text, text, (size_t)text_len);
+    cache->text_len = text_len;
+    memcpy(cache->json, json, (size_t)json_len);
+    cache->json_len = json_len;
+    cache->refreshes++;
+    cache->stale_since = 0;
+    ReleaseSRWLockExclusive(&cache->lock);
+
+    return 0;
+}
+
+void serve_cache_mark_stale(StatusCache *cache, ULONGLONG now)
+{
+    AcquireSRWLockExclusive(&cache->lock);
+    if (cache->stale_since == 0) {
+        cache->stale_since = now;
+    }
+    ReleaseSRWLockExclusive(&cache->lock);
+}
+
+int serve_respond(StatusCache *cache, const char *request, char *out, size_t size)
+{
+    const char *start = request;
+    const char *end;
+    size_t len;
+    int ret = -1;
+
+    while (*start == ' ' || *start == '\t' || *start == '\r' || *start == '\n') start++;
+    end = start + strlen(start);
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) end--;
+    len = (size_t)(end - start);
+
+    AcquireSRWLockShared(&cache->lock);
+    if (cache->refreshes > 0) {
+        const char *body = NULL;
+        int body_len = 0;
+
+        if (len == 4 && _strnicmp(start, "json", 4) == 0) {
+            body = cache->json;
+            body_len = cache->json_len;
+        } else if (len == 4 && _strnicmp(start, "text", 4) == 0) {
+            body = cache->text;
+            body_len = cache->text_len;
+        }
+
+        if (body) {
+            /* The first line is the exit code; the mark goes at its end */
+            const char *rest = (const char *)memchr(body, '\n', (size_t)body_len);
+            int head = rest ? (int)(rest - body) : body_len;
+            char mark[SERVE_STALE_MARK_SIZE];
+            int mark_len = 0;
+
+            if (cache->stale_since) {
+                mark_len = sprintf(mark, " stale-since=%llu", cache->stale_since);
+            }
+            if ((size_t)(body_len + mark_len) <= size) {
+                memcpy(out, body, (size_t)head);
+                memcpy(out + head, mark, (size_t)mark_len);
+                memcpy(out + head + mark_len, body + head, (size_t)(body_len - head));
+                ret = body_len + mark_len;
+            }
+        }
+    }
+    ReleaseSRWLockShared(&cache->lock);
+
+    return ret;
+}
+
+/* ============================================================================
+ * STATUS CLIENT
+ * ============================================================================ */
+
+static void pipe_path(wchar_t *path, size_t size)
+{
+    StringCchPrintfW(path, size, L"\\\\.\\pipe\\%ls", g_config.serve_pipe);
+}
+
+int serve_query(int json)
+{
+    wchar_t path[MAX_PATH_LEN];
+    char response[SERVE_RESPONSE_SIZE + 1];
+    const char *request = json ? "json\n" : "text\n";
+    DWORD len = 0, got, written;
+    HANDLE pipe = INVALID_HANDLE_VALUE;
+    char *body;
+    char *stale;
+
+    pipe_path(path, MAX_PATH_LEN);
+
+    /* The server handles one client at a time; a busy pipe frees up quickly */
+    for (int attempt = 0; attempt < 3 && pipe == INVALID_HANDLE_VALUE; attempt++) {
+        pipe = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        if (pipe == INVALID_HANDLE_VALUE &&
+            (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(path, 1000))) {
+            return -1;
+        }
+    }
+    if (pipe == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+
+    if (!WriteFile(pipe, request, (DWORD)strlen(request), &written, NULL)) {
+        CloseHandle(pipe);
+        return -1;
+    }
+    while (len < SERVE_RESPONSE_SIZE &&
+           ReadFile(pipe, response + len, SERVE_RESPONSE_SIZE - len, &got, NULL) && got > 0) {
+        len += got;
+    }
+    CloseHandle(pipe);
+    response[len] = '\0';
+
+    body = strchr(response, '\n');
+    if (!body) {
+        return -1;
+    }
+    *body++ = '\0';
+
+    stale = strstr(response, " stale-since=");
+    if (stale) {
+        FILETIME now;
+        ULONGLONG since = strtoull(stale + 13, NULL, 10);
+        ULONGLONG seconds;
+        wchar_t msg[160];
+
+        GetSystemTimeAsFileTime(&now);
+        seconds = status_unix_seconds(&now);
+        seconds = seconds > since ? seconds - since : 0;
+        StringCchPrintfW(msg, 160, L"Warning: the server has failed to refresh the status for %llu s; "
+                         L"this report may be out of date", seconds);
+        print_error(msg);
+    }
+    print_raw(body, len - (DWORD)(body - response));
+    return atoi(response);
+}
+
+/* ============================================================================
+ * SERVE MODE
+ * ============================================================================ */
+
+static HANDLE g_stop_event;
+static wchar_t g_pipe_path[MAX_PATH_LEN];
+
+static BOOL WINAPI on_console_ctrl(DWORD type)
+{
+    (void)type;
+    SetEvent(g_stop_event);
+    return TRUE;
+}
+
+static int refresh(void *ctx, WatchReason reason)
+{
+    StatusCache *cache = (StatusCache *)ctx;
+    StatusReport report;
+
+    (void)reason;
+    status_collect(&report);
+    if (serve_cache_update(cache, &report) != 0) {
+        FILETIME now;
+
+        /* Queries keep getting the last good report, marked stale */
+        GetSystemTimeAsFileTime(&now);
+        serve_cache_mark_stale(cache, status_unix_seconds(&now));
+        print_error(L"Failed to refresh the status (report too large); serving the previous one");
+        return -1;
+    }
+    return 0;
+}
+
+static DWORD WINAPI refresh_thread(LPVOID param)
+{
+    StatusCache *cache = (StatusCache *)param;
+    WatchOptions opts = g_config.watch;
+    WatchSource source;
+    NET_LUID luid;
+
+    opts.interval_ms = g_config.serve_interval * 1000;
+    if (network_get_luid(&luid) != 0) {
+        return 1;
+    }
+    watch_source_system(&source, &luid);
+    return watch_loop(&source, &opts, g_stop_event, refresh, cache) == 0 ? 0 : 1;
+}
+
+/*
+ * Finish an overlapped pipe operation; `started` is what the call that
+ * began it returned. The operation is cancelled after `timeout_ms` or
+ * once the server stops.
+ * Returns 0 when it completed, -1 on failure, timeout or stop
+ */
+static int pipe_wait(HANDLE pipe, OVERLAPPED *ov, BOOL started, DWORD timeout_ms, DWORD *done)
+{
+    HANDLE events[2] = { ov->hEvent, g_stop_event };
+
+    if (!started && GetLastError() != ERROR_IO_PENDING) {
+        return -1;
+    }
+    if (WaitForMultipleObjects(2, events, FALSE, timeout_ms) != WAIT_OBJECT_0) {
+        CancelIoEx(pipe, ov);
+        GetOverlappedResult(pipe, ov, done, TRUE);
+        return -1;
+    }
+    return GetOverlappedResult(pipe, ov, done, FALSE) ? 0 : -1;
+}
+
+/*
+ * Serve one client: read the request, write the cached answer. Clients
+ * are served in turn, so each read and write gets SERVE_CLIENT_TIMEOUT_MS;
+ * a client that connects and sends nothing cannot hold up the others.
+ */
+static void serve_client(HANDLE pipe, OVERLAPPED *ov, StatusCache *cache)
+{
+    char request[SERVE_REQUEST_SIZE];
+    char response[SERVE_RESPONSE_SIZE];
+    DWORD got, written;
+    int len;
+
+    if (pipe_wait(pipe, ov, ReadFile(pipe, request, SERVE_REQUEST_SIZE - 1, NULL, ov),
+                  SERVE_CLIENT_TIMEOUT_MS, &got) != 0) {
+        return;
+    }
+    request[got] = '\0';
+
+    len = serve_respond(cache, request, response, sizeof(response));
+    if (len < 0) {
+        len = sprintf(response, "2\nunknown request (use text or json)\n");
+    }
+    pipe_wait(pipe, ov, WriteFile(pipe, response, (DWORD)len, NULL, ov),
+              SERVE_CLIENT_TIMEOUT_MS, &written);
+}
+
+int serve_run(void)
+{
+    static StatusCache cache;
+    SECURITY_ATTRIBUTES sa;
+    PSECURITY_DESCRIPTOR sd = NULL;
+    HANDLE thread;
+    OVERLAPPED ov;
+    StatusReport report;
+    wchar_t msg[MAX_PATH_LEN + 64];
+    DWORD open_mode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE;
+    int ret = 0;
+
+    pipe_path(g_pipe_path, MAX_PATH_LEN);
+
+    /* Local system and administrators own the pipe; any signed-in user may query */
+    if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(
+            L"D:(A;;GA;;;SY)(A;;GA;;;BA)(A;;GRGW;;;AU)", SDDL_REVISION_1, &sd, NULL)) {
+        print_error(L"Failed to build the pipe security descriptor");
+        return 1;
+    }
+    sa.nLength = sizeof(sa);
+    sa.lpSecurityDescriptor = sd;
+    sa.bInheritHandle = FALSE;
+
+    serve_cache_init(&cache);
+    status_collect(&report);
+    if (serve_cache_update(&cache, &report) != 0) {
+        print_error(L"Status report too large");
+        LocalFree(sd);
+        return 1;
+    }
+
+    g_stop_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ZeroMemory(&ov, sizeof(ov));
+    ov.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!g_stop_event || !ov.hEvent) {
+        if (g_stop_event) {
+            CloseHandle(g_stop_event);
+        }
+        LocalFree(sd);
+        return 1;
+    }
+    SetConsoleCtrlHandler(on_console_ctrl, TRUE);
+
+    thread = CreateThread(NULL, 0, refresh_thread, &cache, 0, NULL);
+    if (!thread) {
+        print_error(L"Failed to start the refresh thread");
+        ret = 1;
+    }
+
+    StringCchPrintfW(msg, MAX_PATH_LEN + 64, L"Serving status of %ls on %ls (refresh every %d s)",
+                     g_config.interface_name, g_pipe_path, g_config.serve_interval);
+    print_info(msg);
+    print_info(L"Press Ctrl+C to stop.");
+
+    while (!ret && WaitForSingleObject(g_stop_event, 0) != WAIT_OBJECT_0) {
+        DWORD unused;
+        HANDLE pipe = CreateNamedPipeW(g_pipe_path, open_mode,
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            PIPE_UNLIMITED_INSTANCES, SERVE_RESPONSE_SIZE, SERVE_REQUEST_SIZE, 0, &sa);
+
+        if (pipe == INVALID_HANDLE_VALUE) {
+            print_error(GetLastError() == ERROR_ACCESS_DENIED
+                ? L"Another status server is already running"
+                : L"Failed to create the status pipe");
+            ret = 1;
+            break;
+        }
+        open_mode &= ~FILE_FLAG_FIRST_PIPE_INSTANCE;
+
+        /* A client that connected before the wait began is already there */
+        if (ConnectNamedPipe(pipe, &ov) || GetLastError() == ERROR_PIPE_CONNECTED ||
+            pipe_wait(pipe, &ov, FALSE, INFINITE, &unused) == 0) {
+            serve_client(pipe, &ov, &cache);
+        }
+
+        /* Closing, unlike DisconnectNamedPipe, leaves the answer readable
+           until the client closes its end, so there is no flush to wait on */
+        CloseHandle(pipe);
+    }
+
+    SetEvent(g_stop_event);
+    if (thread) {
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+    }
+    SetConsoleCtrlHandler(on_console_ctrl, FALSE);
+    CloseHandle(ov.hEvent);
+    CloseHandle(g_stop_event);
+    LocalFree(sd);
+
+    if (ret == 0) {
+        wprintf(L"\n");
+        StringCchPrintfW(msg, MAX_PATH_LEN + 64, L"Stopped after %llu refreshes", cache.refreshes);
+        print_success(msg);
+    }
+    return ret;
+}
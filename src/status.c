@@ -3,8 +3,19 @@
  */
 
 #include <string.h>
+#include <stdarg.h>
 #include "status.h"
+#include "config.h"
+#include "history.h"
 #include "process.h"
+#include "nrpt.h"
+#include "tcp.h"
+#include "mtu.h"
+#include "suffix.h"
+#include "dnscache.h"
+#include "fastpath.h"
+#include "prefix.h"
+#include "network.h"
 
 /* ============================================================================
  * DOH INFO QUERY
@@ -16,6 +27,7 @@ void status_query_doh_info(const wchar_t *server, DnsServerInfo *info)
     char buffer[4096];
 
     StringCchCopyW(info->address, MAX_ADDR_LEN, server);
+    info->doh_template[0] = L'\0';
     info->has_template = 0;
     info->autoupgrade = 0;
     info->udpfallback = 1; /* Default to insecure */
@@ -34,6 +46,25 @@ void status_query_doh_info(const wchar_t *server, DnsServerInfo *info)
             info->has_template = 1;
         }
 
+        /* "DNS-over-HTTPS template : https://..." */
+        char *template_line = strstr(buffer, "template");
+        if (template_line) {
+            char *colon = strchr(template_line, ':');
+            if (colon) {
+                char url[256] = {0};
+                int i = 0;
+                colon++;
+                while (*colon == ' ' || *colon == '\t') colon++;
+                while (colon[i] && !isspace((unsigned char)colon[i]) && i < 255) {
+                    url[i] = colon[i];
+                    i++;
+                }
+                if (strncmp(url, "http", 4) == 0) {
+                    MultiByteToWideChar(CP_ACP, 0, url, -1, info->doh_template, 256);
+                }
+            }
+        }
+
         /* Check for Auto-upgrade: yes */
         char *auto_line = strstr(buffer, "Auto-upgrade");
         if (auto_line) {
@@ -145,145 +176,656 @@ int status_get_configured_dns(DnsServerInfo *ipv4_servers, int *ipv4_count,
 }
 
 /* ============================================================================
- * STATUS DISPLAY
+ * INTERFACE MTU
  * ============================================================================ */
 
-int status_run(void)
+static void print_mtu_status(void)
 {
-    DnsServerInfo ipv4_servers[4];
-    DnsServerInfo ipv6_servers[4];
-    int ipv4_count = 0, ipv6_count = 0;
-    int ipv4_encrypted = 0, ipv4_total = 0;
-    int ipv6_encrypted = 0, ipv6_total = 0;
-    int any_fallback = 0;
-    int any_unencrypted = 0;
+    ULONG ipv4_mtu, ipv6_mtu;
+    int has_ipv4 = mtu_read(AF_INET, &ipv4_mtu) == 0;
+    int has_ipv6 = mtu_read(AF_INET6, &ipv6_mtu) == 0;
+
+    if (!has_ipv4 && !has_ipv6) {
+        return;
+    }
 
+    wprintf(L"Interface MTU:\n");
+    wprintf(L"----------------------------------------\n");
+    if (has_ipv4) {
+        wprintf(L"  IPv4: %lu bytes\n", ipv4_mtu);
+    }
+    if (has_ipv6) {
+        wprintf(L"  IPv6: %lu bytes\n", ipv6_mtu);
+    }
     wprintf(L"\n");
-    wprintf(L"Status for interface: %ls\n", g_config.interface_name);
-    wprintf(L"========================================\n\n");
+}
 
-    status_get_configured_dns(ipv4_servers, &ipv4_count, ipv6_servers, &ipv6_count);
+/* ============================================================================
+ * DNS SUFFIXES
+ * ============================================================================ */
 
-    /* Display IPv4 DNS */
-    wprintf(L"IPv4 DNS: ");
-    if (ipv4_count == 0) {
-        wprintf(L"(none configured)\n");
-    } else {
-        for (int i = 0; i < ipv4_count; i++) {
-            wprintf(L"%ls%ls", ipv4_servers[i].address,
-                (i < ipv4_count - 1) ? L", " : L"\n");
-        }
+#define SUFFIX_COST_SAMPLES 3
+
+static void print_suffix_status(const StatusReport *report)
+{
+    SuffixList current;
+    RegistryBackend reg;
+    ProbeTarget servers[STATUS_MAX_SERVERS];
+    double cost[SUFFIX_MAX];
+    double total = 0;
+    wchar_t list[SUFFIX_LIST_LEN];
+
+    registry_backend_system(&reg);
+    if (suffix_read(&reg, &current) != 0) {
+        return;
+    }
+    if (current.count == 0 && !g_config.has_suffixes) {
+        return;
     }
 
-    /* Display IPv6 DNS */
-    wprintf(L"IPv6 DNS: ");
-    if (ipv6_count == 0) {
-        wprintf(L"(none configured)\n");
-    } else {
-        for (int i = 0; i < ipv6_count; i++) {
-            wprintf(L"%ls%ls", ipv6_servers[i].address,
-                (i < ipv6_count - 1) ? L", " : L"\n");
+    wprintf(L"DNS suffix search list:\n");
+    wprintf(L"----------------------------------------\n");
+    suffix_format(&current, list, SUFFIX_LIST_LEN);
+    wprintf(L"  %ls\n", list[0] ? list : L"(empty)");
+    if (g_config.has_suffixes && !suffix_equal(&current, &g_config.dns_suffixes)) {
+        suffix_format(&g_config.dns_suffixes, list, SUFFIX_LIST_LEN);
+        wprintf(L"  (config: %ls)\n", list[0] ? list : L"(empty)");
+    }
+    wprintf(L"  A failing single-label lookup sends up to %d queries (%d suffixes, A + AAAA)\n",
+            suffix_worst_case_queries(&current), current.count);
+
+    /* Optional: what those queries cost against the interface's resolvers */
+    if (g_config.suffix_cost && current.count > 0 && report->ipv4_count > 0) {
+        for (int i = 0; i < report->ipv4_count; i++) {
+            servers[i].server = report->ipv4[i].address;
+            servers[i].port = 0;
+        }
+        if (suffix_measure(servers, report->ipv4_count, &current, SUFFIX_COST_SAMPLES,
+                           g_config.probe.timeout_ms, cost) == 0) {
+            for (int i = 0; i < current.count; i++) {
+                wprintf(L"    %-40ls %8.1f ms\n", current.items[i], cost[i]);
+                total += cost[i];
+            }
+            wprintf(L"  Added latency of a failing short-name lookup: %.1f ms\n", total);
         }
     }
-
     wprintf(L"\n");
-    wprintf(L"Encryption:\n");
+}
+
+/* ============================================================================
+ * NRPT RULES
+ * ============================================================================ */
+
+static void print_nrpt_status(void)
+{
+    NrptRuleList active = {0};
+    RegistryBackend reg;
+
+    registry_backend_system(&reg);
+    if (nrpt_read_rules(&reg, &active) != 0) {
+        nrpt_list_free(&active);
+        return;
+    }
+
+    if (active.count == 0 && g_config.nrpt_rules.count == 0) {
+        return;
+    }
+
+    wprintf(L"NRPT rules:\n");
     wprintf(L"----------------------------------------\n");
 
-    /* Analyze IPv4 */
-    for (int i = 0; i < ipv4_count; i++) {
-        ipv4_total++;
-        int encrypted = ipv4_servers[i].has_template &&
-                        ipv4_servers[i].autoupgrade &&
-                        !ipv4_servers[i].udpfallback;
+    /* Configured rules first, then managed rules no longer in the config */
+    for (int i = 0; i < g_config.nrpt_rules.count; i++) {
+        const NrptRule *want = &g_config.nrpt_rules.items[i];
+        const NrptRule *have = nrpt_find(&active, want->name_space);
+        const wchar_t *state = L"NOT ACTIVE";
 
-        if (encrypted) {
-            ipv4_encrypted++;
-        } else {
-            any_unencrypted = 1;
+        if (have) {
+            state = (_wcsicmp(have->servers, want->servers) == 0 &&
+                     _wcsicmp(have->doh_template, want->doh_template) == 0)
+                    ? L"ACTIVE" : L"ACTIVE (differs from config)";
         }
+        wprintf(L"  %ls -> %ls%ls: %ls\n", want->name_space, want->servers,
+            want->doh_template[0] ? L" (DoH)" : L"", state);
+    }
+
+    for (int i = 0; i < active.count; i++) {
+        const NrptRule *have = &active.items[i];
+        int configured = 0;
 
-        if (ipv4_servers[i].udpfallback) {
-            any_fallback = 1;
+        for (int k = 0; k < g_config.nrpt_rules.count && !configured; k++) {
+            configured = _wcsicmp(g_config.nrpt_rules.items[k].name_space, have->name_space) == 0;
         }
+        if (!configured) {
+            wprintf(L"  %ls -> %ls%ls: ACTIVE (not in config)\n", have->name_space,
+                have->servers, have->doh_template[0] ? L" (DoH)" : L"");
+        }
+    }
 
-        wprintf(L"  %ls: %ls", ipv4_servers[i].address,
-            encrypted ? L"ENCRYPTED" : L"NOT ENCRYPTED");
+    wprintf(L"\n");
+    nrpt_list_free(&active);
+}
 
-        if (ipv4_servers[i].has_template && ipv4_servers[i].udpfallback) {
-            wprintf(L" (fallback enabled)");
-        } else if (!ipv4_servers[i].has_template) {
-            wprintf(L" (no DoH template)");
-        }
-        wprintf(L"\n");
+/* ============================================================================
+ * TCP SETTINGS
+ * ============================================================================ */
+
+static void print_tcp_status(void)
+{
+    TcpSettings current;
+
+    if (tcp_read_global(&current) != 0 || !tcp_any(&current)) {
+        return;
     }
 
-    /* Analyze IPv6 */
-    for (int i = 0; i < ipv6_count; i++) {
-        ipv6_total++;
-        int encrypted = ipv6_servers[i].has_template &&
-                        ipv6_servers[i].autoupgrade &&
-                        !ipv6_servers[i].udpfallback;
+    wprintf(L"Global TCP settings:\n");
+    wprintf(L"----------------------------------------\n");
+    for (int i = 0; i < TCP_SETTING_COUNT; i++) {
+        const wchar_t *want = g_config.tcp.values[i];
+        const wchar_t *have = current.values[i][0] ? current.values[i] : L"(not reported)";
 
-        if (encrypted) {
-            ipv6_encrypted++;
+        if (want[0] != L'\0' && _wcsicmp(want, current.values[i]) != 0) {
+            wprintf(L"  %-28ls %ls (config: %ls)\n", tcp_label((TcpSettingId)i), have, want);
         } else {
-            any_unencrypted = 1;
+            wprintf(L"  %-28ls %ls\n", tcp_label((TcpSettingId)i), have);
         }
+    }
+    wprintf(L"\n");
+}
 
-        if (ipv6_servers[i].udpfallback) {
-            any_fallback = 1;
-        }
+/* ============================================================================
+ * NAME RESOLUTION FALLBACKS
+ * ============================================================================ */
 
-        wprintf(L"  %ls: %ls", ipv6_servers[i].address,
-            encrypted ? L"ENCRYPTED" : L"NOT ENCRYPTED");
+/*
+ * Printed under the encryption summary: names these send in the clear
+ * bypass DoH entirely
+ */
+static void print_fallback_status(void)
+{
+    FallbackState states[FALLBACK_COUNT];
+    RegistryBackend reg;
+    wchar_t guid[64];
 
-        if (ipv6_servers[i].has_template && ipv6_servers[i].udpfallback) {
-            wprintf(L" (fallback enabled)");
-        } else if (!ipv6_servers[i].has_template) {
-            wprintf(L" (no DoH template)");
-        }
-        wprintf(L"\n");
+    registry_backend_system(&reg);
+    if (network_get_guid(guid, 64) != 0 || fastpath_read_state(&reg, guid, states) != 0) {
+        return;
     }
 
-    wprintf(L"\n");
-    wprintf(L"Summary:\n");
+    wprintf(L"Name resolution fallbacks:\n");
     wprintf(L"----------------------------------------\n");
+    for (int i = 0; i < FALLBACK_COUNT; i++) {
+        wprintf(L"  %-28ls %ls\n", fastpath_label((FallbackId)i), fastpath_state_text(states[i]));
+    }
+    wprintf(L"\n");
+}
 
-    if (ipv4_total == 0) {
-        wprintf(L"  IPv4: NO DNS CONFIGURED\n");
-    } else if (ipv4_encrypted == ipv4_total) {
-        wprintf(L"  IPv4: ENCRYPTED (%d/%d servers)\n", ipv4_encrypted, ipv4_total);
-    } else {
-        wprintf(L"  IPv4: PARTIALLY ENCRYPTED (%d/%d servers)\n", ipv4_encrypted, ipv4_total);
+/* ============================================================================
+ * PREFIX POLICIES
+ * ============================================================================ */
+
+static void print_prefix_status(void)
+{
+    PrefixPolicyTable active, desired;
+    PrefixPreference preference;
+    PrefixPlan plan;
+
+    if (prefix_policy_read(&active) != 0 || active.count == 0) {
+        return;
     }
+    preference = prefix_policy_classify(&active);
 
-    if (ipv6_total == 0) {
-        wprintf(L"  IPv6: NO DNS CONFIGURED\n");
-    } else if (ipv6_encrypted == ipv6_total) {
-        wprintf(L"  IPv6: ENCRYPTED (%d/%d servers)\n", ipv6_encrypted, ipv6_total);
+    wprintf(L"IPv6 prefix policies:\n");
+    wprintf(L"----------------------------------------\n");
+    if (g_config.prefix_preference != PREFIX_NONE && prefix_policy_desired(&desired) == 0 &&
+        prefix_policy_diff(&desired, &active, &plan) > 0) {
+        wprintf(L"  Preference: %ls (config: %ls, %d difference(s))\n",
+                prefix_preference_name(preference),
+                prefix_preference_name(g_config.prefix_preference), plan.count);
     } else {
-        wprintf(L"  IPv6: PARTIALLY ENCRYPTED (%d/%d servers)\n", ipv6_encrypted, ipv6_total);
+        wprintf(L"  Preference: %ls\n", prefix_preference_name(preference));
+    }
+    if (preference == PREFIX_CUSTOM) {
+        for (int i = 0; i < active.count; i++) {
+            wprintf(L"    %-24ls precedence %3d  label %2d\n", active.items[i].text,
+                    active.items[i].precedence, active.items[i].label);
+        }
+    }
+    wprintf(L"\n");
+}
+
+/* ============================================================================
+ * RESOLVER CACHE
+ * ============================================================================ */
+
+static void print_dnscache_status(void)
+{
+    DnsCacheSettings current;
+    RegistryBackend reg;
+
+    registry_backend_system(&reg);
+    if (dnscache_read(&reg, &current) != 0 ||
+        (!dnscache_any(&current) && !dnscache_any(&g_config.resolver_cache))) {
+        return;
     }
 
-    wprintf(L"  Fallback: %ls\n", any_fallback ? L"ENABLED (insecure)" : L"DISABLED");
-    wprintf(L"  Unencrypted DNS: %ls\n", any_unencrypted ? L"YES (insecure)" : L"NONE");
+    wprintf(L"Resolver cache:\n");
+    wprintf(L"----------------------------------------\n");
+    for (int i = 0; i < DNSCACHE_SETTING_COUNT; i++) {
+        const DnsCacheSettings *want = &g_config.resolver_cache;
+        wchar_t have[32];
 
+        if (current.set[i]) {
+            StringCchPrintfW(have, 32, L"%lu", current.values[i]);
+        } else {
+            StringCchPrintfW(have, 32, L"%lu (default)", dnscache_default((DnsCacheSettingId)i));
+        }
+        if (want->set[i] && (!current.set[i] || want->values[i] != current.values[i])) {
+            wprintf(L"  %-28ls %ls (config: %lu)\n", dnscache_label((DnsCacheSettingId)i),
+                    have, want->values[i]);
+        } else {
+            wprintf(L"  %-28ls %ls\n", dnscache_label((DnsCacheSettingId)i), have);
+        }
+    }
     wprintf(L"\n");
+}
+
+/* ============================================================================
+ * STATUS REPORT
+ * ============================================================================ */
+
+int status_server_encrypted(const DnsServerInfo *info)
+{
+    return info->has_template && info->autoupgrade && !info->udpfallback;
+}
+
+void status_summarize(StatusReport *report)
+{
+    const DnsServerInfo *servers[2] = { report->ipv4, report->ipv6 };
+    const int counts[2] = { report->ipv4_count, report->ipv6_count };
+    int *encrypted[2] = { &report->ipv4_encrypted, &report->ipv6_encrypted };
+
+    report->any_fallback = 0;
+    report->any_unencrypted = 0;
+
+    for (int f = 0; f < 2; f++) {
+        *encrypted[f] = 0;
+        for (int i = 0; i < counts[f]; i++) {
+            if (status_server_encrypted(&servers[f][i])) {
+                (*encrypted[f])++;
+            } else {
+                report->any_unencrypted = 1;
+            }
+            if (servers[f][i].udpfallback) {
+                report->any_fallback = 1;
+            }
+        }
+    }
 
-    int fully_encrypted = (ipv4_total > 0 || ipv6_total > 0) &&
-                          (ipv4_encrypted == ipv4_total) &&
-                          (ipv6_encrypted == ipv6_total) &&
-                          !any_fallback;
-
-    if (ipv4_total == 0 && ipv6_total == 0) {
-        wprintf(L"Overall result: NO DNS CONFIGURED\n");
-        return 1;
-    } else if (fully_encrypted) {
-        wprintf(L"Overall result: OK (fully encrypted)\n");
-        return 0;
+    report->fully_encrypted = (report->ipv4_count > 0 || report->ipv6_count > 0) &&
+                              report->ipv4_encrypted == report->ipv4_count &&
+                              report->ipv6_encrypted == report->ipv6_count &&
+                              !report->any_fallback;
+}
+
+void status_collect(StatusReport *report)
+{
+    ZeroMemory(report, sizeof(*report));
+    StringCchCopyW(report->interface_name, MAX_IFACE_LEN, g_config.interface_name);
+    GetSystemTimeAsFileTime(&report->collected);
+
+    status_get_configured_dns(report->ipv4, &report->ipv4_count,
+                              report->ipv6, &report->ipv6_count);
+    status_summarize(report);
+    history_record(report);
+}
+
+int status_exit_code(const StatusReport *report)
+{
+    return report->fully_encrypted ? 0 : 1;
+}
+
+/* ============================================================================
+ * TEXT FORMAT
+ * ============================================================================ */
+
+static void append(wchar_t *buffer, size_t size, const wchar_t *format, ...)
+{
+    size_t len = wcslen(buffer);
+    va_list args;
+
+    va_start(args, format);
+    StringCchVPrintfW(buffer + len, size - len, format, args);
+    va_end(args);
+}
+
+static void append_servers(wchar_t *buffer, size_t size, const wchar_t *label,
+                           const DnsServerInfo *servers, int count)
+{
+    append(buffer, size, L"%ls DNS: ", label);
+    if (count == 0) {
+        append(buffer, size, L"(none configured)\n");
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        append(buffer, size, L"%ls%ls", servers[i].address, (i < count - 1) ? L", " : L"\n");
+    }
+}
+
+static void append_encryption(wchar_t *buffer, size_t size,
+                              const DnsServerInfo *servers, int count)
+{
+    for (int i = 0; i < count; i++) {
+        append(buffer, size, L"  %ls: %ls", servers[i].address,
+            status_server_encrypted(&servers[i]) ? L"ENCRYPTED" : L"NOT ENCRYPTED");
+
+        if (servers[i].has_template && servers[i].udpfallback) {
+            append(buffer, size, L" (fallback enabled)");
+        } else if (!servers[i].has_template) {
+            append(buffer, size, L" (no DoH template)");
+        }
+        append(buffer, size, L"\n");
+    }
+}
+
+static void append_family_summary(wchar_t *buffer, size_t size, const wchar_t *label,
+                                  int encrypted, int total)
+{
+    if (total == 0) {
+        append(buffer, size, L"  %ls: NO DNS CONFIGURED\n", label);
+    } else if (encrypted == total) {
+        append(buffer, size, L"  %ls: ENCRYPTED (%d/%d servers)\n", label, encrypted, total);
     } else {
-        wprintf(L"Overall result: NOT FULLY ENCRYPTED\n");
-        return 1;
+        append(buffer, size, L"  %ls: PARTIALLY ENCRYPTED (%d/%d servers)\n", label, encrypted, total);
+    }
+}
+
+void status_format_text(const StatusReport *report, wchar_t *buffer, size_t size)
+{
+    buffer[0] = L'\0';
+
+    append(buffer, size, L"\n");
+    append(buffer, size, L"Status for interface: %ls\n", report->interface_name);
+    append(buffer, size, L"========================================\n\n");
+
+    append_servers(buffer, size, L"IPv4", report->ipv4, report->ipv4_count);
+    append_servers(buffer, size, L"IPv6", report->ipv6, report->ipv6_count);
+
+    append(buffer, size, L"\n");
+    append(buffer, size, L"Encryption:\n");
+    append(buffer, size, L"----------------------------------------\n");
+    append_encryption(buffer, size, report->ipv4, report->ipv4_count);
+    append_encryption(buffer, size, report->ipv6, report->ipv6_count);
+
+    append(buffer, size, L"\n");
+    append(buffer, size, L"Summary:\n");
+    append(buffer, size, L"----------------------------------------\n");
+    append_family_summary(buffer, size, L"IPv4", report->ipv4_encrypted, report->ipv4_count);
+    append_family_summary(buffer, size, L"IPv6", report->ipv6_encrypted, report->ipv6_count);
+    append(buffer, size, L"  Fallback: %ls\n",
+        report->any_fallback ? L"ENABLED (insecure)" : L"DISABLED");
+    append(buffer, size, L"  Unencrypted DNS: %ls\n",
+        report->any_unencrypted ? L"YES (insecure)" : L"NONE");
+    append(buffer, size, L"\n");
+}
+
+const wchar_t *status_overall_text(const StatusReport *report)
+{
+    if (report->ipv4_count == 0 && report->ipv6_count == 0) {
+        return L"Overall result: NO DNS CONFIGURED\n";
+    }
+    if (report->fully_encrypted) {
+        return L"Overall result: OK (fully encrypted)\n";
+    }
+    return L"Overall result: NOT FULLY ENCRYPTED\n";
+}
+
+/* ============================================================================
+ * REPORT WRITER
+ * ============================================================================ */
+
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t len;
+    int overflow;
+} ReportWriter;
+
+static void writer_printf(ReportWriter *w, const char *format, ...)
+{
+    va_list args;
+    int n;
+
+    if (w->overflow) {
+        return;
+    }
+    va_start(args, format);
+    n = vsnprintf(w->buffer + w->len, w->size - w->len, format, args);
+    va_end(args);
+
+    if (n < 0 || (size_t)n >= w->size - w->len) {
+        w->overflow = 1;
+        return;
+    }
+    w->len += (size_t)n;
+}
+
+/*
+ * Write a quoted UTF-8 string; JSON and the Prometheus label syntax both
+ * escape '"' and '\\', and differ only in control characters
+ */
+static void writer_string(ReportWriter *w, const wchar_t *value, int json)
+{
+    char utf8[1024];
+
+    if (WideCharToMultiByte(CP_UTF8, 0, value, -1, utf8, sizeof(utf8), NULL, NULL) == 0) {
+        utf8[0] = '\0';
+    }
+
+    writer_printf(w, "\"");
+    for (const char *p = utf8; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '"' || c == '\\') {
+            writer_printf(w, "\\%c", c);
+        } else if (c == '\n' && !json) {
+            writer_printf(w, "\\n");
+        } else if (c < 0x20) {
+            if (json) {
+                writer_printf(w, "\\u%04x", c);
+            }
+        } else {
+            writer_printf(w, "%c", c);
+        }
     }
+    writer_printf(w, "\"");
+}
+
+/*
+ * FILETIME counts 100 ns since 1601; both formats carry Unix seconds
+ */
+ULONGLONG status_unix_seconds(const FILETIME *ft)
+{
+    ULARGE_INTEGER t;
+
+    t.LowPart = ft->dwLowDateTime;
+    t.HighPart = ft->dwHighDateTime;
+    return t.QuadPart >= 116444736000000000ULL ? t.QuadPart / 10000000ULL - 11644473600ULL : 0;
+}
+
+/* ============================================================================
+ * JSON FORMAT
+ * ============================================================================ */
+
+static void json_servers(ReportWriter *w, const char *key, const DnsServerInfo *servers, int count)
+{
+    writer_printf(w, "\"%s\":[", key);
+    for (int i = 0; i < count; i++) {
+        writer_printf(w, "%s{\"address\":", i ? "," : "");
+        writer_string(w, servers[i].address, 1);
+        writer_printf(w, ",\"doh_template\":");
+        writer_string(w, servers[i].doh_template, 1);
+        writer_printf(w, ",\"has_template\":%s,\"autoupgrade\":%s,\"udpfallback\":%s,\"encrypted\":%s}",
+                      servers[i].has_template ? "true" : "false",
+                      servers[i].autoupgrade ? "true" : "false",
+                      servers[i].udpfallback ? "true" : "false",
+                      status_server_encrypted(&servers[i]) ? "true" : "false");
+    }
+    writer_printf(w, "]");
+}
+
+int status_format_json(const StatusReport *report, char *buffer, size_t size)
+{
+    ReportWriter w = { buffer, size, 0, 0 };
+
+    writer_printf(&w, "{\"interface\":");
+    writer_string(&w, report->interface_name, 1);
+    writer_printf(&w, ",\"collected\":%llu,", status_unix_seconds(&report->collected));
+    json_servers(&w, "ipv4", report->ipv4, report->ipv4_count);
+    writer_printf(&w, ",");
+    json_servers(&w, "ipv6", report->ipv6, report->ipv6_count);
+    writer_printf(&w, ",\"ipv4_encrypted\":%d,\"ipv6_encrypted\":%d", report->ipv4_encrypted,
+                  report->ipv6_encrypted);
+    writer_printf(&w, ",\"fallback\":%s,\"unencrypted\":%s,\"fully_encrypted\":%s}\n",
+                  report->any_fallback ? "true" : "false",
+                  report->any_unencrypted ? "true" : "false",
+                  report->fully_encrypted ? "true" : "false");
+
+    return w.overflow ? -1 : (int)w.len;
+}
+
+/* ============================================================================
+ * PROMETHEUS FORMAT
+ * ============================================================================ */
+
+#define PROM_PREFIX "static_ip_fix_dns_"
+
+typedef enum {
+    PROM_HAS_TEMPLATE,
+    PROM_AUTOUPGRADE,
+    PROM_UDPFALLBACK,
+    PROM_ENCRYPTED
+} PromServerField;
+
+static const struct {
+    const char *name;
+    const char *help;
+} prom_server_metrics[] = {
+    { "server_has_template", "DNS server has a DoH template (1) or not (0)" },
+    { "server_autoupgrade",  "DNS server is upgraded to DoH automatically" },
+    { "server_udpfallback",  "DNS server may fall back to plain UDP" },
+    { "server_encrypted",    "DNS server has a DoH template, autoupgrade and no fallback" },
+};
+
+static int prom_server_value(const DnsServerInfo *info, PromServerField field)
+{
+    switch (field) {
+    case PROM_HAS_TEMPLATE: return info->has_template ? 1 : 0;
+    case PROM_AUTOUPGRADE:  return info->autoupgrade ? 1 : 0;
+    case PROM_UDPFALLBACK:  return info->udpfallback ? 1 : 0;
+    default:                return status_server_encrypted(info) ? 1 : 0;
+    }
+}
+
+static void prom_header(ReportWriter *w, const char *name, const char *help)
+{
+    writer_printf(w, "# HELP " PROM_PREFIX "%s %s\n", name, help);
+    writer_printf(w, "# TYPE " PROM_PREFIX "%s gauge\n", name);
+}
+
+/*
+ * One sample: name{interface="..."[,family="..."[,server="..."]]} value
+ */
+static void prom_sample(ReportWriter *w, const char *name, const StatusReport *report,
+                        const char *family, const wchar_t *server, ULONGLONG value)
+{
+    writer_printf(w, PROM_PREFIX "%s{interface=", name);
+    writer_string(w, report->interface_name, 0);
+    if (family) {
+        writer_printf(w, ",family=\"%s\"", family);
+    }
+    if (server) {
+        writer_printf(w, ",server=");
+        writer_string(w, server, 0);
+    }
+    writer_printf(w, "} %llu\n", value);
+}
+
+int status_format_prometheus(const StatusReport *report, char *buffer, size_t size)
+{
+    ReportWriter w = { buffer, size, 0, 0 };
+    const char *families[2] = { "ipv4", "ipv6" };
+    const DnsServerInfo *servers[2] = { report->ipv4, report->ipv6 };
+    const int counts[2] = { report->ipv4_count, report->ipv6_count };
+    const int encrypted[2] = { report->ipv4_encrypted, report->ipv6_encrypted };
+
+    buffer[0] = '\0';
+
+    /* Every sample of a metric has to follow its HELP/TYPE block */
+    for (int m = PROM_HAS_TEMPLATE; m <= PROM_ENCRYPTED; m++) {
+        prom_header(&w, prom_server_metrics[m].name, prom_server_metrics[m].help);
+        for (int f = 0; f < 2; f++) {
+            for (int i = 0; i < counts[f]; i++) {
+                prom_sample(&w, prom_server_metrics[m].name, report, families[f],
+                            servers[f][i].address,
+                            (ULONGLONG)prom_server_value(&servers[f][i], (PromServerField)m));
+            }
+        }
+    }
+
+    prom_header(&w, "servers", "DNS servers configured on the interface");
+    for (int f = 0; f < 2; f++) {
+        prom_sample(&w, "servers", report, families[f], NULL, (ULONGLONG)counts[f]);
+    }
+    prom_header(&w, "servers_encrypted", "Encrypted DNS servers on the interface");
+    for (int f = 0; f < 2; f++) {
+        prom_sample(&w, "servers_encrypted", report, families[f], NULL, (ULONGLONG)encrypted[f]);
+    }
+
+    prom_header(&w, "fallback", "Any DNS server may fall back to plain UDP");
+    prom_sample(&w, "fallback", report, NULL, NULL, report->any_fallback ? 1 : 0);
+    prom_header(&w, "unencrypted", "Any DNS server is not encrypted");
+    prom_sample(&w, "unencrypted", report, NULL, NULL, report->any_unencrypted ? 1 : 0);
+    prom_header(&w, "fully_encrypted", "All DNS servers are encrypted (status exit code 0)");
+    prom_sample(&w, "fully_encrypted", report, NULL, NULL, report->fully_encrypted ? 1 : 0);
+    prom_header(&w, "collected_timestamp_seconds", "Unix time the status was collected");
+    prom_sample(&w, "collected_timestamp_seconds", report, NULL, NULL,
+                status_unix_seconds(&report->collected));
+
+    return w.overflow ? -1 : (int)w.len;
+}
+
+/* ============================================================================
+ * STATUS MODE
+ * ============================================================================ */
+
+int status_run(void)
+{
+    StatusReport report;
+    wchar_t text[STATUS_TEXT_SIZE];
+
+    status_collect(&report);
+
+    if (g_config.status_json) {
+        char json[STATUS_JSON_SIZE];
+        int len = status_format_json(&report, json, sizeof(json));
+        if (len < 0) {
+            print_error(L"Status report too large");
+            return 1;
+        }
+        print_raw(json, (size_t)len);
+        return status_exit_code(&report);
+    }
+
+    status_format_text(&report, text, STATUS_TEXT_SIZE);
+    wprintf(L"%ls", text);
+    print_fallback_status();
+    print_mtu_status();
+    print_suffix_status(&report);
+    print_nrpt_status();
+    print_tcp_status();
+    print_prefix_status();
+    print_dnscache_status();
+    wprintf(L"%ls", status_overall_text(&report));
+
+    return status_exit_code(&report);
 }
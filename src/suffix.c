@@ -0,0 +1,270 @@
+/*
+ * suffix.c - DNS suffix search list ([dns] suffixes)
+ */
+
+#include <winsock2.h>
+#include "suffix.h"
+#include "config.h"
+#include <string.h>
+
+/* ============================================================================
+ * PARSING
+ * ============================================================================ */
+
+/*
+ * Letters, digits, '-' and '_', in dot-separated labels of 1 to 63
+ */
+static int valid_suffix(const wchar_t *name)
+{
+    size_t label = 0, total = wcslen(name);
+
+    if (total == 0 || total > 253) {
+        return 0;
+    }
+    for (const wchar_t *p = name; *p; p++) {
+        if (*p == L'.') {
+            if (label == 0) return 0;
+            label = 0;
+            continue;
+        }
+        if (!((*p >= L'a' && *p <= L'z') || (*p >= L'0' && *p <= L'9') ||
+              *p == L'-' || *p == L'_') || ++label > 63) {
+            return 0;
+        }
+    }
+    return label > 0;
+}
+
+int suffix_parse(const wchar_t *text, SuffixList *out)
+{
+    wchar_t buf[SUFFIX_LIST_LEN];
+    wchar_t *p;
+
+    ZeroMemory(out, sizeof(*out));
+    if (FAILED(StringCchCopyW(buf, SUFFIX_LIST_LEN, text))) {
+        return -1;
+    }
+
+    p = buf;
+    while (*p) {
+        wchar_t *start, *end;
+        int seen = 0;
+
+        while (*p && (iswspace(*p) || *p == L',' || *p == L';')) p++;
+        if (*p == L'\0') break;
+
+        start = p;
+        while (*p && !iswspace(*p) && *p != L',' && *p != L';') {
+            *p = towlower(*p);
+            p++;
+        }
+        if (*p) *p++ = L'\0';
+
+        /* ".corp.example.com." and "corp.example.com" are the same suffix */
+        while (*start == L'.') start++;
+        end = start + wcslen(start);
+        while (end > start && end[-1] == L'.') *--end = L'\0';
+
+        if (!valid_suffix(start)) {
+            return -1;
+        }
+        for (int i = 0; i < out->count && !seen; i++) {
+            seen = wcscmp(out->items[i], start) == 0;
+        }
+        if (seen) {
+            continue;
+        }
+        if (out->count == SUFFIX_MAX) {
+            return -1;
+        }
+        StringCchCopyW(out->items[out->count++], SUFFIX_LEN, start);
+    }
+    return 0;
+}
+
+void suffix_format(const SuffixList *list, wchar_t *buffer, size_t size)
+{
+    buffer[0] = L'\0';
+    for (int i = 0; i < list->count; i++) {
+        if (i > 0) {
+            StringCchCatW(buffer, size, L",");
+        }
+        StringCchCatW(buffer, size, list->items[i]);
+    }
+}
+
+int suffix_equal(const SuffixList *a, const SuffixList *b)
+{
+    if (a->count != b->count) {
+        return 0;
+    }
+    for (int i = 0; i < a->count; i++) {
+        if (wcscmp(a->items[i], b->items[i]) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int suffix_worst_case_queries(const SuffixList *list)
+{
+    return list->count * SUFFIX_QUERIES_PER_NAME;
+}
+
+/* ============================================================================
+ * REGISTRY
+ * ============================================================================ */
+
+int suffix_read(const RegistryBackend *reg, SuffixList *out)
+{
+    wchar_t value[SUFFIX_LIST_LEN];
+    int ret;
+
+    ZeroMemory(out, sizeof(*out));
+    ret = reg->get_string(reg->ctx, SUFFIX_REGISTRY_KEY, SUFFIX_VALUE_NAME, value, SUFFIX_LIST_LEN);
+    if (ret < 0) {
+        return -1;
+    }
+    if (ret > 0) {
+        return 0;
+    }
+    /* Names added by hand that we would reject still count */
+    if (suffix_parse(value, out) != 0) {
+        wchar_t *p, *next;
+
+        ZeroMemory(out, sizeof(*out));
+        for (p = value; p && *p && out->count < SUFFIX_MAX; p = next) {
+            next = wcschr(p, L',');
+            if (next) *next++ = L'\0';
+            if (*p) {
+                StringCchCopyW(out->items[out->count++], SUFFIX_LEN, p);
+            }
+        }
+    }
+    return 0;
+}
+
+int suffix_sync(const RegistryBackend *reg, const SuffixList *desired, SuffixList *previous)
+{
+    wchar_t value[SUFFIX_LIST_LEN];
+
+    if (suffix_read(reg, previous) != 0) {
+        return -1;
+    }
+    if (suffix_equal(desired, previous)) {
+        return 0;
+    }
+
+    suffix_format(desired, value, SUFFIX_LIST_LEN);
+    return reg->set_string(reg->ctx, SUFFIX_REGISTRY_KEY, SUFFIX_VALUE_NAME, value, 0) == 0 ? 1 : -1;
+}
+
+/* ============================================================================
+ * LOOKUP COST
+ * ============================================================================ */
+
+int suffix_measure(const ProbeTarget *servers, int server_count, const SuffixList *list,
+                   int samples, int timeout_ms, double *cost_ms)
+{
+    ProbeStats stats[PROBE_MAX_TARGETS];
+    ProbeOptions opts;
+    unsigned int nonce = (unsigned int)GetTickCount64();
+
+    if (server_count <= 0 || server_count > PROBE_MAX_TARGETS ||
+        samples <= 0 || samples > PROBE_MAX_NAMES) {
+        return -1;
+    }
+
+    for (int i = 0; i < list->count; i++) {
+        ZeroMemory(&opts, sizeof(opts));
+        opts.count = samples;
+        opts.timeout_ms = timeout_ms;
+        opts.name_count = samples;
+
+        /* A fresh name per query, so no resolver answers from its cache */
+        for (int k = 0; k < samples; k++) {
+            StringCchPrintfA(opts.names[k], PROBE_NAME_LEN, "sfx-%08x-%d.%ls",
+                             nonce, i * PROBE_MAX_NAMES + k, list->items[i]);
+        }
+
+        if (probe_run(servers, server_count, &opts, stats) != 0) {
+            return -1;
+        }
+
+        /* Windows moves to the next server only when one stays silent */
+        cost_ms[i] = timeout_ms;
+        for (int s = 0; s < server_count; s++) {
+            if (stats[s].answered > 0) {
+                cost_ms[i] = stats[s].median_ms;
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * APPLY AND ROLLBACK
+ * ============================================================================ */
+
+/* List replaced by the last suffix_apply */
+static SuffixList g_suffix_previous;
+static int g_suffix_changed;
+
+int suffix_apply(void)
+{
+    RegistryBackend reg;
+    wchar_t list[SUFFIX_LIST_LEN], before[SUFFIX_LIST_LEN];
+    wchar_t msg[2 * SUFFIX_LIST_LEN + 64];
+    int ret;
+
+    g_suffix_changed = 0;
+    if (!g_config.has_suffixes) {
+        return 0;
+    }
+
+    registry_backend_system(&reg);
+    ret = suffix_sync(&reg, &g_config.dns_suffixes, &g_suffix_previous);
+    if (ret < 0) {
+        print_error(L"Failed to set the DNS suffix search list");
+        return -1;
+    }
+
+    suffix_format(&g_config.dns_suffixes, list, SUFFIX_LIST_LEN);
+    if (ret == 0) {
+        StringCchPrintfW(msg, 2 * SUFFIX_LIST_LEN + 64,
+                         L"DNS suffix search list already in place: %ls",
+                         list[0] ? list : L"(empty)");
+        print_success(msg);
+        return 0;
+    }
+
+    g_suffix_changed = 1;
+    suffix_format(&g_suffix_previous, before, SUFFIX_LIST_LEN);
+    StringCchPrintfW(msg, 2 * SUFFIX_LIST_LEN + 64, L"DNS suffix search list set: %ls (was: %ls)",
+                     list[0] ? list : L"(empty)", before[0] ? before : L"(empty)");
+    print_success(msg);
+    return 0;
+}
+
+void suffix_rollback(void)
+{
+    RegistryBackend reg;
+    wchar_t value[SUFFIX_LIST_LEN];
+
+    if (!g_suffix_changed) {
+        return;
+    }
+    g_suffix_changed = 0;
+
+    registry_backend_system(&reg);
+    suffix_format(&g_suffix_previous, value, SUFFIX_LIST_LEN);
+    if (reg.set_string(reg.ctx, SUFFIX_REGISTRY_KEY, SUFFIX_VALUE_NAME, value, 0) == 0) {
+        print_info(L"DNS suffix search list restored");
+    }
+}
+
+void suffix_forget(void)
+{
+    g_suffix_changed = 0;
+}
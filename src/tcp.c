@@ -0,0 +1,235 @@
+/*
+ * tcp.c - Global TCP/IP stack settings ([tcp])
+ */
+
+#include "tcp.h"
+#include "config.h"
+#include "process.h"
+#include <string.h>
+
+/* ============================================================================
+ * SETTING TABLE
+ * ============================================================================ */
+
+typedef struct {
+    const wchar_t *key;             /* [tcp] key and --tcp-KEY flag */
+    const wchar_t *label;           /* Shown by status */
+    const char *netsh_label;        /* Line in "tcp show global" */
+    const wchar_t *netsh_name;      /* Parameter of "tcp set global" */
+    const wchar_t *allowed[6];
+} TcpField;
+
+static const TcpField TCP_FIELDS[TCP_SETTING_COUNT] = {
+    { L"autotuning", L"Receive window auto-tuning", "Receive Window Auto-Tuning Level",
+      L"autotuninglevel",
+      { L"disabled", L"highlyrestricted", L"restricted", L"normal", L"experimental", NULL } },
+    { L"rss", L"Receive-side scaling", "Receive-Side Scaling State",
+      L"rss", { L"enabled", L"disabled", NULL } },
+    { L"ecn", L"ECN capability", "ECN Capability",
+      L"ecncapability", { L"enabled", L"disabled", L"default", NULL } },
+    { L"rsc", L"Receive segment coalescing", "Receive Segment Coalescing State",
+      L"rsc", { L"enabled", L"disabled", NULL } },
+};
+
+/* Values replaced by the last tcp_apply */
+static TcpSettings g_tcp_previous;
+static int g_tcp_changed;
+
+const wchar_t *tcp_key(TcpSettingId id)
+{
+    return TCP_FIELDS[id].key;
+}
+
+const wchar_t *tcp_label(TcpSettingId id)
+{
+    return TCP_FIELDS[id].label;
+}
+
+int tcp_set(TcpSettings *settings, const wchar_t *key, const wchar_t *value)
+{
+    for (int i = 0; i < TCP_SETTING_COUNT; i++) {
+        if (_wcsicmp(key, TCP_FIELDS[i].key) != 0) {
+            continue;
+        }
+        for (int k = 0; TCP_FIELDS[i].allowed[k]; k++) {
+            if (_wcsicmp(value, TCP_FIELDS[i].allowed[k]) == 0) {
+                StringCchCopyW(settings->values[i], TCP_VALUE_LEN, TCP_FIELDS[i].allowed[k]);
+                return 0;
+            }
+        }
+        return -1;
+    }
+    return -1;
+}
+
+int tcp_any(const TcpSettings *settings)
+{
+    for (int i = 0; i < TCP_SETTING_COUNT; i++) {
+        if (settings->values[i][0] != L'\0') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * DIFF
+ * ============================================================================ */
+
+void tcp_parse_global(const char *output, TcpSettings *out)
+{
+    ZeroMemory(out, sizeof(*out));
+
+    for (const char *line = output; line && *line; ) {
+        const char *end = strchr(line, '\n');
+        size_t len = end ? (size_t)(end - line) : strlen(line);
+
+        for (int i = 0; i < TCP_SETTING_COUNT; i++) {
+            size_t label_len = strlen(TCP_FIELDS[i].netsh_label);
+            const char *colon;
+            size_t n = 0;
+
+            if (len <= label_len || strncmp(line, TCP_FIELDS[i].netsh_label, label_len) != 0) {
+                continue;
+            }
+            colon = memchr(line + label_len, ':', len - label_len);
+            if (!colon) {
+                continue;
+            }
+            for (colon++; colon < line + len && *colon == ' '; colon++);
+
+            /* Lower case, so "Enabled" and "enabled" compare equal */
+            while (colon + n < line + len && n < TCP_VALUE_LEN - 1 &&
+                   colon[n] != '\r' && colon[n] != ' ') {
+                char c = colon[n];
+                out->values[i][n++] = (wchar_t)(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+            }
+            out->values[i][n] = L'\0';
+        }
+
+        line = end ? end + 1 : NULL;
+    }
+}
+
+int tcp_diff(const TcpSettings *desired, const TcpSettings *current, TcpSettings *changes)
+{
+    int count = 0;
+
+    ZeroMemory(changes, sizeof(*changes));
+    for (int i = 0; i < TCP_SETTING_COUNT; i++) {
+        if (desired->values[i][0] != L'\0' &&
+            _wcsicmp(desired->values[i], current->values[i]) != 0) {
+            StringCchCopyW(changes->values[i], TCP_VALUE_LEN, desired->values[i]);
+            count++;
+        }
+    }
+    return count;
+}
+
+int tcp_build_command(const TcpSettings *settings, wchar_t *args, size_t size)
+{
+    if (!tcp_any(settings) ||
+        FAILED(StringCchCopyW(args, size, L"interface tcp set global"))) {
+        return -1;
+    }
+    for (int i = 0; i < TCP_SETTING_COUNT; i++) {
+        if (settings->values[i][0] == L'\0') {
+            continue;
+        }
+        if (FAILED(StringCchCatW(args, size, L" ")) ||
+            FAILED(StringCchCatW(args, size, TCP_FIELDS[i].netsh_name)) ||
+            FAILED(StringCchCatW(args, size, L"=")) ||
+            FAILED(StringCchCatW(args, size, settings->values[i]))) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * APPLY AND ROLLBACK
+ * ============================================================================ */
+
+int tcp_read_global(TcpSettings *out)
+{
+    char buffer[PIPE_BUFFER_SIZE];
+
+    if (run_netsh_capture(L"interface tcp show global", buffer, sizeof(buffer)) != 0) {
+        ZeroMemory(out, sizeof(*out));
+        return -1;
+    }
+    tcp_parse_global(buffer, out);
+    return 0;
+}
+
+int tcp_apply(void)
+{
+    TcpSettings current, changes;
+    wchar_t args[CMD_BUFFER_SIZE];
+    wchar_t msg[256];
+    int count;
+
+    /* Forget an earlier run's values: tcp_rollback puts back only the
+       globals this run sets, with the values read just below */
+    g_tcp_changed = 0;
+    ZeroMemory(&g_tcp_previous, sizeof(g_tcp_previous));
+
+    if (!tcp_any(&g_config.tcp)) {
+        return 0;
+    }
+
+    print_info(L"Checking global TCP settings...");
+    if (tcp_read_global(&current) != 0) {
+        print_error(L"Failed to read global TCP settings");
+        return -1;
+    }
+
+    count = tcp_diff(&g_config.tcp, &current, &changes);
+    if (count == 0) {
+        print_success(L"Global TCP settings already in place");
+        return 0;
+    }
+
+    for (int i = 0; i < TCP_SETTING_COUNT; i++) {
+        if (changes.values[i][0] != L'\0') {
+            StringCchCopyW(g_tcp_previous.values[i], TCP_VALUE_LEN, current.values[i]);
+            StringCchPrintfW(msg, 256, L"  %ls: %ls -> %ls", TCP_FIELDS[i].label,
+                             current.values[i][0] ? current.values[i] : L"(unknown)",
+                             changes.values[i]);
+            wprintf(L"%ls\n", msg);
+        }
+    }
+
+    /* A failed call may have applied some of the values */
+    g_tcp_changed = 1;
+    if (tcp_build_command(&changes, args, CMD_BUFFER_SIZE) != 0 ||
+        run_netsh_retry(&g_config.retry[RETRY_TCP], args) != 0) {
+        print_error(L"Failed to set global TCP settings");
+        return -1;
+    }
+
+    StringCchPrintfW(msg, 256, L"Global TCP settings applied (%d changed)", count);
+    print_success(msg);
+    return 0;
+}
+
+void tcp_rollback(void)
+{
+    wchar_t args[CMD_BUFFER_SIZE];
+
+    if (!g_tcp_changed) {
+        return;
+    }
+    g_tcp_changed = 0;
+
+    /* Values that were not reported cannot be put back */
+    if (tcp_build_command(&g_tcp_previous, args, CMD_BUFFER_SIZE) == 0) {
+        run_netsh_silent(args);
+        print_info(L"Global TCP settings restored");
+    }
+}
+
+void tcp_forget(void)
+{
+    g_tcp_changed = 0;
+}
@@ -23,6 +23,15 @@ void print_success(const wchar_t *msg)
     wprintf(L"[OK] %ls\n", msg);
 }
 
+void print_raw(const char *data, size_t len)
+{
+    DWORD written;
+
+    /* Bypass the CRT so UTF-8 bytes reach a pipe or file unchanged */
+    fflush(stdout);
+    WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), data, (DWORD)len, &written, NULL);
+}
+
 /* ============================================================================
  * STRING HELPERS
  * ============================================================================ */
@@ -88,6 +97,24 @@ char *find_ipv6(char *str)
     return NULL;
 }
 
+/* ============================================================================
+ * TIMING
+ * ============================================================================ */
+
+LONGLONG timer_now(void)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+double timer_elapsed_ms(LONGLONG start)
+{
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    return (double)(timer_now() - start) * 1000.0 / (double)freq.QuadPart;
+}
+
 /* ============================================================================
  * VALIDATION
  * ============================================================================ */
@@ -0,0 +1,303 @@
+/*
+ * validate.c - Offline pre-flight validation of the resolved configuration
+ */
+
+#include <stdarg.h>
+#include "validate.h"
+
+/* ============================================================================
+ * REPORT
+ * ============================================================================ */
+
+static void report_add(ValidationReport *report, const wchar_t *format, ...)
+{
+    va_list args;
+
+    if (report->count >= VALIDATE_MAX_ERRORS) {
+        report->dropped++;
+        return;
+    }
+    va_start(args, format);
+    StringCchVPrintfW(report->messages[report->count++], VALIDATE_MESSAGE_LEN, format, args);
+    va_end(args);
+}
+
+/*
+ * Parse a bare address (no "/prefix") of the given family
+ */
+static int parse_host(const wchar_t *text, int family, IpAddr *out)
+{
+    return address_parse(text, out) == 0 && out->family == family && out->prefix < 0 ? 0 : -1;
+}
+
+/* ============================================================================
+ * STATIC ADDRESSES
+ * ============================================================================ */
+
+/*
+ * The all-zeros and all-ones host parts of subnets with room for them
+ */
+static int is_network_or_broadcast(const IpAddr *addr, int prefix)
+{
+    DWORD value, host_mask;
+
+    if (prefix > 30) {
+        return 0;
+    }
+    value = ((DWORD)addr->bytes[0] << 24) | ((DWORD)addr->bytes[1] << 16) |
+            ((DWORD)addr->bytes[2] << 8) | (DWORD)addr->bytes[3];
+    host_mask = prefix == 0 ? 0xFFFFFFFFu : (1u << (32 - prefix)) - 1;
+    return (value & host_mask) == 0 || (value & host_mask) == host_mask;
+}
+
+static void check_secondaries(const IpAddrList *list, const IpAddr *primary,
+                              const wchar_t *section, ValidationReport *report)
+{
+    for (int i = 0; i < list->count; i++) {
+        if (address_compare(&list->items[i], primary) == 0) {
+            wchar_t text[MAX_ADDR_LEN];
+            address_format(&list->items[i], text, MAX_ADDR_LEN);
+            report_add(report, L"[%ls] repeats the primary address %ls", section, text);
+        }
+    }
+}
+
+/*
+ * A skipped entry would leave the sync with a partial desired set, and
+ * it removes whatever live address is missing from that set
+ */
+static void check_invalid_entries(const IpAddrList *list, const wchar_t *section,
+                                  ValidationReport *report)
+{
+    if (list->invalid > 0) {
+        report_add(report, L"[%ls] has %d entry(ies) that could not be loaded",
+                   section, list->invalid);
+    }
+}
+
+static void check_ipv4(const Config *config, ValidationReport *report)
+{
+    IpAddr address, gateway;
+    int prefix;
+
+    if (parse_host(config->ipv4_address, AF_INET, &address) != 0) {
+        report_add(report, L"IPv4 address is not valid: %ls", config->ipv4_address);
+        return;
+    }
+
+    prefix = address_mask_to_prefix(config->ipv4_mask);
+    if (prefix <= 0) {
+        report_add(report, L"IPv4 mask is not a contiguous netmask: %ls", config->ipv4_mask);
+        return;
+    }
+    if (is_network_or_broadcast(&address, prefix)) {
+        report_add(report, L"IPv4 address %ls is the network or broadcast address of its /%d",
+                   config->ipv4_address, prefix);
+    }
+    check_secondaries(&config->ipv4_addresses, &address, L"ipv4.addresses", report);
+
+    if (config->ipv4_gateway[0] == L'\0') {
+        return;
+    }
+    if (parse_host(config->ipv4_gateway, AF_INET, &gateway) != 0) {
+        report_add(report, L"IPv4 gateway is not valid: %ls", config->ipv4_gateway);
+        return;
+    }
+    address.prefix = prefix;
+    if (!address_in_prefix(&gateway, &address)) {
+        report_add(report, L"IPv4 gateway %ls is outside %ls/%d",
+                   config->ipv4_gateway, config->ipv4_address, prefix);
+    } else if (address_compare(&gateway, &address) == 0) {
+        report_add(report, L"IPv4 gateway %ls is the interface's own address", config->ipv4_gateway);
+    } else if (is_network_or_broadcast(&gateway, prefix)) {
+        report_add(report, L"IPv4 gateway %ls is the network or broadcast address of its /%d",
+                   config->ipv4_gateway, prefix);
+    }
+}
+
+static void check_ipv6(const Config *config, ValidationReport *report)
+{
+    static const IpAddr link_local = { AF_INET6, { 0xFE, 0x80 }, 10 };
+    IpAddr address, gateway;
+    wchar_t *end;
+    long prefix;
+
+    if (parse_host(config->ipv6_address, AF_INET6, &address) != 0) {
+        report_add(report, L"IPv6 address is not valid: %ls", config->ipv6_address);
+        return;
+    }
+    check_secondaries(&config->ipv6_addresses, &address, L"ipv6.addresses", report);
+
+    prefix = wcstol(config->ipv6_prefix, &end, 10);
+    if (end == config->ipv6_prefix || *end != L'\0' || prefix < 1 || prefix > 128) {
+        report_add(report, L"IPv6 prefix length must be 1-128: %ls", config->ipv6_prefix);
+        prefix = -1;
+    }
+
+    if (config->ipv6_gateway[0] == L'\0') {
+        return;
+    }
+    if (parse_host(config->ipv6_gateway, AF_INET6, &gateway) != 0) {
+        report_add(report, L"IPv6 gateway is not valid: %ls", config->ipv6_gateway);
+        return;
+    }
+    if (address_compare(&gateway, &address) == 0) {
+        report_add(report, L"IPv6 gateway %ls is the interface's own address", config->ipv6_gateway);
+        return;
+    }
+
+    /* Routers usually advertise a link-local next hop, which is always on-link */
+    address.prefix = (int)prefix;
+    if (prefix > 0 && !address_in_prefix(&gateway, &link_local) &&
+        !address_in_prefix(&gateway, &address)) {
+        report_add(report, L"IPv6 gateway %ls is outside %ls/%ld and not link-local",
+                   config->ipv6_gateway, config->ipv6_address, prefix);
+    }
+}
+
+/* ============================================================================
+ * DNS SERVERS AND DOH
+ * ============================================================================ */
+
+static void check_servers(const DnsProvider *provider, int family,
+                          const wchar_t *primary, const wchar_t *secondary,
+                          ValidationReport *report)
+{
+    const wchar_t *label = family == AF_INET ? L"IPv4" : L"IPv6";
+    const wchar_t *servers[2] = { primary, secondary };
+    const wchar_t *rank[2] = { L"primary", L"secondary" };
+    IpAddr parsed[2];
+    int valid = 0;
+
+    for (int i = 0; i < 2; i++) {
+        if (!servers[i] || servers[i][0] == L'\0') {
+            report_add(report, L"%ls: %ls %ls DNS server is missing", provider->name, label, rank[i]);
+        } else if (parse_host(servers[i], family, &parsed[i]) != 0) {
+            report_add(report, L"%ls: %ls %ls DNS server is not valid: %ls",
+                       provider->name, label, rank[i], servers[i]);
+        } else {
+            valid++;
+        }
+    }
+
+    if (valid == 2 && address_compare(&parsed[0], &parsed[1]) == 0) {
+        report_add(report, L"%ls: %ls DNS server %ls is listed twice", provider->name, label, primary);
+    }
+}
+
+static int is_host_char(wchar_t c)
+{
+    return (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') ||
+           (c >= L'0' && c <= L'9') || c == L'-' || c == L'.';
+}
+
+const wchar_t *validate_doh_template(const wchar_t *url)
+{
+    const wchar_t *p;
+
+    if (!url || url[0] == L'\0') {
+        return L"is missing";
+    }
+    for (p = url; *p; p++) {
+        if (*p <= L' ' || *p == L'"' || *p == 0x7F) {
+            return L"contains spaces, quotes or control characters";
+        }
+    }
+    if (_wcsnicmp(url, L"https://", 8) != 0) {
+        return L"must start with https://";
+    }
+
+    /* Host: a DNS name or a bracketed IPv6 literal */
+    p = url + 8;
+    if (*p == L'[') {
+        wchar_t literal[MAX_ADDR_LEN];
+        const wchar_t *close = wcschr(p, L']');
+        IpAddr addr;
+
+        if (!close || close - p - 1 <= 0 || close - p - 1 >= MAX_ADDR_LEN) {
+            return L"has an invalid IPv6 host";
+        }
+        StringCchCopyNW(literal, MAX_ADDR_LEN, p + 1, (size_t)(close - p - 1));
+        if (parse_host(literal, AF_INET6, &addr) != 0) {
+            return L"has an invalid IPv6 host";
+        }
+        p = close + 1;
+    } else {
+        const wchar_t *host = p;
+        while (is_host_char(*p)) p++;
+        if (p == host || *host == L'.' || *host == L'-' || p[-1] == L'-') {
+            return L"has no valid host name";
+        }
+    }
+
+    if (*p == L':') {
+        long port = 0;
+        const wchar_t *digits = ++p;
+        while (*p >= L'0' && *p <= L'9' && port <= 65535) {
+            port = port * 10 + (*p++ - L'0');
+        }
+        if (p == digits || port < 1 || port > 65535) {
+            return L"has an invalid port";
+        }
+    }
+
+    if (*p != L'/') {
+        return L"has no path (e.g. /dns-query)";
+    }
+    if (wcschr(p, L'#')) {
+        return L"must not contain a fragment";
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * VALIDATION
+ * ============================================================================ */
+
+int validate_config(const Config *config, const DnsProvider *provider, ValidationReport *report)
+{
+    const wchar_t *problem;
+
+    ZeroMemory(report, sizeof(*report));
+
+    if (!config->dns_only) {
+        check_invalid_entries(&config->ipv4_addresses, L"ipv4.addresses", report);
+        check_invalid_entries(&config->ipv6_addresses, L"ipv6.addresses", report);
+        if (config->has_ipv4 && config->ipv4_address[0] != L'\0') {
+            check_ipv4(config, report);
+        }
+        if (config->has_ipv6 && config->ipv6_address[0] != L'\0') {
+            check_ipv6(config, report);
+        }
+    }
+
+    check_servers(provider, AF_INET, provider->ipv4_primary, provider->ipv4_secondary, report);
+    check_servers(provider, AF_INET6, provider->ipv6_primary, provider->ipv6_secondary, report);
+
+    problem = validate_doh_template(provider->doh_template);
+    if (problem && (!provider->doh_template || provider->doh_template[0] == L'\0')) {
+        report_add(report, L"%ls: DoH template %ls", provider->name, problem);
+    } else if (problem) {
+        report_add(report, L"%ls: DoH template %ls %ls", provider->name, provider->doh_template, problem);
+    }
+
+    return report->count + report->dropped;
+}
+
+int validate_preflight(const DnsProvider *provider)
+{
+    ValidationReport report;
+    wchar_t msg[128];
+    int problems = validate_config(&g_config, provider, &report);
+
+    if (problems == 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < report.count; i++) {
+        print_error(report.messages[i]);
+    }
+    StringCchPrintfW(msg, 128, L"%d configuration problem(s) found, nothing was changed", problems);
+    print_error(msg);
+    return -1;
+}
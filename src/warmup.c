@@ -0,0 +1,188 @@
+/*
+ * warmup.c - Resolver cache warm-up after switching DNS providers
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "warmup.h"
+#include "config.h"
+
+/* ============================================================================
+ * OPTIONS
+ * ============================================================================ */
+
+void warmup_options_init(WarmupOptions *opts)
+{
+    ZeroMemory(opts, sizeof(*opts));
+    opts->concurrency = WARMUP_DEFAULT_CONCURRENCY;
+}
+
+int warmup_set_names(WarmupOptions *opts, const wchar_t *value)
+{
+    wchar_t buf[CONFIG_LINE_SIZE];
+    wchar_t *token, *context = NULL;
+    int ret = 0;
+
+    StringCchCopyW(buf, CONFIG_LINE_SIZE, value);
+    opts->name_count = 0;
+
+    for (token = wcstok_s(buf, L", ", &context); token; token = wcstok_s(NULL, L", ", &context)) {
+        char *name = opts->names[opts->name_count];
+        size_t len = wcslen(token);
+        int ascii = len < PROBE_NAME_LEN && opts->name_count < WARMUP_MAX_NAMES;
+
+        for (size_t i = 0; ascii && i < len; i++) {
+            ascii = token[i] > 0x20 && token[i] < 0x7F;
+            name[i] = (char)token[i];
+        }
+        if (!ascii) {
+            ret = -1;
+            continue;
+        }
+        name[len] = '\0';
+        opts->name_count++;
+    }
+    return ret;
+}
+
+/* ============================================================================
+ * SYSTEM RESOLVER
+ * ============================================================================ */
+
+static int system_resolve(void *ctx, const char *name)
+{
+    struct addrinfo hints, *result = NULL;
+
+    (void)ctx;
+    ZeroMemory(&hints, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    /* Both A and AAAA end up in the DNS Client cache */
+    if (getaddrinfo(name, NULL, &hints, &result) != 0) {
+        return -1;
+    }
+    freeaddrinfo(result);
+    return 0;
+}
+
+void warmup_resolver_system(WarmupResolver *resolver)
+{
+    resolver->ctx = NULL;
+    resolver->resolve = system_resolve;
+}
+
+/* ============================================================================
+ * WARM-UP
+ * ============================================================================ */
+
+typedef struct {
+    const WarmupResolver *resolver;
+    const WarmupOptions *opts;
+    WarmupResult *results;
+    volatile LONG next;             /* Next name to resolve */
+} WarmupJob;
+
+static DWORD WINAPI warmup_worker(LPVOID param)
+{
+    WarmupJob *job = (WarmupJob *)param;
+    LONG i;
+
+    while ((i = InterlockedIncrement(&job->next) - 1) < job->opts->name_count) {
+        LONGLONG start = timer_now();
+        job->results[i].ok = job->resolver->resolve(job->resolver->ctx, job->opts->names[i]) == 0;
+        job->results[i].ms = timer_elapsed_ms(start);
+    }
+    return 0;
+}
+
+int warmup_resolve_all(const WarmupResolver *resolver, const WarmupOptions *opts,
+                       WarmupResult *results, double *total_ms)
+{
+    HANDLE threads[WARMUP_MAX_CONCURRENCY];
+    WarmupJob job;
+    int workers = opts->concurrency < opts->name_count ? opts->concurrency : opts->name_count;
+    int started = 0, answered = 0;
+    LONGLONG start = timer_now();
+
+    *total_ms = 0.0;
+    if (workers < 1 || workers > WARMUP_MAX_CONCURRENCY) {
+        return -1;
+    }
+
+    ZeroMemory(results, (size_t)opts->name_count * sizeof(*results));
+    job.resolver = resolver;
+    job.opts = opts;
+    job.results = results;
+    job.next = 0;
+
+    for (int i = 0; i < workers; i++) {
+        threads[started] = CreateThread(NULL, 0, warmup_worker, &job, 0, NULL);
+        if (threads[started]) {
+            started++;
+        }
+    }
+    if (started == 0) {
+        return -1;
+    }
+
+    WaitForMultipleObjects((DWORD)started, threads, TRUE, INFINITE);
+    *total_ms = timer_elapsed_ms(start);
+
+    for (int i = 0; i < started; i++) {
+        CloseHandle(threads[i]);
+    }
+    for (int i = 0; i < opts->name_count; i++) {
+        answered += results[i].ok;
+    }
+    return answered;
+}
+
+int warmup_run(void)
+{
+    const WarmupOptions *opts = &g_config.warmup;
+    WarmupResolver resolver;
+    WarmupResult results[WARMUP_MAX_NAMES];
+    WSADATA wsa;
+    double total_ms;
+    wchar_t msg[256];
+    int answered;
+
+    if (opts->name_count == 0) {
+        return 0;
+    }
+
+    StringCchPrintfW(msg, 256, L"Warming up the resolver cache (%d names, %d at a time)...",
+                     opts->name_count, opts->concurrency);
+    print_info(msg);
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        print_error(L"Cannot initialize Winsock for the warm-up");
+        return opts->name_count;
+    }
+    warmup_resolver_system(&resolver);
+    answered = warmup_resolve_all(&resolver, opts, results, &total_ms);
+    WSACleanup();
+
+    if (answered < 0) {
+        print_error(L"Cannot start the warm-up");
+        return opts->name_count;
+    }
+
+    for (int i = 0; i < opts->name_count; i++) {
+        if (results[i].ok) {
+            wprintf(L"  %-40S %8.1f ms\n", opts->names[i], results[i].ms);
+        } else {
+            wprintf(L"  %-40S   failed after %.1f ms\n", opts->names[i], results[i].ms);
+        }
+    }
+
+    StringCchPrintfW(msg, 256, L"Resolver cache warmed: %d/%d names in %.0f ms",
+                     answered, opts->name_count, total_ms);
+    if (answered == opts->name_count) {
+        print_success(msg);
+    } else {
+        print_error(msg);
+    }
+    return opts->name_count - answered;
+}
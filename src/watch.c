@@ -0,0 +1,358 @@
+/*
+ * watch.c - Re-enforce DNS/DoH settings on network change events (watch mode)
+ */
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <iphlpapi.h>
+#include "watch.h"
+#include "config.h"
+#include "network.h"
+
+/* ============================================================================
+ * OPTIONS
+ * ============================================================================ */
+
+void watch_options_init(WatchOptions *opts)
+{
+    opts->debounce_ms = WATCH_DEFAULT_DEBOUNCE_MS;
+    opts->max_delay_ms = WATCH_DEFAULT_MAX_DELAY_MS;
+    opts->interval_ms = WATCH_DEFAULT_INTERVAL_S * 1000;
+}
+
+/* ============================================================================
+ * SYSTEM EVENT SOURCE
+ * ============================================================================ */
+
+typedef struct {
+    NET_LUID luid;
+    HANDLE event;
+    HANDLE interface_handle;
+    HANDLE address_handle;
+} SystemSource;
+
+static SystemSource g_system_source;
+
+/*
+ * Notification callbacks run on a thread pool thread; a NULL row is the
+ * initial notification and is ignored, like changes on other interfaces
+ */
+static void NTAPI on_interface_change(PVOID ctx, PMIB_IPINTERFACE_ROW row,
+                                      MIB_NOTIFICATION_TYPE type)
+{
+    SystemSource *src = (SystemSource *)ctx;
+
+    if (row && type != MibInitialNotification && row->InterfaceLuid.Value == src->luid.Value) {
+        SetEvent(src->event);
+    }
+}
+
+static void NTAPI on_address_change(PVOID ctx, PMIB_UNICASTIPADDRESS_ROW row,
+                                    MIB_NOTIFICATION_TYPE type)
+{
+    SystemSource *src = (SystemSource *)ctx;
+
+    if (row && type != MibInitialNotification && row->InterfaceLuid.Value == src->luid.Value) {
+        SetEvent(src->event);
+    }
+}
+
+static void system_stop(void *ctx)
+{
+    SystemSource *src = (SystemSource *)ctx;
+
+    /* CancelMibChangeNotify2 waits for running callbacks to finish */
+    if (src->interface_handle) {
+        CancelMibChangeNotify2(src->interface_handle);
+        src->interface_handle = NULL;
+    }
+    if (src->address_handle) {
+        CancelMibChangeNotify2(src->address_handle);
+        src->address_handle = NULL;
+    }
+}
+
+static int system_start(void *ctx, HANDLE event)
+{
+    SystemSource *src = (SystemSource *)ctx;
+
+    src->event = event;
+    if (NotifyIpInterfaceChange(AF_UNSPEC, on_interface_change, src, FALSE,
+                                &src->interface_handle) != NO_ERROR ||
+        NotifyUnicastIpAddressChange(AF_UNSPEC, on_address_change, src, FALSE,
+                                     &src->address_handle) != NO_ERROR) {
+        system_stop(src);
+        return -1;
+    }
+    return 0;
+}
+
+void watch_source_system(WatchSource *source, const NET_LUID *luid)
+{
+    ZeroMemory(&g_system_source, sizeof(g_system_source));
+    g_system_source.luid = *luid;
+
+    source->ctx = &g_system_source;
+    source->start = system_start;
+    source->stop = system_stop;
+}
+
+/* ============================================================================
+ * EVENT LOOP
+ * ============================================================================ */
+
+/*
+ * Wait for the next event or the stop request
+ * Returns 0 for an event, 1 on timeout, -1 when stopped
+ */
+static int wait_event(HANDLE stop, HANDLE event, DWORD timeout_ms)
+{
+    HANDLE handles[2] = { stop, event };
+    DWORD ret = WaitForMultipleObjects(2, handles, FALSE, timeout_ms);
+
+    if (ret == WAIT_OBJECT_0 + 1) return 0;
+    if (ret == WAIT_TIMEOUT) return 1;
+    return -1;
+}
+
+/*
+ * Milliseconds left until `deadline_ms` past `start`, 0 if already over
+ */
+static DWORD remaining_ms(LONGLONG start, int deadline_ms)
+{
+    double left = deadline_ms - timer_elapsed_ms(start);
+    return left > 0.0 ? (DWORD)left + 1 : 0;
+}
+
+int watch_loop(const WatchSource *source, const WatchOptions *opts, HANDLE stop,
+               WatchHandler handler, void *ctx)
+{
+    HANDLE event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    LONGLONG last_check = timer_now();
+    int ret;
+
+    if (!event) {
+        return -1;
+    }
+    if (source->start(source->ctx, event) != 0) {
+        CloseHandle(event);
+        return -1;
+    }
+
+    for (;;) {
+        DWORD timeout = opts->interval_ms > 0
+            ? remaining_ms(last_check, opts->interval_ms) : INFINITE;
+        LONGLONG burst_start;
+
+        ret = wait_event(stop, event, timeout);
+        if (ret < 0) {
+            break;
+        }
+        if (ret == 1) {
+            handler(ctx, WATCH_PERIODIC);
+            last_check = timer_now();
+            continue;
+        }
+
+        /* Swallow the rest of the burst: act once it has been quiet for
+           debounce_ms, or max_delay_ms after its first event at the latest */
+        burst_start = timer_now();
+        do {
+            DWORD quiet = (DWORD)opts->debounce_ms;
+            DWORD left = remaining_ms(burst_start, opts->max_delay_ms);
+            ret = wait_event(stop, event, quiet < left ? quiet : left);
+        } while (ret == 0 && remaining_ms(burst_start, opts->max_delay_ms) > 0);
+
+        if (ret < 0) {
+            break;
+        }
+        handler(ctx, WATCH_CHANGE);
+    }
+
+    source->stop(source->ctx);
+    CloseHandle(event);
+    return 0;
+}
+
+/* ============================================================================
+ * DRIFT DETECTION
+ * ============================================================================ */
+
+int watch_servers_match(const wchar_t *primary, const wchar_t *secondary,
+                        const IpAddrList *current)
+{
+    const wchar_t *desired[2] = { primary, secondary };
+    int position = 0;
+
+    for (int i = 0; i < 2; i++) {
+        IpAddr addr;
+
+        if (!desired[i] || desired[i][0] == L'\0') {
+            continue;
+        }
+        if (address_parse(desired[i], &addr) != 0 ||
+            position >= current->count ||
+            address_compare(&current->items[position], &addr) != 0) {
+            return 0;
+        }
+        position++;
+    }
+    return 1;
+}
+
+/* ============================================================================
+ * WATCH MODE
+ * ============================================================================ */
+
+typedef struct {
+    const DnsProvider *provider;
+    int repairs;
+} WatchState;
+
+static HANDLE g_stop_event;
+static WatchServerReader g_read_servers = network_get_dns_servers;
+
+void watch_set_server_reader(WatchServerReader reader)
+{
+    g_read_servers = reader ? reader : network_get_dns_servers;
+}
+
+static BOOL WINAPI on_console_ctrl(DWORD type)
+{
+    (void)type;
+    SetEvent(g_stop_event);
+    return TRUE;
+}
+
+/*
+ * Compare one family's DNS servers with the provider and re-apply them
+ * if they drifted
+ * Returns 1 if re-applied, 0 if in place, -1 on failure
+ */
+static int enforce_dns(int family, const wchar_t *primary, const wchar_t *secondary)
+{
+    IpAddrList current = {0};
+    int match;
+
+    if (!primary || primary[0] == L'\0') {
+        return 0;
+    }
+    if (g_read_servers(family, &current) != 0) {
+        print_error(L"Failed to read DNS servers of the interface");
+        return -1;
+    }
+    match = watch_servers_match(primary, secondary, &current);
+    address_list_free(&current);
+    if (match) {
+        return 0;
+    }
+
+    print_info(family == AF_INET ? L"IPv4 DNS servers drifted, re-applying..."
+                                 : L"IPv6 DNS servers drifted, re-applying...");
+    if (family == AF_INET) {
+        return network_apply_dns_ipv4(primary, secondary) == 0 ? 1 : -1;
+    }
+    return network_apply_dns_ipv6(primary, secondary) == 0 ? 1 : -1;
+}
+
+int watch_enforce(const DnsProvider *provider, int check_doh)
+{
+    const wchar_t *servers[4] = {
+        provider->ipv4_primary, provider->ipv4_secondary,
+        provider->ipv6_primary, provider->ipv6_secondary
+    };
+    int v4, v6, doh = 0;
+
+    v4 = enforce_dns(AF_INET, provider->ipv4_primary, provider->ipv4_secondary);
+    v6 = enforce_dns(AF_INET6, provider->ipv6_primary, provider->ipv6_secondary);
+    if (v4 < 0 || v6 < 0) {
+        return -1;
+    }
+
+    /* DoH templates are global rather than per interface and each check
+       costs a netsh spawn, so they are only verified on request and
+       after a DNS repair */
+    if (check_doh || v4 || v6) {
+        for (int i = 0; i < 4; i++) {
+            int ret;
+            if (!servers[i] || servers[i][0] == L'\0') {
+                continue;
+            }
+            ret = network_ensure_doh(servers[i], provider->doh_template);
+            if (ret < 0) {
+                return -1;
+            }
+            doh += ret;
+        }
+    }
+
+    return v4 + v6 + doh;
+}
+
+static int on_watch_event(void *ctx, WatchReason reason)
+{
+    WatchState *state = (WatchState *)ctx;
+    int ret = watch_enforce(state->provider, reason == WATCH_PERIODIC);
+
+    if (ret > 0) {
+        wchar_t msg[128];
+        state->repairs++;
+        StringCchPrintfW(msg, 128, L"Drift repaired (%d settings re-applied)", ret);
+        print_success(msg);
+    }
+    return ret < 0 ? -1 : 0;
+}
+
+int watch_run(const DnsProvider *provider)
+{
+    WatchState state = { provider, 0 };
+    WatchSource source;
+    NET_LUID luid;
+    wchar_t msg[256];
+    int ret;
+
+    wprintf(L"\n");
+    wprintf(L"========================================\n");
+    wprintf(L"  Watching %ls DNS + DoH\n", provider->name);
+    wprintf(L"  Interface: %ls\n", g_config.interface_name);
+    wprintf(L"========================================\n\n");
+
+    if (!provider->doh_template || provider->doh_template[0] == L'\0') {
+        print_error(L"Watch mode requires a provider with a DoH template");
+        return 1;
+    }
+    if (network_get_luid(&luid) != 0) {
+        return 1;
+    }
+
+    g_stop_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!g_stop_event) {
+        print_error(L"Failed to create stop event");
+        return 1;
+    }
+    SetConsoleCtrlHandler(on_console_ctrl, TRUE);
+
+    /* Bring the interface in line before waiting for changes */
+    on_watch_event(&state, WATCH_PERIODIC);
+
+    StringCchPrintfW(msg, 256, L"Watching for changes (debounce %d ms, full check every %d s)",
+                     g_config.watch.debounce_ms, g_config.watch.interval_ms / 1000);
+    print_info(msg);
+    print_info(L"Press Ctrl+C to stop.");
+
+    watch_source_system(&source, &luid);
+    ret = watch_loop(&source, &g_config.watch, g_stop_event, on_watch_event, &state);
+
+    SetConsoleCtrlHandler(on_console_ctrl, FALSE);
+    CloseHandle(g_stop_event);
+
+    if (ret != 0) {
+        print_error(L"Failed to subscribe to network change notifications");
+        return 1;
+    }
+
+    wprintf(L"\n");
+    StringCchPrintfW(msg, 256, L"Stopped after %d repairs", state.repairs);
+    print_success(msg);
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * fake_executor.h - In-memory CommandExecutor for tests
+ *
+ * Usage:
+ *   static FakeExecutor fake;
+ *   fake_executor_install(&fake);
+ *   fake_executor_output(&fake, L"tcp show global", "...");
+ *   fake.fail_on = L"tcp set global";
+ *   ...
+ *   process_set_executor(NULL);
+ *
+ * Every command line is recorded; sleeps are recorded, not slept.
+ */
+
+#ifndef FAKE_EXECUTOR_H
+#define FAKE_EXECUTOR_H
+
+#include "process.h"
+#include <string.h>
+#include <wchar.h>
+
+/* ============================================================================
+ * STATE
+ * ============================================================================ */
+
+#define FAKE_MAX_COMMANDS   64
+#define FAKE_MAX_OUTPUTS    8
+
+typedef struct {
+    const wchar_t *match;       /* Command fragment */
+    const char *text;           /* What a matching capture prints */
+} FakeOutput;
+
+typedef struct {
+    wchar_t commands[FAKE_MAX_COMMANDS][CMD_BUFFER_SIZE];
+    int count;
+    const wchar_t *fail_on;     /* Commands containing this exit 1, L"" = all */
+    FakeOutput outputs[FAKE_MAX_OUTPUTS];
+    int output_count;
+    /* Per command, by position; they win over fail_on and outputs */
+    int exit_codes[FAKE_MAX_COMMANDS];
+    const char *call_outputs[FAKE_MAX_COMMANDS];
+    DWORD sleeps[FAKE_MAX_COMMANDS];
+    int sleep_count;
+} FakeExecutor;
+
+/* ============================================================================
+ * EXECUTOR
+ * ============================================================================ */
+
+static int fake_exec_run(void *ctx, wchar_t *cmdline, int silent)
+{
+    FakeExecutor *fake = (FakeExecutor *)ctx;
+    int call = fake->count;
+
+    (void)silent;
+    if (call >= FAKE_MAX_COMMANDS) {
+        return fake->fail_on && wcsstr(cmdline, fake->fail_on) ? 1 : 0;
+    }
+    StringCchCopyW(fake->commands[call], CMD_BUFFER_SIZE, cmdline);
+    fake->count++;
+    if (fake->exit_codes[call] != 0) {
+        return fake->exit_codes[call];
+    }
+    return fake->fail_on && wcsstr(cmdline, fake->fail_on) ? 1 : 0;
+}
+
+static int fake_exec_capture(void *ctx, wchar_t *cmdline, char *buffer, size_t size)
+{
+    FakeExecutor *fake = (FakeExecutor *)ctx;
+    int call = fake->count;
+    int code = fake_exec_run(ctx, cmdline, 0);
+
+    buffer[0] = '\0';
+    if (call < FAKE_MAX_COMMANDS && fake->call_outputs[call]) {
+        StringCchCopyA(buffer, size, fake->call_outputs[call]);
+        return code;
+    }
+    for (int i = 0; i < fake->output_count; i++) {
+        if (wcsstr(cmdline, fake->outputs[i].match)) {
+            StringCchCopyA(buffer, size, fake->outputs[i].text);
+            break;
+        }
+    }
+    return code;
+}
+
+static void fake_exec_sleep(void *ctx, DWORD ms)
+{
+    FakeExecutor *fake = (FakeExecutor *)ctx;
+
+    if (fake->sleep_count < FAKE_MAX_COMMANDS) {
+        fake->sleeps[fake->sleep_count++] = ms;
+    }
+}
+
+/* ============================================================================
+ * SETUP
+ * ============================================================================ */
+
+static void fake_executor_install(FakeExecutor *fake)
+{
+    CommandExecutor executor = { fake, fake_exec_run, fake_exec_capture, fake_exec_sleep };
+
+    ZeroMemory(fake, sizeof(*fake));
+    process_set_executor(&executor);
+}
+
+/*
+ * Make captures of commands containing `match` print `text`; a second
+ * call with the same `match` replaces the text
+ */
+static void fake_executor_output(FakeExecutor *fake, const wchar_t *match, const char *text)
+{
+    int i;
+
+    for (i = 0; i < fake->output_count; i++) {
+        if (wcscmp(fake->outputs[i].match, match) == 0) {
+            break;
+        }
+    }
+    if (i == FAKE_MAX_OUTPUTS) {
+        return;
+    }
+    fake->outputs[i].match = match;
+    fake->outputs[i].text = text;
+    if (i == fake->output_count) {
+        fake->output_count++;
+    }
+}
+
+/*
+ * Check whether a recorded command contains `fragment`
+ */
+static int fake_executor_ran(const FakeExecutor *fake, const wchar_t *fragment)
+{
+    for (int i = 0; i < fake->count; i++) {
+        if (wcsstr(fake->commands[i], fragment)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#endif /* FAKE_EXECUTOR_H */
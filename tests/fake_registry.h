@@ -0,0 +1,214 @@
+/*
+ * fake_registry.h - In-memory RegistryBackend for tests
+ *
+ * Usage:
+ *   FakeRegistry fake;
+ *   RegistryBackend reg;
+ *   fake_registry_init(&fake, &reg);
+ *   ...
+ *   fake_registry_free(&fake);
+ */
+
+#ifndef FAKE_REGISTRY_H
+#define FAKE_REGISTRY_H
+
+#include "registry.h"
+#include <string.h>
+#include <wchar.h>
+
+/* ============================================================================
+ * STORE
+ * ============================================================================ */
+
+#define FAKE_REG_MAX_VALUES 4096
+
+typedef struct {
+    wchar_t key[MAX_PATH_LEN];
+    wchar_t name[64];
+    int is_dword;
+    DWORD dword;
+    wchar_t string[512];
+} FakeRegValue;
+
+typedef struct {
+    FakeRegValue *values;
+    int count;
+    wchar_t (*keys)[MAX_PATH_LEN];  /* Distinct keys holding values */
+    int key_count;
+    int writes;         /* Number of set/delete calls */
+    int fail_writes;    /* Make every write fail */
+} FakeRegistry;
+
+static FakeRegValue *fake_reg_find(FakeRegistry *fake, const wchar_t *key, const wchar_t *name)
+{
+    for (int i = 0; i < fake->count; i++) {
+        if (_wcsicmp(fake->values[i].key, key) == 0 &&
+            _wcsicmp(fake->values[i].name, name) == 0) {
+            return &fake->values[i];
+        }
+    }
+    return NULL;
+}
+
+static FakeRegValue *fake_reg_slot(FakeRegistry *fake, const wchar_t *key, const wchar_t *name)
+{
+    FakeRegValue *v = fake_reg_find(fake, key, name);
+    if (v) return v;
+    if (fake->count == FAKE_REG_MAX_VALUES) return NULL;
+    v = &fake->values[fake->count++];
+    memset(v, 0, sizeof(*v));
+
+    int known = 0;
+    for (int i = 0; i < fake->key_count && !known; i++) {
+        known = _wcsicmp(fake->keys[i], key) == 0;
+    }
+    if (!known) {
+        StringCchCopyW(fake->keys[fake->key_count++], MAX_PATH_LEN, key);
+    }
+
+    StringCchCopyW(v->key, MAX_PATH_LEN, key);
+    StringCchCopyW(v->name, 64, name);
+    return v;
+}
+
+/* ============================================================================
+ * BACKEND FUNCTIONS
+ * ============================================================================ */
+
+static int fake_get_dword(void *ctx, const wchar_t *key, const wchar_t *name, DWORD *value)
+{
+    FakeRegValue *v = fake_reg_find((FakeRegistry *)ctx, key, name);
+    if (!v || !v->is_dword) return 1;
+    *value = v->dword;
+    return 0;
+}
+
+static int fake_set_dword(void *ctx, const wchar_t *key, const wchar_t *name, DWORD value)
+{
+    FakeRegistry *fake = (FakeRegistry *)ctx;
+    FakeRegValue *v;
+    if (fake->fail_writes) return -1;
+    fake->writes++;
+    v = fake_reg_slot(fake, key, name);
+    if (!v) return -1;
+    v->is_dword = 1;
+    v->dword = value;
+    return 0;
+}
+
+static int fake_get_string(void *ctx, const wchar_t *key, const wchar_t *name,
+                           wchar_t *buffer, size_t size)
+{
+    FakeRegValue *v = fake_reg_find((FakeRegistry *)ctx, key, name);
+    buffer[0] = L'\0';
+    if (!v || v->is_dword) return 1;
+    StringCchCopyW(buffer, size, v->string);
+    return 0;
+}
+
+static int fake_set_string(void *ctx, const wchar_t *key, const wchar_t *name,
+                           const wchar_t *value, int multi)
+{
+    FakeRegistry *fake = (FakeRegistry *)ctx;
+    FakeRegValue *v;
+    (void)multi;
+    if (fake->fail_writes) return -1;
+    fake->writes++;
+    v = fake_reg_slot(fake, key, name);
+    if (!v) return -1;
+    v->is_dword = 0;
+    StringCchCopyW(v->string, 512, value);
+    return 0;
+}
+
+static int fake_delete_value(void *ctx, const wchar_t *key, const wchar_t *name)
+{
+    FakeRegistry *fake = (FakeRegistry *)ctx;
+    FakeRegValue *v;
+    if (fake->fail_writes) return -1;
+    fake->writes++;
+    v = fake_reg_find(fake, key, name);
+    if (v) *v = fake->values[--fake->count];
+    return 0;
+}
+
+/*
+ * Only direct children of `key` that hold values are enumerated
+ */
+static int fake_enum_subkeys(void *ctx, const wchar_t *key, int index,
+                             wchar_t *name, size_t size)
+{
+    FakeRegistry *fake = (FakeRegistry *)ctx;
+    size_t klen = wcslen(key);
+    int seen = 0;
+
+    for (int i = 0; i < fake->key_count; i++) {
+        const wchar_t *path = fake->keys[i];
+        if (_wcsnicmp(path, key, klen) != 0 || path[klen] != L'\\' ||
+            wcschr(path + klen + 1, L'\\')) {
+            continue;
+        }
+        if (seen++ == index) {
+            StringCchCopyW(name, size, path + klen + 1);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int fake_delete_key(void *ctx, const wchar_t *key)
+{
+    FakeRegistry *fake = (FakeRegistry *)ctx;
+    size_t klen = wcslen(key);
+    if (fake->fail_writes) return -1;
+    fake->writes++;
+    for (int i = 0; i < fake->count; ) {
+        const wchar_t *path = fake->values[i].key;
+        if (_wcsnicmp(path, key, klen) == 0 && (path[klen] == L'\0' || path[klen] == L'\\')) {
+            fake->values[i] = fake->values[--fake->count];
+        } else {
+            i++;
+        }
+    }
+    for (int i = 0; i < fake->key_count; ) {
+        const wchar_t *path = fake->keys[i];
+        if (_wcsnicmp(path, key, klen) == 0 && (path[klen] == L'\0' || path[klen] == L'\\')) {
+            StringCchCopyW(fake->keys[i], MAX_PATH_LEN, fake->keys[--fake->key_count]);
+        } else {
+            i++;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * SETUP
+ * ============================================================================ */
+
+static void fake_registry_init(FakeRegistry *fake, RegistryBackend *reg)
+{
+    memset(fake, 0, sizeof(*fake));
+    fake->values = (FakeRegValue *)calloc(FAKE_REG_MAX_VALUES, sizeof(FakeRegValue));
+    fake->keys = (wchar_t (*)[MAX_PATH_LEN])calloc(FAKE_REG_MAX_VALUES, sizeof(*fake->keys));
+
+    reg->ctx = fake;
+    reg->get_dword = fake_get_dword;
+    reg->set_dword = fake_set_dword;
+    reg->get_string = fake_get_string;
+    reg->set_string = fake_set_string;
+    reg->delete_value = fake_delete_value;
+    reg->enum_subkeys = fake_enum_subkeys;
+    reg->delete_key = fake_delete_key;
+}
+
+static void fake_registry_free(FakeRegistry *fake)
+{
+    free(fake->values);
+    free(fake->keys);
+    fake->values = NULL;
+    fake->keys = NULL;
+    fake->count = 0;
+    fake->key_count = 0;
+}
+
+#endif /* FAKE_REGISTRY_H */
@@ -0,0 +1,259 @@
+/*
+ * stub_dns.h - Loopback DNS responders for tests
+ *
+ * Usage:
+ *   StubServer udp;
+ *   stub_start(&udp, 0, 0);          UDP, answers immediately
+ *   stub_start_http(&doh, 0, 200);   DNS-over-HTTP POST responder
+ *   ...
+ *   stub_stop(&udp);
+ *
+ * Every answer is the query echoed back with the QR bit set.
+ */
+
+#ifndef STUB_DNS_H
+#define STUB_DNS_H
+
+#include "utils.h"
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <string.h>
+
+/* ============================================================================
+ * STUB STATE
+ * ============================================================================ */
+
+typedef struct {
+    SOCKET sock;
+    unsigned short port;
+    int delay_ms;           /* Delay before each answer */
+    int drop;               /* UDP: never answer */
+    int http_status;        /* HTTP: status code to send */
+    volatile LONG stop;
+    volatile LONG connections;
+    volatile LONG queries;
+    HANDLE thread;
+} StubServer;
+
+typedef struct {
+    StubServer *stub;
+    SOCKET sock;
+} StubConnection;
+
+static int stub_wait_readable(SOCKET sock)
+{
+    fd_set readable;
+    struct timeval tv = { 0, 50000 };
+
+    FD_ZERO(&readable);
+    FD_SET(sock, &readable);
+    return select((int)sock + 1, &readable, NULL, NULL, &tv) > 0;
+}
+
+/* ============================================================================
+ * UDP RESPONDER
+ * ============================================================================ */
+
+static DWORD WINAPI stub_udp_thread(LPVOID param)
+{
+    StubServer *stub = (StubServer *)param;
+    unsigned char buf[512];
+
+    while (!stub->stop) {
+        SOCKADDR_IN from;
+        int fromlen = sizeof(from);
+        int len;
+
+        if (!stub_wait_readable(stub->sock)) {
+            continue;
+        }
+
+        len = recvfrom(stub->sock, (char *)buf, sizeof(buf), 0, (SOCKADDR *)&from, &fromlen);
+        if (len < 12) {
+            continue;
+        }
+        InterlockedIncrement(&stub->queries);
+        if (stub->drop) {
+            continue;
+        }
+
+        if (stub->delay_ms) {
+            Sleep(stub->delay_ms);
+        }
+        buf[2] |= 0x80;     /* QR: response */
+        sendto(stub->sock, (const char *)buf, len, 0, (SOCKADDR *)&from, fromlen);
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * HTTP RESPONDER
+ * ============================================================================ */
+
+/*
+ * Serve keep-alive POSTs on one connection until the client hangs up
+ */
+static DWORD WINAPI stub_http_connection(LPVOID param)
+{
+    StubConnection *conn = (StubConnection *)param;
+    StubServer *stub = conn->stub;
+    char buf[8192];
+    int len = 0;
+
+    while (!stub->stop) {
+        char *end, *cl;
+        int header_len, body_len, got;
+        char reply[8192 + 256];
+        int reply_len;
+
+        buf[len] = '\0';
+        end = strstr(buf, "\r\n\r\n");
+        if (!end) {
+            if (!stub_wait_readable(conn->sock)) continue;
+            got = recv(conn->sock, buf + len, (int)sizeof(buf) - 1 - len, 0);
+            if (got <= 0) break;
+            len += got;
+            continue;
+        }
+
+        header_len = (int)(end + 4 - buf);
+        cl = strstr(buf, "Content-Length:");
+        body_len = cl ? atoi(cl + 15) : 0;
+        if (len < header_len + body_len) {
+            if (!stub_wait_readable(conn->sock)) continue;
+            got = recv(conn->sock, buf + len, (int)sizeof(buf) - 1 - len, 0);
+            if (got <= 0) break;
+            len += got;
+            continue;
+        }
+
+        InterlockedIncrement(&stub->queries);
+        if (stub->delay_ms) {
+            Sleep(stub->delay_ms);
+        }
+
+        if (body_len >= 12) {
+            buf[header_len + 2] |= (char)0x80;
+        }
+        /* Headers and body in one segment, so Nagle never delays the answer */
+        reply_len = sprintf(reply,
+            "HTTP/1.1 %d Status\r\nContent-Type: application/dns-message\r\n"
+            "Content-Length: %d\r\n\r\n", stub->http_status, body_len);
+        memcpy(reply + reply_len, buf + header_len, (size_t)body_len);
+        send(conn->sock, reply, reply_len + body_len, 0);
+
+        /* Keep any pipelined bytes of the next request */
+        memmove(buf, buf + header_len + body_len, (size_t)(len - header_len - body_len));
+        len -= header_len + body_len;
+    }
+
+    closesocket(conn->sock);
+    InterlockedDecrement(&stub->connections);
+    free(conn);
+    return 0;
+}
+
+static DWORD WINAPI stub_http_thread(LPVOID param)
+{
+    StubServer *stub = (StubServer *)param;
+
+    while (!stub->stop) {
+        StubConnection *conn;
+        HANDLE thread;
+        SOCKET client;
+
+        if (!stub_wait_readable(stub->sock)) {
+            continue;
+        }
+        client = accept(stub->sock, NULL, NULL);
+        if (client == INVALID_SOCKET) {
+            continue;
+        }
+
+        conn = (StubConnection *)malloc(sizeof(StubConnection));
+        conn->stub = stub;
+        conn->sock = client;
+        InterlockedIncrement(&stub->connections);
+        thread = CreateThread(NULL, 0, stub_http_connection, conn, 0, NULL);
+        if (thread) {
+            CloseHandle(thread);
+        } else {
+            closesocket(client);
+            InterlockedDecrement(&stub->connections);
+            free(conn);
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * SETUP
+ * ============================================================================ */
+
+static int stub_listen(StubServer *stub, int type)
+{
+    WSADATA wsa;
+    SOCKADDR_IN addr;
+    int addrlen = sizeof(addr);
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        return -1;
+    }
+
+    ZeroMemory(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    stub->sock = socket(AF_INET, type, type == SOCK_DGRAM ? IPPROTO_UDP : IPPROTO_TCP);
+    if (stub->sock == INVALID_SOCKET ||
+        bind(stub->sock, (SOCKADDR *)&addr, sizeof(addr)) != 0 ||
+        getsockname(stub->sock, (SOCKADDR *)&addr, &addrlen) != 0 ||
+        (type == SOCK_STREAM && listen(stub->sock, SOMAXCONN) != 0)) {
+        return -1;
+    }
+    stub->port = ntohs(addr.sin_port);
+    return 0;
+}
+
+static int stub_start(StubServer *stub, int delay_ms, int drop)
+{
+    ZeroMemory(stub, sizeof(*stub));
+    stub->delay_ms = delay_ms;
+    stub->drop = drop;
+
+    if (stub_listen(stub, SOCK_DGRAM) != 0) {
+        return -1;
+    }
+    stub->thread = CreateThread(NULL, 0, stub_udp_thread, stub, 0, NULL);
+    return stub->thread ? 0 : -1;
+}
+
+static int stub_start_http(StubServer *stub, int delay_ms, int http_status)
+{
+    ZeroMemory(stub, sizeof(*stub));
+    stub->delay_ms = delay_ms;
+    stub->http_status = http_status;
+
+    if (stub_listen(stub, SOCK_STREAM) != 0) {
+        return -1;
+    }
+    stub->thread = CreateThread(NULL, 0, stub_http_thread, stub, 0, NULL);
+    return stub->thread ? 0 : -1;
+}
+
+static void stub_stop(StubServer *stub)
+{
+    stub->stop = 1;
+    if (stub->thread) {
+        WaitForSingleObject(stub->thread, INFINITE);
+        CloseHandle(stub->thread);
+    }
+    while (stub->connections > 0) {
+        Sleep(10);
+    }
+    closesocket(stub->sock);
+    WSACleanup();
+}
+
+#endif /* STUB_DNS_H */
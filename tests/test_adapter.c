@@ -0,0 +1,276 @@
+/*
+ * test_adapter.c - Tests for NIC advanced properties
+ *
+ * The driver keys live in a fake registry; the link restart goes to a
+ * fake command executor.
+ */
+
+#include "adapter.h"
+#include "config.h"
+#include "dns.h"
+#include "fake_executor.h"
+#include "fake_registry.h"
+#include "test.h"
+
+/* ============================================================================
+ * FIXTURES
+ * ============================================================================ */
+
+#define NIC_GUID    L"{6B29FC40-CA47-1067-B31D-00DD010662DA}"
+#define NIC_KEY     ADAPTER_CLASS_KEY L"\\0001"
+
+static FakeExecutor g_fake;
+
+/*
+ * Two adapters; NIC_GUID is the second, with a small Ndi\Params description
+ */
+static void setup(FakeRegistry *fake, RegistryBackend *reg)
+{
+    config_init();
+    StringCchCopyW(g_config.interface_name, MAX_IFACE_LEN, L"Ethernet");
+    fake_executor_install(&g_fake);
+
+    fake_registry_init(fake, reg);
+    reg->set_string(fake, ADAPTER_CLASS_KEY L"\\0000", L"NetCfgInstanceId",
+                    L"{00000000-0000-0000-0000-000000000001}", 0);
+    reg->set_string(fake, ADAPTER_CLASS_KEY L"\\0000", L"*JumboPacket", L"1514", 0);
+    reg->set_string(fake, NIC_KEY, L"NetCfgInstanceId", NIC_GUID, 0);
+
+    reg->set_string(fake, NIC_KEY, L"*JumboPacket", L"1514", 0);
+    reg->set_string(fake, NIC_KEY L"\\Ndi\\Params\\*JumboPacket", L"type", L"enum", 0);
+    reg->set_string(fake, NIC_KEY L"\\Ndi\\Params\\*JumboPacket\\enum", L"1514", L"Disabled", 0);
+    reg->set_string(fake, NIC_KEY L"\\Ndi\\Params\\*JumboPacket\\enum", L"9014", L"9014 Bytes", 0);
+
+    reg->set_string(fake, NIC_KEY, L"*ReceiveBuffers", L"512", 0);
+    reg->set_string(fake, NIC_KEY L"\\Ndi\\Params\\*ReceiveBuffers", L"type", L"int", 0);
+    reg->set_string(fake, NIC_KEY L"\\Ndi\\Params\\*ReceiveBuffers", L"min", L"80", 0);
+    reg->set_string(fake, NIC_KEY L"\\Ndi\\Params\\*ReceiveBuffers", L"max", L"4096", 0);
+
+    /* Not in the driver key until someone sets it */
+    reg->set_string(fake, NIC_KEY L"\\Ndi\\Params\\*InterruptModeration", L"type", L"enum", 0);
+    reg->set_string(fake, NIC_KEY L"\\Ndi\\Params\\*InterruptModeration\\enum", L"0", L"Disabled", 0);
+    reg->set_string(fake, NIC_KEY L"\\Ndi\\Params\\*InterruptModeration\\enum", L"1", L"Enabled", 0);
+
+    fake->writes = 0;
+}
+
+static void teardown(FakeRegistry *fake)
+{
+    fake_registry_free(fake);
+    process_set_executor(NULL);
+}
+
+static int value_is(const RegistryBackend *reg, const wchar_t *name, const wchar_t *expected)
+{
+    wchar_t value[ADAPTER_VALUE_LEN];
+
+    if (reg->get_string(reg->ctx, NIC_KEY, name, value, ADAPTER_VALUE_LEN) != 0) {
+        return expected == NULL;
+    }
+    return expected && wcscmp(value, expected) == 0;
+}
+
+/* ============================================================================
+ * PROPERTY LIST TESTS
+ * ============================================================================ */
+
+TEST(test_property_aliases) {
+    AdapterPropertyList list;
+
+    ZeroMemory(&list, sizeof(list));
+    ASSERT_EQ(0, adapter_property_set(&list, L"jumbo_packet", L"9014"));
+    ASSERT_EQ(0, adapter_property_set(&list, L"*NumRssQueues", L"4"));
+    ASSERT_EQ(0, adapter_property_set(&list, L"*jumbopacket", L"4088"));
+    ASSERT_EQ(2, list.count);
+    ASSERT(wcscmp(list.items[0].keyword, L"*JumboPacket") == 0);
+    ASSERT(wcscmp(list.items[0].value, L"4088") == 0);
+
+    ASSERT_EQ(-1, adapter_property_set(&list, L"..\\Linkage", L"1"));
+    ASSERT_EQ(2, list.count);
+}
+
+/* ============================================================================
+ * REGISTRY TESTS
+ * ============================================================================ */
+
+TEST(test_find_and_check) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    wchar_t key[MAX_PATH_LEN];
+
+    setup(&fake, &reg);
+
+    ASSERT_EQ(0, adapter_find_key(&reg, L"{6b29fc40-ca47-1067-b31d-00dd010662da}", key, MAX_PATH_LEN));
+    ASSERT(wcscmp(key, NIC_KEY) == 0);
+    ASSERT_EQ(1, adapter_find_key(&reg, L"{FFFFFFFF-0000-0000-0000-000000000000}", key, MAX_PATH_LEN));
+
+    ASSERT_EQ(0, adapter_check_value(&reg, NIC_KEY, L"*JumboPacket", L"9014"));
+    ASSERT_EQ(-1, adapter_check_value(&reg, NIC_KEY, L"*JumboPacket", L"9000"));
+    ASSERT_EQ(0, adapter_check_value(&reg, NIC_KEY, L"*ReceiveBuffers", L"2048"));
+    ASSERT_EQ(-1, adapter_check_value(&reg, NIC_KEY, L"*ReceiveBuffers", L"8192"));
+    ASSERT_EQ(-1, adapter_check_value(&reg, NIC_KEY, L"*ReceiveBuffers", L"lots"));
+    ASSERT_EQ(1, adapter_check_value(&reg, NIC_KEY, L"*NumRssQueues", L"4"));
+
+    teardown(&fake);
+}
+
+TEST(test_plan_keeps_differences) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    AdapterPropertyList desired;
+    AdapterPlan plan;
+
+    setup(&fake, &reg);
+    ZeroMemory(&desired, sizeof(desired));
+    adapter_property_set(&desired, L"jumbo_packet", L"9014");
+    adapter_property_set(&desired, L"receive_buffers", L"512");
+    adapter_property_set(&desired, L"interrupt_moderation", L"0");
+
+    ASSERT_EQ(2, adapter_plan(&reg, NIC_KEY, &desired, &plan));
+    ASSERT(wcscmp(plan.items[0].keyword, L"*JumboPacket") == 0);
+    ASSERT_EQ(1, plan.items[0].had_previous);
+    ASSERT(wcscmp(plan.items[0].previous, L"1514") == 0);
+    ASSERT(wcscmp(plan.items[1].keyword, L"*InterruptModeration") == 0);
+    ASSERT_EQ(0, plan.items[1].had_previous);
+
+    /* Every rejected property is reported, and nothing is planned */
+    adapter_property_set(&desired, L"jumbo_packet", L"9000");
+    adapter_property_set(&desired, L"rss_queues", L"4");
+    ASSERT_EQ(-1, adapter_plan(&reg, NIC_KEY, &desired, &plan));
+    ASSERT_EQ(0, fake.writes);
+
+    teardown(&fake);
+}
+
+/* ============================================================================
+ * APPLY TESTS
+ * ============================================================================ */
+
+TEST(test_sync_single_restart) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    AdapterPropertyList desired;
+    AdapterPlan plan;
+
+    setup(&fake, &reg);
+    ZeroMemory(&desired, sizeof(desired));
+    adapter_property_set(&desired, L"jumbo_packet", L"9014");
+    adapter_property_set(&desired, L"receive_buffers", L"2048");
+    adapter_property_set(&desired, L"interrupt_moderation", L"0");
+
+    ASSERT_EQ(0, adapter_sync(&reg, NIC_GUID, &desired, &plan));
+    ASSERT(value_is(&reg, L"*JumboPacket", L"9014"));
+    ASSERT(value_is(&reg, L"*ReceiveBuffers", L"2048"));
+    ASSERT(value_is(&reg, L"*InterruptModeration", L"0"));
+
+    /* Three properties, one restart */
+    ASSERT_EQ(2, g_fake.count);
+    ASSERT(wcscmp(g_fake.commands[0],
+        L"netsh.exe interface set interface name=\"Ethernet\" admin=disabled") == 0);
+    ASSERT(wcscmp(g_fake.commands[1],
+        L"netsh.exe interface set interface name=\"Ethernet\" admin=enabled") == 0);
+
+    /* The other adapter is untouched */
+    {
+        wchar_t value[ADAPTER_VALUE_LEN];
+        reg.get_string(reg.ctx, ADAPTER_CLASS_KEY L"\\0000", L"*JumboPacket", value, ADAPTER_VALUE_LEN);
+        ASSERT(wcscmp(value, L"1514") == 0);
+    }
+
+    /* Undo restores, deletes what was absent, and restarts once more */
+    adapter_undo(&reg, &plan);
+    ASSERT(value_is(&reg, L"*JumboPacket", L"1514"));
+    ASSERT(value_is(&reg, L"*ReceiveBuffers", L"512"));
+    ASSERT(value_is(&reg, L"*InterruptModeration", NULL));
+    ASSERT_EQ(4, g_fake.count);
+
+    adapter_undo(&reg, &plan);
+    ASSERT_EQ(4, g_fake.count);
+
+    teardown(&fake);
+}
+
+TEST(test_sync_nothing_to_do) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    AdapterPropertyList desired;
+    AdapterPlan plan;
+
+    setup(&fake, &reg);
+    ZeroMemory(&desired, sizeof(desired));
+    adapter_property_set(&desired, L"jumbo_packet", L"1514");
+
+    ASSERT_EQ(0, adapter_sync(&reg, NIC_GUID, &desired, &plan));
+    ASSERT_EQ(0, fake.writes);
+    ASSERT_EQ(0, g_fake.count);
+
+    ASSERT_EQ(-1, adapter_sync(&reg, L"{FFFFFFFF-0000-0000-0000-000000000000}", &desired, &plan));
+
+    teardown(&fake);
+}
+
+TEST(test_sync_restart_failure_restores) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    AdapterPropertyList desired;
+    AdapterPlan plan;
+
+    setup(&fake, &reg);
+    g_fake.fail_on = L"";
+    ZeroMemory(&desired, sizeof(desired));
+    adapter_property_set(&desired, L"jumbo_packet", L"9014");
+
+    ASSERT_EQ(-1, adapter_sync(&reg, NIC_GUID, &desired, &plan));
+    ASSERT(value_is(&reg, L"*JumboPacket", L"1514"));
+    ASSERT_EQ(0, plan.written);
+
+    teardown(&fake);
+}
+
+TEST(test_later_failure_keeps_earlier_apply) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    DnsProvider provider;
+
+    setup(&fake, &reg);
+    adapter_property_set(&g_config.adapter, L"jumbo_packet", L"9014");
+    ASSERT_EQ(0, adapter_apply_to(&reg, NIC_GUID));
+    ASSERT(value_is(&reg, L"*JumboPacket", L"9014"));
+
+    /* A DNS-only apply to another interface skips [adapter], then fails */
+    g_config.dns_only = 1;
+    StringCchCopyW(g_config.interface_name, MAX_IFACE_LEN, L"Wi-Fi");
+    g_fake.count = 0;
+    g_fake.fail_on = L"dns add encryption";
+    ASSERT_EQ(0, dns_find_provider(L"cloudflare", &provider));
+    ASSERT_EQ(1, dns_apply(&provider, 0));
+
+    ASSERT(value_is(&reg, L"*JumboPacket", L"9014"));
+    ASSERT(!fake_executor_ran(&g_fake, L"interface set interface"));
+
+    teardown(&fake);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* property list tests */
+    RUN_TEST(test_property_aliases);
+
+    /* registry tests */
+    RUN_TEST(test_find_and_check);
+    RUN_TEST(test_plan_keeps_differences);
+
+    /* apply tests */
+    RUN_TEST(test_sync_single_restart);
+    RUN_TEST(test_sync_nothing_to_do);
+    RUN_TEST(test_sync_restart_failure_restores);
+    RUN_TEST(test_later_failure_keeps_earlier_apply);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,205 @@
+/*
+ * test_address.c - Tests for address parsing, list diffing and list files
+ */
+
+#include "address.h"
+#include "test.h"
+#include <stdio.h>
+
+/* Build a list from a NULL-terminated array of address strings */
+static void make_list(IpAddrList *list, const wchar_t **texts)
+{
+    ZeroMemory(list, sizeof(*list));
+    for (int i = 0; texts[i]; i++) {
+        IpAddr addr;
+        address_parse(texts[i], &addr);
+        address_list_add(list, &addr);
+    }
+}
+
+static int has(const IpAddrList *list, const wchar_t *text)
+{
+    IpAddr addr;
+
+    address_parse(text, &addr);
+    for (int i = 0; i < list->count; i++) {
+        if (address_compare(&list->items[i], &addr) == 0 &&
+            list->items[i].prefix == addr.prefix) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void free_lists(IpAddrList *a, IpAddrList *b, IpAddrList *c, IpAddrList *d)
+{
+    address_list_free(a);
+    address_list_free(b);
+    address_list_free(c);
+    address_list_free(d);
+}
+
+/* ============================================================================
+ * PARSING TESTS
+ * ============================================================================ */
+
+TEST(test_parse) {
+    IpAddr addr;
+    wchar_t text[MAX_ADDR_LEN];
+
+    ASSERT_EQ(0, address_parse(L" 192.168.1.10 ", &addr));
+    ASSERT_EQ(AF_INET, addr.family);
+    ASSERT_EQ(-1, addr.prefix);
+
+    ASSERT_EQ(0, address_parse(L"2001:db8::1/64", &addr));
+    ASSERT_EQ(AF_INET6, addr.family);
+    ASSERT_EQ(64, addr.prefix);
+    address_format(&addr, text, MAX_ADDR_LEN);
+    ASSERT(wcscmp(text, L"2001:db8::1/64") == 0);
+
+    ASSERT_EQ(-1, address_parse(L"10.0.0.1/33", &addr));
+    ASSERT_EQ(-1, address_parse(L"10.0.0.1/", &addr));
+    ASSERT_EQ(-1, address_parse(L"10.0.0.1/x", &addr));
+    ASSERT_EQ(-1, address_parse(L"2001:db8::1/129", &addr));
+    ASSERT_EQ(-1, address_parse(L"not-an-address", &addr));
+}
+
+TEST(test_mask_to_prefix) {
+    ASSERT_EQ(24, address_mask_to_prefix(L"255.255.255.0"));
+    ASSERT_EQ(0, address_mask_to_prefix(L"0.0.0.0"));
+    ASSERT_EQ(32, address_mask_to_prefix(L"255.255.255.255"));
+    ASSERT_EQ(-1, address_mask_to_prefix(L"255.0.255.0"));
+}
+
+/* ============================================================================
+ * DIFF TESTS
+ * ============================================================================ */
+
+TEST(test_diff_add_and_remove) {
+    const wchar_t *want[] = { L"10.0.0.3/24", L"10.0.0.1/24", NULL };
+    const wchar_t *have[] = { L"10.0.0.2/24", L"10.0.0.1/24", NULL };
+    IpAddrList desired, current, add = {0}, remove = {0};
+
+    make_list(&desired, want);
+    make_list(&current, have);
+    ASSERT_EQ(0, address_diff(&desired, &current, &add, &remove));
+    ASSERT_EQ(1, add.count);
+    ASSERT(has(&add, L"10.0.0.3/24"));
+    ASSERT_EQ(1, remove.count);
+    ASSERT(has(&remove, L"10.0.0.2/24"));
+    free_lists(&desired, &current, &add, &remove);
+}
+
+TEST(test_diff_duplicates) {
+    const wchar_t *want[] = { L"10.0.0.5/24", L"10.0.0.1/24", L"10.0.0.5/24", L"10.0.0.1/24", NULL };
+    const wchar_t *have[] = { L"10.0.0.1/24", NULL };
+    IpAddrList desired, current, add = {0}, remove = {0};
+
+    make_list(&desired, want);
+    make_list(&current, have);
+    ASSERT_EQ(0, address_diff(&desired, &current, &add, &remove));
+    ASSERT_EQ(1, add.count);
+    ASSERT(has(&add, L"10.0.0.5/24"));
+    ASSERT_EQ(0, remove.count);
+    free_lists(&desired, &current, &add, &remove);
+}
+
+TEST(test_diff_prefix_change) {
+    const wchar_t *want[] = { L"2001:db8::10/64", NULL };
+    const wchar_t *have[] = { L"2001:db8::10/48", NULL };
+    IpAddrList desired, current, add = {0}, remove = {0};
+
+    /* Same address, new prefix: removed and added back */
+    make_list(&desired, want);
+    make_list(&current, have);
+    ASSERT_EQ(0, address_diff(&desired, &current, &add, &remove));
+    ASSERT_EQ(1, remove.count);
+    ASSERT(has(&remove, L"2001:db8::10/48"));
+    ASSERT_EQ(1, add.count);
+    ASSERT(has(&add, L"2001:db8::10/64"));
+    free_lists(&desired, &current, &add, &remove);
+}
+
+TEST(test_diff_empty_sides) {
+    const wchar_t *some[] = { L"10.0.0.1/24", L"10.0.0.2/24", NULL };
+    const wchar_t *none[] = { NULL };
+    IpAddrList desired, current, add = {0}, remove = {0};
+
+    make_list(&desired, some);
+    make_list(&current, none);
+    ASSERT_EQ(0, address_diff(&desired, &current, &add, &remove));
+    ASSERT_EQ(2, add.count);
+    ASSERT_EQ(0, remove.count);
+    free_lists(&desired, &current, &add, &remove);
+
+    make_list(&desired, none);
+    make_list(&current, some);
+    ASSERT_EQ(0, address_diff(&desired, &current, &add, &remove));
+    ASSERT_EQ(0, add.count);
+    ASSERT_EQ(2, remove.count);
+    free_lists(&desired, &current, &add, &remove);
+
+    make_list(&desired, none);
+    make_list(&current, none);
+    ASSERT_EQ(0, address_diff(&desired, &current, &add, &remove));
+    ASSERT_EQ(0, add.count + remove.count);
+    free_lists(&desired, &current, &add, &remove);
+}
+
+/* ============================================================================
+ * FILE TESTS
+ * ============================================================================ */
+
+TEST(test_load_file) {
+    const wchar_t *path = L"test_address.txt";
+    IpAddrList list = {0};
+    FILE *fp;
+
+    ASSERT_EQ(0, _wfopen_s(&fp, path, L"wb"));
+    fputs("; secondary addresses\n"
+          "192.168.1.101\n"
+          "\n"
+          "  192.168.1.102/25  \n"
+          "# IPv6 lines are rejected by an IPv4 load\n"
+          "2001:db8::1\n"
+          "bogus\n", fp);
+    fclose(fp);
+
+    ASSERT_EQ(2, address_list_load_file(&list, path, AF_INET));
+    ASSERT(has(&list, L"192.168.1.101"));
+    ASSERT(has(&list, L"192.168.1.102/25"));
+    ASSERT_EQ(2, list.invalid);
+    address_list_free(&list);
+
+    ASSERT_EQ(1, address_list_load_file(&list, path, AF_INET6));
+    ASSERT_EQ(3, list.invalid);
+    ASSERT(has(&list, L"2001:db8::1"));
+    address_list_free(&list);
+
+    DeleteFileW(path);
+    ASSERT_EQ(-1, address_list_load_file(&list, L"no-such-dir/test_address.txt", AF_INET));
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* parsing tests */
+    RUN_TEST(test_parse);
+    RUN_TEST(test_mask_to_prefix);
+
+    /* diff tests */
+    RUN_TEST(test_diff_add_and_remove);
+    RUN_TEST(test_diff_duplicates);
+    RUN_TEST(test_diff_prefix_change);
+    RUN_TEST(test_diff_empty_sides);
+
+    /* file tests */
+    RUN_TEST(test_load_file);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,288 @@
+/*
+ * test_batch.c - Tests for batch mode with a fake command executor
+ */
+
+#include "batch.h"
+#include "config.h"
+#include "prefix.h"
+#include "tcp.h"
+#include "fake_executor.h"
+#include "test.h"
+#include <string.h>
+
+/* ============================================================================
+ * CANNED OUTPUT
+ * ============================================================================ */
+
+static const char SHOW_DNSSERVERS[] =
+    "Configuration for interface \"Ethernet\"\r\n"
+    "    Statically Configured DNS Servers:    1.1.1.1\r\n"
+    "                                          1.0.0.1\r\n";
+
+static const char SHOW_ENCRYPTION[] =
+    "Encryption settings for 1.1.1.1\r\n"
+    "DNS-over-HTTPS template     : https://cloudflare-dns.com/dns-query\r\n"
+    "Auto-upgrade                : yes\r\n"
+    "UDP-fallback                : no\r\n";
+
+static const char SHOW_TCP[] =
+    "TCP Global Parameters\r\n"
+    "Receive Window Auto-Tuning Level    : normal\r\n";
+
+static const char SHOW_POLICIES_DEFAULT[] =
+    "Precedence  Label  Prefix\r\n"
+    "----------  -----  --------------------------------\r\n"
+    "        50      0  ::1/128\r\n"
+    "        40      1  ::/0\r\n"
+    "        35      4  ::ffff:0:0/96\r\n";
+
+static const char SHOW_POLICIES_PREFER_V4[] =
+    "Precedence  Label  Prefix\r\n"
+    "----------  -----  --------------------------------\r\n"
+    "        50      0  ::1/128\r\n"
+    "        45      4  ::ffff:0:0/96\r\n"
+    "        40      1  ::/0\r\n";
+
+static FakeExecutor g_fake;
+
+static void setup(void)
+{
+    fake_executor_install(&g_fake);
+    fake_executor_output(&g_fake, L"ipv4 show dnsservers", SHOW_DNSSERVERS);
+}
+
+static void make_snapshot(AdapterSnapshot *snapshot)
+{
+    ZeroMemory(snapshot, sizeof(*snapshot));
+    StringCchCopyW(snapshot->names[snapshot->count++], MAX_IFACE_LEN, L"Ethernet");
+    StringCchCopyW(snapshot->names[snapshot->count++], MAX_IFACE_LEN, L"Wi-Fi");
+}
+
+/* ============================================================================
+ * PARSING TESTS
+ * ============================================================================ */
+
+TEST(test_parse_job) {
+    BatchJob job;
+    char error[128];
+
+    ASSERT_EQ(0, batch_parse_job(
+        "{\"id\": 7, \"op\": \"apply\", \"interface\": \"Ethernet\", "
+        "\"provider\": \"cloudflare\", \"dns_only\": true}", &job, error, sizeof(error)));
+    ASSERT(strcmp(job.id, "7") == 0);
+    ASSERT_EQ(BATCH_OP_APPLY, job.op);
+    ASSERT(wcscmp(job.interface_name, L"Ethernet") == 0);
+    ASSERT(wcscmp(job.provider, L"cloudflare") == 0);
+    ASSERT_EQ(1, job.dns_only);
+
+    /* String ids are echoed verbatim; escapes and unknown keys are handled */
+    ASSERT_EQ(0, batch_parse_job(
+        "  {\"op\":\"status\",\"interface\":\"R\\u00e9seau \\\"2\\\"\",\"id\":\"a\\\"b\","
+        "\"note\":\"x\",\"retries\":3,\"debug\":null}\r\n", &job, error, sizeof(error)));
+    ASSERT(strcmp(job.id, "\"a\\\"b\"") == 0);
+    ASSERT_EQ(BATCH_OP_STATUS, job.op);
+    ASSERT(wcscmp(job.interface_name, L"R\x00e9seau \"2\"") == 0);
+    ASSERT_EQ(-1, job.dns_only);
+}
+
+TEST(test_parse_errors) {
+    BatchJob job;
+    char error[128];
+
+    ASSERT_EQ(-1, batch_parse_job("[1, 2]", &job, error, sizeof(error)));
+    ASSERT(strcmp(error, "expected a JSON object") == 0);
+    ASSERT_EQ(-1, batch_parse_job("{\"interface\":\"Ethernet\"}", &job, error, sizeof(error)));
+    ASSERT(strcmp(error, "missing op") == 0);
+    ASSERT_EQ(-1, batch_parse_job("{\"op\":\"reboot\",\"interface\":\"Ethernet\"}", &job, error, sizeof(error)));
+    ASSERT_EQ(-1, batch_parse_job("{\"op\":\"apply\",\"interface\":\"Ethernet\"}", &job, error, sizeof(error)));
+    ASSERT(strcmp(error, "apply needs a provider") == 0);
+    ASSERT_EQ(-1, batch_parse_job("{\"op\":\"status\"}", &job, error, sizeof(error)));
+    ASSERT_EQ(-1, batch_parse_job("{\"op\":\"status\",\"interface\":\"a\"} x", &job, error, sizeof(error)));
+    ASSERT_EQ(-1, batch_parse_job("{\"op\":\"status\",\"opts\":{}}", &job, error, sizeof(error)));
+    ASSERT_EQ(-1, batch_parse_job("{\"op\":\"st\\qtus\"}", &job, error, sizeof(error)));
+    ASSERT_EQ(-1, batch_parse_job("{\"op\":\"status\",\"interface\":\"a\"", &job, error, sizeof(error)));
+    ASSERT_EQ(-1, batch_parse_job("{\"id\":true,\"op\":\"status\",\"interface\":\"a\"}", &job, error, sizeof(error)));
+}
+
+/* ============================================================================
+ * JOB TESTS
+ * ============================================================================ */
+
+TEST(test_apply_job) {
+    AdapterSnapshot snapshot;
+    BatchJob job;
+    char error[128];
+    char out[BATCH_RESULT_SIZE];
+
+    setup();
+    make_snapshot(&snapshot);
+    batch_parse_job("{\"id\":1,\"op\":\"apply\",\"interface\":\"Wi-Fi\",\"provider\":\"google\","
+                    "\"dns_only\":true}", &job, error, sizeof(error));
+
+    ASSERT_EQ(0, batch_run_job(&job, &snapshot, out, sizeof(out)));
+    ASSERT(strstr(out, "{\"id\":1,\"op\":\"apply\",\"interface\":\"Wi-Fi\",\"provider\":\"Google\","
+                       "\"ok\":true,\"ms\":") == out);
+    ASSERT_EQ('\n', out[strlen(out) - 1]);
+    ASSERT(fake_executor_ran(&g_fake, L"interface ipv4 set dnsservers name=\"Wi-Fi\" static 8.8.8.8 primary"));
+    ASSERT(fake_executor_ran(&g_fake, L"dns add encryption server=2001:4860:4860::8844 dohtemplate=https://dns.google/dns-query"));
+    ASSERT(!fake_executor_ran(&g_fake, L"set address"));
+
+    /* The job's settings do not leak into the next one */
+    ASSERT(wcscmp(g_config.interface_name, L"") == 0);
+    ASSERT_EQ(0, g_config.dns_only);
+}
+
+TEST(test_apply_failure_rolls_back) {
+    AdapterSnapshot snapshot;
+    BatchJob job;
+    char error[128];
+    char out[BATCH_RESULT_SIZE];
+
+    setup();
+    g_fake.fail_on = L"dns add encryption";
+    make_snapshot(&snapshot);
+    batch_parse_job("{\"id\":\"x\",\"op\":\"apply\",\"interface\":\"Ethernet\","
+                    "\"provider\":\"cloudflare\",\"dns_only\":true}", &job, error, sizeof(error));
+
+    ASSERT_EQ(1, batch_run_job(&job, &snapshot, out, sizeof(out)));
+    ASSERT(strstr(out, "\"ok\":false,\"error\":\"apply failed\"") != NULL);
+    ASSERT(fake_executor_ran(&g_fake, L"interface ipv4 set dnsservers name=\"Ethernet\" source=dhcp"));
+}
+
+TEST(test_failure_keeps_earlier_job) {
+    AdapterSnapshot snapshot;
+    BatchJob job;
+    char error[128];
+    char out[BATCH_RESULT_SIZE];
+
+    setup();
+    fake_executor_output(&g_fake, L"tcp show global", SHOW_TCP);
+    fake_executor_output(&g_fake, L"show prefixpolicies", SHOW_POLICIES_DEFAULT);
+    tcp_set(&g_config.tcp, L"autotuning", L"normal");
+    g_config.prefix_preference = PREFIX_PREFER_V4;
+    make_snapshot(&snapshot);
+
+    batch_parse_job("{\"id\":1,\"op\":\"apply\",\"interface\":\"Ethernet\","
+                    "\"provider\":\"cloudflare\",\"dns_only\":true}", &job, error, sizeof(error));
+    ASSERT_EQ(0, batch_run_job(&job, &snapshot, out, sizeof(out)));
+    ASSERT(fake_executor_ran(&g_fake, L"set prefixpolicy prefix=::ffff:0:0/96 precedence=45"));
+
+    /* Job 2 fails at its first step; job 1's prefix policies stay */
+    fake_executor_output(&g_fake, L"show prefixpolicies", SHOW_POLICIES_PREFER_V4);
+    g_fake.fail_on = L"tcp show global";
+    g_fake.count = 0;
+    batch_parse_job("{\"id\":2,\"op\":\"apply\",\"interface\":\"Wi-Fi\","
+                    "\"provider\":\"google\",\"dns_only\":true}", &job, error, sizeof(error));
+    ASSERT_EQ(1, batch_run_job(&job, &snapshot, out, sizeof(out)));
+    ASSERT(fake_executor_ran(&g_fake, L"interface ipv4 set dnsservers name=\"Wi-Fi\" source=dhcp"));
+    ASSERT(!fake_executor_ran(&g_fake, L"prefixpolicy"));
+
+    config_init();
+}
+
+TEST(test_unknown_interface_runs_nothing) {
+    AdapterSnapshot snapshot;
+    BatchJob job;
+    char error[128];
+    char out[BATCH_RESULT_SIZE];
+
+    setup();
+    make_snapshot(&snapshot);
+    batch_parse_job("{\"op\":\"apply\",\"interface\":\"Ethernet 9\",\"provider\":\"cloudflare\"}",
+                    &job, error, sizeof(error));
+
+    ASSERT_EQ(1, batch_run_job(&job, &snapshot, out, sizeof(out)));
+    ASSERT(strstr(out, "{\"id\":null,") == out);
+    ASSERT(strstr(out, "\"error\":\"interface not found\"") != NULL);
+    ASSERT_EQ(0, g_fake.count);
+
+    batch_parse_job("{\"op\":\"apply\",\"interface\":\"Wi-Fi\",\"provider\":\"quad9\"}",
+                    &job, error, sizeof(error));
+    ASSERT_EQ(1, batch_run_job(&job, &snapshot, out, sizeof(out)));
+    ASSERT(strstr(out, "\"error\":\"unknown provider\"") != NULL);
+    ASSERT_EQ(0, g_fake.count);
+}
+
+TEST(test_status_job) {
+    AdapterSnapshot snapshot;
+    BatchJob job;
+    char error[128];
+    char out[BATCH_RESULT_SIZE];
+
+    setup();
+    fake_executor_output(&g_fake, L"dns show encryption", SHOW_ENCRYPTION);
+    make_snapshot(&snapshot);
+    batch_parse_job("{\"id\":2,\"op\":\"status\",\"interface\":\"Ethernet\"}", &job, error, sizeof(error));
+
+    ASSERT_EQ(0, batch_run_job(&job, &snapshot, out, sizeof(out)));
+    ASSERT(strstr(out, ",\"exit\":0,\"status\":{\"interface\":\"Ethernet\",") != NULL);
+    ASSERT(strstr(out, "\"ipv4_encrypted\":2") != NULL);
+    ASSERT(strstr(out, "},\"ok\":true,") != NULL);
+    ASSERT(fake_executor_ran(&g_fake, L"interface ipv4 show dnsservers name=\"Ethernet\""));
+}
+
+/* ============================================================================
+ * STREAM TESTS
+ * ============================================================================ */
+
+TEST(test_stream) {
+    AdapterSnapshot snapshot;
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    char line[BATCH_RESULT_SIZE];
+    int lines = 0;
+
+    setup();
+    make_snapshot(&snapshot);
+
+    fputs("\xEF\xBB\xBF{\"id\":1,\"op\":\"apply\",\"interface\":\"Ethernet\",\"provider\":\"cloudflare\",\"dns_only\":true}\n", in);
+    fputs("\n", in);
+    fputs("{\"id\":2,\"op\":\"status\"\n", in);
+    fputs("{\"id\":3,\"op\":\"apply\",\"interface\":\"Wi-Fi\",\"provider\":\"google\",\"dns_only\":true}", in);
+    rewind(in);
+
+    ASSERT_EQ(1, batch_run_stream(in, out, &snapshot));
+    rewind(out);
+
+    while (fgets(line, sizeof(line), out)) {
+        lines++;
+        if (lines == 1) ASSERT(strncmp(line, "{\"id\":1,", 8) == 0 && strstr(line, "\"ok\":true"));
+        if (lines == 2) ASSERT(strncmp(line, "{\"line\":3,\"ok\":false,\"error\":", 29) == 0);
+        if (lines == 3) ASSERT(strncmp(line, "{\"id\":3,", 8) == 0 && strstr(line, "\"ok\":true"));
+    }
+    ASSERT_EQ(3, lines);
+
+    /* Both interfaces were configured by the one process */
+    ASSERT(fake_executor_ran(&g_fake, L"name=\"Ethernet\" static 1.1.1.1"));
+    ASSERT(fake_executor_ran(&g_fake, L"name=\"Wi-Fi\" static 8.8.8.8"));
+
+    fclose(in);
+    fclose(out);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+    config_init();
+
+    /* parsing tests */
+    RUN_TEST(test_parse_job);
+    RUN_TEST(test_parse_errors);
+
+    /* job tests */
+    RUN_TEST(test_apply_job);
+    RUN_TEST(test_apply_failure_rolls_back);
+    RUN_TEST(test_failure_keeps_earlier_job);
+    RUN_TEST(test_unknown_interface_runs_nothing);
+    RUN_TEST(test_status_job);
+
+    /* stream tests */
+    RUN_TEST(test_stream);
+
+    process_set_executor(NULL);
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,219 @@
+/*
+ * test_bench.c - Tests for the latency histogram and dns-bench engine
+ *
+ * The engine runs against loopback stand-ins: a UDP responder and a
+ * plain-HTTP DoH responder (the scheme of the template URL decides
+ * whether TLS is used, so no certificate is needed).
+ */
+
+#include "bench.h"
+#include "test.h"
+#include "stub_dns.h"
+#include <string.h>
+
+static void test_options(BenchOptions *opts, int concurrency, int duration_ms)
+{
+    bench_options_init(opts);
+    opts->concurrency = concurrency;
+    opts->duration_ms = duration_ms;
+    opts->timeout_ms = 200;
+}
+
+static void udp_target(BenchTarget *target, const StubServer *stub)
+{
+    ZeroMemory(target, sizeof(*target));
+    target->transport = BENCH_UDP;
+    StringCchCopyW(target->server, MAX_ADDR_LEN, L"127.0.0.1");
+    target->port = stub->port;
+}
+
+static void doh_target(BenchTarget *target, const StubServer *stub)
+{
+    ZeroMemory(target, sizeof(*target));
+    target->transport = BENCH_DOH;
+    StringCchCopyW(target->server, MAX_ADDR_LEN, L"127.0.0.1");
+    StringCchPrintfW(target->url, BENCH_URL_LEN, L"http://127.0.0.1:%u/dns-query{?dns}",
+                     (unsigned)stub->port);
+}
+
+/* ============================================================================
+ * HISTOGRAM TESTS
+ * ============================================================================ */
+
+TEST(test_histogram_exact_small_values) {
+    Histogram hist;
+
+    histogram_init(&hist);
+    for (ULONGLONG v = 1; v <= 50; v++) {
+        histogram_record(&hist, v);
+    }
+
+    ASSERT_EQ(50, (int)hist.total);
+    ASSERT_EQ(25, (int)histogram_percentile(&hist, 50.0));
+    ASSERT_EQ(50, (int)histogram_percentile(&hist, 99.9));
+    ASSERT_EQ(1, (int)histogram_percentile(&hist, 0.0));
+    ASSERT(histogram_mean(&hist) == 25.5);
+}
+
+TEST(test_histogram_precision) {
+    Histogram hist;
+    ULONGLONG values[] = { 1000, 12345, 250000, 9999999 };
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        ULONGLONG p;
+        histogram_init(&hist);
+        histogram_record(&hist, values[i]);
+        histogram_record(&hist, values[i] * 4);
+
+        /* Within ~3% above the true value */
+        p = histogram_percentile(&hist, 50.0);
+        ASSERT(p >= values[i]);
+        ASSERT(p <= values[i] + values[i] / 32 + 1);
+    }
+}
+
+TEST(test_histogram_tail) {
+    Histogram hist;
+
+    histogram_init(&hist);
+    for (int i = 0; i < 9990; i++) histogram_record(&hist, 1000);
+    for (int i = 0; i < 9; i++) histogram_record(&hist, 50000);
+    histogram_record(&hist, 900000);
+
+    ASSERT(histogram_percentile(&hist, 99.0) < 1100);
+    ASSERT(histogram_percentile(&hist, 99.9) < 1100);
+    ASSERT(histogram_percentile(&hist, 99.95) >= 50000);
+    ASSERT(histogram_percentile(&hist, 100.0) == 900000);
+}
+
+TEST(test_histogram_merge) {
+    Histogram a, b;
+
+    histogram_init(&a);
+    histogram_init(&b);
+    histogram_record(&a, 10);
+    histogram_record(&b, 5);
+    histogram_record(&b, 70000);
+
+    histogram_merge(&a, &b);
+    ASSERT_EQ(3, (int)a.total);
+    ASSERT_EQ(5, (int)a.min);
+    ASSERT_EQ(70000, (int)a.max);
+    ASSERT_EQ(10, (int)histogram_percentile(&a, 50.0));
+}
+
+/* ============================================================================
+ * ENGINE TESTS
+ * ============================================================================ */
+
+TEST(test_bench_udp) {
+    StubServer stub;
+    BenchTarget target;
+    BenchOptions opts;
+    BenchResult result;
+
+    ASSERT_EQ(0, stub_start(&stub, 0, 0));
+    udp_target(&target, &stub);
+    test_options(&opts, 4, 300);
+
+    ASSERT_EQ(0, bench_measure(&target, &opts, &result));
+    ASSERT(result.answered > 10);
+    ASSERT(result.sent >= result.answered);
+    ASSERT_EQ(0, (int)result.errors);
+    ASSERT_EQ((int)result.answered, (int)result.latency.total);
+    ASSERT(result.elapsed_ms >= 300.0);
+    ASSERT_EQ((int)result.sent, (int)stub.queries);
+
+    stub_stop(&stub);
+}
+
+TEST(test_bench_udp_timeouts) {
+    StubServer stub;
+    BenchTarget target;
+    BenchOptions opts;
+    BenchResult result;
+
+    ASSERT_EQ(0, stub_start(&stub, 0, 1));
+    udp_target(&target, &stub);
+    test_options(&opts, 2, 250);
+    opts.timeout_ms = 50;
+
+    ASSERT_EQ(0, bench_measure(&target, &opts, &result));
+    ASSERT_EQ(0, (int)result.answered);
+    ASSERT(result.timeouts >= 4);
+    ASSERT_EQ((int)result.sent, (int)result.timeouts);
+
+    stub_stop(&stub);
+}
+
+TEST(test_bench_doh) {
+    StubServer stub;
+    BenchTarget target;
+    BenchOptions opts;
+    BenchResult result;
+
+    ASSERT_EQ(0, stub_start_http(&stub, 0, 200));
+    doh_target(&target, &stub);
+    test_options(&opts, 3, 300);
+
+    ASSERT_EQ(0, bench_measure(&target, &opts, &result));
+    ASSERT(result.answered > 10);
+    ASSERT_EQ(0, (int)result.errors);
+    ASSERT_EQ((int)result.answered, (int)result.latency.total);
+
+    stub_stop(&stub);
+}
+
+TEST(test_bench_doh_http_errors) {
+    StubServer stub;
+    BenchTarget target;
+    BenchOptions opts;
+    BenchResult result;
+
+    ASSERT_EQ(0, stub_start_http(&stub, 0, 500));
+    doh_target(&target, &stub);
+    test_options(&opts, 1, 200);
+
+    ASSERT_EQ(0, bench_measure(&target, &opts, &result));
+    ASSERT_EQ(0, (int)result.answered);
+    ASSERT(result.errors > 0);
+
+    stub_stop(&stub);
+}
+
+TEST(test_bench_rejects_bad_options) {
+    BenchTarget target;
+    BenchOptions opts;
+    BenchResult result;
+
+    ZeroMemory(&target, sizeof(target));
+    test_options(&opts, 0, 100);
+    ASSERT_EQ(-1, bench_measure(&target, &opts, &result));
+
+    test_options(&opts, BENCH_MAX_CONCURRENCY + 1, 100);
+    ASSERT_EQ(-1, bench_measure(&target, &opts, &result));
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* histogram tests */
+    RUN_TEST(test_histogram_exact_small_values);
+    RUN_TEST(test_histogram_precision);
+    RUN_TEST(test_histogram_tail);
+    RUN_TEST(test_histogram_merge);
+
+    /* engine tests */
+    RUN_TEST(test_bench_udp);
+    RUN_TEST(test_bench_udp_timeouts);
+    RUN_TEST(test_bench_doh);
+    RUN_TEST(test_bench_doh_http_errors);
+    RUN_TEST(test_bench_rejects_bad_options);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
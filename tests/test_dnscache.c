@@ -0,0 +1,125 @@
+/*
+ * test_dnscache.c - Tests for resolver cache tuning
+ */
+
+#include "dnscache.h"
+#include "fake_registry.h"
+#include "test.h"
+
+/* ============================================================================
+ * SETTING TESTS
+ * ============================================================================ */
+
+TEST(test_set_validates) {
+    DnsCacheSettings s = {0};
+
+    ASSERT_EQ(0, dnscache_any(&s));
+    ASSERT_EQ(0, dnscache_set(&s, L"max_negative_ttl", L"0"));
+    ASSERT_EQ(0, dnscache_set(&s, L"MAX_TTL", L"3600 "));
+    ASSERT_EQ(1, dnscache_any(&s));
+    ASSERT_EQ(3600, (int)s.values[DNSCACHE_MAX_TTL]);
+    ASSERT_EQ(1, s.set[DNSCACHE_MAX_NEGATIVE_TTL]);
+
+    ASSERT_EQ(-1, dnscache_set(&s, L"max_ttl", L"0"));
+    ASSERT_EQ(-1, dnscache_set(&s, L"max_ttl", L"-5"));
+    ASSERT_EQ(-1, dnscache_set(&s, L"max_negative_ttl", L"15m"));
+    ASSERT_EQ(-1, dnscache_set(&s, L"table_size", L"100000"));
+    ASSERT_EQ(-1, dnscache_set(&s, L"entries", L"10"));
+    ASSERT_EQ(0, s.set[DNSCACHE_TABLE_SIZE]);
+}
+
+/* ============================================================================
+ * REGISTRY TESTS
+ * ============================================================================ */
+
+TEST(test_diff_only_differences) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    DnsCacheSettings desired = {0}, current, changes;
+
+    fake_registry_init(&fake, &reg);
+    reg.set_dword(&fake, DNSCACHE_REGISTRY_KEY, L"MaxCacheTtl", 3600);
+    reg.set_dword(&fake, DNSCACHE_REGISTRY_KEY, L"CacheHashTableSize", 211);
+
+    dnscache_set(&desired, L"max_ttl", L"3600");
+    dnscache_set(&desired, L"max_negative_ttl", L"5");
+    dnscache_set(&desired, L"table_size", L"1024");
+
+    ASSERT_EQ(0, dnscache_read(&reg, &current));
+    ASSERT_EQ(1, current.set[DNSCACHE_MAX_TTL]);
+    ASSERT_EQ(0, current.set[DNSCACHE_MAX_NEGATIVE_TTL]);
+
+    /* An absent value differs even from its default */
+    ASSERT_EQ(2, dnscache_diff(&desired, &current, &changes));
+    ASSERT_EQ(0, changes.set[DNSCACHE_MAX_TTL]);
+    ASSERT_EQ(5, (int)changes.values[DNSCACHE_MAX_NEGATIVE_TTL]);
+    ASSERT_EQ(0, changes.set[DNSCACHE_BUCKET_SIZE]);
+
+    fake_registry_free(&fake);
+}
+
+TEST(test_write_and_restore) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    DnsCacheSettings desired = {0}, previous, changes, after;
+    DWORD value;
+
+    fake_registry_init(&fake, &reg);
+    reg.set_dword(&fake, DNSCACHE_REGISTRY_KEY, L"MaxCacheTtl", 86400);
+
+    dnscache_set(&desired, L"max_ttl", L"600");
+    dnscache_set(&desired, L"max_negative_ttl", L"0");
+    dnscache_read(&reg, &previous);
+    dnscache_diff(&desired, &previous, &changes);
+
+    ASSERT_EQ(0, dnscache_write(&reg, &changes, &previous));
+    dnscache_read(&reg, &after);
+    ASSERT_EQ(0, dnscache_diff(&desired, &after, &changes));
+    ASSERT_EQ(0, reg.get_dword(&fake, DNSCACHE_REGISTRY_KEY, L"MaxNegativeCacheTtl", &value));
+    ASSERT_EQ(0, (int)value);
+
+    /* Rollback puts the old TTL back and removes the value that was absent */
+    dnscache_diff(&desired, &previous, &changes);
+    ASSERT_EQ(0, dnscache_restore(&reg, &changes, &previous));
+    ASSERT_EQ(0, reg.get_dword(&fake, DNSCACHE_REGISTRY_KEY, L"MaxCacheTtl", &value));
+    ASSERT_EQ(86400, (int)value);
+    ASSERT_EQ(1, reg.get_dword(&fake, DNSCACHE_REGISTRY_KEY, L"MaxNegativeCacheTtl", &value));
+
+    fake_registry_free(&fake);
+}
+
+TEST(test_write_failure) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    DnsCacheSettings desired = {0}, previous, changes;
+
+    fake_registry_init(&fake, &reg);
+    dnscache_set(&desired, L"bucket_size", L"32");
+    dnscache_read(&reg, &previous);
+    dnscache_diff(&desired, &previous, &changes);
+
+    fake.fail_writes = 1;
+    ASSERT_EQ(-1, dnscache_write(&reg, &changes, &previous));
+    ASSERT_EQ(-1, dnscache_restore(&reg, &changes, &previous));
+
+    fake_registry_free(&fake);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* setting tests */
+    RUN_TEST(test_set_validates);
+
+    /* registry tests */
+    RUN_TEST(test_diff_only_differences);
+    RUN_TEST(test_write_and_restore);
+    RUN_TEST(test_write_failure);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,183 @@
+/*
+ * test_export.c - Tests for the Prometheus/JSON status exporter
+ */
+
+#include "export.h"
+#include "test.h"
+#include <string.h>
+
+static void add_server(DnsServerInfo *servers, int *count, const wchar_t *address,
+                       int has_template, int autoupgrade, int udpfallback)
+{
+    DnsServerInfo *info = &servers[(*count)++];
+
+    ZeroMemory(info, sizeof(*info));
+    StringCchCopyW(info->address, MAX_ADDR_LEN, address);
+    info->has_template = has_template;
+    info->autoupgrade = autoupgrade;
+    info->udpfallback = udpfallback;
+}
+
+/* One encrypted IPv4 server, one IPv4 server with fallback, one plain IPv6 server */
+static void mixed_report(StatusReport *report)
+{
+    ULONGLONG t = (1704067200ULL + 11644473600ULL) * 10000000ULL;
+
+    ZeroMemory(report, sizeof(*report));
+    StringCchCopyW(report->interface_name, MAX_IFACE_LEN, L"Ethernet");
+    report->collected.dwLowDateTime = (DWORD)t;
+    report->collected.dwHighDateTime = (DWORD)(t >> 32);
+    add_server(report->ipv4, &report->ipv4_count, L"1.1.1.1", 1, 1, 0);
+    add_server(report->ipv4, &report->ipv4_count, L"1.0.0.1", 1, 1, 1);
+    add_server(report->ipv6, &report->ipv6_count, L"fd00::53", 0, 0, 0);
+    status_summarize(report);
+}
+
+static int count_lines(const char *text, const char *prefix)
+{
+    int count = 0;
+    size_t len = strlen(prefix);
+
+    for (const char *line = text; *line; ) {
+        const char *next = strchr(line, '\n');
+        if (strncmp(line, prefix, len) == 0) {
+            count++;
+        }
+        if (!next) {
+            break;
+        }
+        line = next + 1;
+    }
+    return count;
+}
+
+/* ============================================================================
+ * FORMAT TESTS
+ * ============================================================================ */
+
+TEST(test_parse_format) {
+    ExportFormat format = EXPORT_JSON;
+
+    ASSERT_EQ(0, export_parse_format(L"Prometheus", &format));
+    ASSERT_EQ(EXPORT_PROMETHEUS, format);
+    ASSERT_EQ(0, export_parse_format(L"json", &format));
+    ASSERT_EQ(EXPORT_JSON, format);
+    ASSERT_EQ(-1, export_parse_format(L"xml", &format));
+    ASSERT_EQ(EXPORT_JSON, format);
+}
+
+TEST(test_prometheus_server_gauges) {
+    StatusReport report;
+    static char text[STATUS_METRICS_SIZE];
+
+    mixed_report(&report);
+    ASSERT(export_format(&report, EXPORT_PROMETHEUS, text, sizeof(text)) > 0);
+
+    ASSERT(strstr(text, "# TYPE static_ip_fix_dns_server_encrypted gauge\n") != NULL);
+    ASSERT(strstr(text, "static_ip_fix_dns_server_encrypted{interface=\"Ethernet\",family=\"ipv4\","
+                        "server=\"1.1.1.1\"} 1\n") != NULL);
+    ASSERT(strstr(text, "static_ip_fix_dns_server_encrypted{interface=\"Ethernet\",family=\"ipv4\","
+                        "server=\"1.0.0.1\"} 0\n") != NULL);
+    ASSERT(strstr(text, "static_ip_fix_dns_server_udpfallback{interface=\"Ethernet\",family=\"ipv4\","
+                        "server=\"1.0.0.1\"} 1\n") != NULL);
+    ASSERT(strstr(text, "static_ip_fix_dns_server_has_template{interface=\"Ethernet\",family=\"ipv6\","
+                        "server=\"fd00::53\"} 0\n") != NULL);
+
+    /* One sample per server and gauge, one HELP/TYPE block per gauge */
+    ASSERT_EQ(3, count_lines(text, "static_ip_fix_dns_server_autoupgrade{"));
+    ASSERT_EQ(1, count_lines(text, "# TYPE static_ip_fix_dns_server_autoupgrade "));
+}
+
+TEST(test_prometheus_interface_summary) {
+    StatusReport report;
+    static char text[STATUS_METRICS_SIZE];
+
+    mixed_report(&report);
+    export_format(&report, EXPORT_PROMETHEUS, text, sizeof(text));
+
+    ASSERT(strstr(text, "static_ip_fix_dns_servers{interface=\"Ethernet\",family=\"ipv4\"} 2\n") != NULL);
+    ASSERT(strstr(text, "static_ip_fix_dns_servers_encrypted{interface=\"Ethernet\",family=\"ipv4\"} 1\n") != NULL);
+    ASSERT(strstr(text, "static_ip_fix_dns_servers_encrypted{interface=\"Ethernet\",family=\"ipv6\"} 0\n") != NULL);
+    ASSERT(strstr(text, "static_ip_fix_dns_fallback{interface=\"Ethernet\"} 1\n") != NULL);
+    ASSERT(strstr(text, "static_ip_fix_dns_fully_encrypted{interface=\"Ethernet\"} 0\n") != NULL);
+    ASSERT(strstr(text, "static_ip_fix_dns_collected_timestamp_seconds{interface=\"Ethernet\"} 1704067200\n") != NULL);
+}
+
+TEST(test_prometheus_label_escaping) {
+    StatusReport report;
+    static char text[STATUS_METRICS_SIZE];
+
+    mixed_report(&report);
+    StringCchCopyW(report.interface_name, MAX_IFACE_LEN, L"LAN \"2\" \\ x\ny");
+    export_format(&report, EXPORT_PROMETHEUS, text, sizeof(text));
+
+    ASSERT(strstr(text, "static_ip_fix_dns_fallback{interface=\"LAN \\\"2\\\" \\\\ x\\ny\"} 1\n") != NULL);
+}
+
+TEST(test_format_overflow) {
+    StatusReport report;
+    char small[256];
+
+    mixed_report(&report);
+    ASSERT_EQ(-1, export_format(&report, EXPORT_PROMETHEUS, small, sizeof(small)));
+    ASSERT_EQ(-1, export_format(&report, EXPORT_JSON, small, 32));
+}
+
+/* ============================================================================
+ * FILE TESTS
+ * ============================================================================ */
+
+static int read_file(const wchar_t *path, char *buffer, size_t size)
+{
+    FILE *fp = NULL;
+    size_t len;
+
+    if (_wfopen_s(&fp, path, L"rb") != 0 || !fp) {
+        return -1;
+    }
+    len = fread(buffer, 1, size - 1, fp);
+    fclose(fp);
+    buffer[len] = '\0';
+    return (int)len;
+}
+
+TEST(test_write_file_replaces) {
+    const wchar_t *path = L"test_export.prom";
+    char buffer[64];
+    FILE *fp = NULL;
+
+    ASSERT_EQ(0, export_write_file(path, "first\n", 6));
+    ASSERT_EQ(0, export_write_file(path, "second\n", 7));
+    ASSERT_EQ(7, read_file(path, buffer, sizeof(buffer)));
+    ASSERT(strcmp(buffer, "second\n") == 0);
+
+    /* The temp file does not outlive the rename */
+    ASSERT(_wfopen_s(&fp, L"test_export.prom.tmp", L"rb") != 0);
+    DeleteFileW(path);
+}
+
+TEST(test_write_file_bad_directory) {
+    ASSERT_EQ(-1, export_write_file(L"no-such-dir/test_export.prom", "x", 1));
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* format tests */
+    RUN_TEST(test_parse_format);
+    RUN_TEST(test_prometheus_server_gauges);
+    RUN_TEST(test_prometheus_interface_summary);
+    RUN_TEST(test_prometheus_label_escaping);
+    RUN_TEST(test_format_overflow);
+
+    /* file tests */
+    RUN_TEST(test_write_file_replaces);
+    RUN_TEST(test_write_file_bad_directory);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,217 @@
+/*
+ * test_fastpath.c - Tests for disabling the LLMNR, NetBIOS and mDNS fallbacks
+ */
+
+#include "fastpath.h"
+#include "fake_registry.h"
+#include "test.h"
+
+#define GUID_VPN    L"{11111111-2222-3333-4444-555555555555}"
+#define GUID_WIFI   L"{66666666-7777-8888-9999-000000000000}"
+
+#define NETBT_VPN   FASTPATH_NETBT_KEY L"\\Tcpip_" GUID_VPN
+#define NETBT_WIFI  FASTPATH_NETBT_KEY L"\\Tcpip_" GUID_WIFI
+
+static void seed(FakeRegistry *fake, RegistryBackend *reg)
+{
+    fake_registry_init(fake, reg);
+    reg->set_dword(fake, NETBT_VPN, L"NetbiosOptions", 0);
+    reg->set_dword(fake, NETBT_WIFI, L"NetbiosOptions", 1);
+    reg->set_dword(fake, FASTPATH_NETBT_KEY L"\\Tcpip6_" GUID_VPN, L"NetbiosOptions", 0);
+    fake->writes = 0;
+}
+
+/* ============================================================================
+ * STATE TESTS
+ * ============================================================================ */
+
+TEST(test_scope_parse) {
+    FastPathScope scope;
+
+    ASSERT_EQ(0, fastpath_scope_parse(L"Interface", &scope));
+    ASSERT_EQ(FASTPATH_INTERFACE, scope);
+    ASSERT_EQ(0, fastpath_scope_parse(L"global", &scope));
+    ASSERT_EQ(FASTPATH_GLOBAL, scope);
+    ASSERT_EQ(0, fastpath_scope_parse(L"no", &scope));
+    ASSERT_EQ(FASTPATH_OFF, scope);
+    ASSERT_EQ(-1, fastpath_scope_parse(L"yes", &scope));
+}
+
+TEST(test_read_state) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    FallbackState states[FALLBACK_COUNT];
+
+    seed(&fake, &reg);
+
+    /* Nothing set: Windows defaults */
+    ASSERT_EQ(0, fastpath_read_state(&reg, GUID_VPN, states));
+    ASSERT_EQ(FALLBACK_ENABLED, states[FALLBACK_LLMNR]);
+    ASSERT_EQ(FALLBACK_ENABLED, states[FALLBACK_MDNS]);
+    ASSERT_EQ(FALLBACK_FROM_DHCP, states[FALLBACK_NETBIOS]);
+
+    reg.set_dword(&fake, FASTPATH_LLMNR_KEY, L"EnableMulticast", 0);
+    ASSERT_EQ(0, fastpath_read_state(&reg, GUID_WIFI, states));
+    ASSERT_EQ(FALLBACK_DISABLED, states[FALLBACK_LLMNR]);
+    ASSERT_EQ(FALLBACK_ENABLED, states[FALLBACK_NETBIOS]);
+
+    fake_registry_free(&fake);
+}
+
+/* ============================================================================
+ * PLAN TESTS
+ * ============================================================================ */
+
+TEST(test_plan_interface) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    FastPathPlan plan, again;
+    FallbackState states[FALLBACK_COUNT];
+    DWORD value;
+
+    seed(&fake, &reg);
+
+    ASSERT_EQ(3, fastpath_plan(&reg, FASTPATH_INTERFACE, GUID_VPN, &plan));
+    ASSERT_EQ(0, fastpath_write(&reg, &plan));
+    ASSERT_EQ(3, fake.writes);
+
+    ASSERT_EQ(0, fastpath_read_state(&reg, GUID_VPN, states));
+    for (int i = 0; i < FALLBACK_COUNT; i++) {
+        ASSERT_EQ(FALLBACK_DISABLED, states[i]);
+    }
+
+    /* Other interfaces keep NetBIOS */
+    reg.get_dword(&fake, NETBT_WIFI, L"NetbiosOptions", &value);
+    ASSERT_EQ(1, (int)value);
+
+    /* Nothing left to do on a second run */
+    ASSERT_EQ(0, fastpath_plan(&reg, FASTPATH_INTERFACE, GUID_VPN, &again));
+
+    fastpath_plan_free(&plan);
+    fastpath_plan_free(&again);
+    fake_registry_free(&fake);
+}
+
+TEST(test_plan_global) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    FastPathPlan plan;
+    DWORD value;
+
+    seed(&fake, &reg);
+    reg.set_dword(&fake, FASTPATH_MDNS_KEY, L"EnableMDNS", 0);
+
+    /* LLMNR and both Tcpip_ interfaces; not the Tcpip6_ binding */
+    ASSERT_EQ(3, fastpath_plan(&reg, FASTPATH_GLOBAL, GUID_VPN, &plan));
+    ASSERT_EQ(0, fastpath_write(&reg, &plan));
+    reg.get_dword(&fake, NETBT_WIFI, L"NetbiosOptions", &value);
+    ASSERT_EQ(2, (int)value);
+    reg.get_dword(&fake, FASTPATH_NETBT_KEY L"\\Tcpip6_" GUID_VPN, L"NetbiosOptions", &value);
+    ASSERT_EQ(0, (int)value);
+    fastpath_plan_free(&plan);
+
+    ASSERT_EQ(0, fastpath_plan(&reg, FASTPATH_OFF, GUID_VPN, &plan));
+
+    fake_registry_free(&fake);
+}
+
+TEST(test_plan_many_interfaces) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    FastPathPlan plan;
+    DWORD value;
+
+    /* A VPN-heavy host: 200 bindings, every other one already off */
+    fake_registry_init(&fake, &reg);
+    for (int i = 0; i < 200; i++) {
+        wchar_t key[MAX_PATH_LEN];
+        StringCchPrintfW(key, MAX_PATH_LEN, L"%ls\\Tcpip_{%08d-0000-0000-0000-000000000000}",
+                         FASTPATH_NETBT_KEY, i);
+        reg.set_dword(&fake, key, L"NetbiosOptions", i % 2 == 0 ? 2 : 0);
+    }
+
+    ASSERT_EQ(102, fastpath_plan(&reg, FASTPATH_GLOBAL, GUID_VPN, &plan));
+    ASSERT_EQ(0, fastpath_write(&reg, &plan));
+    reg.get_dword(&fake, FASTPATH_NETBT_KEY L"\\Tcpip_{00000199-0000-0000-0000-000000000000}",
+                  L"NetbiosOptions", &value);
+    ASSERT_EQ(2, (int)value);
+
+    ASSERT_EQ(0, fastpath_restore(&reg, &plan));
+    reg.get_dword(&fake, FASTPATH_NETBT_KEY L"\\Tcpip_{00000199-0000-0000-0000-000000000000}",
+                  L"NetbiosOptions", &value);
+    ASSERT_EQ(0, (int)value);
+
+    fastpath_plan_free(&plan);
+    fake_registry_free(&fake);
+}
+
+/* ============================================================================
+ * ROLLBACK TESTS
+ * ============================================================================ */
+
+TEST(test_restore) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    FastPathPlan plan;
+    DWORD value;
+
+    seed(&fake, &reg);
+    fastpath_plan(&reg, FASTPATH_GLOBAL, GUID_VPN, &plan);
+    fastpath_write(&reg, &plan);
+
+    ASSERT_EQ(0, fastpath_restore(&reg, &plan));
+    ASSERT_EQ(1, reg.get_dword(&fake, FASTPATH_LLMNR_KEY, L"EnableMulticast", &value));
+    ASSERT_EQ(1, reg.get_dword(&fake, FASTPATH_MDNS_KEY, L"EnableMDNS", &value));
+    reg.get_dword(&fake, NETBT_VPN, L"NetbiosOptions", &value);
+    ASSERT_EQ(0, (int)value);
+    reg.get_dword(&fake, NETBT_WIFI, L"NetbiosOptions", &value);
+    ASSERT_EQ(1, (int)value);
+
+    /* Restoring twice is a no-op */
+    fake.writes = 0;
+    ASSERT_EQ(0, fastpath_restore(&reg, &plan));
+    ASSERT_EQ(0, fake.writes);
+
+    fastpath_plan_free(&plan);
+    fake_registry_free(&fake);
+}
+
+TEST(test_write_failure) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    FastPathPlan plan;
+
+    seed(&fake, &reg);
+    fastpath_plan(&reg, FASTPATH_INTERFACE, GUID_VPN, &plan);
+
+    fake.fail_writes = 1;
+    ASSERT_EQ(-1, fastpath_write(&reg, &plan));
+    ASSERT_EQ(0, plan.written);
+
+    fastpath_plan_free(&plan);
+    fake_registry_free(&fake);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* state tests */
+    RUN_TEST(test_scope_parse);
+    RUN_TEST(test_read_state);
+
+    /* plan tests */
+    RUN_TEST(test_plan_interface);
+    RUN_TEST(test_plan_global);
+    RUN_TEST(test_plan_many_interfaces);
+
+    /* rollback tests */
+    RUN_TEST(test_restore);
+    RUN_TEST(test_write_failure);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
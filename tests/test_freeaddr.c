@@ -0,0 +1,221 @@
+/*
+ * test_freeaddr.c - Tests for auto:RANGE free address discovery
+ */
+
+#include "freeaddr.h"
+#include "test.h"
+
+/* ============================================================================
+ * SIMULATED NEIGHBOR TABLE
+ * ============================================================================ */
+
+typedef struct {
+    IpAddr owners[512];         /* Addresses that answer ARP/ND */
+    int owner_count;
+    int calls;                  /* Probe rounds, each one wait */
+    int probed;                 /* Candidates asked, over all rounds */
+    int fail;
+} SimNeighbors;
+
+static int sim_probe(void *ctx, const IpAddr *candidates, int count, int wait_ms, int *in_use)
+{
+    SimNeighbors *sim = (SimNeighbors *)ctx;
+
+    (void)wait_ms;
+    if (sim->fail) {
+        return -1;
+    }
+    sim->calls++;
+    sim->probed += count;
+    for (int i = 0; i < count; i++) {
+        in_use[i] = 0;
+        for (int j = 0; j < sim->owner_count; j++) {
+            if (address_compare(&candidates[i], &sim->owners[j]) == 0) {
+                in_use[i] = 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Every address from `first` for `count` addresses answers
+ */
+static void sim_take(SimNeighbors *sim, const wchar_t *first, int count)
+{
+    IpAddr addr;
+
+    address_parse(first, &addr);
+    for (int i = 0; i < count; i++) {
+        sim->owners[sim->owner_count] = addr;
+        sim->owners[sim->owner_count].bytes[addr.family == AF_INET ? 3 : 15] =
+            (BYTE)(addr.bytes[addr.family == AF_INET ? 3 : 15] + i);
+        sim->owner_count++;
+    }
+}
+
+static int same(const IpAddr *addr, const wchar_t *text)
+{
+    IpAddr expected;
+
+    return address_parse(text, &expected) == 0 && address_compare(addr, &expected) == 0;
+}
+
+/* ============================================================================
+ * RANGE TESTS
+ * ============================================================================ */
+
+TEST(test_is_auto) {
+    ASSERT(freeaddr_is_auto(L"auto:192.168.1.0/24"));
+    ASSERT(freeaddr_is_auto(L"AUTO:10.0.0.10-10.0.0.20"));
+    ASSERT(!freeaddr_is_auto(L"192.168.1.50"));
+    ASSERT(!freeaddr_is_auto(L""));
+}
+
+TEST(test_parse_range) {
+    FreeAddrRange range;
+
+    ASSERT_EQ(0, freeaddr_parse_range(L"10.0.0.10-10.0.0.20", AF_INET, &range));
+    ASSERT(same(&range.first, L"10.0.0.10"));
+    ASSERT(same(&range.last, L"10.0.0.20"));
+
+    /* A network leaves out its network and broadcast addresses */
+    ASSERT_EQ(0, freeaddr_parse_range(L"192.168.1.77/24", AF_INET, &range));
+    ASSERT(same(&range.first, L"192.168.1.1"));
+    ASSERT(same(&range.last, L"192.168.1.254"));
+    ASSERT_EQ(-1, range.first.prefix);
+
+    ASSERT_EQ(0, freeaddr_parse_range(L"2001:db8::/120", AF_INET6, &range));
+    ASSERT(same(&range.first, L"2001:db8::1"));
+    ASSERT(same(&range.last, L"2001:db8::ff"));
+
+    ASSERT_EQ(0, freeaddr_parse_range(L"10.0.0.0/20", AF_INET, &range));
+    ASSERT_EQ(-1, freeaddr_parse_range(L"10.0.0.0/19", AF_INET, &range));
+    ASSERT_EQ(-1, freeaddr_parse_range(L"2001:db8::/64", AF_INET6, &range));
+    ASSERT_EQ(-1, freeaddr_parse_range(L"10.0.0.20-10.0.0.10", AF_INET, &range));
+    ASSERT_EQ(-1, freeaddr_parse_range(L"10.0.0.1-10.0.0.2", AF_INET6, &range));
+    ASSERT_EQ(-1, freeaddr_parse_range(L"10.0.0.1-", AF_INET, &range));
+    ASSERT_EQ(-1, freeaddr_parse_range(L"10.0.0.1", AF_INET, &range));
+}
+
+TEST(test_candidates_exclude) {
+    FreeAddrRange range;
+    IpAddr exclude[2], list[16];
+    int count;
+
+    freeaddr_parse_range(L"10.0.0.1-10.0.0.6", AF_INET, &range);
+    address_parse(L"10.0.0.1", &exclude[0]);
+    address_parse(L"10.0.0.4", &exclude[1]);
+
+    count = freeaddr_candidates(&range, exclude, 2, list, 16);
+    ASSERT_EQ(4, count);
+    ASSERT(same(&list[0], L"10.0.0.2"));
+    ASSERT(same(&list[2], L"10.0.0.5"));
+
+    ASSERT_EQ(2, freeaddr_candidates(&range, NULL, 0, list, 2));
+}
+
+/* ============================================================================
+ * DISCOVERY TESTS
+ * ============================================================================ */
+
+TEST(test_find_first_free) {
+    static SimNeighbors sim;
+    FreeAddrBackend backend = { &sim, sim_probe };
+    FreeAddrRange range;
+    IpAddr list[FREEADDR_MAX_CANDIDATES], chosen;
+    int count;
+
+    ZeroMemory(&sim, sizeof(sim));
+    sim_take(&sim, L"192.168.1.1", 9);
+    sim_take(&sim, L"192.168.1.11", 5);
+    freeaddr_parse_range(L"192.168.1.0/24", AF_INET, &range);
+    count = freeaddr_candidates(&range, NULL, 0, list, FREEADDR_MAX_CANDIDATES);
+
+    /* A whole /24 goes out in one round, so it costs one wait */
+    ASSERT_EQ(0, freeaddr_find(&backend, list, count, NULL, 0, FREEADDR_WAIT_MS, &chosen));
+    ASSERT(same(&chosen, L"192.168.1.10"));
+    ASSERT_EQ(1, sim.calls);
+    ASSERT_EQ(254, sim.probed);
+}
+
+TEST(test_find_keeps_current) {
+    static SimNeighbors sim;
+    FreeAddrBackend backend = { &sim, sim_probe };
+    FreeAddrRange range;
+    IpAddr list[64], current[2], chosen;
+    int count;
+
+    ZeroMemory(&sim, sizeof(sim));
+    freeaddr_parse_range(L"2001:db8::10-2001:db8::2f", AF_INET6, &range);
+    count = freeaddr_candidates(&range, NULL, 0, list, 64);
+    address_parse(L"fe80::1", &current[0]);
+    address_parse(L"2001:db8::20/64", &current[1]);
+
+    /* A rerun keeps the address it picked last time, without probing */
+    ASSERT_EQ(0, freeaddr_find(&backend, list, count, current, 2, FREEADDR_WAIT_MS, &chosen));
+    ASSERT(same(&chosen, L"2001:db8::20"));
+    ASSERT_EQ(0, sim.calls);
+
+    ASSERT_EQ(0, freeaddr_find(&backend, list, count, current, 1, FREEADDR_WAIT_MS, &chosen));
+    ASSERT(same(&chosen, L"2001:db8::10"));
+}
+
+TEST(test_find_batches) {
+    static SimNeighbors sim;
+    FreeAddrBackend backend = { &sim, sim_probe };
+    FreeAddrRange range;
+    IpAddr list[FREEADDR_MAX_CANDIDATES], chosen;
+    int count;
+
+    /* 10.0.0.1 - 10.0.1.44 answer: the first free address is in the second batch */
+    ZeroMemory(&sim, sizeof(sim));
+    sim_take(&sim, L"10.0.0.1", 255);
+    sim_take(&sim, L"10.0.1.0", 45);
+    freeaddr_parse_range(L"10.0.0.0/22", AF_INET, &range);
+    count = freeaddr_candidates(&range, NULL, 0, list, FREEADDR_MAX_CANDIDATES);
+    ASSERT_EQ(1022, count);
+
+    ASSERT_EQ(0, freeaddr_find(&backend, list, count, NULL, 0, FREEADDR_WAIT_MS, &chosen));
+    ASSERT(same(&chosen, L"10.0.1.45"));
+    ASSERT_EQ(2, sim.calls);
+}
+
+TEST(test_find_none_free) {
+    static SimNeighbors sim;
+    FreeAddrBackend backend = { &sim, sim_probe };
+    FreeAddrRange range;
+    IpAddr list[16], chosen;
+    int count;
+
+    ZeroMemory(&sim, sizeof(sim));
+    sim_take(&sim, L"10.0.0.1", 6);
+    freeaddr_parse_range(L"10.0.0.0/29", AF_INET, &range);
+    count = freeaddr_candidates(&range, NULL, 0, list, 16);
+    ASSERT_EQ(1, freeaddr_find(&backend, list, count, NULL, 0, FREEADDR_WAIT_MS, &chosen));
+
+    sim.fail = 1;
+    ASSERT_EQ(-1, freeaddr_find(&backend, list, count, NULL, 0, FREEADDR_WAIT_MS, &chosen));
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* range tests */
+    RUN_TEST(test_is_auto);
+    RUN_TEST(test_parse_range);
+    RUN_TEST(test_candidates_exclude);
+
+    /* discovery tests */
+    RUN_TEST(test_find_first_free);
+    RUN_TEST(test_find_keeps_current);
+    RUN_TEST(test_find_batches);
+    RUN_TEST(test_find_none_free);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
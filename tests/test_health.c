@@ -0,0 +1,311 @@
+/*
+ * test_health.c - Tests for resolver health probing and failover
+ *
+ * The probe loop runs against stub DNS servers on the loopback interface
+ * whose answer delay is changed while the loop is running.
+ */
+
+#include "health.h"
+#include "test.h"
+#include "stub_dns.h"
+
+static const DnsProvider PRIMARY = {
+    L"Primary", L"127.0.0.1", L"", L"", L"", L"https://primary.example/dns-query"
+};
+static const DnsProvider FALLBACK = {
+    L"Fallback", L"127.0.0.1", L"", L"", L"", L"https://fallback.example/dns-query"
+};
+
+static void test_options(HealthOptions *opts)
+{
+    health_options_init(opts);
+    opts->window = 4;
+    opts->max_latency_ms = 50;
+    opts->max_loss_pct = 25;
+    opts->fail_after = 2;
+    opts->recover_after = 3;
+}
+
+/* Fill an upstream's window with `n` samples */
+static void fill(HealthUpstream *up, const HealthOptions *opts, int n, int ok, double ms)
+{
+    for (int i = 0; i < n; i++) {
+        health_record(up, opts, ok, ms);
+    }
+}
+
+/* ============================================================================
+ * WINDOW TESTS
+ * ============================================================================ */
+
+TEST(test_window_rolls) {
+    HealthOptions opts;
+    HealthMonitor mon;
+    HealthUpstream *up = &mon.upstreams[HEALTH_PRIMARY];
+    HealthSummary summary;
+
+    test_options(&opts);
+    ASSERT_EQ(0, health_monitor_init(&mon, &PRIMARY, &FALLBACK));
+
+    health_record(up, &opts, 1, 10.0);
+    health_record(up, &opts, 0, 0.0);
+    health_record(up, &opts, 1, 30.0);
+    health_summarize(up, &summary);
+    ASSERT_EQ(3, summary.samples);
+    ASSERT_EQ(33, summary.loss_pct);
+    ASSERT(summary.median_ms == 20.0);
+
+    /* Three more samples fill the window and push out the oldest two */
+    health_record(up, &opts, 1, 40.0);
+    health_record(up, &opts, 1, 50.0);
+    health_record(up, &opts, 1, 60.0);
+    health_summarize(up, &summary);
+    ASSERT_EQ(4, summary.samples);
+    ASSERT_EQ(0, summary.loss_pct);
+    ASSERT(summary.median_ms == 45.0);
+}
+
+TEST(test_judge) {
+    HealthOptions opts;
+    HealthSummary summary = { 1, 100, 0.0 };
+
+    test_options(&opts);
+
+    /* Less than half a window says nothing */
+    ASSERT_EQ(HEALTH_UNKNOWN, health_judge(&summary, &opts, 100));
+
+    summary.samples = 4;
+    summary.loss_pct = 25;
+    summary.median_ms = 50.0;
+    ASSERT_EQ(HEALTH_GOOD, health_judge(&summary, &opts, 100));
+
+    /* Right at the limits is not good enough to recover */
+    ASSERT_EQ(HEALTH_DEGRADED, health_judge(&summary, &opts, HEALTH_RECOVER_PCT));
+
+    summary.median_ms = 50.5;
+    ASSERT_EQ(HEALTH_DEGRADED, health_judge(&summary, &opts, 100));
+
+    summary.median_ms = 5.0;
+    summary.loss_pct = 50;
+    ASSERT_EQ(HEALTH_DEGRADED, health_judge(&summary, &opts, 100));
+}
+
+TEST(test_monitor_needs_servers) {
+    HealthMonitor mon;
+    DnsProvider empty = { L"Empty", L"", NULL, L"", NULL, L"" };
+    DnsProvider v6only = { L"V6", L"", NULL, L"::1", NULL, L"" };
+
+    ASSERT_EQ(-1, health_monitor_init(&mon, &PRIMARY, &empty));
+    ASSERT_EQ(0, health_monitor_init(&mon, &v6only, &FALLBACK));
+    ASSERT(wcscmp(mon.upstreams[HEALTH_PRIMARY].target.server, L"::1") == 0);
+}
+
+/* ============================================================================
+ * DECISION TESTS
+ * ============================================================================ */
+
+TEST(test_failover_needs_sustained_breach) {
+    HealthOptions opts;
+    HealthMonitor mon;
+
+    test_options(&opts);
+    health_monitor_init(&mon, &PRIMARY, &FALLBACK);
+    fill(&mon.upstreams[HEALTH_FALLBACK], &opts, 4, 1, 10.0);
+    fill(&mon.upstreams[HEALTH_PRIMARY], &opts, 4, 1, 200.0);
+
+    ASSERT_EQ(HEALTH_STAY, health_evaluate(&mon, &opts));
+
+    /* A good window in between starts the count over */
+    fill(&mon.upstreams[HEALTH_PRIMARY], &opts, 4, 1, 10.0);
+    ASSERT_EQ(HEALTH_STAY, health_evaluate(&mon, &opts));
+    fill(&mon.upstreams[HEALTH_PRIMARY], &opts, 4, 1, 200.0);
+    ASSERT_EQ(HEALTH_STAY, health_evaluate(&mon, &opts));
+    ASSERT_EQ(HEALTH_FAILOVER, health_evaluate(&mon, &opts));
+}
+
+TEST(test_no_failover_to_degraded_fallback) {
+    HealthOptions opts;
+    HealthMonitor mon;
+
+    test_options(&opts);
+    health_monitor_init(&mon, &PRIMARY, &FALLBACK);
+    fill(&mon.upstreams[HEALTH_PRIMARY], &opts, 4, 0, 0.0);
+    fill(&mon.upstreams[HEALTH_FALLBACK], &opts, 4, 0, 0.0);
+
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ(HEALTH_STAY, health_evaluate(&mon, &opts));
+    }
+
+    /* Once the fallback answers again, the breach streak still counts */
+    fill(&mon.upstreams[HEALTH_FALLBACK], &opts, 4, 1, 10.0);
+    ASSERT_EQ(HEALTH_FAILOVER, health_evaluate(&mon, &opts));
+}
+
+TEST(test_failback_hysteresis) {
+    HealthOptions opts;
+    HealthMonitor mon;
+
+    test_options(&opts);
+    health_monitor_init(&mon, &PRIMARY, &FALLBACK);
+    mon.active = HEALTH_FALLBACK;
+    fill(&mon.upstreams[HEALTH_FALLBACK], &opts, 4, 1, 10.0);
+
+    /* Just inside the failover limit, but not inside the recovery band */
+    fill(&mon.upstreams[HEALTH_PRIMARY], &opts, 4, 1, 45.0);
+    for (int i = 0; i < 5; i++) {
+        ASSERT_EQ(HEALTH_STAY, health_evaluate(&mon, &opts));
+    }
+
+    fill(&mon.upstreams[HEALTH_PRIMARY], &opts, 4, 1, 20.0);
+    ASSERT_EQ(HEALTH_STAY, health_evaluate(&mon, &opts));
+    ASSERT_EQ(HEALTH_STAY, health_evaluate(&mon, &opts));
+    ASSERT_EQ(HEALTH_FAILBACK, health_evaluate(&mon, &opts));
+}
+
+/* ============================================================================
+ * PROBE LOOP TESTS
+ * ============================================================================ */
+
+typedef struct {
+    StubServer *primary;
+    HANDLE stop;
+    const wchar_t *applied[8];
+    int calls;
+    int fail_first;         /* Calls to fail before succeeding */
+    int on_fallback;
+} SwitchLog;
+
+/*
+ * Heal the primary once traffic moved away from it; stop after failback
+ */
+static int record_switch(void *ctx, const DnsProvider *provider)
+{
+    SwitchLog *log = (SwitchLog *)ctx;
+
+    if (log->calls < 8) {
+        log->applied[log->calls] = provider->name;
+    }
+    log->calls++;
+    if (log->fail_first > 0) {
+        log->fail_first--;
+        return -1;
+    }
+
+    if (wcscmp(provider->name, L"Fallback") == 0) {
+        log->primary->delay_ms = 0;
+        log->on_fallback = 1;
+    } else if (log->on_fallback) {
+        SetEvent(log->stop);
+    }
+    return 0;
+}
+
+static int run_loop(HealthMonitor *mon, SwitchLog *log, int fail_first, double *elapsed)
+{
+    StubServer primary, fallback;
+    HealthOptions opts;
+    ProbeOptions probe;
+    LONGLONG start;
+    int ret;
+
+    if (stub_start(&primary, 80, 0) != 0 || stub_start(&fallback, 0, 0) != 0) {
+        return -1;
+    }
+
+    test_options(&opts);
+    opts.interval_ms = 20;
+    opts.timeout_ms = 200;
+    probe_options_init(&probe);
+
+    health_monitor_init(mon, &PRIMARY, &FALLBACK);
+    mon->upstreams[HEALTH_PRIMARY].target.port = primary.port;
+    mon->upstreams[HEALTH_FALLBACK].target.port = fallback.port;
+
+    ZeroMemory(log, sizeof(*log));
+    log->primary = &primary;
+    log->stop = CreateEventW(NULL, TRUE, FALSE, NULL);
+    log->fail_first = fail_first;
+
+    start = timer_now();
+    ret = health_loop(mon, &opts, &probe, log->stop, record_switch, log);
+    *elapsed = timer_elapsed_ms(start);
+
+    CloseHandle(log->stop);
+    stub_stop(&primary);
+    stub_stop(&fallback);
+    return ret;
+}
+
+TEST(test_loop_fails_over_and_back) {
+    HealthMonitor mon;
+    SwitchLog log;
+    double elapsed;
+
+    ASSERT_EQ(0, run_loop(&mon, &log, 0, &elapsed));
+    ASSERT_EQ(2, log.calls);
+    ASSERT(wcscmp(log.applied[0], L"Fallback") == 0);
+    ASSERT(wcscmp(log.applied[1], L"Primary") == 0);
+    ASSERT_EQ(2, mon.switches);
+    ASSERT_EQ(HEALTH_PRIMARY, mon.active);
+
+    /* Half a window plus the breach streak at 80 ms, then the recovery streak */
+    ASSERT(elapsed >= 3 * 80.0);
+    ASSERT(elapsed < 5000.0);
+}
+
+TEST(test_loop_retries_failed_switch) {
+    HealthMonitor mon;
+    SwitchLog log;
+    double elapsed;
+
+    /* The failed failover is followed by the primary being re-applied */
+    ASSERT_EQ(0, run_loop(&mon, &log, 1, &elapsed));
+    ASSERT_EQ(4, log.calls);
+    ASSERT(wcscmp(log.applied[0], L"Fallback") == 0);
+    ASSERT(wcscmp(log.applied[1], L"Primary") == 0);
+    ASSERT(wcscmp(log.applied[2], L"Fallback") == 0);
+    ASSERT(wcscmp(log.applied[3], L"Primary") == 0);
+    ASSERT_EQ(2, mon.switches);
+}
+
+TEST(test_loop_failed_restore) {
+    HealthMonitor mon;
+    SwitchLog log;
+    double elapsed;
+
+    /* The re-apply fails too: the monitor still counts the primary as
+       active and switches on the next breach */
+    ASSERT_EQ(0, run_loop(&mon, &log, 2, &elapsed));
+    ASSERT_EQ(4, log.calls);
+    ASSERT(wcscmp(log.applied[0], L"Fallback") == 0);
+    ASSERT(wcscmp(log.applied[1], L"Primary") == 0);
+    ASSERT(wcscmp(log.applied[2], L"Fallback") == 0);
+    ASSERT_EQ(HEALTH_PRIMARY, mon.active);
+    ASSERT_EQ(2, mon.switches);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* window tests */
+    RUN_TEST(test_window_rolls);
+    RUN_TEST(test_judge);
+    RUN_TEST(test_monitor_needs_servers);
+
+    /* decision tests */
+    RUN_TEST(test_failover_needs_sustained_breach);
+    RUN_TEST(test_no_failover_to_degraded_fallback);
+    RUN_TEST(test_failback_hysteresis);
+
+    /* probe loop tests */
+    RUN_TEST(test_loop_fails_over_and_back);
+    RUN_TEST(test_loop_retries_failed_switch);
+    RUN_TEST(test_loop_failed_restore);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,235 @@
+/*
+ * test_history.c - Tests for the status history ring
+ */
+
+#include "history.h"
+#include "config.h"
+#include "test.h"
+#include <string.h>
+
+#define TEST_CAPACITY 8
+
+/* An anonymous block stands in for the mapped file */
+static BYTE g_block[sizeof(HistoryHeader) + TEST_CAPACITY * sizeof(HistoryRecord)];
+
+static void attach_new(HistoryRing *ring)
+{
+    ZeroMemory(g_block, sizeof(g_block));
+    ZeroMemory(ring, sizeof(*ring));
+    history_attach(ring, g_block, sizeof(g_block), TEST_CAPACITY);
+}
+
+static void make_report(StatusReport *report, const wchar_t *iface, int minute)
+{
+    ULONGLONG t = (1704067200ULL + 60ULL * minute + 11644473600ULL) * 10000000ULL;
+
+    ZeroMemory(report, sizeof(*report));
+    StringCchCopyW(report->interface_name, MAX_IFACE_LEN, iface);
+    report->collected.dwLowDateTime = (DWORD)t;
+    report->collected.dwHighDateTime = (DWORD)(t >> 32);
+}
+
+static void add_server(StatusReport *report, const wchar_t *address, int encrypted)
+{
+    DnsServerInfo *info = &report->ipv4[report->ipv4_count++];
+
+    StringCchCopyW(info->address, MAX_ADDR_LEN, address);
+    info->has_template = encrypted;
+    info->autoupgrade = encrypted;
+    info->udpfallback = !encrypted;
+}
+
+static void cloudflare_report(StatusReport *report, const wchar_t *iface, int minute, int encrypted)
+{
+    make_report(report, iface, minute);
+    add_server(report, L"1.1.1.1", encrypted);
+    add_server(report, L"1.0.0.1", 1);
+    status_summarize(report);
+}
+
+/* ============================================================================
+ * RING TESTS
+ * ============================================================================ */
+
+TEST(test_record_is_compact) {
+    ASSERT_EQ(64, (int)sizeof(HistoryHeader));
+    ASSERT_EQ(64, (int)sizeof(HistoryRecord));
+}
+
+TEST(test_attach) {
+    HistoryRing ring;
+
+    attach_new(&ring);
+    ASSERT_EQ(TEST_CAPACITY, (int)ring.header->capacity);
+    ASSERT_EQ(0, (int)history_count(&ring));
+
+    /* Re-attaching keeps the ring and its capacity */
+    ASSERT_EQ(0, history_attach(&ring, g_block, sizeof(g_block), 1024));
+    ASSERT_EQ(TEST_CAPACITY, (int)ring.header->capacity);
+
+    /* Foreign content and short blocks are refused */
+    ring.header->magic = 0x12345678;
+    ASSERT_EQ(-1, history_attach(&ring, g_block, sizeof(g_block), TEST_CAPACITY));
+    ZeroMemory(g_block, sizeof(g_block));
+    ASSERT_EQ(-1, history_attach(&ring, g_block, sizeof(g_block), TEST_CAPACITY + 1));
+}
+
+TEST(test_wraps_around) {
+    HistoryRing ring;
+    StatusReport report;
+
+    attach_new(&ring);
+    for (int i = 0; i < TEST_CAPACITY + 3; i++) {
+        cloudflare_report(&report, L"Ethernet", i, 1);
+        ASSERT_EQ(0, history_append(&ring, &report));
+    }
+
+    ASSERT_EQ(TEST_CAPACITY, (int)history_count(&ring));
+    ASSERT_EQ(4, (int)history_get(&ring, 0)->sequence);
+    ASSERT_EQ(TEST_CAPACITY + 3, (int)history_get(&ring, TEST_CAPACITY - 1)->sequence);
+
+    /* A claimed but unpublished slot reads as missing */
+    ring.records[(TEST_CAPACITY + 2) % TEST_CAPACITY].sequence = 0;
+    ASSERT(history_get(&ring, TEST_CAPACITY - 1) == NULL);
+}
+
+/* ============================================================================
+ * CHANGE TESTS
+ * ============================================================================ */
+
+TEST(test_change_bitmap) {
+    HistoryRing ring;
+    StatusReport report;
+
+    attach_new(&ring);
+    cloudflare_report(&report, L"Ethernet", 0, 1);
+    history_append(&ring, &report);
+    cloudflare_report(&report, L"Ethernet", 1, 1);
+    history_append(&ring, &report);
+    cloudflare_report(&report, L"Ethernet", 2, 0);
+    history_append(&ring, &report);
+
+    ASSERT(history_get(&ring, 0)->changes == HISTORY_CHANGE_FIRST);
+    ASSERT(history_get(&ring, 1)->changes == 0);
+    ASSERT(history_get(&ring, 2)->changes ==
+           (HISTORY_CHANGE_ENCRYPTED | HISTORY_CHANGE_FALLBACK | HISTORY_CHANGE_UNENCRYPTED |
+            HISTORY_CHANGE_SLOT(0)));
+    ASSERT(history_get(&ring, 2)->server_flags[0] == (HISTORY_SERVER_FALLBACK));
+}
+
+TEST(test_changes_per_interface) {
+    HistoryRing ring;
+    StatusReport report;
+
+    attach_new(&ring);
+    cloudflare_report(&report, L"Ethernet", 0, 1);
+    history_append(&ring, &report);
+    cloudflare_report(&report, L"Wi-Fi", 0, 0);
+    history_append(&ring, &report);
+    cloudflare_report(&report, L"Ethernet", 1, 1);
+    history_append(&ring, &report);
+
+    /* Compared with Ethernet's last sample, not with Wi-Fi's */
+    ASSERT(history_get(&ring, 1)->changes == HISTORY_CHANGE_FIRST);
+    ASSERT(history_get(&ring, 2)->changes == 0);
+
+    /* Other servers with the same flags still count as a change */
+    make_report(&report, L"Ethernet", 2);
+    add_server(&report, L"9.9.9.9", 1);
+    add_server(&report, L"1.0.0.1", 1);
+    status_summarize(&report);
+    history_append(&ring, &report);
+    ASSERT(history_get(&ring, 3)->changes == HISTORY_CHANGE_SERVERS);
+}
+
+TEST(test_long_interface_name) {
+    StatusReport report;
+    HistoryRecord record;
+
+    /* 10 three-byte characters do not fit in 23 bytes */
+    make_report(&report, L"\x20ac\x20ac\x20ac\x20ac\x20ac\x20ac\x20ac\x20ac\x20ac\x20ac", 0);
+    history_make_record(&report, NULL, &record);
+    ASSERT_EQ(21, (int)strlen(record.interface_name));
+}
+
+TEST(test_format_record) {
+    HistoryRing ring;
+    StatusReport report;
+    wchar_t line[512];
+
+    attach_new(&ring);
+    cloudflare_report(&report, L"Ethernet", 0, 1);
+    history_append(&ring, &report);
+    cloudflare_report(&report, L"Ethernet", 90, 0);
+    history_append(&ring, &report);
+
+    history_format_record(history_get(&ring, 0), line, 512);
+    ASSERT(wcsncmp(line, L"2024-01-01 00:00:00Z  Ethernet ", 31) == 0);
+    ASSERT(wcsstr(line, L"ENCRYPTED            IPv4 2/2  IPv6 0/0  first sample") != NULL);
+
+    history_format_record(history_get(&ring, 1), line, 512);
+    ASSERT(wcsncmp(line, L"2024-01-01 01:30:00Z", 20) == 0);
+    ASSERT(wcsstr(line, L"NOT FULLY ENCRYPTED  IPv4 1/2") != NULL);
+    ASSERT(wcsstr(line, L"no longer fully encrypted, fallback enabled, unencrypted server appeared, "
+                        L"IPv4 #1 not encrypted") != NULL);
+
+    cloudflare_report(&report, L"Ethernet", 91, 1);
+    history_append(&ring, &report);
+    history_format_record(history_get(&ring, 2), line, 512);
+    ASSERT(wcsstr(line, L"now fully encrypted, fallback disabled") != NULL);
+}
+
+TEST(test_run_without_file) {
+    const wchar_t *path = L"test_history_missing.hist";
+
+    config_init();
+    DeleteFileW(path);
+    StringCchCopyW(g_config.history_file, MAX_PATH_LEN, path);
+
+    /* Reading reports that nothing was recorded and creates nothing */
+    ASSERT_EQ(0, history_run());
+    ASSERT(GetFileAttributesW(path) == INVALID_FILE_ATTRIBUTES);
+
+    config_init();
+}
+
+TEST(test_append_fast) {
+    HistoryRing ring;
+    StatusReport report;
+    LONGLONG start;
+
+    attach_new(&ring);
+    cloudflare_report(&report, L"Ethernet", 0, 1);
+
+    start = timer_now();
+    for (int i = 0; i < 10000; i++) {
+        history_append(&ring, &report);
+    }
+    /* 10000 samples into the ring */
+    ASSERT(timer_elapsed_ms(start) < 100.0);
+    ASSERT_EQ(10000, (int)ring.header->next);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* ring tests */
+    RUN_TEST(test_record_is_compact);
+    RUN_TEST(test_attach);
+    RUN_TEST(test_wraps_around);
+
+    /* change tests */
+    RUN_TEST(test_change_bitmap);
+    RUN_TEST(test_changes_per_interface);
+    RUN_TEST(test_long_interface_name);
+    RUN_TEST(test_format_record);
+    RUN_TEST(test_run_without_file);
+    RUN_TEST(test_append_fast);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
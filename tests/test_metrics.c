@@ -0,0 +1,399 @@
+/*
+ * test_metrics.c - Tests for interface metric tuning
+ *
+ * A simulated set of adapters answers echoes after a per-link latency
+ * and keeps its interface metrics in memory.
+ */
+
+#include "metrics.h"
+#include "fake_registry.h"
+#include "test.h"
+
+/* ============================================================================
+ * SIMULATED ADAPTERS
+ * ============================================================================ */
+
+#define SIM_LINKS 4
+
+typedef struct {
+    int latency_ms;
+    int lose_every;                         /* Lose every Nth echo, 0 = none */
+    int has_family[METRICS_FAMILIES];
+    MetricSetting setting[METRICS_FAMILIES];
+    int fail_set;                           /* Writes to this adapter fail */
+    volatile LONG pings;
+} SimAdapter;
+
+typedef struct {
+    SimAdapter adapters[SIM_LINKS];
+    volatile LONG in_flight;
+    volatile LONG max_in_flight;
+    int writes;
+} SimNet;
+
+static SimAdapter *sim_adapter(void *ctx, const MetricLink *link)
+{
+    return &((SimNet *)ctx)->adapters[link->luid.Value];
+}
+
+static int family_index(int family)
+{
+    return family == AF_INET ? 0 : 1;
+}
+
+static int sim_ping(void *ctx, const MetricLink *link, int timeout_ms, double *rtt_ms)
+{
+    SimNet *net = (SimNet *)ctx;
+    SimAdapter *adapter = sim_adapter(ctx, link);
+    LONG n = InterlockedIncrement(&adapter->pings);
+    LONG now = InterlockedIncrement(&net->in_flight);
+    int lost = adapter->lose_every && n % adapter->lose_every == 0;
+
+    for (LONG seen = net->max_in_flight; now > seen; seen = net->max_in_flight) {
+        InterlockedCompareExchange(&net->max_in_flight, now, seen);
+    }
+
+    Sleep(lost ? (DWORD)timeout_ms : (DWORD)adapter->latency_ms);
+    *rtt_ms = adapter->latency_ms;
+
+    InterlockedDecrement(&net->in_flight);
+    return lost ? -1 : 0;
+}
+
+static int sim_get(void *ctx, const MetricLink *link, int family, MetricSetting *out)
+{
+    SimAdapter *adapter = sim_adapter(ctx, link);
+
+    if (!adapter->has_family[family_index(family)]) {
+        return -1;
+    }
+    *out = adapter->setting[family_index(family)];
+    return 0;
+}
+
+static int sim_set(void *ctx, const MetricLink *link, int family, const MetricSetting *setting)
+{
+    SimAdapter *adapter = sim_adapter(ctx, link);
+
+    ((SimNet *)ctx)->writes++;
+    if (adapter->fail_set || !adapter->has_family[family_index(family)]) {
+        return -1;
+    }
+    adapter->setting[family_index(family)] = *setting;
+    return 0;
+}
+
+/*
+ * Adapters with both families on automatic metric 25 (IPv4) and 35 (IPv6)
+ */
+static void sim_setup(SimNet *net, MetricsBackend *backend, MetricLink *links,
+                      const int *latencies, int count)
+{
+    ZeroMemory(net, sizeof(*net));
+    ZeroMemory(links, (size_t)count * sizeof(*links));
+    for (int i = 0; i < count; i++) {
+        SimAdapter *adapter = &net->adapters[i];
+        adapter->latency_ms = latencies[i];
+        adapter->has_family[0] = 1;
+        adapter->has_family[1] = 1;
+        adapter->setting[0].automatic = 1;
+        adapter->setting[0].metric = 25;
+        adapter->setting[1].automatic = 1;
+        adapter->setting[1].metric = 35;
+
+        StringCchPrintfW(links[i].name, MAX_IFACE_LEN, L"Ethernet %d", i + 1);
+        links[i].luid.Value = (ULONG64)i;
+        address_parse(L"192.168.1.1", &links[i].gateway);
+    }
+
+    backend->ctx = net;
+    backend->ping = sim_ping;
+    backend->get = sim_get;
+    backend->set = sim_set;
+}
+
+static void test_options(MetricsOptions *opts)
+{
+    metrics_options_init(opts);
+    opts->pings = 3;
+    opts->timeout_ms = 150;
+}
+
+/* ============================================================================
+ * MEASUREMENT TESTS
+ * ============================================================================ */
+
+TEST(test_measure_concurrently) {
+    static const int latencies[] = { 60, 20, 40 };
+    SimNet net;
+    MetricsBackend backend;
+    MetricLink links[SIM_LINKS];
+    MetricsOptions opts;
+    LONGLONG start;
+    double elapsed;
+
+    test_options(&opts);
+    sim_setup(&net, &backend, links, latencies, 3);
+
+    start = timer_now();
+    ASSERT_EQ(0, metrics_measure(&backend, links, 3, &opts));
+    elapsed = timer_elapsed_ms(start);
+
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(3, links[i].rtt.sent);
+        ASSERT_EQ(3, links[i].rtt.answered);
+        ASSERT(links[i].rtt.median_ms == latencies[i]);
+    }
+
+    /* As long as the slowest link, not the sum of all three */
+    ASSERT_EQ(3, (int)net.max_in_flight);
+    ASSERT(elapsed >= 170.0);
+    ASSERT(elapsed < 300.0);
+}
+
+TEST(test_measure_counts_lost_echoes) {
+    static const int latencies[] = { 10 };
+    SimNet net;
+    MetricsBackend backend;
+    MetricLink links[SIM_LINKS];
+    MetricsOptions opts;
+
+    test_options(&opts);
+    opts.pings = 4;
+    sim_setup(&net, &backend, links, latencies, 1);
+    net.adapters[0].lose_every = 2;
+
+    ASSERT_EQ(0, metrics_measure(&backend, links, 1, &opts));
+    ASSERT_EQ(4, links[0].rtt.sent);
+    ASSERT_EQ(2, links[0].rtt.answered);
+}
+
+/* ============================================================================
+ * RANKING TESTS
+ * ============================================================================ */
+
+TEST(test_assign_fastest_first) {
+    MetricLink links[SIM_LINKS];
+    MetricsOptions opts;
+    int order[SIM_LINKS];
+
+    metrics_options_init(&opts);
+    ZeroMemory(links, sizeof(links));
+    for (int i = 0; i < 4; i++) {
+        links[i].rtt.sent = 5;
+        links[i].rtt.answered = 5;
+    }
+    links[0].rtt.median_ms = 3.1;
+    links[1].rtt.median_ms = 0.4;
+    links[2].rtt.median_ms = 0.2;       /* Fastest, but lost most echoes */
+    links[2].rtt.answered = 2;
+    links[3].rtt.median_ms = 0.4;       /* Ties with link 1 */
+    links[3].rtt.p95_ms = 0.9;
+    links[1].rtt.p95_ms = 0.9;
+
+    metrics_assign(links, 4, &opts, order);
+    ASSERT_EQ(1, order[0]);
+    ASSERT_EQ(3, order[1]);
+    ASSERT_EQ(0, order[2]);
+    ASSERT_EQ(2, order[3]);
+
+    ASSERT_EQ(10, (int)links[1].metric);
+    ASSERT_EQ(20, (int)links[3].metric);
+    ASSERT_EQ(30, (int)links[0].metric);
+    ASSERT_EQ(40, (int)links[2].metric);
+}
+
+/* ============================================================================
+ * APPLY TESTS
+ * ============================================================================ */
+
+TEST(test_apply_records_previous) {
+    static const int latencies[] = { 30, 5 };
+    SimNet net;
+    MetricsBackend backend;
+    MetricLink links[SIM_LINKS];
+    MetricsOptions opts;
+    int order[SIM_LINKS];
+
+    test_options(&opts);
+    sim_setup(&net, &backend, links, latencies, 2);
+    net.adapters[1].has_family[1] = 0;      /* IPv6 disabled on the fast link */
+
+    ASSERT_EQ(0, metrics_measure(&backend, links, 2, &opts));
+    metrics_assign(links, 2, &opts, order);
+    ASSERT_EQ(0, metrics_apply(&backend, links, 2));
+
+    ASSERT_EQ(3, net.writes);
+    ASSERT_EQ(0, net.adapters[1].setting[0].automatic);
+    ASSERT_EQ(10, (int)net.adapters[1].setting[0].metric);
+    ASSERT_EQ(20, (int)net.adapters[0].setting[0].metric);
+    ASSERT_EQ(20, (int)net.adapters[0].setting[1].metric);
+
+    ASSERT_EQ(1, links[0].has_family[1]);
+    ASSERT_EQ(0, links[1].has_family[1]);
+    ASSERT_EQ(1, links[0].previous[1].automatic);
+    ASSERT_EQ(35, (int)links[0].previous[1].metric);
+
+    /* The record is enough to go back */
+    ASSERT_EQ(0, metrics_restore(&backend, links, 2));
+    ASSERT_EQ(1, net.adapters[1].setting[0].automatic);
+    ASSERT_EQ(25, (int)net.adapters[1].setting[0].metric);
+}
+
+TEST(test_apply_failure_rolls_back) {
+    static const int latencies[] = { 5, 30, 60 };
+    SimNet net;
+    MetricsBackend backend;
+    MetricLink links[SIM_LINKS];
+    MetricsOptions opts;
+    int order[SIM_LINKS];
+
+    test_options(&opts);
+    sim_setup(&net, &backend, links, latencies, 3);
+    net.adapters[1].setting[0].automatic = 0;
+    net.adapters[1].setting[0].metric = 5;
+
+    ASSERT_EQ(0, metrics_measure(&backend, links, 3, &opts));
+    metrics_assign(links, 3, &opts, order);
+    net.adapters[2].fail_set = 1;
+
+    ASSERT_EQ(-1, metrics_apply(&backend, links, 3));
+
+    /* Links 0 and 1 were changed, then put back */
+    ASSERT_EQ(1, net.adapters[0].setting[0].automatic);
+    ASSERT_EQ(25, (int)net.adapters[0].setting[0].metric);
+    ASSERT_EQ(35, (int)net.adapters[0].setting[1].metric);
+    ASSERT_EQ(0, net.adapters[1].setting[0].automatic);
+    ASSERT_EQ(5, (int)net.adapters[1].setting[0].metric);
+}
+
+/* ============================================================================
+ * SAVED STATE TESTS
+ * ============================================================================ */
+
+static const MetricLink *find_link(const MetricLink *links, int count, const wchar_t *name)
+{
+    for (int i = 0; i < count; i++) {
+        if (wcscmp(links[i].name, name) == 0) {
+            return &links[i];
+        }
+    }
+    return NULL;
+}
+
+TEST(test_state_round_trip) {
+    static const int latencies[] = { 30, 5 };
+    FakeRegistry fake;
+    RegistryBackend reg;
+    SimNet net;
+    MetricsBackend backend;
+    MetricLink links[SIM_LINKS], saved[SIM_LINKS], restored;
+    const MetricLink *link;
+
+    fake_registry_init(&fake, &reg);
+    sim_setup(&net, &backend, links, latencies, 2);
+    net.adapters[1].setting[0].automatic = 0;
+    net.adapters[1].setting[0].metric = 5;
+    net.adapters[1].has_family[1] = 0;
+    links[0].metric = 20;
+    links[1].metric = 10;
+    ASSERT_EQ(0, metrics_apply(&backend, links, 2));
+
+    ASSERT_EQ(0, metrics_save_state(&reg, links, 2));
+    ASSERT_EQ(2, metrics_load_state(&reg, saved, SIM_LINKS));
+
+    link = find_link(saved, 2, L"Ethernet 1");
+    ASSERT(link != NULL);
+    ASSERT_EQ(1, link->has_family[0]);
+    ASSERT_EQ(1, link->previous[0].automatic);
+    ASSERT_EQ(1, link->previous[1].automatic);
+
+    link = find_link(saved, 2, L"Ethernet 2");
+    ASSERT(link != NULL);
+    ASSERT_EQ(0, link->previous[0].automatic);
+    ASSERT_EQ(5, (int)link->previous[0].metric);
+    ASSERT_EQ(0, link->has_family[1]);
+
+    /* The loaded state is enough to go back once the LUID is looked up */
+    restored = *link;
+    restored.luid.Value = 1;
+    ASSERT_EQ(0, metrics_restore(&backend, &restored, 1));
+    ASSERT_EQ(5, (int)net.adapters[1].setting[0].metric);
+    fake_registry_free(&fake);
+}
+
+TEST(test_state_keeps_first_run) {
+    static const int latencies[] = { 5 };
+    FakeRegistry fake;
+    RegistryBackend reg;
+    SimNet net;
+    MetricsBackend backend;
+    MetricLink links[SIM_LINKS], saved[SIM_LINKS];
+
+    fake_registry_init(&fake, &reg);
+    sim_setup(&net, &backend, links, latencies, 1);
+    links[0].metric = 10;
+    ASSERT_EQ(0, metrics_apply(&backend, links, 1));
+    ASSERT_EQ(0, metrics_save_state(&reg, links, 1));
+
+    /* A second run sees its own metric as the previous one */
+    links[0].metric = 20;
+    ASSERT_EQ(0, metrics_apply(&backend, links, 1));
+    ASSERT_EQ(0, links[0].previous[0].automatic);
+    ASSERT_EQ(0, metrics_save_state(&reg, links, 1));
+
+    ASSERT_EQ(1, metrics_load_state(&reg, saved, SIM_LINKS));
+    ASSERT_EQ(1, saved[0].previous[0].automatic);
+    ASSERT_EQ(1, saved[0].previous[1].automatic);
+    fake_registry_free(&fake);
+}
+
+TEST(test_state_clear) {
+    static const int latencies[] = { 5, 30 };
+    FakeRegistry fake;
+    RegistryBackend reg;
+    SimNet net;
+    MetricsBackend backend;
+    MetricLink links[SIM_LINKS], saved[SIM_LINKS];
+
+    fake_registry_init(&fake, &reg);
+    sim_setup(&net, &backend, links, latencies, 2);
+    ASSERT_EQ(0, metrics_load_state(&reg, saved, SIM_LINKS));
+
+    ASSERT_EQ(0, metrics_apply(&backend, links, 2));
+    ASSERT_EQ(0, metrics_save_state(&reg, links, 2));
+    ASSERT_EQ(0, metrics_clear_state(&reg, &links[0]));
+    ASSERT_EQ(1, metrics_load_state(&reg, saved, SIM_LINKS));
+    ASSERT(wcscmp(saved[0].name, L"Ethernet 2") == 0);
+
+    fake.fail_writes = 1;
+    ASSERT_EQ(-1, metrics_save_state(&reg, links, 1));
+    fake_registry_free(&fake);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* measurement tests */
+    RUN_TEST(test_measure_concurrently);
+    RUN_TEST(test_measure_counts_lost_echoes);
+
+    /* ranking tests */
+    RUN_TEST(test_assign_fastest_first);
+
+    /* apply tests */
+    RUN_TEST(test_apply_records_previous);
+    RUN_TEST(test_apply_failure_rolls_back);
+
+    /* saved state tests */
+    RUN_TEST(test_state_round_trip);
+    RUN_TEST(test_state_keeps_first_run);
+    RUN_TEST(test_state_clear);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
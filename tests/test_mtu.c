@@ -0,0 +1,266 @@
+/*
+ * test_mtu.c - Tests for path MTU probing
+ *
+ * A simulated path answers DF probes up to its MTU. Larger probes get
+ * "fragmentation needed" back, or vanish on a black-holing path.
+ */
+
+#include "mtu.h"
+#include "config.h"
+#include "fake_executor.h"
+#include "test.h"
+#include <stdio.h>
+
+/* ============================================================================
+ * SIMULATED PATH
+ * ============================================================================ */
+
+typedef struct {
+    int mtu;                /* Largest packet the path carries, 0 = unreachable */
+    int black_hole;         /* Drop larger packets instead of reporting them */
+    int lose_every;         /* Lose every Nth probe, 0 = none */
+    int probes;
+    int largest_sent;
+} SimPath;
+
+typedef struct {
+    SimPath paths[4];       /* Indexed by the last byte of the target */
+} SimNet;
+
+static MtuProbeResult sim_probe(void *ctx, const IpAddr *target, int size, int timeout_ms)
+{
+    SimPath *path = &((SimNet *)ctx)->paths[target->bytes[3] % 4];
+
+    (void)timeout_ms;
+    path->probes++;
+    if (size > path->largest_sent) {
+        path->largest_sent = size;
+    }
+    if (path->mtu == 0 || (path->lose_every && path->probes % path->lose_every == 0)) {
+        return MTU_PROBE_LOST;
+    }
+    if (size > path->mtu) {
+        return path->black_hole ? MTU_PROBE_LOST : MTU_PROBE_TOO_BIG;
+    }
+    return MTU_PROBE_FITS;
+}
+
+static void sim_setup(SimNet *net, MtuBackend *backend, MtuOptions *opts)
+{
+    ZeroMemory(net, sizeof(*net));
+    backend->ctx = net;
+    backend->probe = sim_probe;
+    mtu_options_init(opts);
+}
+
+static IpAddr target(const wchar_t *text)
+{
+    IpAddr addr;
+    address_parse(text, &addr);
+    return addr;
+}
+
+/* ============================================================================
+ * PROBING TESTS
+ * ============================================================================ */
+
+TEST(test_probe_finds_path_mtu) {
+    SimNet net;
+    MtuBackend backend;
+    MtuOptions opts;
+    IpAddr gw = target(L"10.8.0.1");
+    int probes;
+
+    sim_setup(&net, &backend, &opts);
+    net.paths[1].mtu = 1420;
+
+    ASSERT_EQ(1420, mtu_probe_path(&backend, &gw, &opts, &probes));
+    /* min, max, then a binary search over 924 sizes */
+    ASSERT(probes <= 12);
+    ASSERT_EQ(1500, net.paths[1].largest_sent);
+
+    net.paths[1].mtu = 576;
+    ASSERT_EQ(576, mtu_probe_path(&backend, &gw, &opts, &probes));
+}
+
+TEST(test_probe_full_size_path) {
+    SimNet net;
+    MtuBackend backend;
+    MtuOptions opts;
+    IpAddr gw = target(L"192.168.1.1");
+    int probes;
+
+    sim_setup(&net, &backend, &opts);
+    net.paths[1].mtu = 9000;
+
+    ASSERT_EQ(1500, mtu_probe_path(&backend, &gw, &opts, &probes));
+    ASSERT_EQ(2, probes);
+
+    opts.max = 9000;
+    ASSERT_EQ(9000, mtu_probe_path(&backend, &gw, &opts, &probes));
+}
+
+TEST(test_probe_black_hole) {
+    SimNet net;
+    MtuBackend backend;
+    MtuOptions opts;
+    IpAddr gw = target(L"10.8.0.1");
+    int probes;
+
+    /* No "fragmentation needed" comes back; silence counts as too big */
+    sim_setup(&net, &backend, &opts);
+    net.paths[1].mtu = 1280;
+    net.paths[1].black_hole = 1;
+
+    ASSERT_EQ(1280, mtu_probe_path(&backend, &gw, &opts, &probes));
+}
+
+TEST(test_probe_survives_loss) {
+    SimNet net;
+    MtuBackend backend;
+    MtuOptions opts;
+    IpAddr gw = target(L"10.8.0.1");
+    int probes;
+
+    sim_setup(&net, &backend, &opts);
+    net.paths[1].mtu = 1392;
+    net.paths[1].lose_every = 3;
+
+    ASSERT_EQ(1392, mtu_probe_path(&backend, &gw, &opts, &probes));
+}
+
+TEST(test_probe_unreachable) {
+    SimNet net;
+    MtuBackend backend;
+    MtuOptions opts;
+    IpAddr gw = target(L"10.8.0.1");
+    int probes;
+
+    sim_setup(&net, &backend, &opts);
+    ASSERT_EQ(-1, mtu_probe_path(&backend, &gw, &opts, &probes));
+    ASSERT_EQ(MTU_DEFAULT_ATTEMPTS, probes);
+}
+
+/* ============================================================================
+ * TARGET TESTS
+ * ============================================================================ */
+
+TEST(test_resolve_targets) {
+    IpAddr gw = target(L"10.0.0.1");
+    IpAddr dns[2];
+    IpAddr out[MTU_MAX_TARGETS];
+    wchar_t text[MAX_ADDR_LEN];
+
+    dns[0] = target(L"10.0.0.53");
+    dns[1] = target(L"10.0.0.1");
+
+    ASSERT_EQ(2, mtu_resolve_targets(L"gateway, dns", &gw, dns, 2, out, MTU_MAX_TARGETS));
+    address_format(&out[1], text, MAX_ADDR_LEN);
+    ASSERT(wcscmp(text, L"10.0.0.53") == 0);
+
+    ASSERT_EQ(1, mtu_resolve_targets(L"gateway 1.1.1.1", NULL, dns, 2, out, MTU_MAX_TARGETS));
+    ASSERT_EQ(3, mtu_resolve_targets(L"dns,1.1.1.1", &gw, dns, 2, out, MTU_MAX_TARGETS));
+    ASSERT_EQ(0, mtu_resolve_targets(L"gateway", NULL, NULL, 0, out, MTU_MAX_TARGETS));
+
+    ASSERT_EQ(-1, mtu_resolve_targets(L"gateway, router", &gw, dns, 2, out, MTU_MAX_TARGETS));
+    ASSERT_EQ(-1, mtu_resolve_targets(L"2606:4700::1111", &gw, dns, 2, out, MTU_MAX_TARGETS));
+}
+
+TEST(test_discover_smallest) {
+    SimNet net;
+    MtuBackend backend;
+    MtuOptions opts;
+    IpAddr targets[3];
+
+    sim_setup(&net, &backend, &opts);
+    targets[0] = target(L"10.8.0.1");
+    targets[1] = target(L"10.8.0.2");
+    targets[2] = target(L"10.8.0.3");
+    net.paths[1].mtu = 1500;
+    net.paths[2].mtu = 1400;            /* Tunnel towards the DNS server */
+
+    ASSERT_EQ(1400, mtu_discover(&backend, targets, 3, &opts));
+    ASSERT_EQ(-1, mtu_discover(&backend, &targets[2], 1, &opts));
+}
+
+/* ============================================================================
+ * CONFIGURATION TESTS
+ * ============================================================================ */
+
+TEST(test_set_through_netsh) {
+    static FakeExecutor fake;
+
+    config_init();
+    StringCchCopyW(g_config.interface_name, MAX_IFACE_LEN, L"VPN");
+    fake_executor_install(&fake);
+
+    ASSERT_EQ(0, mtu_set(1400));
+    ASSERT_EQ(2, fake.count);
+    ASSERT(wcscmp(fake.commands[0],
+        L"netsh.exe interface ipv4 set subinterface \"VPN\" mtu=1400 store=persistent") == 0);
+    ASSERT(wcscmp(fake.commands[1],
+        L"netsh.exe interface ipv6 set subinterface \"VPN\" mtu=1400 store=persistent") == 0);
+
+    /* Below the IPv6 minimum only IPv4 changes */
+    fake.count = 0;
+    ASSERT_EQ(0, mtu_set(1200));
+    ASSERT_EQ(1, fake.count);
+
+    process_set_executor(NULL);
+}
+
+static void parse_mtu_section(const char *body)
+{
+    FILE *fp;
+
+    config_init();
+    if (_wfopen_s(&fp, L"test_mtu.ini", L"wb") == 0) {
+        fputs("[mtu]\n", fp);
+        fputs(body, fp);
+        fclose(fp);
+    }
+    config_parse_file(L"test_mtu.ini");
+    DeleteFileW(L"test_mtu.ini");
+}
+
+TEST(test_config_range) {
+    /* max may come before min */
+    parse_mtu_section("max = 9000\nmin = 1280\n");
+    ASSERT_EQ(1280, g_config.mtu.min);
+    ASSERT_EQ(9000, g_config.mtu.max);
+
+    /* An inverted or empty range falls back to the defaults */
+    parse_mtu_section("min = 1400\nmax = 1200\n");
+    ASSERT_EQ(MTU_MIN_IPV4, g_config.mtu.min);
+    ASSERT_EQ(MTU_DEFAULT_MAX, g_config.mtu.max);
+
+    parse_mtu_section("min = 1500\n");
+    ASSERT_EQ(MTU_MIN_IPV4, g_config.mtu.min);
+    ASSERT_EQ(MTU_DEFAULT_MAX, g_config.mtu.max);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* probing tests */
+    RUN_TEST(test_probe_finds_path_mtu);
+    RUN_TEST(test_probe_full_size_path);
+    RUN_TEST(test_probe_black_hole);
+    RUN_TEST(test_probe_survives_loss);
+    RUN_TEST(test_probe_unreachable);
+
+    /* target tests */
+    RUN_TEST(test_resolve_targets);
+    RUN_TEST(test_discover_smallest);
+
+    /* configuration tests */
+    RUN_TEST(test_set_through_netsh);
+    RUN_TEST(test_config_range);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,184 @@
+/*
+ * test_nrpt.c - Tests for NRPT rule parsing and bulk synchronization
+ */
+
+#include "nrpt.h"
+#include "test.h"
+#include "fake_registry.h"
+#include <string.h>
+
+static void add_rule(NrptRuleList *list, const wchar_t *ns, const wchar_t *value)
+{
+    NrptRule rule;
+    if (nrpt_parse_rule(ns, value, &rule) == 0) {
+        nrpt_list_add(list, &rule);
+    }
+}
+
+/* ============================================================================
+ * PARSE TESTS
+ * ============================================================================ */
+
+TEST(test_parse_servers) {
+    NrptRule rule;
+    ASSERT_EQ(0, nrpt_parse_rule(L".corp.example.com", L"10.0.0.53, 10.0.0.54", &rule));
+    ASSERT_WSTR_EQ(L"10.0.0.53;10.0.0.54", rule.servers);
+    ASSERT_WSTR_EQ(L"", rule.doh_template);
+}
+
+TEST(test_parse_doh) {
+    NrptRule rule;
+    ASSERT_EQ(0, nrpt_parse_rule(L".example.org",
+        L"1.1.1.1 doh=https://cloudflare-dns.com/dns-query", &rule));
+    ASSERT_WSTR_EQ(L"1.1.1.1", rule.servers);
+    ASSERT_WSTR_EQ(L"https://cloudflare-dns.com/dns-query", rule.doh_template);
+}
+
+TEST(test_parse_rejects_empty) {
+    NrptRule rule;
+    ASSERT_EQ(-1, nrpt_parse_rule(L".corp", L"doh=https://x/dns-query", &rule));
+    ASSERT_EQ(-1, nrpt_parse_rule(L"", L"10.0.0.1", &rule));
+    ASSERT_EQ(-1, nrpt_parse_rule(L"bad\\ns", L"10.0.0.1", &rule));
+}
+
+/* ============================================================================
+ * SYNC TESTS
+ * ============================================================================ */
+
+TEST(test_sync_adds_then_noop) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    NrptRuleList desired = {0}, active = {0};
+    NrptSyncResult result;
+
+    fake_registry_init(&fake, &reg);
+    add_rule(&desired, L".corp.example.com", L"10.0.0.53, 10.0.0.54");
+    add_rule(&desired, L".lab.example.com", L"10.1.0.53");
+
+    ASSERT_EQ(0, nrpt_sync(&reg, &desired, &result));
+    ASSERT_EQ(2, result.added);
+
+    ASSERT_EQ(0, nrpt_read_rules(&reg, &active));
+    ASSERT_EQ(2, active.count);
+    ASSERT_NOT_NULL(nrpt_find(&active, L".CORP.example.com"));
+
+    int writes = fake.writes;
+    ASSERT_EQ(0, nrpt_sync(&reg, &desired, &result));
+    ASSERT_EQ(2, result.unchanged);
+    ASSERT_EQ(writes, fake.writes);
+
+    nrpt_list_free(&desired);
+    nrpt_list_free(&active);
+    fake_registry_free(&fake);
+}
+
+TEST(test_sync_updates_and_removes) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    NrptRuleList desired = {0}, active = {0};
+    NrptSyncResult result;
+
+    fake_registry_init(&fake, &reg);
+    add_rule(&desired, L".a.example.com", L"10.0.0.1");
+    add_rule(&desired, L".b.example.com", L"10.0.0.2");
+    ASSERT_EQ(0, nrpt_sync(&reg, &desired, &result));
+    nrpt_list_free(&desired);
+
+    add_rule(&desired, L".a.example.com", L"10.0.0.1 doh=https://dns.example/dns-query");
+    ASSERT_EQ(0, nrpt_sync(&reg, &desired, &result));
+    ASSERT_EQ(1, result.updated);
+    ASSERT_EQ(1, result.removed);
+
+    ASSERT_EQ(0, nrpt_read_rules(&reg, &active));
+    ASSERT_EQ(1, active.count);
+    ASSERT_WSTR_EQ(L"https://dns.example/dns-query", active.items[0].doh_template);
+
+    nrpt_list_free(&desired);
+    nrpt_list_free(&active);
+    fake_registry_free(&fake);
+}
+
+TEST(test_sync_leaves_foreign_rules) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    NrptRuleList desired = {0};
+    NrptSyncResult result;
+    wchar_t value[64];
+
+    fake_registry_init(&fake, &reg);
+    reg.set_string(reg.ctx, NRPT_REGISTRY_KEY L"\\{1234}", L"Name", L".vpn.example.com", 1);
+
+    ASSERT_EQ(0, nrpt_sync(&reg, &desired, &result));
+    ASSERT_EQ(0, result.removed);
+    ASSERT_EQ(0, reg.get_string(reg.ctx, NRPT_REGISTRY_KEY L"\\{1234}", L"Name", value, 64));
+
+    fake_registry_free(&fake);
+}
+
+TEST(test_sync_hundreds_of_rules) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    NrptRuleList desired = {0};
+    NrptSyncResult result;
+    wchar_t ns[64];
+
+    fake_registry_init(&fake, &reg);
+    for (int i = 0; i < 300; i++) {
+        StringCchPrintfW(ns, 64, L".site%d.corp.example.com", i);
+        add_rule(&desired, ns, L"10.0.0.53, 10.0.0.54");
+    }
+
+    ASSERT_EQ(0, nrpt_sync(&reg, &desired, &result));
+    ASSERT_EQ(300, result.added);
+
+    /* Change a single rule: only that one is rewritten */
+    int writes = fake.writes;
+    StringCchCopyW(desired.items[7].servers, NRPT_SERVERS_LEN, L"10.9.9.9");
+    ASSERT_EQ(0, nrpt_sync(&reg, &desired, &result));
+    ASSERT_EQ(1, result.updated);
+    ASSERT_EQ(299, result.unchanged);
+    ASSERT(fake.writes - writes < 10);
+
+    nrpt_list_free(&desired);
+    fake_registry_free(&fake);
+}
+
+TEST(test_sync_reports_write_failure) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    NrptRuleList desired = {0};
+    NrptSyncResult result;
+
+    fake_registry_init(&fake, &reg);
+    fake.fail_writes = 1;
+    add_rule(&desired, L".corp.example.com", L"10.0.0.53");
+
+    ASSERT_EQ(-1, nrpt_sync(&reg, &desired, &result));
+    ASSERT_EQ(1, result.failed);
+
+    nrpt_list_free(&desired);
+    fake_registry_free(&fake);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* parse tests */
+    RUN_TEST(test_parse_servers);
+    RUN_TEST(test_parse_doh);
+    RUN_TEST(test_parse_rejects_empty);
+
+    /* sync tests */
+    RUN_TEST(test_sync_adds_then_noop);
+    RUN_TEST(test_sync_updates_and_removes);
+    RUN_TEST(test_sync_leaves_foreign_rules);
+    RUN_TEST(test_sync_hundreds_of_rules);
+    RUN_TEST(test_sync_reports_write_failure);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
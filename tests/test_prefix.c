@@ -0,0 +1,254 @@
+/*
+ * test_prefix.c - Tests for IPv6 prefix policies and the v4/v6 latency probe
+ */
+
+#include "prefix.h"
+#include "config.h"
+#include "fake_executor.h"
+#include "test.h"
+#include <string.h>
+
+/* ============================================================================
+ * CANNED OUTPUT
+ * ============================================================================ */
+
+static const char SHOW_DEFAULT[] =
+    "Querying active state...\r\n"
+    "\r\n"
+    "Precedence  Label  Prefix\r\n"
+    "----------  -----  --------------------------------\r\n"
+    "        50      0  ::1/128\r\n"
+    "        40      1  ::/0\r\n"
+    "        35      4  ::ffff:0:0/96\r\n"
+    "        30      2  2002::/16\r\n"
+    "         5      5  2001::/32\r\n"
+    "         3     13  fc00::/7\r\n"
+    "         1     11  fec0::/10\r\n"
+    "         1     12  3ffe::/16\r\n"
+    "         1      3  ::/96\r\n";
+
+static const char SHOW_PREFER_V4[] =
+    "Precedence  Label  Prefix\r\n"
+    "----------  -----  --------------------------------\r\n"
+    "        50      0  ::1/128\r\n"
+    "        45      4  ::ffff:0:0/96\r\n"
+    "        40      1  ::/0\r\n"
+    "        30      2  2002::/16\r\n"
+    "         5      5  2001::/32\r\n"
+    "         3     13  fc00::/7\r\n"
+    "         1     11  fec0::/10\r\n"
+    "         1     12  3ffe::/16\r\n"
+    "         1      3  ::/96\r\n";
+
+static FakeExecutor g_fake;
+
+static void setup(void)
+{
+    fake_executor_install(&g_fake);
+    fake_executor_output(&g_fake, L"show prefixpolicies", SHOW_DEFAULT);
+    config_init();
+}
+
+/* ============================================================================
+ * TABLE TESTS
+ * ============================================================================ */
+
+TEST(test_parse_and_classify) {
+    PrefixPolicyTable table;
+
+    prefix_policy_parse_netsh(SHOW_DEFAULT, &table);
+    ASSERT_EQ(9, table.count);
+    ASSERT(wcscmp(table.items[2].text, L"::ffff:0:0/96") == 0);
+    ASSERT_EQ(35, table.items[2].precedence);
+    ASSERT_EQ(4, table.items[2].label);
+    ASSERT_EQ(PREFIX_PREFER_V6, prefix_policy_classify(&table));
+
+    /* Row order does not matter */
+    prefix_policy_parse_netsh(SHOW_PREFER_V4, &table);
+    ASSERT_EQ(PREFIX_PREFER_V4, prefix_policy_classify(&table));
+
+    table.items[0].label = 7;
+    ASSERT_EQ(PREFIX_CUSTOM, prefix_policy_classify(&table));
+}
+
+TEST(test_policy_lines) {
+    PrefixPolicyTable table = {0};
+
+    ASSERT_EQ(0, prefix_policy_add(&table, L"::1/128 50 0"));
+    ASSERT_EQ(0, prefix_policy_add(&table, L"  ::ffff:0:0/96   100  4 "));
+    ASSERT_EQ(0, prefix_policy_add(&table, L"::FFFF:0:0/96 60 4"));
+    ASSERT_EQ(2, table.count);
+    ASSERT_EQ(60, table.items[1].precedence);
+
+    ASSERT_EQ(-1, prefix_policy_add(&table, L"::/0 40"));
+    ASSERT_EQ(-1, prefix_policy_add(&table, L"::/0 40 1 extra"));
+    ASSERT_EQ(-1, prefix_policy_add(&table, L"10.0.0.0/8 40 1"));
+    ASSERT_EQ(-1, prefix_policy_add(&table, L"2001:db8:: 40 1"));
+    ASSERT_EQ(-1, prefix_policy_add(&table, L"::/0 -1 1"));
+}
+
+TEST(test_diff_commands) {
+    PrefixPolicyTable current, desired;
+    PrefixPlan plan;
+    wchar_t args[CMD_BUFFER_SIZE];
+
+    prefix_policy_parse_netsh(SHOW_DEFAULT, &current);
+    prefix_policy_preset(PREFIX_PREFER_V4, &desired);
+
+    ASSERT_EQ(1, prefix_policy_diff(&desired, &current, &plan));
+    ASSERT_EQ(PREFIX_OP_SET, plan.items[0].kind);
+    ASSERT_EQ(0, prefix_policy_command(&plan.items[0], args, CMD_BUFFER_SIZE));
+    ASSERT(wcscmp(args, L"interface ipv6 set prefixpolicy prefix=::ffff:0:0/96 "
+                        L"precedence=45 label=4 store=persistent") == 0);
+
+    /* A custom table deletes the rows it does not list, before adding */
+    ZeroMemory(&desired, sizeof(desired));
+    prefix_policy_add(&desired, L"::1/128 50 0");
+    prefix_policy_add(&desired, L"::ffff:0:0/96 45 4");
+    prefix_policy_add(&desired, L"::/0 40 1");
+    prefix_policy_add(&desired, L"64:ff9b::/96 10 6");
+    ASSERT_EQ(8, prefix_policy_diff(&desired, &current, &plan));
+    ASSERT_EQ(PREFIX_OP_DELETE, plan.items[0].kind);
+    ASSERT_EQ(PREFIX_OP_ADD, plan.items[7].kind);
+    prefix_policy_command(&plan.items[0], args, CMD_BUFFER_SIZE);
+    ASSERT(wcscmp(args, L"interface ipv6 delete prefixpolicy prefix=2002::/16 store=persistent") == 0);
+
+    ASSERT_EQ(0, prefix_policy_diff(&current, &current, &plan));
+}
+
+/* ============================================================================
+ * APPLY TESTS
+ * ============================================================================ */
+
+TEST(test_apply_and_rollback) {
+    setup();
+    g_config.prefix_preference = PREFIX_PREFER_V4;
+
+    ASSERT_EQ(0, prefix_policy_apply());
+    ASSERT_EQ(2, g_fake.count);
+    ASSERT(wcscmp(g_fake.commands[1], L"netsh.exe interface ipv6 set prefixpolicy "
+                  L"prefix=::ffff:0:0/96 precedence=45 label=4 store=persistent") == 0);
+
+    /* Rollback diffs against the table as it now is */
+    fake_executor_output(&g_fake, L"show prefixpolicies", SHOW_PREFER_V4);
+    prefix_policy_rollback();
+    ASSERT_EQ(4, g_fake.count);
+    ASSERT(wcsstr(g_fake.commands[3], L"prefix=::ffff:0:0/96 precedence=35") != NULL);
+    prefix_policy_rollback();
+    ASSERT_EQ(4, g_fake.count);
+
+    /* Already in place: nothing runs and nothing is rolled back */
+    ASSERT_EQ(0, prefix_policy_apply());
+    ASSERT_EQ(5, g_fake.count);
+    prefix_policy_rollback();
+    ASSERT_EQ(5, g_fake.count);
+
+    process_set_executor(NULL);
+}
+
+TEST(test_apply_not_configured) {
+    setup();
+
+    ASSERT_EQ(0, prefix_policy_apply());
+    ASSERT_EQ(0, g_fake.count);
+
+    /* custom without policy lines is an error, before netsh runs */
+    g_config.prefix_preference = PREFIX_CUSTOM;
+    ASSERT_EQ(-1, prefix_policy_apply());
+    ASSERT_EQ(0, g_fake.count);
+
+    process_set_executor(NULL);
+}
+
+/* ============================================================================
+ * PROBE TESTS
+ * ============================================================================ */
+
+typedef struct {
+    double v4_ms, v6_ms;        /* Connect time, -1 = fails */
+    int v6_fail_every;          /* Fail every Nth IPv6 connect, 0 = none */
+    int v6_calls;
+} SimServers;
+
+static double sim_connect(void *ctx, const IpAddr *server, int timeout_ms)
+{
+    SimServers *sim = (SimServers *)ctx;
+
+    (void)timeout_ms;
+    if (server->family == AF_INET) {
+        return sim->v4_ms;
+    }
+    sim->v6_calls++;
+    if (sim->v6_fail_every && sim->v6_calls % sim->v6_fail_every == 0) {
+        return -1;
+    }
+    return sim->v6_ms;
+}
+
+TEST(test_measure_and_recommend) {
+    SimServers sim = { 12.0, 15.0, 0, 0 };
+    PrefixProbeBackend backend = { &sim, sim_connect };
+    IpAddr v4[2], v6[2];
+    FamilyLatency lat4, lat6;
+    PrefixPreference pick;
+
+    address_parse(L"1.1.1.1", &v4[0]);
+    address_parse(L"1.0.0.1", &v4[1]);
+    address_parse(L"2606:4700:4700::1111", &v6[0]);
+    address_parse(L"2606:4700:4700::1001", &v6[1]);
+
+    prefix_measure(&backend, v4, 2, 3, 1000, &lat4);
+    prefix_measure(&backend, v6, 2, 3, 1000, &lat6);
+    ASSERT_EQ(6, lat4.attempts);
+    ASSERT_EQ(6, lat6.connected);
+    ASSERT(lat4.median_ms == 12.0);
+
+    /* A few milliseconds apart: keep IPv6 first */
+    ASSERT_EQ(0, prefix_recommend(&lat4, &lat6, &pick));
+    ASSERT_EQ(PREFIX_PREFER_V6, pick);
+
+    /* Half-working IPv6 loses connects */
+    sim.v6_fail_every = 3;
+    prefix_measure(&backend, v6, 2, 3, 1000, &lat6);
+    ASSERT_EQ(4, lat6.connected);
+    ASSERT_EQ(0, prefix_recommend(&lat4, &lat6, &pick));
+    ASSERT_EQ(PREFIX_PREFER_V4, pick);
+
+    /* Slow IPv6 */
+    sim.v6_fail_every = 0;
+    sim.v6_ms = 12.0 + PREFIX_V6_SLOWER_MS + 1;
+    prefix_measure(&backend, v6, 2, 3, 1000, &lat6);
+    ASSERT_EQ(0, prefix_recommend(&lat4, &lat6, &pick));
+    ASSERT_EQ(PREFIX_PREFER_V4, pick);
+
+    /* No IPv6 server, or nothing answers: no recommendation */
+    prefix_measure(&backend, v6, 0, 3, 1000, &lat6);
+    ASSERT_EQ(-1, prefix_recommend(&lat4, &lat6, &pick));
+    sim.v4_ms = sim.v6_ms = -1;
+    prefix_measure(&backend, v4, 2, 3, 1000, &lat4);
+    prefix_measure(&backend, v6, 2, 3, 1000, &lat6);
+    ASSERT_EQ(-1, prefix_recommend(&lat4, &lat6, &pick));
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* table tests */
+    RUN_TEST(test_parse_and_classify);
+    RUN_TEST(test_policy_lines);
+    RUN_TEST(test_diff_commands);
+
+    /* apply tests */
+    RUN_TEST(test_apply_and_rollback);
+    RUN_TEST(test_apply_not_configured);
+
+    /* probe tests */
+    RUN_TEST(test_measure_and_recommend);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
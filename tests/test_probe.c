@@ -0,0 +1,201 @@
+/*
+ * test_probe.c - Tests for resolver latency probing
+ *
+ * The probe engine runs against stub DNS servers on the loopback
+ * interface that answer after a configurable delay, or not at all.
+ */
+
+#include "probe.h"
+#include "test.h"
+#include "stub_dns.h"
+#include <string.h>
+
+static void test_options(ProbeOptions *opts, int count, int timeout_ms)
+{
+    probe_options_init(opts);
+    opts->count = count;
+    opts->timeout_ms = timeout_ms;
+}
+
+/* ============================================================================
+ * QUERY ENCODING TESTS
+ * ============================================================================ */
+
+TEST(test_build_query) {
+    unsigned char buf[512];
+    static const unsigned char expected[] = {
+        0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0,
+        0x00, 0x01, 0x00, 0x01
+    };
+
+    ASSERT_EQ((int)sizeof(expected), probe_build_query("example.com", 0x1234, buf, sizeof(buf)));
+    ASSERT(memcmp(expected, buf, sizeof(expected)) == 0);
+
+    /* A trailing dot encodes the same name */
+    ASSERT_EQ((int)sizeof(expected), probe_build_query("example.com.", 0x1234, buf, sizeof(buf)));
+    ASSERT(memcmp(expected, buf, sizeof(expected)) == 0);
+}
+
+TEST(test_build_query_rejects_invalid) {
+    unsigned char buf[512];
+    char label[80];
+
+    memset(label, 'a', 64);
+    label[64] = '\0';
+
+    ASSERT_EQ(-1, probe_build_query("", 1, buf, sizeof(buf)));
+    ASSERT_EQ(-1, probe_build_query("a..b", 1, buf, sizeof(buf)));
+    ASSERT_EQ(-1, probe_build_query(label, 1, buf, sizeof(buf)));
+    ASSERT_EQ(-1, probe_build_query("example.com", 1, buf, 20));
+}
+
+/* ============================================================================
+ * STATISTICS TESTS
+ * ============================================================================ */
+
+TEST(test_stats_odd) {
+    double samples[] = { 5.0, 1.0, 3.0, 2.0, 4.0 };
+    ProbeStats stats;
+
+    probe_compute_stats(samples, 5, &stats);
+    ASSERT(stats.median_ms == 3.0);
+    ASSERT(stats.p95_ms == 5.0);
+}
+
+TEST(test_stats_even) {
+    double samples[20];
+    ProbeStats stats;
+
+    for (int i = 0; i < 20; i++) {
+        samples[i] = (double)(20 - i);
+    }
+
+    probe_compute_stats(samples, 20, &stats);
+    ASSERT(stats.median_ms == 10.5);
+    ASSERT(stats.p95_ms == 19.0);
+}
+
+TEST(test_pick_best) {
+    ProbeStats stats[4] = {
+        { 10, 10, 20.0, 40.0 },
+        { 10, 4, 5.0, 6.0 },        /* Fast but lossy: excluded */
+        { 10, 9, 12.0, 30.0 },
+        { 10, 10, 12.0, 15.0 },     /* Same median, better p95 */
+    };
+
+    ASSERT_EQ(3, probe_pick_best(stats, 4));
+    ASSERT_EQ(-1, probe_pick_best(&stats[1], 1));
+}
+
+/* ============================================================================
+ * PROBE ENGINE TESTS
+ * ============================================================================ */
+
+TEST(test_run_picks_fastest) {
+    StubServer fast, slow;
+    ProbeTarget targets[2];
+    ProbeStats stats[2];
+    ProbeOptions opts;
+
+    ASSERT_EQ(0, stub_start(&slow, 30, 0));
+    ASSERT_EQ(0, stub_start(&fast, 0, 0));
+
+    targets[0].server = L"127.0.0.1";
+    targets[0].port = slow.port;
+    targets[1].server = L"127.0.0.1";
+    targets[1].port = fast.port;
+
+    test_options(&opts, 5, 1000);
+    ASSERT_EQ(0, probe_run(targets, 2, &opts, stats));
+
+    ASSERT_EQ(5, stats[0].answered);
+    ASSERT_EQ(5, stats[1].answered);
+    ASSERT(stats[0].median_ms >= 25.0);
+    ASSERT(stats[1].median_ms < stats[0].median_ms);
+    ASSERT_EQ(1, probe_pick_best(stats, 2));
+
+    stub_stop(&fast);
+    stub_stop(&slow);
+}
+
+TEST(test_run_silent_server) {
+    StubServer silent, fast;
+    ProbeTarget targets[2];
+    ProbeStats stats[2];
+    ProbeOptions opts;
+
+    ASSERT_EQ(0, stub_start(&silent, 0, 1));
+    ASSERT_EQ(0, stub_start(&fast, 0, 0));
+
+    targets[0].server = L"127.0.0.1";
+    targets[0].port = silent.port;
+    targets[1].server = L"127.0.0.1";
+    targets[1].port = fast.port;
+
+    test_options(&opts, 3, 100);
+    ASSERT_EQ(0, probe_run(targets, 2, &opts, stats));
+
+    ASSERT_EQ(3, stats[0].sent);
+    ASSERT_EQ(0, stats[0].answered);
+    ASSERT_EQ(3, stats[1].answered);
+    ASSERT_EQ(1, probe_pick_best(stats, 2));
+
+    stub_stop(&fast);
+    stub_stop(&silent);
+}
+
+TEST(test_run_ignores_late_answers) {
+    StubServer late;
+    ProbeTarget target;
+    ProbeStats stats;
+    ProbeOptions opts;
+
+    /* Answers arrive after the round is over and carry a stale ID */
+    ASSERT_EQ(0, stub_start(&late, 150, 0));
+    target.server = L"127.0.0.1";
+    target.port = late.port;
+
+    test_options(&opts, 3, 100);
+    ASSERT_EQ(0, probe_run(&target, 1, &opts, &stats));
+    ASSERT_EQ(0, stats.answered);
+
+    stub_stop(&late);
+}
+
+TEST(test_run_invalid_target) {
+    ProbeTarget target = { L"not-an-address", 0 };
+    ProbeStats stats;
+    ProbeOptions opts;
+
+    test_options(&opts, 2, 50);
+    ASSERT_EQ(0, probe_run(&target, 1, &opts, &stats));
+    ASSERT_EQ(2, stats.sent);
+    ASSERT_EQ(0, stats.answered);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* query encoding tests */
+    RUN_TEST(test_build_query);
+    RUN_TEST(test_build_query_rejects_invalid);
+
+    /* statistics tests */
+    RUN_TEST(test_stats_odd);
+    RUN_TEST(test_stats_even);
+    RUN_TEST(test_pick_best);
+
+    /* probe engine tests */
+    RUN_TEST(test_run_picks_fastest);
+    RUN_TEST(test_run_silent_server);
+    RUN_TEST(test_run_ignores_late_answers);
+    RUN_TEST(test_run_invalid_target);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
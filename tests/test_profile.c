@@ -0,0 +1,286 @@
+/*
+ * test_profile.c - Tests for site profiles and fingerprint matching
+ */
+
+#include "profile.h"
+#include "config.h"
+#include "dns.h"
+#include "watch.h"
+#include "fake_executor.h"
+#include "test.h"
+#include <string.h>
+
+static void make_profile(Profile *profile, const wchar_t *name)
+{
+    ZeroMemory(profile, sizeof(*profile));
+    StringCchCopyW(profile->name, PROFILE_NAME_LEN, name);
+}
+
+static void add_gateway(NetworkFingerprint *fp, const wchar_t *gateway, const BYTE *mac)
+{
+    address_parse(gateway, &fp->gateways[fp->gateway_count]);
+    if (mac) {
+        memcpy(fp->gateway_macs[fp->gateway_count], mac, 6);
+        fp->gateway_has_mac[fp->gateway_count] = 1;
+    }
+    fp->gateway_count++;
+}
+
+static void add_address(NetworkFingerprint *fp, const wchar_t *address)
+{
+    address_parse(address, &fp->addresses[fp->address_count++]);
+}
+
+/* A laptop on the office LAN */
+static void office_fingerprint(NetworkFingerprint *fp)
+{
+    static const BYTE mac[6] = { 0x00, 0x11, 0x22, 0xaa, 0xbb, 0xcc };
+
+    ZeroMemory(fp, sizeof(*fp));
+    add_gateway(fp, L"192.168.10.1", mac);
+    add_gateway(fp, L"fe80::1", NULL);
+    add_address(fp, L"192.168.10.57/24");
+    add_address(fp, L"fe80::1234/64");
+    StringCchCopyW(fp->dns_suffix, PROFILE_SUFFIX_LEN, L"corp.example.com");
+}
+
+/* ============================================================================
+ * PARSING TESTS
+ * ============================================================================ */
+
+TEST(test_parse_mac) {
+    BYTE mac[6];
+
+    ASSERT_EQ(0, profile_parse_mac(L"00:11:22:aa:BB:cc", mac));
+    ASSERT_EQ(0x00, mac[0]);
+    ASSERT_EQ(0xbb, mac[4]);
+    ASSERT_EQ(0, profile_parse_mac(L"00-11-22-AA-BB-CC", mac));
+    ASSERT_EQ(0xcc, mac[5]);
+
+    ASSERT_EQ(-1, profile_parse_mac(L"00:11:22:aa:bb", mac));
+    ASSERT_EQ(-1, profile_parse_mac(L"00:11:22:aa:bb:cc:dd", mac));
+    ASSERT_EQ(-1, profile_parse_mac(L"0:11:22:aa:bb:cc", mac));
+    ASSERT_EQ(-1, profile_parse_mac(L"00:11:22:aa:bb:zz", mac));
+}
+
+TEST(test_profile_set) {
+    Profile profile;
+
+    make_profile(&profile, L"office");
+    ASSERT_EQ(0, profile_set(&profile, L"match_gateway", L"192.168.10.1"));
+    ASSERT_EQ(0, profile_set(&profile, L"match_subnet", L"192.168.10.0/24"));
+    ASSERT_EQ(0, profile_set(&profile, L"ipv4_address", L"192.168.10.20"));
+    ASSERT_EQ(0, profile_set(&profile, L"ipv4_mask", L"255.255.255.0"));
+    ASSERT_EQ(0, profile_set(&profile, L"provider", L"google"));
+    ASSERT_EQ(0, profile_set(&profile, L"dns_only", L"yes"));
+
+    ASSERT_EQ(AF_INET, profile.gateway.family);
+    ASSERT_EQ(24, profile.subnet.prefix);
+    ASSERT_EQ(1, profile.dns_only);
+    ASSERT(wcscmp(profile.ipv4_address, L"192.168.10.20") == 0);
+
+    /* Invalid values and unknown keys are rejected */
+    ASSERT_EQ(-1, profile_set(&profile, L"match_subnet", L"192.168.10.0"));
+    ASSERT_EQ(-1, profile_set(&profile, L"match_gateway", L"not-an-ip"));
+    ASSERT_EQ(-1, profile_set(&profile, L"ipv4_address", L"2001:db8::1"));
+    ASSERT_EQ(-1, profile_set(&profile, L"ipv4_mask", L"255.0.255.0"));
+    ASSERT_EQ(-1, profile_set(&profile, L"ipv6_prefix", L"129"));
+    ASSERT_EQ(-1, profile_set(&profile, L"colour", L"blue"));
+}
+
+TEST(test_address_in_prefix) {
+    IpAddr net, addr;
+
+    address_parse(L"10.20.0.0/14", &net);
+    address_parse(L"10.23.255.1", &addr);
+    ASSERT_EQ(1, address_in_prefix(&addr, &net));
+    address_parse(L"10.24.0.1", &addr);
+    ASSERT_EQ(0, address_in_prefix(&addr, &net));
+
+    address_parse(L"2001:db8:abcd::/48", &net);
+    address_parse(L"2001:db8:abcd:12::5", &addr);
+    ASSERT_EQ(1, address_in_prefix(&addr, &net));
+    address_parse(L"10.23.255.1", &addr);
+    ASSERT_EQ(0, address_in_prefix(&addr, &net));
+}
+
+/* ============================================================================
+ * MATCHING TESTS
+ * ============================================================================ */
+
+TEST(test_score) {
+    NetworkFingerprint fp;
+    Profile profile;
+
+    office_fingerprint(&fp);
+
+    make_profile(&profile, L"office");
+    profile_set(&profile, L"match_gateway", L"192.168.10.1");
+    profile_set(&profile, L"match_gateway_mac", L"00:11:22:aa:bb:cc");
+    profile_set(&profile, L"match_subnet", L"192.168.10.0/24");
+    profile_set(&profile, L"match_suffix", L"CORP.example.com");
+    ASSERT_EQ(4, profile_score(&profile, &fp));
+
+    /* One failing criterion rules the profile out */
+    profile_set(&profile, L"match_gateway_mac", L"00:11:22:aa:bb:cd");
+    ASSERT_EQ(-1, profile_score(&profile, &fp));
+
+    /* No criteria: fallback with score 0 */
+    make_profile(&profile, L"default");
+    ASSERT_EQ(0, profile_score(&profile, &fp));
+}
+
+TEST(test_gateway_mac_without_neighbor_entry) {
+    NetworkFingerprint fp;
+    Profile profile;
+
+    ZeroMemory(&fp, sizeof(fp));
+    add_gateway(&fp, L"192.168.10.1", NULL);
+
+    make_profile(&profile, L"office");
+    profile_set(&profile, L"match_gateway_mac", L"00:11:22:aa:bb:cc");
+    ASSERT_EQ(-1, profile_score(&profile, &fp));
+}
+
+TEST(test_select_most_specific) {
+    NetworkFingerprint fp;
+    Profile profiles[4];
+
+    office_fingerprint(&fp);
+
+    make_profile(&profiles[0], L"default");
+    make_profile(&profiles[1], L"lab");
+    profile_set(&profiles[1], L"match_subnet", L"10.0.0.0/8");
+    make_profile(&profiles[2], L"office-any");
+    profile_set(&profiles[2], L"match_subnet", L"192.168.0.0/16");
+    make_profile(&profiles[3], L"office");
+    profile_set(&profiles[3], L"match_subnet", L"192.168.10.0/24");
+    profile_set(&profiles[3], L"match_suffix", L"corp.example.com");
+
+    ASSERT_EQ(3, profile_select(profiles, 4, &fp));
+
+    /* Off-site only the fallback is left */
+    ZeroMemory(&fp, sizeof(fp));
+    add_address(&fp, L"172.16.5.9/24");
+    ASSERT_EQ(0, profile_select(profiles, 4, &fp));
+    ASSERT_EQ(-1, profile_select(&profiles[1], 3, &fp));
+}
+
+TEST(test_select_tie_keeps_first) {
+    NetworkFingerprint fp;
+    Profile profiles[2];
+
+    office_fingerprint(&fp);
+    make_profile(&profiles[0], L"a");
+    profile_set(&profiles[0], L"match_gateway", L"192.168.10.1");
+    make_profile(&profiles[1], L"b");
+    profile_set(&profiles[1], L"match_suffix", L"corp.example.com");
+
+    ASSERT_EQ(0, profile_select(profiles, 2, &fp));
+}
+
+TEST(test_select_all_profiles_fast) {
+    NetworkFingerprint fp;
+    Profile profiles[MAX_PROFILES];
+    LONGLONG start;
+
+    office_fingerprint(&fp);
+    for (int i = 0; i < MAX_PROFILES; i++) {
+        wchar_t subnet[32];
+        make_profile(&profiles[i], L"site");
+        StringCchPrintfW(subnet, 32, L"192.168.%d.0/24", i);
+        profile_set(&profiles[i], L"match_subnet", subnet);
+        profile_set(&profiles[i], L"match_gateway_mac", L"00:11:22:aa:bb:cc");
+    }
+
+    start = timer_now();
+    for (int round = 0; round < 1000; round++) {
+        ASSERT_EQ(10, profile_select(profiles, MAX_PROFILES, &fp));
+    }
+    /* 1000 selections over the full profile table */
+    ASSERT(timer_elapsed_ms(start) < 100.0);
+}
+
+/* ============================================================================
+ * APPLY TESTS
+ * ============================================================================ */
+
+/* The interface already has Cloudflare's servers */
+static int read_cloudflare_servers(int family, IpAddrList *out)
+{
+    const wchar_t *servers[2] = { L"1.1.1.1", L"1.0.0.1" };
+    IpAddr addr;
+
+    if (family == AF_INET6) {
+        servers[0] = L"2606:4700:4700::1111";
+        servers[1] = L"2606:4700:4700::1001";
+    }
+    out->count = 0;
+    for (int i = 0; i < 2; i++) {
+        if (address_parse(servers[i], &addr) != 0 || address_list_add(out, &addr) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static const char SHOW_ENCRYPTION[] =
+    "Encryption settings for 1.1.1.1\r\n"
+    "DNS-over-HTTPS template     : https://cloudflare-dns.com/dns-query\r\n"
+    "Auto-upgrade                : yes\r\n"
+    "UDP-fallback                : no\r\n";
+
+TEST(test_keep_in_place_repairs_doh) {
+    static FakeExecutor fake;
+    DnsProvider provider;
+
+    config_init();
+    g_config.dns_only = 1;
+    StringCchCopyW(g_config.interface_name, MAX_IFACE_LEN, L"Ethernet");
+    ASSERT_EQ(0, dns_find_provider(L"cloudflare", &provider));
+
+    /* Servers in place but no DoH template: only the templates are added */
+    fake_executor_install(&fake);
+    watch_set_server_reader(read_cloudflare_servers);
+    ASSERT_EQ(0, dns_apply(&provider, 1));
+    ASSERT(fake_executor_ran(&fake, L"dns add encryption server=1.1.1.1"));
+    ASSERT(fake_executor_ran(&fake, L"dns add encryption server=2606:4700:4700::1001"));
+    ASSERT(!fake_executor_ran(&fake, L"set dnsservers"));
+
+    /* Templates in place too: nothing is re-applied */
+    fake.count = 0;
+    fake_executor_output(&fake, L"dns show encryption", SHOW_ENCRYPTION);
+    ASSERT_EQ(0, dns_apply(&provider, 1));
+    ASSERT(!fake_executor_ran(&fake, L"dns add encryption"));
+    ASSERT(!fake_executor_ran(&fake, L"set dnsservers"));
+
+    watch_set_server_reader(NULL);
+    process_set_executor(NULL);
+    config_init();
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* parsing tests */
+    RUN_TEST(test_parse_mac);
+    RUN_TEST(test_profile_set);
+    RUN_TEST(test_address_in_prefix);
+
+    /* matching tests */
+    RUN_TEST(test_score);
+    RUN_TEST(test_gateway_mac_without_neighbor_entry);
+    RUN_TEST(test_select_most_specific);
+    RUN_TEST(test_select_tie_keeps_first);
+    RUN_TEST(test_select_all_profiles_fast);
+
+    /* apply tests */
+    RUN_TEST(test_keep_in_place_repairs_doh);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
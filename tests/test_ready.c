@@ -0,0 +1,267 @@
+/*
+ * test_ready.c - Tests for --wait-ready
+ *
+ * A simulated network thread changes the address and route state, then
+ * fires the notification like the IP Helper callbacks would.
+ */
+
+#include "ready.h"
+#include "config.h"
+#include "test.h"
+#include <string.h>
+
+/* ============================================================================
+ * SIMULATED NETWORK
+ * ============================================================================ */
+
+typedef struct {
+    int delay_ms;           /* Sleep before the change */
+    int preferred;
+    int duplicate;
+    int default_route;
+    int notify;             /* Fire the notification after the change */
+} NetStep;
+
+typedef struct {
+    const NetStep *steps;
+    int step_count;
+    volatile LONG preferred;
+    volatile LONG duplicate;
+    volatile LONG default_route;
+    int queries;
+    HANDLE event;
+    HANDLE thread;
+    int started;
+    int stopped;
+} SimNet;
+
+static DWORD WINAPI sim_thread(LPVOID param)
+{
+    SimNet *net = (SimNet *)param;
+
+    for (int i = 0; i < net->step_count; i++) {
+        Sleep(net->steps[i].delay_ms);
+        InterlockedExchange(&net->preferred, net->steps[i].preferred);
+        InterlockedExchange(&net->duplicate, net->steps[i].duplicate);
+        InterlockedExchange(&net->default_route, net->steps[i].default_route);
+        if (net->steps[i].notify) {
+            SetEvent(net->event);
+        }
+    }
+    return 0;
+}
+
+static int sim_start(void *ctx, HANDLE event)
+{
+    SimNet *net = (SimNet *)ctx;
+
+    net->event = event;
+    net->started++;
+    net->thread = CreateThread(NULL, 0, sim_thread, net, 0, NULL);
+    return net->thread ? 0 : -1;
+}
+
+static void sim_stop(void *ctx)
+{
+    SimNet *net = (SimNet *)ctx;
+
+    WaitForSingleObject(net->thread, INFINITE);
+    CloseHandle(net->thread);
+    net->stopped++;
+}
+
+static int sim_fail_start(void *ctx, HANDLE event)
+{
+    (void)ctx;
+    (void)event;
+    return -1;
+}
+
+static int sim_query(void *ctx, const ReadyTarget *target, ReadyState *state)
+{
+    SimNet *net = (SimNet *)ctx;
+
+    (void)target;
+    net->queries++;
+    state->preferred = (int)net->preferred;
+    state->duplicate = (int)net->duplicate;
+    state->default_route = (int)net->default_route;
+    return 0;
+}
+
+/*
+ * Play `steps` from an initial state and wait for one target
+ */
+static int run_net(const NetStep *initial, const NetStep *steps, int count, int need_route,
+                   DWORD timeout_ms, SimNet *net, double *elapsed)
+{
+    WatchSource source = { net, sim_start, sim_stop };
+    ReadyProbe probe = { net, sim_query };
+    ReadyTarget target;
+
+    ZeroMemory(net, sizeof(*net));
+    net->steps = steps;
+    net->step_count = count;
+    net->preferred = initial->preferred;
+    net->default_route = initial->default_route;
+
+    ZeroMemory(&target, sizeof(target));
+    address_parse(L"192.168.1.10", &target.address);
+    target.need_route = need_route;
+
+    return ready_wait(&source, &probe, &target, 1, 0, timeout_ms, elapsed);
+}
+
+/* ============================================================================
+ * WAIT TESTS
+ * ============================================================================ */
+
+TEST(test_already_ready) {
+    static const NetStep initial = { 0, 1, 0, 1, 0 };
+    SimNet net;
+    double elapsed;
+
+    ASSERT_EQ(0, run_net(&initial, NULL, 0, 1, 5000, &net, &elapsed));
+    ASSERT_EQ(1, net.queries);
+    ASSERT_EQ(1, net.started);
+    ASSERT_EQ(1, net.stopped);
+    ASSERT(elapsed < 100.0);
+}
+
+TEST(test_ready_on_notification) {
+    static const NetStep initial = { 0, 0, 0, 0, 0 };
+    static const NetStep steps[] = {
+        { 100, 1, 0, 0, 1 },        /* DAD done, no route yet */
+        { 100, 1, 0, 1, 1 }         /* Default route added */
+    };
+    SimNet net;
+    double elapsed;
+
+    ASSERT_EQ(0, run_net(&initial, steps, 2, 1, 5000, &net, &elapsed));
+    ASSERT_EQ(3, net.queries);
+
+    /* Woken by the notification, not by the fallback poll */
+    ASSERT(elapsed >= 190.0);
+    ASSERT(elapsed < READY_POLL_MS);
+}
+
+TEST(test_route_not_needed) {
+    static const NetStep initial = { 0, 0, 0, 0, 0 };
+    static const NetStep steps[] = { { 50, 1, 0, 0, 1 } };
+    SimNet net;
+    double elapsed;
+
+    ASSERT_EQ(0, run_net(&initial, steps, 1, 0, 5000, &net, &elapsed));
+    ASSERT_EQ(2, net.queries);
+}
+
+TEST(test_change_without_notification) {
+    static const NetStep initial = { 0, 0, 0, 0, 0 };
+    static const NetStep steps[] = { { 50, 1, 0, 1, 0 } };
+    SimNet net;
+    double elapsed;
+
+    /* The fallback poll still notices */
+    ASSERT_EQ(0, run_net(&initial, steps, 1, 1, 5000, &net, &elapsed));
+    ASSERT(elapsed >= READY_POLL_MS - 50);
+}
+
+TEST(test_timeout) {
+    static const NetStep initial = { 0, 1, 0, 0, 0 };
+    static const NetStep steps[] = { { 50, 1, 0, 0, 1 } };
+    SimNet net;
+    double elapsed;
+
+    ASSERT_EQ(1, run_net(&initial, steps, 1, 1, 300, &net, &elapsed));
+    ASSERT(elapsed >= 300.0);
+    ASSERT(elapsed < 800.0);
+    ASSERT_EQ(1, net.stopped);
+}
+
+TEST(test_duplicate_address) {
+    static const NetStep initial = { 0, 0, 0, 0, 0 };
+    static const NetStep steps[] = { { 50, 0, 1, 0, 1 } };
+    SimNet net;
+    double elapsed;
+
+    ASSERT_EQ(2, run_net(&initial, steps, 1, 1, 5000, &net, &elapsed));
+    ASSERT(elapsed < READY_POLL_MS);
+}
+
+TEST(test_elapsed_since_apply) {
+    SimNet net;
+    WatchSource source = { &net, sim_start, sim_stop };
+    ReadyProbe probe = { &net, sim_query };
+    ReadyTarget target;
+    LONGLONG applied = timer_now();
+    double elapsed;
+
+    ZeroMemory(&net, sizeof(net));
+    ZeroMemory(&target, sizeof(target));
+    net.preferred = 1;
+
+    /* The DNS steps ran between the addresses and the wait */
+    Sleep(200);
+    ASSERT_EQ(0, ready_wait(&source, &probe, &target, 1, applied, 1000, &elapsed));
+    ASSERT(elapsed >= 190.0);
+}
+
+TEST(test_source_failure) {
+    SimNet net;
+    WatchSource source = { &net, sim_fail_start, sim_stop };
+    ReadyProbe probe = { &net, sim_query };
+    ReadyTarget target;
+    double elapsed;
+
+    ZeroMemory(&net, sizeof(net));
+    ZeroMemory(&target, sizeof(target));
+    ASSERT_EQ(-1, ready_wait(&source, &probe, &target, 1, 0, 1000, &elapsed));
+    ASSERT_EQ(0, net.queries);
+}
+
+/* ============================================================================
+ * TARGET TESTS
+ * ============================================================================ */
+
+TEST(test_targets_from_config) {
+    ReadyTarget targets[READY_MAX_TARGETS];
+
+    config_init();
+    ASSERT_EQ(0, ready_targets_from_config(targets));
+
+    StringCchCopyW(g_config.ipv4_address, MAX_ADDR_LEN, L"192.168.1.10");
+    StringCchCopyW(g_config.ipv4_gateway, MAX_ADDR_LEN, L"192.168.1.1");
+    StringCchCopyW(g_config.ipv6_address, MAX_ADDR_LEN, L"2001:db8::10");
+    g_config.has_ipv4 = 1;
+    g_config.has_ipv6 = 1;
+
+    ASSERT_EQ(2, ready_targets_from_config(targets));
+    ASSERT_EQ(AF_INET, targets[0].address.family);
+    ASSERT_EQ(1, targets[0].need_route);
+    ASSERT_EQ(AF_INET6, targets[1].address.family);
+    ASSERT_EQ(0, targets[1].need_route);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* wait tests */
+    RUN_TEST(test_already_ready);
+    RUN_TEST(test_ready_on_notification);
+    RUN_TEST(test_route_not_needed);
+    RUN_TEST(test_change_without_notification);
+    RUN_TEST(test_timeout);
+    RUN_TEST(test_duplicate_address);
+    RUN_TEST(test_elapsed_since_apply);
+    RUN_TEST(test_source_failure);
+
+    /* target tests */
+    RUN_TEST(test_targets_from_config);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,155 @@
+/*
+ * test_retry.c - Tests for per-step netsh retry policies
+ */
+
+#include "retry.h"
+#include "fake_executor.h"
+#include "test.h"
+#include <string.h>
+
+static FakeExecutor g_fake;
+
+/* ============================================================================
+ * POLICY TESTS
+ * ============================================================================ */
+
+TEST(test_default_policy) {
+    RetryPolicy policy;
+
+    retry_policy_init(&policy);
+    ASSERT_EQ(3, policy.attempts);
+    ASSERT_EQ(1, retry_is_retryable(&policy, 1, "\r\nElement not found.\r\n\r\n"));
+    ASSERT_EQ(1, retry_is_retryable(&policy, 1, "The device is NOT READY."));
+    ASSERT_EQ(0, retry_is_retryable(&policy, 1, "The object already exists."));
+    ASSERT_EQ(0, retry_is_retryable(&policy, 0, "Element not found."));
+    ASSERT_EQ(0, retry_is_retryable(&policy, 1, NULL));
+}
+
+TEST(test_set_keys) {
+    RetryPolicy policy;
+    RetryStep step;
+
+    retry_policy_init(&policy);
+    ASSERT_EQ(0, retry_set(&policy, L"attempts", L"5"));
+    ASSERT_EQ(0, retry_set(&policy, L"delay", L"100"));
+    ASSERT_EQ(0, retry_set(&policy, L"max_delay", L"250"));
+    ASSERT_EQ(0, retry_set(&policy, L"exit_codes", L"1, -1"));
+    ASSERT_EQ(0, retry_set(&policy, L"patterns", L"interface is busy | try again"));
+    ASSERT_EQ(5, policy.attempts);
+    ASSERT_EQ(2, policy.exit_code_count);
+    ASSERT_EQ(-1, policy.exit_codes[1]);
+    ASSERT_EQ(2, policy.pattern_count);
+    ASSERT(strcmp(policy.patterns[0], "interface is busy") == 0);
+    ASSERT(strcmp(policy.patterns[1], "try again") == 0);
+
+    /* Listed exit codes retry whatever the output; patterns were replaced */
+    ASSERT_EQ(1, retry_is_retryable(&policy, -1, ""));
+    ASSERT_EQ(0, retry_is_retryable(&policy, 2, "Element not found."));
+
+    /* Invalid values leave the policy unchanged */
+    ASSERT_EQ(-1, retry_set(&policy, L"attempts", L"0"));
+    ASSERT_EQ(-1, retry_set(&policy, L"attempts", L"3x"));
+    ASSERT_EQ(-1, retry_set(&policy, L"exit_codes", L"1, two"));
+    ASSERT_EQ(-1, retry_set(&policy, L"patterns", L"a|b|c|d|e"));
+    ASSERT_EQ(-1, retry_set(&policy, L"jitter", L"1"));
+    ASSERT_EQ(5, policy.attempts);
+    ASSERT_EQ(2, policy.exit_code_count);
+    ASSERT_EQ(2, policy.pattern_count);
+
+    ASSERT_EQ(0, retry_step_from_name(L"DNS", &step));
+    ASSERT_EQ(RETRY_DNS, step);
+    ASSERT_EQ(-1, retry_step_from_name(L"routes", &step));
+}
+
+TEST(test_backoff) {
+    RetryPolicy policy;
+
+    retry_policy_init(&policy);
+    ASSERT_EQ(500, retry_delay_ms(&policy, 1));
+    ASSERT_EQ(1000, retry_delay_ms(&policy, 2));
+    ASSERT_EQ(2000, retry_delay_ms(&policy, 3));
+    ASSERT_EQ(4000, retry_delay_ms(&policy, 4));
+    ASSERT_EQ(4000, retry_delay_ms(&policy, 9));
+
+    policy.delay_ms = 0;
+    ASSERT_EQ(0, retry_delay_ms(&policy, 5));
+}
+
+/* ============================================================================
+ * EXECUTION TESTS
+ * ============================================================================ */
+
+TEST(test_transient_failure_recovers) {
+    RetryPolicy policy;
+
+    retry_policy_init(&policy);
+    fake_executor_install(&g_fake);
+    g_fake.exit_codes[0] = 1;
+    g_fake.call_outputs[0] = "Element not found.\r\n";
+    g_fake.exit_codes[1] = 1;
+    g_fake.call_outputs[1] = "\r\nElement not found.\r\n";
+
+    ASSERT_EQ(0, run_netsh_retry(&policy, L"interface ipv4 set dnsservers name=\"Ethernet\" static 1.1.1.1"));
+    ASSERT_EQ(3, g_fake.count);
+    ASSERT_EQ(2, g_fake.sleep_count);
+    ASSERT_EQ(500, (int)g_fake.sleeps[0]);
+    ASSERT_EQ(1000, (int)g_fake.sleeps[1]);
+}
+
+TEST(test_permanent_failure_stops) {
+    RetryPolicy policy;
+
+    retry_policy_init(&policy);
+    fake_executor_install(&g_fake);
+    g_fake.exit_codes[0] = 1;
+    g_fake.call_outputs[0] = "The filename, directory name, or volume label syntax is incorrect.\r\n";
+
+    ASSERT_EQ(1, run_netsh_retry(&policy, L"interface ipv4 set dnsservers"));
+    ASSERT_EQ(1, g_fake.count);
+    ASSERT_EQ(0, g_fake.sleep_count);
+}
+
+TEST(test_attempts_exhausted) {
+    RetryPolicy policy;
+
+    retry_policy_init(&policy);
+    fake_executor_install(&g_fake);
+    for (int i = 0; i < FAKE_MAX_COMMANDS; i++) {
+        g_fake.exit_codes[i] = 1;
+        g_fake.call_outputs[i] = "Element not found.";
+    }
+
+    ASSERT_EQ(1, run_netsh_retry(&policy, L"dns add encryption server=1.1.1.1"));
+    ASSERT_EQ(3, g_fake.count);
+    ASSERT_EQ(2, g_fake.sleep_count);
+
+    /* attempts = 1 disables retries */
+    policy.attempts = 1;
+    fake_executor_install(&g_fake);
+    g_fake.exit_codes[0] = 1;
+    g_fake.call_outputs[0] = "Element not found.";
+    ASSERT_EQ(1, run_netsh_retry(&policy, L"dns add encryption server=1.1.1.1"));
+    ASSERT_EQ(1, g_fake.count);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* policy tests */
+    RUN_TEST(test_default_policy);
+    RUN_TEST(test_set_keys);
+    RUN_TEST(test_backoff);
+
+    /* execution tests */
+    RUN_TEST(test_transient_failure_recovers);
+    RUN_TEST(test_permanent_failure_stops);
+    RUN_TEST(test_attempts_exhausted);
+
+    process_set_executor(NULL);
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,304 @@
+/*
+ * test_route.c - Tests for route parsing, diffing and synchronization
+ */
+
+#include "route.h"
+#include "test.h"
+#include <string.h>
+
+/* ============================================================================
+ * IN-MEMORY ROUTING TABLE
+ * ============================================================================ */
+
+typedef struct {
+    RouteList routes;
+    int adds;
+    int removes;
+    int updates;
+    int fail_adds;
+} MemTable;
+
+static int find_route(MemTable *table, const RouteEntry *route)
+{
+    for (int i = 0; i < table->routes.count; i++) {
+        const RouteEntry *r = &table->routes.items[i];
+        if (address_compare(&r->dest, &route->dest) == 0 &&
+            r->dest.prefix == route->dest.prefix &&
+            address_compare(&r->nexthop, &route->nexthop) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int mem_list(void *ctx, RouteList *out)
+{
+    MemTable *table = (MemTable *)ctx;
+    for (int i = 0; i < table->routes.count; i++) {
+        if (route_list_add(out, &table->routes.items[i]) != 0) return -1;
+    }
+    return 0;
+}
+
+static int mem_add(void *ctx, const RouteEntry *route)
+{
+    MemTable *table = (MemTable *)ctx;
+    RouteEntry stored = *route;
+    if (table->fail_adds) return -1;
+    if (stored.metric < 0) stored.metric = 0;
+    table->adds++;
+    return route_list_add(&table->routes, &stored);
+}
+
+static int mem_remove(void *ctx, const RouteEntry *route)
+{
+    MemTable *table = (MemTable *)ctx;
+    int idx = find_route(table, route);
+    if (idx < 0) return -1;
+    table->routes.items[idx] = table->routes.items[--table->routes.count];
+    table->removes++;
+    return 0;
+}
+
+static int mem_update(void *ctx, const RouteEntry *route)
+{
+    MemTable *table = (MemTable *)ctx;
+    int idx = find_route(table, route);
+    if (idx < 0) return -1;
+    table->routes.items[idx].metric = route->metric;
+    table->updates++;
+    return 0;
+}
+
+static void mem_backend(RouteBackend *backend, MemTable *table)
+{
+    memset(table, 0, sizeof(*table));
+    backend->ctx = table;
+    backend->list = mem_list;
+    backend->add = mem_add;
+    backend->remove = mem_remove;
+    backend->update = mem_update;
+}
+
+static void add_spec(RouteList *list, const wchar_t *spec)
+{
+    RouteEntry route;
+    if (route_parse(spec, &route) == 0) {
+        route_list_add(list, &route);
+    }
+}
+
+static void progress_count(int done, int total, void *ctx)
+{
+    (void)total;
+    *(int *)ctx = done;
+}
+
+/* ============================================================================
+ * PARSE TESTS
+ * ============================================================================ */
+
+TEST(test_parse_via_metric) {
+    RouteEntry route;
+    wchar_t text[128];
+    ASSERT_EQ(0, route_parse(L"10.0.0.0/8 via 192.168.1.254 metric 10", &route));
+    ASSERT_EQ(8, route.dest.prefix);
+    ASSERT_EQ(10, route.metric);
+    route_format(&route, text, 128);
+    ASSERT_WSTR_EQ(L"10.0.0.0/8 via 192.168.1.254 metric 10", text);
+}
+
+TEST(test_parse_bare_nexthop) {
+    RouteEntry route;
+    ASSERT_EQ(0, route_parse(L"172.16.0.0/12 10.0.0.1", &route));
+    ASSERT_EQ(-1, route.metric);
+    ASSERT_EQ(AF_INET, route.nexthop.family);
+}
+
+TEST(test_parse_host_route_and_masking) {
+    RouteEntry route;
+    wchar_t text[128];
+    ASSERT_EQ(0, route_parse(L"10.1.2.3", &route));
+    ASSERT_EQ(32, route.dest.prefix);
+    ASSERT_EQ(0, route_parse(L"10.1.2.3/8 via 10.0.0.1", &route));
+    route_format(&route, text, 128);
+    ASSERT_WSTR_EQ(L"10.0.0.0/8 via 10.0.0.1", text);
+}
+
+TEST(test_parse_ipv6) {
+    RouteEntry route;
+    ASSERT_EQ(0, route_parse(L"::/0 via fe80::1", &route));
+    ASSERT_EQ(AF_INET6, route.dest.family);
+    ASSERT_EQ(0, route.dest.prefix);
+}
+
+TEST(test_parse_rejects_mixed_family) {
+    RouteEntry route;
+    ASSERT_EQ(-1, route_parse(L"10.0.0.0/8 via fe80::1", &route));
+    ASSERT_EQ(-1, route_parse(L"10.0.0.0/8 metric", &route));
+    ASSERT_EQ(-1, route_parse(L"not-a-route", &route));
+}
+
+/* ============================================================================
+ * SYNC TESTS
+ * ============================================================================ */
+
+TEST(test_sync_adds_missing) {
+    MemTable table;
+    RouteBackend backend;
+    RouteList desired = {0};
+    RouteSyncResult result;
+
+    mem_backend(&backend, &table);
+    add_spec(&desired, L"10.0.0.0/8 via 192.168.1.254");
+    add_spec(&desired, L"172.16.0.0/12 via 192.168.1.254");
+
+    ASSERT_EQ(0, route_sync(&backend, &desired, 0, NULL, NULL, &result));
+    ASSERT_EQ(2, result.added);
+    ASSERT_EQ(2, table.routes.count);
+
+    /* Second run is a no-op */
+    ASSERT_EQ(0, route_sync(&backend, &desired, 0, NULL, NULL, &result));
+    ASSERT_EQ(0, result.added);
+    ASSERT_EQ(2, result.unchanged);
+    ASSERT_EQ(2, table.adds);
+
+    route_list_free(&desired);
+    route_list_free(&table.routes);
+}
+
+TEST(test_sync_replaces_nexthop_without_prune) {
+    MemTable table;
+    RouteBackend backend;
+    RouteList desired = {0};
+    RouteSyncResult result;
+
+    mem_backend(&backend, &table);
+    add_spec(&table.routes, L"10.0.0.0/8 via 192.168.1.1");
+    add_spec(&table.routes, L"192.0.2.0/24 via 192.168.1.1");
+    add_spec(&desired, L"10.0.0.0/8 via 192.168.1.254");
+
+    ASSERT_EQ(0, route_sync(&backend, &desired, 0, NULL, NULL, &result));
+    ASSERT_EQ(1, result.added);
+    ASSERT_EQ(1, result.removed);
+    /* Unlisted destination survives */
+    ASSERT_EQ(2, table.routes.count);
+
+    route_list_free(&desired);
+    route_list_free(&table.routes);
+}
+
+TEST(test_sync_prune_removes_unlisted) {
+    MemTable table;
+    RouteBackend backend;
+    RouteList desired = {0};
+    RouteSyncResult result;
+
+    mem_backend(&backend, &table);
+    add_spec(&table.routes, L"10.0.0.0/8 via 192.168.1.1");
+    add_spec(&table.routes, L"192.0.2.0/24 via 192.168.1.1");
+    add_spec(&desired, L"10.0.0.0/8 via 192.168.1.1");
+
+    ASSERT_EQ(0, route_sync(&backend, &desired, 1, NULL, NULL, &result));
+    ASSERT_EQ(1, result.removed);
+    ASSERT_EQ(1, result.unchanged);
+    ASSERT_EQ(1, table.routes.count);
+
+    route_list_free(&desired);
+    route_list_free(&table.routes);
+}
+
+TEST(test_sync_metric_update) {
+    MemTable table;
+    RouteBackend backend;
+    RouteList desired = {0};
+    RouteSyncResult result;
+
+    mem_backend(&backend, &table);
+    add_spec(&table.routes, L"10.0.0.0/8 via 192.168.1.1 metric 5");
+    add_spec(&desired, L"10.0.0.0/8 via 192.168.1.1 metric 20");
+
+    ASSERT_EQ(0, route_sync(&backend, &desired, 0, NULL, NULL, &result));
+    ASSERT_EQ(1, result.updated);
+    ASSERT_EQ(0, result.added);
+    ASSERT_EQ(20, table.routes.items[0].metric);
+
+    route_list_free(&desired);
+    route_list_free(&table.routes);
+}
+
+TEST(test_sync_reports_failures) {
+    MemTable table;
+    RouteBackend backend;
+    RouteList desired = {0};
+    RouteSyncResult result;
+
+    mem_backend(&backend, &table);
+    table.fail_adds = 1;
+    add_spec(&desired, L"10.0.0.0/8 via 192.168.1.1");
+
+    ASSERT_EQ(-1, route_sync(&backend, &desired, 0, NULL, NULL, &result));
+    ASSERT_EQ(1, result.failed);
+
+    route_list_free(&desired);
+    route_list_free(&table.routes);
+}
+
+TEST(test_sync_ten_thousand_routes) {
+    MemTable table;
+    RouteBackend backend;
+    RouteList desired = {0};
+    RouteSyncResult result;
+    wchar_t spec[128];
+    int progress = 0;
+
+    mem_backend(&backend, &table);
+    for (int i = 0; i < 10000; i++) {
+        StringCchPrintfW(spec, 128, L"10.%d.%d.0/24 via 192.168.1.254", i / 256, i % 256);
+        add_spec(&desired, spec);
+    }
+    ASSERT_EQ(10000, desired.count);
+
+    ULONGLONG start = GetTickCount64();
+    ASSERT_EQ(0, route_sync(&backend, &desired, 1, progress_count, &progress, &result));
+    ASSERT_EQ(10000, result.added);
+    ASSERT_EQ(10000, progress);
+
+    /* Change one next hop and drop one route, then resync with prune */
+    desired.count--;
+    ASSERT_EQ(0, route_parse(L"10.0.0.0/24 via 192.168.1.253", &desired.items[0]));
+    ASSERT_EQ(0, route_sync(&backend, &desired, 1, NULL, NULL, &result));
+    ASSERT_EQ(1, result.added);
+    ASSERT_EQ(2, result.removed);
+    ASSERT_EQ(9998, result.unchanged);
+    ASSERT(GetTickCount64() - start < 5000);
+
+    route_list_free(&desired);
+    route_list_free(&table.routes);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* parse tests */
+    RUN_TEST(test_parse_via_metric);
+    RUN_TEST(test_parse_bare_nexthop);
+    RUN_TEST(test_parse_host_route_and_masking);
+    RUN_TEST(test_parse_ipv6);
+    RUN_TEST(test_parse_rejects_mixed_family);
+
+    /* sync tests */
+    RUN_TEST(test_sync_adds_missing);
+    RUN_TEST(test_sync_replaces_nexthop_without_prune);
+    RUN_TEST(test_sync_prune_removes_unlisted);
+    RUN_TEST(test_sync_metric_update);
+    RUN_TEST(test_sync_reports_failures);
+    RUN_TEST(test_sync_ten_thousand_routes);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,247 @@
+/*
+ * test_serve.c - Tests for status reports and the status server cache
+ */
+
+#include "serve.h"
+#include "test.h"
+#include <string.h>
+
+static void add_server(DnsServerInfo *servers, int *count, const wchar_t *address,
+                       int has_template, int autoupgrade, int udpfallback)
+{
+    DnsServerInfo *info = &servers[(*count)++];
+
+    ZeroMemory(info, sizeof(*info));
+    StringCchCopyW(info->address, MAX_ADDR_LEN, address);
+    if (has_template) {
+        StringCchCopyW(info->doh_template, 256, L"https://cloudflare-dns.com/dns-query");
+    }
+    info->has_template = has_template;
+    info->autoupgrade = autoupgrade;
+    info->udpfallback = udpfallback;
+}
+
+/* 2024-01-01 00:00:00 UTC */
+static void make_report(StatusReport *report)
+{
+    ULONGLONG t = (1704067200ULL + 11644473600ULL) * 10000000ULL;
+
+    ZeroMemory(report, sizeof(*report));
+    StringCchCopyW(report->interface_name, MAX_IFACE_LEN, L"Ethernet");
+    report->collected.dwLowDateTime = (DWORD)t;
+    report->collected.dwHighDateTime = (DWORD)(t >> 32);
+}
+
+/* Both Cloudflare servers per family, all with DoH and no fallback */
+static void encrypted_report(StatusReport *report)
+{
+    make_report(report);
+    add_server(report->ipv4, &report->ipv4_count, L"1.1.1.1", 1, 1, 0);
+    add_server(report->ipv4, &report->ipv4_count, L"1.0.0.1", 1, 1, 0);
+    add_server(report->ipv6, &report->ipv6_count, L"2606:4700:4700::1111", 1, 1, 0);
+    status_summarize(report);
+}
+
+/* ============================================================================
+ * STATUS REPORT TESTS
+ * ============================================================================ */
+
+TEST(test_summarize_encrypted) {
+    StatusReport report;
+
+    encrypted_report(&report);
+    ASSERT_EQ(2, report.ipv4_encrypted);
+    ASSERT_EQ(1, report.ipv6_encrypted);
+    ASSERT_EQ(0, report.any_fallback);
+    ASSERT_EQ(0, report.any_unencrypted);
+    ASSERT_EQ(1, report.fully_encrypted);
+    ASSERT_EQ(0, status_exit_code(&report));
+}
+
+TEST(test_summarize_partial) {
+    StatusReport report;
+
+    make_report(&report);
+    add_server(report.ipv4, &report.ipv4_count, L"1.1.1.1", 1, 1, 1);
+    add_server(report.ipv4, &report.ipv4_count, L"192.168.1.1", 0, 0, 0);
+    status_summarize(&report);
+
+    ASSERT_EQ(0, report.ipv4_encrypted);
+    ASSERT_EQ(1, report.any_fallback);
+    ASSERT_EQ(1, report.any_unencrypted);
+    ASSERT_EQ(0, report.fully_encrypted);
+    ASSERT_EQ(1, status_exit_code(&report));
+
+    /* No servers at all is not encrypted either */
+    make_report(&report);
+    status_summarize(&report);
+    ASSERT_EQ(0, report.fully_encrypted);
+    ASSERT(wcsstr(status_overall_text(&report), L"NO DNS CONFIGURED") != NULL);
+}
+
+TEST(test_format_text) {
+    StatusReport report;
+    wchar_t text[STATUS_TEXT_SIZE];
+
+    encrypted_report(&report);
+    status_format_text(&report, text, STATUS_TEXT_SIZE);
+
+    ASSERT(wcsstr(text, L"Status for interface: Ethernet\n") != NULL);
+    ASSERT(wcsstr(text, L"IPv4 DNS: 1.1.1.1, 1.0.0.1\n") != NULL);
+    ASSERT(wcsstr(text, L"  1.0.0.1: ENCRYPTED\n") != NULL);
+    ASSERT(wcsstr(text, L"  IPv4: ENCRYPTED (2/2 servers)\n") != NULL);
+    ASSERT(wcsstr(text, L"  Fallback: DISABLED\n") != NULL);
+    ASSERT(wcsstr(status_overall_text(&report), L"OK (fully encrypted)") != NULL);
+}
+
+TEST(test_format_json) {
+    StatusReport report;
+    char json[STATUS_JSON_SIZE];
+    int len;
+
+    encrypted_report(&report);
+    StringCchCopyW(report.interface_name, MAX_IFACE_LEN, L"Wi-Fi \"5G\"");
+    len = status_format_json(&report, json, sizeof(json));
+
+    ASSERT(len > 0);
+    ASSERT_EQ((int)strlen(json), len);
+    ASSERT(strncmp(json, "{\"interface\":\"Wi-Fi \\\"5G\\\"\",\"collected\":1704067200,", 50) == 0);
+    ASSERT(strstr(json, "{\"address\":\"1.0.0.1\",") != NULL);
+    ASSERT(strstr(json, "\"has_template\":true,\"autoupgrade\":true,\"udpfallback\":false,"
+                        "\"encrypted\":true}") != NULL);
+    ASSERT(strstr(json, "\"fully_encrypted\":true}\n") != NULL);
+    ASSERT_EQ('\n', json[len - 1]);
+
+    /* Too small a buffer is reported, not truncated */
+    ASSERT_EQ(-1, status_format_json(&report, json, 64));
+}
+
+/* ============================================================================
+ * CACHE TESTS
+ * ============================================================================ */
+
+TEST(test_respond_empty_cache) {
+    StatusCache cache;
+    char out[SERVE_RESPONSE_SIZE];
+
+    serve_cache_init(&cache);
+    ASSERT_EQ(-1, serve_respond(&cache, "json", out, sizeof(out)));
+}
+
+TEST(test_respond_formats) {
+    static StatusCache cache;
+    StatusReport report;
+    char out[SERVE_RESPONSE_SIZE + 1];
+    int len;
+
+    serve_cache_init(&cache);
+    encrypted_report(&report);
+    ASSERT_EQ(0, serve_cache_update(&cache, &report));
+
+    len = serve_respond(&cache, "json\n", out, sizeof(out));
+    ASSERT(len > 0);
+    out[len] = '\0';
+    ASSERT(strncmp(out, "0\n{\"interface\":\"Ethernet\"", 25) == 0);
+
+    len = serve_respond(&cache, "  TEXT\r\n", out, sizeof(out));
+    ASSERT(len > 0);
+    out[len] = '\0';
+    ASSERT(strncmp(out, "0\n", 2) == 0);
+    ASSERT(strstr(out, "Status for interface: Ethernet") != NULL);
+    ASSERT(strstr(out, "Overall result: OK (fully encrypted)\n") != NULL);
+
+    /* Unknown requests and short buffers get no answer */
+    ASSERT_EQ(-1, serve_respond(&cache, "jsonx", out, sizeof(out)));
+    ASSERT_EQ(-1, serve_respond(&cache, "", out, sizeof(out)));
+    ASSERT_EQ(-1, serve_respond(&cache, "json", out, 8));
+}
+
+TEST(test_update_replaces_report) {
+    static StatusCache cache;
+    StatusReport report;
+    char out[SERVE_RESPONSE_SIZE];
+
+    serve_cache_init(&cache);
+    encrypted_report(&report);
+    serve_cache_update(&cache, &report);
+
+    report.ipv4[0].udpfallback = 1;
+    status_summarize(&report);
+    serve_cache_update(&cache, &report);
+
+    ASSERT_EQ(2, (int)cache.refreshes);
+    ASSERT(serve_respond(&cache, "json", out, sizeof(out)) > 0);
+    ASSERT(strncmp(out, "1\n", 2) == 0);
+}
+
+TEST(test_respond_stale) {
+    static StatusCache cache;
+    StatusReport report;
+    char out[SERVE_RESPONSE_SIZE + 1];
+    int len;
+
+    serve_cache_init(&cache);
+    encrypted_report(&report);
+    serve_cache_update(&cache, &report);
+
+    /* Only the first failure sets the time */
+    serve_cache_mark_stale(&cache, 1709646067);
+    serve_cache_mark_stale(&cache, 1709646127);
+    len = serve_respond(&cache, "json", out, sizeof(out));
+    ASSERT(len > 0);
+    out[len] = '\0';
+    ASSERT(strncmp(out, "0 stale-since=1709646067\n{\"interface\":\"Ethernet\"", 48) == 0);
+
+    len = serve_respond(&cache, "text", out, sizeof(out));
+    ASSERT(len > 0);
+    out[len] = '\0';
+    ASSERT(strncmp(out, "0 stale-since=1709646067\n", 25) == 0);
+
+    /* A good refresh clears the mark */
+    serve_cache_update(&cache, &report);
+    len = serve_respond(&cache, "json", out, sizeof(out));
+    ASSERT(len > 0);
+    ASSERT(strncmp(out, "0\n{", 3) == 0);
+}
+
+TEST(test_respond_fast) {
+    static StatusCache cache;
+    static char out[SERVE_RESPONSE_SIZE];
+    StatusReport report;
+    LONGLONG start;
+
+    serve_cache_init(&cache);
+    encrypted_report(&report);
+    serve_cache_update(&cache, &report);
+
+    start = timer_now();
+    for (int i = 0; i < 10000; i++) {
+        ASSERT(serve_respond(&cache, "json\n", out, sizeof(out)) > 0);
+    }
+    /* 10000 answers from memory, no netsh involved */
+    ASSERT(timer_elapsed_ms(start) < 100.0);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* status report tests */
+    RUN_TEST(test_summarize_encrypted);
+    RUN_TEST(test_summarize_partial);
+    RUN_TEST(test_format_text);
+    RUN_TEST(test_format_json);
+
+    /* cache tests */
+    RUN_TEST(test_respond_empty_cache);
+    RUN_TEST(test_respond_formats);
+    RUN_TEST(test_update_replaces_report);
+    RUN_TEST(test_respond_stale);
+    RUN_TEST(test_respond_fast);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,159 @@
+/*
+ * test_suffix.c - Tests for the DNS suffix search list
+ */
+
+#include "suffix.h"
+#include "fake_registry.h"
+#include "stub_dns.h"
+#include "test.h"
+
+/* ============================================================================
+ * PARSING TESTS
+ * ============================================================================ */
+
+TEST(test_parse_normalizes) {
+    SuffixList list;
+    wchar_t text[SUFFIX_LIST_LEN];
+
+    ASSERT_EQ(0, suffix_parse(L" Corp.Example.com., .lab.example.com; corp.example.com  dev-1.example.com", &list));
+    ASSERT_EQ(3, list.count);
+    ASSERT(wcscmp(list.items[0], L"corp.example.com") == 0);
+    ASSERT(wcscmp(list.items[1], L"lab.example.com") == 0);
+
+    suffix_format(&list, text, SUFFIX_LIST_LEN);
+    ASSERT(wcscmp(text, L"corp.example.com,lab.example.com,dev-1.example.com") == 0);
+    ASSERT_EQ(6, suffix_worst_case_queries(&list));
+
+    ASSERT_EQ(0, suffix_parse(L"", &list));
+    ASSERT_EQ(0, list.count);
+    ASSERT_EQ(0, suffix_worst_case_queries(&list));
+}
+
+TEST(test_parse_rejects) {
+    SuffixList list;
+    wchar_t many[SUFFIX_LIST_LEN] = L"";
+
+    ASSERT_EQ(-1, suffix_parse(L"corp..example.com", &list));
+    ASSERT_EQ(-1, suffix_parse(L"corp.example.com/24", &list));
+    ASSERT_EQ(-1, suffix_parse(L"exa mple.com!", &list));
+
+    for (int i = 0; i <= SUFFIX_MAX; i++) {
+        wchar_t name[32];
+        StringCchPrintfW(name, 32, L"s%d.example.com,", i);
+        StringCchCatW(many, SUFFIX_LIST_LEN, name);
+    }
+    ASSERT_EQ(-1, suffix_parse(many, &list));
+}
+
+/* ============================================================================
+ * REGISTRY TESTS
+ * ============================================================================ */
+
+TEST(test_sync_writes_differences) {
+    FakeRegistry fake;
+    RegistryBackend reg;
+    SuffixList desired, previous, current;
+    wchar_t value[SUFFIX_LIST_LEN];
+
+    fake_registry_init(&fake, &reg);
+    suffix_parse(L"corp.example.com, example.com", &desired);
+
+    /* No SearchList yet */
+    ASSERT_EQ(1, suffix_sync(&reg, &desired, &previous));
+    ASSERT_EQ(0, previous.count);
+    reg.get_string(&fake, SUFFIX_REGISTRY_KEY, SUFFIX_VALUE_NAME, value, SUFFIX_LIST_LEN);
+    ASSERT(wcscmp(value, L"corp.example.com,example.com") == 0);
+
+    ASSERT_EQ(1, fake.writes);
+    ASSERT_EQ(0, suffix_sync(&reg, &desired, &previous));
+    ASSERT_EQ(1, fake.writes);
+
+    /* Order matters for the search */
+    suffix_parse(L"example.com, corp.example.com", &desired);
+    ASSERT_EQ(1, suffix_sync(&reg, &desired, &previous));
+    ASSERT(wcscmp(previous.items[0], L"corp.example.com") == 0);
+
+    /* A value written by hand is read as it stands */
+    reg.set_string(&fake, SUFFIX_REGISTRY_KEY, SUFFIX_VALUE_NAME, L"CORP,bad!name,", 0);
+    ASSERT_EQ(0, suffix_read(&reg, &current));
+    ASSERT_EQ(2, current.count);
+    ASSERT(wcscmp(current.items[1], L"bad!name") == 0);
+
+    fake.fail_writes = 1;
+    ASSERT_EQ(-1, suffix_sync(&reg, &desired, &previous));
+
+    fake_registry_free(&fake);
+}
+
+/* ============================================================================
+ * LOOKUP COST TESTS
+ * ============================================================================ */
+
+TEST(test_measure_per_suffix) {
+    StubServer stub;
+    ProbeTarget target;
+    SuffixList list;
+    double cost[SUFFIX_MAX];
+
+    ASSERT_EQ(0, stub_start(&stub, 30, 0));
+    target.server = L"127.0.0.1";
+    target.port = stub.port;
+    suffix_parse(L"corp.example.com, lab.example.com", &list);
+
+    ASSERT_EQ(0, suffix_measure(&target, 1, &list, 3, 1000, cost));
+    ASSERT_EQ(6, (int)stub.queries);
+    ASSERT(cost[0] >= 25.0 && cost[0] < 200.0);
+    ASSERT(cost[1] >= 25.0 && cost[1] < 200.0);
+
+    stub_stop(&stub);
+}
+
+TEST(test_measure_silent_servers) {
+    StubServer silent, fast;
+    ProbeTarget targets[2];
+    SuffixList list;
+    double cost[SUFFIX_MAX];
+
+    ASSERT_EQ(0, stub_start(&silent, 0, 1));
+    ASSERT_EQ(0, stub_start(&fast, 0, 0));
+    targets[0].server = L"127.0.0.1";
+    targets[0].port = silent.port;
+    targets[1].server = L"127.0.0.1";
+    targets[1].port = fast.port;
+    suffix_parse(L"corp.example.com", &list);
+
+    /* The first server that answers sets the cost */
+    ASSERT_EQ(0, suffix_measure(targets, 2, &list, 2, 200, cost));
+    ASSERT(cost[0] < 100.0);
+
+    /* Nobody answers: each suffix costs the full timeout */
+    ASSERT_EQ(0, suffix_measure(targets, 1, &list, 2, 100, cost));
+    ASSERT(cost[0] == 100.0);
+
+    ASSERT_EQ(-1, suffix_measure(targets, 1, &list, PROBE_MAX_NAMES + 1, 100, cost));
+
+    stub_stop(&fast);
+    stub_stop(&silent);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* parsing tests */
+    RUN_TEST(test_parse_normalizes);
+    RUN_TEST(test_parse_rejects);
+
+    /* registry tests */
+    RUN_TEST(test_sync_writes_differences);
+
+    /* lookup cost tests */
+    RUN_TEST(test_measure_per_suffix);
+    RUN_TEST(test_measure_silent_servers);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,184 @@
+/*
+ * test_tcp.c - Tests for global TCP settings with a fake command executor
+ */
+
+#include "tcp.h"
+#include "config.h"
+#include "fake_executor.h"
+#include "test.h"
+#include <string.h>
+
+/* ============================================================================
+ * CANNED OUTPUT
+ * ============================================================================ */
+
+static const char SHOW_GLOBAL[] =
+    "Querying active state...\r\n"
+    "\r\n"
+    "TCP Global Parameters\r\n"
+    "----------------------------------------------\r\n"
+    "Receive-Side Scaling State          : enabled\r\n"
+    "Receive Window Auto-Tuning Level    : normal\r\n"
+    "Add-On Congestion Control Provider  : default\r\n"
+    "ECN Capability                      : Disabled\r\n"
+    "RFC 1323 Timestamps                 : disabled\r\n"
+    "Initial RTO                         : 1000\r\n"
+    "Receive Segment Coalescing State    : enabled\r\n";
+
+static FakeExecutor g_fake;
+
+static void setup(void)
+{
+    fake_executor_install(&g_fake);
+    fake_executor_output(&g_fake, L"tcp show global", SHOW_GLOBAL);
+    config_init();
+}
+
+/* ============================================================================
+ * PARSING TESTS
+ * ============================================================================ */
+
+TEST(test_set_values) {
+    TcpSettings s;
+
+    ZeroMemory(&s, sizeof(s));
+    ASSERT_EQ(0, tcp_any(&s));
+
+    ASSERT_EQ(0, tcp_set(&s, L"autotuning", L"HighlyRestricted"));
+    ASSERT(wcscmp(s.values[TCP_AUTOTUNING], L"highlyrestricted") == 0);
+    ASSERT_EQ(0, tcp_set(&s, L"ECN", L"default"));
+    ASSERT_EQ(1, tcp_any(&s));
+
+    ASSERT_EQ(-1, tcp_set(&s, L"rss", L"default"));
+    ASSERT_EQ(-1, tcp_set(&s, L"chimney", L"enabled"));
+    ASSERT(s.values[TCP_RSS][0] == L'\0');
+}
+
+TEST(test_parse_global) {
+    TcpSettings s;
+
+    tcp_parse_global(SHOW_GLOBAL, &s);
+    ASSERT(wcscmp(s.values[TCP_AUTOTUNING], L"normal") == 0);
+    ASSERT(wcscmp(s.values[TCP_RSS], L"enabled") == 0);
+    ASSERT(wcscmp(s.values[TCP_ECN], L"disabled") == 0);
+    ASSERT(wcscmp(s.values[TCP_RSC], L"enabled") == 0);
+
+    tcp_parse_global("TCP Global Parameters\n", &s);
+    ASSERT_EQ(0, tcp_any(&s));
+}
+
+TEST(test_diff_and_command) {
+    TcpSettings desired, current, changes;
+    wchar_t args[CMD_BUFFER_SIZE];
+
+    ZeroMemory(&desired, sizeof(desired));
+    tcp_parse_global(SHOW_GLOBAL, &current);
+    tcp_set(&desired, L"autotuning", L"restricted");
+    tcp_set(&desired, L"rss", L"enabled");
+    tcp_set(&desired, L"ecn", L"enabled");
+
+    ASSERT_EQ(2, tcp_diff(&desired, &current, &changes));
+    ASSERT(changes.values[TCP_RSS][0] == L'\0');
+    ASSERT_EQ(0, tcp_build_command(&changes, args, CMD_BUFFER_SIZE));
+    ASSERT(wcscmp(args, L"interface tcp set global autotuninglevel=restricted ecncapability=enabled") == 0);
+
+    ZeroMemory(&changes, sizeof(changes));
+    ASSERT_EQ(-1, tcp_build_command(&changes, args, CMD_BUFFER_SIZE));
+}
+
+/* ============================================================================
+ * APPLY TESTS
+ * ============================================================================ */
+
+TEST(test_apply_only_differences) {
+    setup();
+    tcp_set(&g_config.tcp, L"autotuning", L"restricted");
+    tcp_set(&g_config.tcp, L"rss", L"enabled");
+    tcp_set(&g_config.tcp, L"ecn", L"enabled");
+
+    ASSERT_EQ(0, tcp_apply());
+    ASSERT_EQ(2, g_fake.count);
+    ASSERT(wcsstr(g_fake.commands[0], L"tcp show global") != NULL);
+    ASSERT(wcscmp(g_fake.commands[1],
+        L"netsh.exe interface tcp set global autotuninglevel=restricted ecncapability=enabled") == 0);
+
+    /* Rollback sets back exactly what was replaced, once */
+    tcp_rollback();
+    ASSERT_EQ(3, g_fake.count);
+    ASSERT(wcscmp(g_fake.commands[2],
+        L"netsh.exe interface tcp set global autotuninglevel=normal ecncapability=disabled") == 0);
+    tcp_rollback();
+    ASSERT_EQ(3, g_fake.count);
+
+    process_set_executor(NULL);
+}
+
+TEST(test_apply_nothing_to_do) {
+    setup();
+
+    /* No [tcp] section: netsh is not even asked */
+    ASSERT_EQ(0, tcp_apply());
+    ASSERT_EQ(0, g_fake.count);
+
+    tcp_set(&g_config.tcp, L"rss", L"enabled");
+    tcp_set(&g_config.tcp, L"autotuning", L"normal");
+    ASSERT_EQ(0, tcp_apply());
+    ASSERT_EQ(1, g_fake.count);
+
+    tcp_rollback();
+    ASSERT_EQ(1, g_fake.count);
+
+    process_set_executor(NULL);
+}
+
+TEST(test_apply_failure_rolls_back) {
+    setup();
+    g_fake.fail_on = L"tcp set global";
+    tcp_set(&g_config.tcp, L"rsc", L"disabled");
+
+    ASSERT_EQ(-1, tcp_apply());
+    tcp_rollback();
+    ASSERT(wcscmp(g_fake.commands[g_fake.count - 1],
+        L"netsh.exe interface tcp set global rsc=enabled") == 0);
+
+    process_set_executor(NULL);
+}
+
+TEST(test_new_apply_forgets_previous_changes) {
+    int count;
+
+    setup();
+    tcp_set(&g_config.tcp, L"rsc", L"disabled");
+    ASSERT_EQ(0, tcp_apply());
+
+    /* A later run without changes must not undo the earlier one */
+    ZeroMemory(&g_config.tcp, sizeof(g_config.tcp));
+    ASSERT_EQ(0, tcp_apply());
+    count = g_fake.count;
+    tcp_rollback();
+    ASSERT_EQ(count, g_fake.count);
+
+    process_set_executor(NULL);
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* parsing tests */
+    RUN_TEST(test_set_values);
+    RUN_TEST(test_parse_global);
+    RUN_TEST(test_diff_and_command);
+
+    /* apply tests */
+    RUN_TEST(test_apply_only_differences);
+    RUN_TEST(test_apply_nothing_to_do);
+    RUN_TEST(test_apply_failure_rolls_back);
+    RUN_TEST(test_new_apply_forgets_previous_changes);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,213 @@
+/*
+ * test_validate.c - Tests for the pre-flight configuration validation
+ */
+
+#include "validate.h"
+#include "test.h"
+#include <string.h>
+
+static Config g_test;
+
+static const DnsProvider CUSTOM = {
+    .name = L"Custom",
+    .ipv4_primary = L"9.9.9.9",
+    .ipv4_secondary = L"149.112.112.112",
+    .ipv6_primary = L"2620:fe::fe",
+    .ipv6_secondary = L"2620:fe::9",
+    .doh_template = L"https://dns.quad9.net/dns-query"
+};
+
+static Config *static_config(void)
+{
+    ZeroMemory(&g_test, sizeof(g_test));
+    StringCchCopyW(g_test.ipv4_address, MAX_ADDR_LEN, L"192.168.1.10");
+    StringCchCopyW(g_test.ipv4_mask, MAX_ADDR_LEN, L"255.255.255.0");
+    StringCchCopyW(g_test.ipv4_gateway, MAX_ADDR_LEN, L"192.168.1.1");
+    StringCchCopyW(g_test.ipv6_address, MAX_ADDR_LEN, L"2001:db8::10");
+    StringCchCopyW(g_test.ipv6_prefix, 16, L"64");
+    StringCchCopyW(g_test.ipv6_gateway, MAX_ADDR_LEN, L"fe80::1");
+    g_test.has_ipv4 = 1;
+    g_test.has_ipv6 = 1;
+    return &g_test;
+}
+
+static int has_message(const ValidationReport *report, const wchar_t *fragment)
+{
+    for (int i = 0; i < report->count; i++) {
+        if (wcsstr(report->messages[i], fragment)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * DOH TEMPLATE TESTS
+ * ============================================================================ */
+
+TEST(test_doh_template_valid) {
+    ASSERT(validate_doh_template(L"https://cloudflare-dns.com/dns-query") == NULL);
+    ASSERT(validate_doh_template(L"HTTPS://dns.google/dns-query{?dns}") == NULL);
+    ASSERT(validate_doh_template(L"https://dns.example:8443/q") == NULL);
+    ASSERT(validate_doh_template(L"https://[2606:4700::1111]/dns-query") == NULL);
+}
+
+TEST(test_doh_template_invalid) {
+    ASSERT(validate_doh_template(L"") != NULL);
+    ASSERT(validate_doh_template(NULL) != NULL);
+    ASSERT(wcscmp(validate_doh_template(L"http://dns.google/dns-query"), L"must start with https://") == 0);
+    ASSERT(wcscmp(validate_doh_template(L"https://dns.google"), L"has no path (e.g. /dns-query)") == 0);
+    ASSERT(validate_doh_template(L"https:///dns-query") != NULL);
+    ASSERT(validate_doh_template(L"https://-bad/dns-query") != NULL);
+    ASSERT(validate_doh_template(L"https://dns.google:0/dns-query") != NULL);
+    ASSERT(validate_doh_template(L"https://dns.google:99999/dns-query") != NULL);
+    ASSERT(validate_doh_template(L"https://[2606:zz::1]/dns-query") != NULL);
+    ASSERT(validate_doh_template(L"https://dns.google/dns query") != NULL);
+    ASSERT(validate_doh_template(L"https://dns.google/\"q") != NULL);
+    ASSERT(validate_doh_template(L"https://dns.google/q#x") != NULL);
+}
+
+/* ============================================================================
+ * CONFIG TESTS
+ * ============================================================================ */
+
+TEST(test_valid_config) {
+    ValidationReport report;
+
+    ASSERT_EQ(0, validate_config(static_config(), &CUSTOM, &report));
+
+    /* Global-scope IPv6 gateway inside the prefix */
+    StringCchCopyW(g_test.ipv6_gateway, MAX_ADDR_LEN, L"2001:db8::1");
+    ASSERT_EQ(0, validate_config(&g_test, &CUSTOM, &report));
+
+    /* /31 point-to-point links have no network or broadcast address */
+    StringCchCopyW(g_test.ipv4_address, MAX_ADDR_LEN, L"10.0.0.0");
+    StringCchCopyW(g_test.ipv4_mask, MAX_ADDR_LEN, L"255.255.255.254");
+    StringCchCopyW(g_test.ipv4_gateway, MAX_ADDR_LEN, L"10.0.0.1");
+    ASSERT_EQ(0, validate_config(&g_test, &CUSTOM, &report));
+}
+
+TEST(test_ipv4_errors) {
+    ValidationReport report;
+
+    static_config();
+    StringCchCopyW(g_test.ipv4_mask, MAX_ADDR_LEN, L"255.0.255.0");
+    ASSERT_EQ(1, validate_config(&g_test, &CUSTOM, &report));
+    ASSERT(has_message(&report, L"IPv4 mask is not a contiguous netmask: 255.0.255.0"));
+
+    static_config();
+    StringCchCopyW(g_test.ipv4_gateway, MAX_ADDR_LEN, L"192.168.2.1");
+    ASSERT_EQ(1, validate_config(&g_test, &CUSTOM, &report));
+    ASSERT(has_message(&report, L"IPv4 gateway 192.168.2.1 is outside 192.168.1.10/24"));
+
+    static_config();
+    StringCchCopyW(g_test.ipv4_address, MAX_ADDR_LEN, L"192.168.1.255");
+    StringCchCopyW(g_test.ipv4_gateway, MAX_ADDR_LEN, L"192.168.1.10/24");
+    ASSERT_EQ(2, validate_config(&g_test, &CUSTOM, &report));
+    ASSERT(has_message(&report, L"broadcast address of its /24"));
+    ASSERT(has_message(&report, L"IPv4 gateway is not valid: 192.168.1.10/24"));
+
+    static_config();
+    StringCchCopyW(g_test.ipv4_address, MAX_ADDR_LEN, L"192.168.1.300");
+    ASSERT_EQ(1, validate_config(&g_test, &CUSTOM, &report));
+    ASSERT(has_message(&report, L"IPv4 address is not valid: 192.168.1.300"));
+}
+
+TEST(test_ipv6_errors) {
+    ValidationReport report;
+
+    static_config();
+    StringCchCopyW(g_test.ipv6_prefix, 16, L"129");
+    ASSERT_EQ(1, validate_config(&g_test, &CUSTOM, &report));
+    ASSERT(has_message(&report, L"IPv6 prefix length must be 1-128: 129"));
+
+    static_config();
+    StringCchCopyW(g_test.ipv6_gateway, MAX_ADDR_LEN, L"2001:db9::1");
+    ASSERT_EQ(1, validate_config(&g_test, &CUSTOM, &report));
+    ASSERT(has_message(&report, L"outside 2001:db8::10/64 and not link-local"));
+
+    static_config();
+    StringCchCopyW(g_test.ipv6_address, MAX_ADDR_LEN, L"192.168.1.10");
+    ASSERT_EQ(1, validate_config(&g_test, &CUSTOM, &report));
+    ASSERT(has_message(&report, L"IPv6 address is not valid"));
+}
+
+TEST(test_dns_only_skips_addresses) {
+    ValidationReport report;
+
+    static_config();
+    StringCchCopyW(g_test.ipv4_mask, MAX_ADDR_LEN, L"255.0.255.0");
+    g_test.dns_only = 1;
+    ASSERT_EQ(0, validate_config(&g_test, &CUSTOM, &report));
+}
+
+TEST(test_invalid_address_entries) {
+    ValidationReport report;
+
+    static_config();
+    g_test.ipv4_addresses.invalid = 1;
+    g_test.ipv6_addresses.invalid = 2;
+    ASSERT_EQ(2, validate_config(&g_test, &CUSTOM, &report));
+    ASSERT(has_message(&report, L"[ipv4.addresses] has 1 entry(ies)"));
+    ASSERT(has_message(&report, L"[ipv6.addresses] has 2 entry(ies)"));
+
+    /* Secondaries are not applied in DNS-only mode */
+    g_test.dns_only = 1;
+    ASSERT_EQ(0, validate_config(&g_test, &CUSTOM, &report));
+}
+
+TEST(test_server_errors) {
+    ValidationReport report;
+    DnsProvider provider = CUSTOM;
+
+    provider.ipv4_secondary = L"9.9.9.9";
+    provider.ipv6_primary = L"2620:00fe:0::9";
+    ASSERT_EQ(2, validate_config(static_config(), &provider, &report));
+    ASSERT(has_message(&report, L"Custom: IPv4 DNS server 9.9.9.9 is listed twice"));
+    ASSERT(has_message(&report, L"Custom: IPv6 DNS server 2620:00fe:0::9 is listed twice"));
+
+    provider = CUSTOM;
+    provider.ipv4_primary = L"2620:fe::fe";
+    provider.ipv6_secondary = L"";
+    ASSERT_EQ(2, validate_config(&g_test, &provider, &report));
+    ASSERT(has_message(&report, L"Custom: IPv4 primary DNS server is not valid: 2620:fe::fe"));
+    ASSERT(has_message(&report, L"Custom: IPv6 secondary DNS server is missing"));
+}
+
+TEST(test_reports_every_error) {
+    ValidationReport report;
+    DnsProvider provider = CUSTOM;
+
+    static_config();
+    StringCchCopyW(g_test.ipv4_gateway, MAX_ADDR_LEN, L"10.1.1.1");
+    StringCchCopyW(g_test.ipv6_prefix, 16, L"0");
+    provider.ipv4_secondary = L"1.1.1";
+    provider.doh_template = L"http://dns.quad9.net/dns-query";
+
+    ASSERT_EQ(4, validate_config(&g_test, &provider, &report));
+    ASSERT(has_message(&report, L"Custom: DoH template http://dns.quad9.net/dns-query must start with https://"));
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* DoH template tests */
+    RUN_TEST(test_doh_template_valid);
+    RUN_TEST(test_doh_template_invalid);
+
+    /* config tests */
+    RUN_TEST(test_valid_config);
+    RUN_TEST(test_ipv4_errors);
+    RUN_TEST(test_ipv6_errors);
+    RUN_TEST(test_dns_only_skips_addresses);
+    RUN_TEST(test_invalid_address_entries);
+    RUN_TEST(test_server_errors);
+    RUN_TEST(test_reports_every_error);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
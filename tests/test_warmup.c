@@ -0,0 +1,183 @@
+/*
+ * test_warmup.c - Tests for the resolver cache warm-up
+ *
+ * Names are resolved over UDP against a stub DNS server on the loopback
+ * interface instead of the system resolver.
+ */
+
+#include "warmup.h"
+#include "test.h"
+#include "stub_dns.h"
+#include <string.h>
+
+/* ============================================================================
+ * LOOPBACK RESOLVER
+ * ============================================================================ */
+
+typedef struct {
+    ProbeTarget target;
+    int timeout_ms;
+    int upstream_ms;            /* Extra latency per name, like a cold cache */
+    volatile LONG in_flight;
+    volatile LONG max_in_flight;
+    volatile LONG next_id;
+} LoopbackResolver;
+
+static int loopback_resolve(void *ctx, const char *name)
+{
+    LoopbackResolver *lr = (LoopbackResolver *)ctx;
+    unsigned short id = (unsigned short)InterlockedIncrement(&lr->next_id);
+    unsigned char query[512], answer[512];
+    SOCKET sock;
+    fd_set readable;
+    struct timeval tv = { lr->timeout_ms / 1000, (lr->timeout_ms % 1000) * 1000 };
+    int qlen, len = -1;
+    LONG now = InterlockedIncrement(&lr->in_flight);
+
+    /* Track the highest number of names in flight at once */
+    for (LONG seen = lr->max_in_flight; now > seen; seen = lr->max_in_flight) {
+        InterlockedCompareExchange(&lr->max_in_flight, now, seen);
+    }
+
+    qlen = probe_build_query(name, id, query, sizeof(query));
+    sock = probe_open_socket(&lr->target);
+    if (qlen > 0 && sock != INVALID_SOCKET && send(sock, (const char *)query, qlen, 0) == qlen) {
+        FD_ZERO(&readable);
+        FD_SET(sock, &readable);
+        if (select((int)sock + 1, &readable, NULL, NULL, &tv) > 0) {
+            len = recv(sock, (char *)answer, sizeof(answer), 0);
+        }
+    }
+    if (sock != INVALID_SOCKET) {
+        closesocket(sock);
+    }
+    Sleep(lr->upstream_ms);
+
+    InterlockedDecrement(&lr->in_flight);
+    return len >= 12 && answer[0] == (id >> 8) && answer[1] == (id & 0xFF) && (answer[2] & 0x80) ? 0 : -1;
+}
+
+static void loopback_resolver(WarmupResolver *resolver, LoopbackResolver *lr,
+                              const StubServer *stub, int timeout_ms, int upstream_ms)
+{
+    ZeroMemory(lr, sizeof(*lr));
+    lr->target.server = L"127.0.0.1";
+    lr->target.port = stub->port;
+    lr->timeout_ms = timeout_ms;
+    lr->upstream_ms = upstream_ms;
+
+    resolver->ctx = lr;
+    resolver->resolve = loopback_resolve;
+}
+
+/* ============================================================================
+ * OPTION TESTS
+ * ============================================================================ */
+
+TEST(test_set_names) {
+    WarmupOptions opts;
+
+    warmup_options_init(&opts);
+    ASSERT_EQ(0, opts.name_count);
+    ASSERT_EQ(WARMUP_DEFAULT_CONCURRENCY, opts.concurrency);
+
+    ASSERT_EQ(0, warmup_set_names(&opts, L"example.com, api.example.net,login.example.org"));
+    ASSERT_EQ(3, opts.name_count);
+    ASSERT(strcmp(opts.names[1], "api.example.net") == 0);
+
+    /* Non-ASCII names are dropped, the rest are kept */
+    ASSERT_EQ(-1, warmup_set_names(&opts, L"b\x00fccher.example, example.com"));
+    ASSERT_EQ(1, opts.name_count);
+    ASSERT(strcmp(opts.names[0], "example.com") == 0);
+}
+
+/* ============================================================================
+ * WARM-UP TESTS
+ * ============================================================================ */
+
+TEST(test_resolves_concurrently) {
+    StubServer stub;
+    LoopbackResolver lr;
+    WarmupResolver resolver;
+    WarmupOptions opts;
+    WarmupResult results[WARMUP_MAX_NAMES];
+    double total_ms;
+
+    ASSERT_EQ(0, stub_start(&stub, 0, 0));
+    loopback_resolver(&resolver, &lr, &stub, 1000, 100);
+
+    warmup_options_init(&opts);
+    warmup_set_names(&opts, L"a.example, b.example, c.example, d.example, "
+                            L"e.example, f.example, g.example, h.example");
+    opts.concurrency = 4;
+
+    ASSERT_EQ(8, warmup_resolve_all(&resolver, &opts, results, &total_ms));
+    ASSERT_EQ(8, (int)stub.queries);
+    ASSERT_EQ(4, (int)lr.max_in_flight);
+
+    /* Two rounds of 100 ms, not eight */
+    ASSERT(total_ms >= 190.0);
+    ASSERT(total_ms < 500.0);
+    for (int i = 0; i < 8; i++) {
+        ASSERT(results[i].ok);
+        ASSERT(results[i].ms >= 95.0);
+    }
+
+    stub_stop(&stub);
+}
+
+TEST(test_reports_failures) {
+    StubServer silent;
+    LoopbackResolver lr;
+    WarmupResolver resolver;
+    WarmupOptions opts;
+    WarmupResult results[WARMUP_MAX_NAMES];
+    double total_ms;
+
+    ASSERT_EQ(0, stub_start(&silent, 0, 1));
+    loopback_resolver(&resolver, &lr, &silent, 150, 0);
+
+    warmup_options_init(&opts);
+    warmup_set_names(&opts, L"a.example, b.example, c.example");
+
+    ASSERT_EQ(0, warmup_resolve_all(&resolver, &opts, results, &total_ms));
+    ASSERT_EQ(3, (int)silent.queries);
+    for (int i = 0; i < 3; i++) {
+        ASSERT(!results[i].ok);
+        ASSERT(results[i].ms >= 140.0);
+    }
+
+    /* All three time out together */
+    ASSERT(total_ms < 400.0);
+
+    stub_stop(&silent);
+}
+
+TEST(test_nothing_to_do) {
+    WarmupResolver resolver = { NULL, NULL };
+    WarmupOptions opts;
+    WarmupResult results[WARMUP_MAX_NAMES];
+    double total_ms;
+
+    warmup_options_init(&opts);
+    ASSERT_EQ(-1, warmup_resolve_all(&resolver, &opts, results, &total_ms));
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* option tests */
+    RUN_TEST(test_set_names);
+
+    /* warm-up tests */
+    RUN_TEST(test_resolves_concurrently);
+    RUN_TEST(test_reports_failures);
+    RUN_TEST(test_nothing_to_do);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,280 @@
+/*
+ * test_watch.c - Tests for the watch mode event loop and drift detection
+ *
+ * The loop is driven by a simulated event source: a thread that plays a
+ * script of change events, then asks the loop to stop.
+ */
+
+#include "watch.h"
+#include "test.h"
+#include <string.h>
+
+/* ============================================================================
+ * SIMULATED EVENT SOURCE
+ * ============================================================================ */
+
+typedef struct {
+    int delay_ms;           /* Sleep before firing */
+    int fire;               /* 1 = change event, 0 = stop the loop */
+} ScriptStep;
+
+typedef struct {
+    const ScriptStep *steps;
+    int step_count;
+    HANDLE event;
+    HANDLE stop;
+    HANDLE thread;
+    int started;
+    int stopped;
+} SimSource;
+
+static DWORD WINAPI sim_thread(LPVOID param)
+{
+    SimSource *sim = (SimSource *)param;
+
+    for (int i = 0; i < sim->step_count; i++) {
+        Sleep(sim->steps[i].delay_ms);
+        SetEvent(sim->steps[i].fire ? sim->event : sim->stop);
+    }
+    return 0;
+}
+
+static int sim_start(void *ctx, HANDLE event)
+{
+    SimSource *sim = (SimSource *)ctx;
+
+    sim->event = event;
+    sim->started++;
+    sim->thread = CreateThread(NULL, 0, sim_thread, sim, 0, NULL);
+    return sim->thread ? 0 : -1;
+}
+
+static void sim_stop(void *ctx)
+{
+    SimSource *sim = (SimSource *)ctx;
+
+    WaitForSingleObject(sim->thread, INFINITE);
+    CloseHandle(sim->thread);
+    sim->stopped++;
+}
+
+static int sim_fail_start(void *ctx, HANDLE event)
+{
+    (void)ctx;
+    (void)event;
+    return -1;
+}
+
+typedef struct {
+    int changes;
+    int periodic;
+} HandlerLog;
+
+static int log_handler(void *ctx, WatchReason reason)
+{
+    HandlerLog *log = (HandlerLog *)ctx;
+
+    if (reason == WATCH_CHANGE) {
+        log->changes++;
+    } else {
+        log->periodic++;
+    }
+    return 0;
+}
+
+/*
+ * Play `steps` against the loop and record the handler calls
+ */
+static int run_script(const ScriptStep *steps, int count, const WatchOptions *opts,
+                      HandlerLog *log, SimSource *sim)
+{
+    WatchSource source;
+    int ret;
+
+    ZeroMemory(sim, sizeof(*sim));
+    ZeroMemory(log, sizeof(*log));
+    sim->steps = steps;
+    sim->step_count = count;
+    sim->stop = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    source.ctx = sim;
+    source.start = sim_start;
+    source.stop = sim_stop;
+
+    ret = watch_loop(&source, opts, sim->stop, log_handler, log);
+    CloseHandle(sim->stop);
+    return ret;
+}
+
+static void test_options(WatchOptions *opts, int debounce_ms, int max_delay_ms, int interval_ms)
+{
+    watch_options_init(opts);
+    opts->debounce_ms = debounce_ms;
+    opts->max_delay_ms = max_delay_ms;
+    opts->interval_ms = interval_ms;
+}
+
+/* ============================================================================
+ * EVENT LOOP TESTS
+ * ============================================================================ */
+
+TEST(test_burst_is_debounced) {
+    /* Two bursts, like an adapter reset followed by a VPN connect */
+    static const ScriptStep steps[] = {
+        { 10, 1 }, { 5, 1 }, { 5, 1 }, { 5, 1 }, { 5, 1 },
+        { 300, 1 }, { 5, 1 }, { 5, 1 },
+        { 300, 0 }
+    };
+    WatchOptions opts;
+    HandlerLog log;
+    SimSource sim;
+
+    test_options(&opts, 80, 5000, 0);
+    ASSERT_EQ(0, run_script(steps, 9, &opts, &log, &sim));
+    ASSERT_EQ(2, log.changes);
+    ASSERT_EQ(0, log.periodic);
+    ASSERT_EQ(1, sim.started);
+    ASSERT_EQ(1, sim.stopped);
+}
+
+TEST(test_endless_burst_hits_max_delay) {
+    ScriptStep steps[41];
+    WatchOptions opts;
+    HandlerLog log;
+    SimSource sim;
+
+    /* Events every 20 ms never leave a 100 ms quiet gap */
+    for (int i = 0; i < 40; i++) {
+        steps[i].delay_ms = 20;
+        steps[i].fire = 1;
+    }
+    steps[40].delay_ms = 50;
+    steps[40].fire = 0;
+
+    test_options(&opts, 100, 200, 0);
+    ASSERT_EQ(0, run_script(steps, 41, &opts, &log, &sim));
+    ASSERT(log.changes >= 2);
+    ASSERT(log.changes <= 5);
+}
+
+TEST(test_stop_during_burst) {
+    static const ScriptStep steps[] = { { 10, 1 }, { 10, 0 } };
+    WatchOptions opts;
+    HandlerLog log;
+    SimSource sim;
+
+    /* The loop exits without acting on a burst cut short by the stop */
+    test_options(&opts, 500, 5000, 0);
+    ASSERT_EQ(0, run_script(steps, 2, &opts, &log, &sim));
+    ASSERT_EQ(0, log.changes);
+    ASSERT_EQ(1, sim.stopped);
+}
+
+TEST(test_periodic_check) {
+    static const ScriptStep steps[] = { { 275, 0 } };
+    WatchOptions opts;
+    HandlerLog log;
+    SimSource sim;
+
+    test_options(&opts, 50, 1000, 50);
+    ASSERT_EQ(0, run_script(steps, 1, &opts, &log, &sim));
+    ASSERT_EQ(0, log.changes);
+    ASSERT(log.periodic >= 4);
+    ASSERT(log.periodic <= 6);
+}
+
+TEST(test_idle_without_interval) {
+    static const ScriptStep steps[] = { { 150, 0 } };
+    WatchOptions opts;
+    HandlerLog log;
+    SimSource sim;
+
+    test_options(&opts, 50, 1000, 0);
+    ASSERT_EQ(0, run_script(steps, 1, &opts, &log, &sim));
+    ASSERT_EQ(0, log.changes);
+    ASSERT_EQ(0, log.periodic);
+}
+
+TEST(test_source_start_failure) {
+    WatchSource source = { NULL, sim_fail_start, sim_stop };
+    WatchOptions opts;
+    HandlerLog log = { 0, 0 };
+    HANDLE stop = CreateEventW(NULL, TRUE, TRUE, NULL);
+
+    watch_options_init(&opts);
+    ASSERT_EQ(-1, watch_loop(&source, &opts, stop, log_handler, &log));
+    ASSERT_EQ(0, log.changes + log.periodic);
+    CloseHandle(stop);
+}
+
+/* ============================================================================
+ * DRIFT DETECTION TESTS
+ * ============================================================================ */
+
+static void make_list(IpAddrList *list, const wchar_t *const *servers, int count)
+{
+    ZeroMemory(list, sizeof(*list));
+    for (int i = 0; i < count; i++) {
+        IpAddr addr;
+        address_parse(servers[i], &addr);
+        address_list_add(list, &addr);
+    }
+}
+
+TEST(test_servers_match) {
+    static const wchar_t *const current[] = { L"1.1.1.1", L"1.0.0.1", L"192.168.1.1" };
+    IpAddrList list;
+
+    make_list(&list, current, 3);
+    ASSERT_EQ(1, watch_servers_match(L"1.1.1.1", L"1.0.0.1", &list));
+    ASSERT_EQ(1, watch_servers_match(L"1.1.1.1", L"", &list));
+    ASSERT_EQ(0, watch_servers_match(L"1.0.0.1", L"1.1.1.1", &list));
+    ASSERT_EQ(0, watch_servers_match(L"8.8.8.8", L"8.8.4.4", &list));
+    address_list_free(&list);
+}
+
+TEST(test_servers_match_ipv6_spelling) {
+    static const wchar_t *const current[] = { L"2606:4700:4700:0:0:0:0:1111", L"2606:4700:4700::1001" };
+    IpAddrList list;
+
+    make_list(&list, current, 2);
+    ASSERT_EQ(1, watch_servers_match(L"2606:4700:4700::1111", L"2606:4700:4700::1001", &list));
+    address_list_free(&list);
+}
+
+TEST(test_servers_reset_to_dhcp) {
+    static const wchar_t *const current[] = { L"192.168.1.1" };
+    IpAddrList list;
+
+    make_list(&list, current, 1);
+    ASSERT_EQ(0, watch_servers_match(L"1.1.1.1", L"1.0.0.1", &list));
+    address_list_free(&list);
+
+    ZeroMemory(&list, sizeof(list));
+    ASSERT_EQ(0, watch_servers_match(L"1.1.1.1", L"1.0.0.1", &list));
+    ASSERT_EQ(1, watch_servers_match(L"", L"", &list));
+}
+
+/* ============================================================================
+ * MAIN
+ * ============================================================================ */
+
+int main(void) {
+    TEST_INIT();
+
+    /* event loop tests */
+    RUN_TEST(test_burst_is_debounced);
+    RUN_TEST(test_endless_burst_hits_max_delay);
+    RUN_TEST(test_stop_during_burst);
+    RUN_TEST(test_periodic_check);
+    RUN_TEST(test_idle_without_interval);
+    RUN_TEST(test_source_start_failure);
+
+    /* drift detection tests */
+    RUN_TEST(test_servers_match);
+    RUN_TEST(test_servers_match_ipv6_spelling);
+    RUN_TEST(test_servers_reset_to_dhcp);
+
+    TEST_REPORT();
+    return TEST_EXIT_CODE();
+}